@@ -143,8 +143,14 @@ def get_arg_names(args):
     return [starred_name.strip("* ") for starred_name in starred_names]
 
 def get_func_boilerplate(fn_info):
-    call_args_str = ", ".join(get_arg_names(fn_info.args))
+    arg_names = get_arg_names(fn_info.args)
+    call_args_str = ", ".join(arg_names)
     args_ann_unused = fn_info.args.replace(",", " G_GNUC_UNUSED,")
+    # functions without the error argument (e.g. copy and free functions of
+    # opaque types implemented by the plugin) can only log the error
+    has_error = "error" in arg_names
+    if arg_names and not has_error:
+        args_ann_unused += " G_GNUC_UNUSED"
 
     if "int" in fn_info.rtype:
         default_ret = "0"
@@ -155,17 +161,21 @@ def get_func_boilerplate(fn_info):
     elif fn_info.rtype.endswith("*"):
         # a pointer
         default_ret = "NULL"
+    elif fn_info.rtype.strip() == "void":
+        default_ret = None
     else:
         # enum or whatever
         default_ret = 0
 
     # first add the stub function doing nothing and just reporting error
-    ret = ("static {0.rtype} {0.name}_stub ({2}) {{\n" +
-           "    bd_utils_log_format (BD_UTILS_LOG_CRIT, \"The function '{0.name}' called, but not implemented!\");\n" +
-           "    g_set_error (error, BD_INIT_ERROR, BD_INIT_ERROR_NOT_IMPLEMENTED,\n"+
-           "                \"The function '{0.name}' called, but not implemented!\");\n"
-           "    return {1};\n"
-           "}}\n\n").format(fn_info, default_ret, args_ann_unused)
+    ret = ("static {0.rtype} {0.name}_stub ({1}) {{\n" +
+           "    bd_utils_log_format (BD_UTILS_LOG_CRIT, \"The function '{0.name}' called, but not implemented!\");\n").format(fn_info, args_ann_unused)
+    if has_error:
+        ret += ("    g_set_error (error, BD_INIT_ERROR, BD_INIT_ERROR_NOT_IMPLEMENTED,\n" +
+                "                \"The function '{0.name}' called, but not implemented!\");\n").format(fn_info)
+    if default_ret is not None:
+        ret += "    return {0};\n".format(default_ret)
+    ret += "}\n\n"
 
     # then add a variable holding a reference to the dynamically loaded function
     # (if any) initialized to the stub
@@ -174,8 +184,8 @@ def get_func_boilerplate(fn_info):
     # then add a documented function calling the dynamically loaded one via the
     # reference
     ret += ("{0.doc}{0.rtype} {0.name} ({0.args}) {{\n" +
-            "    return _{0.name} ({1});\n" +
-            "}}\n\n\n").format(fn_info, call_args_str)
+            "    {1}_{0.name} ({2});\n" +
+            "}}\n\n\n").format(fn_info, "" if default_ret is None else "return ", call_args_str)
 
     return ret
 
@@ -17,17 +17,23 @@
  * Author: Vratislav Podzimek <vpodzime@redhat.com>
  */
 
+#define _GNU_SOURCE
 #include <string.h>
+#include <stdlib.h>
 #include <glib.h>
 #include <libcryptsetup.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fs.h>
 #include <linux/random.h>
 #include <locale.h>
 #include <unistd.h>
 #include <errno.h>
 #include <blkid.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/random.h>
 #include <keyutils.h>
 #include <blockdev/utils.h>
 
@@ -55,6 +61,12 @@
 
 #define DEFAULT_OPAL_KEYSIZE_BITS 256
 
+/* the maximum number of parallel jobs bd_crypto_luks_header_info_many() chooses */
+#define HEADER_INFO_MAX_JOBS 16
+
+/* the maximum number of parallel jobs bd_crypto_integrity_format_parallel() chooses */
+#define INTEGRITY_WIPE_MAX_JOBS 16
+
 #define SQUARE_LOWER_LIMIT 136
 #define SQUARE_UPPER_LIMIT 426
 #define SQUARE_BYTES_TO_CHECK 512
@@ -307,6 +319,168 @@ BDCryptoLUKSTokenInfo* bd_crypto_luks_token_info_copy (BDCryptoLUKSTokenInfo *in
     return new_info;
 }
 
+void bd_crypto_luks_keyslot_info_free (BDCryptoLUKSKeyslotInfo *info) {
+    if (info == NULL)
+        return;
+
+    g_free (info->pbkdf);
+    g_free (info);
+}
+
+BDCryptoLUKSKeyslotInfo* bd_crypto_luks_keyslot_info_copy (BDCryptoLUKSKeyslotInfo *info) {
+    if (info == NULL)
+        return NULL;
+
+    BDCryptoLUKSKeyslotInfo *new_info = g_new0 (BDCryptoLUKSKeyslotInfo, 1);
+
+    new_info->id = info->id;
+    new_info->last = info->last;
+    new_info->unbound = info->unbound;
+    new_info->pbkdf = g_strdup (info->pbkdf);
+
+    return new_info;
+}
+
+void bd_crypto_luks_header_info_free (BDCryptoLUKSHeaderInfo *info) {
+    BDCryptoLUKSKeyslotInfo **keyslot_p = NULL;
+    BDCryptoLUKSTokenInfo **token_p = NULL;
+
+    if (info == NULL)
+        return;
+
+    g_free (info->device);
+    bd_crypto_luks_info_free (info->info);
+    for (keyslot_p = info->keyslots; keyslot_p && *keyslot_p; keyslot_p++)
+        bd_crypto_luks_keyslot_info_free (*keyslot_p);
+    g_free (info->keyslots);
+    for (token_p = info->tokens; token_p && *token_p; token_p++)
+        bd_crypto_luks_token_info_free (*token_p);
+    g_free (info->tokens);
+    g_free (info);
+}
+
+BDCryptoLUKSHeaderInfo* bd_crypto_luks_header_info_copy (BDCryptoLUKSHeaderInfo *info) {
+    guint i = 0;
+
+    if (info == NULL)
+        return NULL;
+
+    BDCryptoLUKSHeaderInfo *new_info = g_new0 (BDCryptoLUKSHeaderInfo, 1);
+
+    new_info->device = g_strdup (info->device);
+    new_info->info = bd_crypto_luks_info_copy (info->info);
+    if (info->keyslots) {
+        new_info->keyslots = g_new0 (BDCryptoLUKSKeyslotInfo *, g_strv_length ((gchar **) info->keyslots) + 1);
+        for (i = 0; info->keyslots[i]; i++)
+            new_info->keyslots[i] = bd_crypto_luks_keyslot_info_copy (info->keyslots[i]);
+    }
+    if (info->tokens) {
+        new_info->tokens = g_new0 (BDCryptoLUKSTokenInfo *, g_strv_length ((gchar **) info->tokens) + 1);
+        for (i = 0; info->tokens[i]; i++)
+            new_info->tokens[i] = bd_crypto_luks_token_info_copy (info->tokens[i]);
+    }
+
+    return new_info;
+}
+
+void bd_crypto_luks_open_result_free (BDCryptoLUKSOpenResult *result) {
+    if (result == NULL)
+        return;
+
+    g_free (result->device);
+    g_free (result->name);
+    g_free (result->error_msg);
+    g_free (result);
+}
+
+BDCryptoLUKSOpenResult* bd_crypto_luks_open_result_copy (BDCryptoLUKSOpenResult *result) {
+    if (result == NULL)
+        return NULL;
+
+    BDCryptoLUKSOpenResult *new_result = g_new0 (BDCryptoLUKSOpenResult, 1);
+
+    new_result->device = g_strdup (result->device);
+    new_result->name = g_strdup (result->name);
+    new_result->success = result->success;
+    new_result->error_msg = g_strdup (result->error_msg);
+    new_result->kdf_memory = result->kdf_memory;
+    new_result->wait_time = result->wait_time;
+    new_result->duration = result->duration;
+
+    return new_result;
+}
+
+void bd_crypto_tune_result_free (BDCryptoTuneResult *result) {
+    g_free (result);
+}
+
+BDCryptoTuneResult* bd_crypto_tune_result_copy (BDCryptoTuneResult *result) {
+    if (result == NULL)
+        return NULL;
+
+    BDCryptoTuneResult *new_result = g_new0 (BDCryptoTuneResult, 1);
+
+    new_result->flags = result->flags;
+    new_result->sector_size = result->sector_size;
+    new_result->seq_read = result->seq_read;
+    new_result->seq_write = result->seq_write;
+    new_result->rand_read_latency = result->rand_read_latency;
+    new_result->rand_write_latency = result->rand_write_latency;
+    new_result->total_time = result->total_time;
+
+    return new_result;
+}
+
+BDCryptoLUKSReencryptParams* bd_crypto_luks_reencrypt_params_copy (BDCryptoLUKSReencryptParams *params) {
+    if (params == NULL)
+        return NULL;
+
+    BDCryptoLUKSReencryptParams *new_params = g_new0 (BDCryptoLUKSReencryptParams, 1);
+
+    new_params->mode = params->mode;
+    new_params->cipher = g_strdup (params->cipher);
+    new_params->key_size = params->key_size;
+    new_params->sector_size = params->sector_size;
+    new_params->pbkdf = bd_crypto_luks_pbkdf_copy (params->pbkdf);
+    new_params->header = g_strdup (params->header);
+    new_params->resilience = g_strdup (params->resilience);
+    new_params->hash = g_strdup (params->hash);
+    new_params->max_hotzone_size = params->max_hotzone_size;
+    new_params->device_size = params->device_size;
+    new_params->max_rate = params->max_rate;
+
+    return new_params;
+}
+
+void bd_crypto_luks_reencrypt_params_free (BDCryptoLUKSReencryptParams *params) {
+    if (params == NULL)
+        return;
+
+    g_free (params->cipher);
+    bd_crypto_luks_pbkdf_free (params->pbkdf);
+    g_free (params->header);
+    g_free (params->resilience);
+    g_free (params->hash);
+    g_free (params);
+}
+
+BDCryptoLUKSReencryptParams* bd_crypto_luks_reencrypt_params_new (BDCryptoLUKSReencryptMode mode, const gchar *cipher, guint64 key_size, guint32 sector_size, BDCryptoLUKSPBKDF *pbkdf, const gchar *header, const gchar *resilience, const gchar *hash, guint64 max_hotzone_size, guint64 device_size, guint64 max_rate) {
+    BDCryptoLUKSReencryptParams *ret = g_new0 (BDCryptoLUKSReencryptParams, 1);
+    ret->mode = mode;
+    ret->cipher = g_strdup (cipher);
+    ret->key_size = key_size;
+    ret->sector_size = sector_size;
+    ret->pbkdf = bd_crypto_luks_pbkdf_copy (pbkdf);
+    ret->header = g_strdup (header);
+    ret->resilience = g_strdup (resilience);
+    ret->hash = g_strdup (hash);
+    ret->max_hotzone_size = max_hotzone_size;
+    ret->device_size = device_size;
+    ret->max_rate = max_rate;
+
+    return ret;
+}
+
 /* "C" locale to get the locale-agnostic error messages */
 static locale_t c_locale = (locale_t) 0;
 
@@ -360,6 +534,8 @@ gboolean bd_crypto_init (void) {
  *
  */
 void bd_crypto_close (void) {
+    bd_crypto_set_keyslot_cache (FALSE, NULL);
+    bd_crypto_set_pbkdf_cache (FALSE, NULL);
     c_locale = (locale_t) 0;
     crypt_set_log_callback (NULL, NULL, NULL);
     crypt_set_debug_level (CRYPT_DEBUG_NONE);
@@ -378,12 +554,20 @@ gboolean bd_crypto_is_tech_avail (BDCryptoTech tech, guint64 mode, GError **erro
     guint64 ret = 0;
     switch (tech) {
         case BD_CRYPTO_TECH_LUKS:
+#ifndef LIBCRYPTSETUP_24
+            if (mode & BD_CRYPTO_TECH_MODE_REENCRYPT) {
+                g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                             "LUKS re-encryption requires libcryptsetup >= 2.4.0");
+                return FALSE;
+            }
+#endif
             ret = mode & (BD_CRYPTO_TECH_MODE_CREATE|BD_CRYPTO_TECH_MODE_OPEN_CLOSE|BD_CRYPTO_TECH_MODE_QUERY|
                           BD_CRYPTO_TECH_MODE_ADD_KEY|BD_CRYPTO_TECH_MODE_REMOVE_KEY|BD_CRYPTO_TECH_MODE_RESIZE|
-                          BD_CRYPTO_TECH_MODE_SUSPEND_RESUME|BD_CRYPTO_TECH_MODE_BACKUP_RESTORE);
+                          BD_CRYPTO_TECH_MODE_SUSPEND_RESUME|BD_CRYPTO_TECH_MODE_BACKUP_RESTORE|
+                          BD_CRYPTO_TECH_MODE_REENCRYPT);
             if (ret != mode) {
                 g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
-                             "Only 'create', 'open', 'query', 'add-key', 'remove-key', 'resize', 'suspend-resume', 'backup-restore' supported for LUKS");
+                             "Only 'create', 'open', 'query', 'add-key', 'remove-key', 'resize', 'suspend-resume', 'backup-restore', 'reencrypt' supported for LUKS");
                 return FALSE;
             } else
                 return TRUE;
@@ -458,6 +642,14 @@ gboolean bd_crypto_is_tech_avail (BDCryptoTech tech, guint64 mode, GError **erro
                 return FALSE;
             } else
                 return TRUE;
+        case BD_CRYPTO_TECH_PLAIN:
+            ret = mode & BD_CRYPTO_TECH_MODE_OPEN_CLOSE;
+            if (ret != mode) {
+                g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                             "Only 'open' supported for plain dm-crypt");
+                return FALSE;
+            } else
+                return TRUE;
         default:
             g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL, "Unknown technology");
             return FALSE;
@@ -740,9 +932,34 @@ typedef enum {
     BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_VOLUME_KEY,
 } BDCryptoKeyslotContextType;
 
+/* public part of the secrets of keyslot contexts (see crypto.api), all the
+   library needs to share them between copies of a context and to drop them */
+typedef struct BDCryptoSecret {
+    gint ref_count;
+    void (*release) (struct BDCryptoSecret *secret);
+} BDCryptoSecret;
+
+/* storage for the secrets (passphrase, volume key or key file contents) of
+   keyslot contexts, locked in memory, excluded from core dumps, shared by all
+   copies of a context and wiped when the last of them is freed */
+typedef struct BDCryptoSecureBuffer {
+    BDCryptoSecret parent;
+    gsize size;
+    gsize map_size;
+    guint8 *data;
+} BDCryptoSecureBuffer;
+
 struct _BDCryptoKeyslotContext {
     BDCryptoKeyslotContextType type;
 
+    /* keyslot/token to try first when unlocking, CRYPT_ANY_SLOT/CRYPT_ANY_TOKEN if not set */
+    gint keyslot_hint;
+    gint token_hint;
+
+    /* pass_data/volume_key point to the data of the secret (a BDCryptoSecureBuffer),
+       the key file is loaded into it when the context is first used */
+    BDCryptoSecret *secret;
+
     union {
         struct {
             guint8 *pass_data;
@@ -766,18 +983,99 @@ struct _BDCryptoKeyslotContext {
     } u;
 };
 
+/* protects loading of key files into contexts' secrets */
+static GMutex keyfile_lock;
+
+static gboolean secure_buffer_alloc (BDCryptoSecureBuffer *buffer, const guint8 *data, gsize size) {
+    gsize page_size = (gsize) sysconf (_SC_PAGESIZE);
+    gsize map_size = (MAX (size, 1) + page_size - 1) / page_size * page_size;
+    guint8 *map = NULL;
+
+    map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return FALSE;
+
+    /* not being able to lock the memory (e.g. because of RLIMIT_MEMLOCK) is not
+       fatal, the secret is still kept out of core dumps and wiped when freed */
+    if (mlock (map, map_size) != 0)
+        bd_utils_log_format (BD_UTILS_LOG_DEBUG, "Failed to lock memory for a secret: %s", strerror_l (errno, c_locale));
+    if (madvise (map, map_size, MADV_DONTDUMP) != 0)
+        bd_utils_log_format (BD_UTILS_LOG_DEBUG, "Failed to exclude a secret from core dumps: %s", strerror_l (errno, c_locale));
+
+    memcpy (map, data, size);
+    buffer->data = map;
+    buffer->size = size;
+    buffer->map_size = map_size;
+
+    return TRUE;
+}
+
+static void secure_buffer_release (BDCryptoSecret *secret) {
+    BDCryptoSecureBuffer *buffer = (BDCryptoSecureBuffer *) secret;
+
+    if (buffer->data) {
+        explicit_bzero (buffer->data, buffer->map_size);
+        munmap (buffer->data, buffer->map_size);
+    }
+    g_free (buffer);
+}
+
+/* creates a new secure buffer with a copy of @data, or an empty one to be
+   filled later if @data is %NULL */
+static BDCryptoSecureBuffer* secure_buffer_new (const guint8 *data, gsize size, GError **error) {
+    BDCryptoSecureBuffer *buffer = g_new0 (BDCryptoSecureBuffer, 1);
+
+    buffer->parent.ref_count = 1;
+    buffer->parent.release = secure_buffer_release;
+    if (data && !secure_buffer_alloc (buffer, data, size)) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_NO_KEY,
+                     "Failed to allocate memory for the key: %s", strerror_l (errno, c_locale));
+        g_free (buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+/* gets the key from the key file of @context, the key file is read only once
+   for a context and all its copies and the key is owned by @context */
+static gint keyfile_context_get_key (struct crypt_device *cd, BDCryptoKeyslotContext *context, gchar **key, gsize *key_len) {
+    BDCryptoSecureBuffer *secret = (BDCryptoSecureBuffer *) context->secret;
+    gchar *buffer = NULL;
+    gsize buffer_len = 0;
+    gint ret = 0;
+
+    g_mutex_lock (&keyfile_lock);
+    if (!secret->data) {
+        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &buffer, &buffer_len,
+                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+        if (ret == 0) {
+            if (!secure_buffer_alloc (secret, (const guint8 *) buffer, buffer_len))
+                ret = -ENOMEM;
+            crypt_safe_free (buffer);
+        }
+    }
+    g_mutex_unlock (&keyfile_lock);
+
+    if (ret == 0) {
+        *key = (gchar *) secret->data;
+        *key_len = secret->size;
+    }
+
+    return ret;
+}
+
 void bd_crypto_keyslot_context_free (BDCryptoKeyslotContext *context) {
     if (context == NULL)
         return;
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE)
-        g_free (context->u.passphrase.pass_data);
-    else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
+    if (context->secret && g_atomic_int_dec_and_test (&(context->secret->ref_count)))
+        context->secret->release (context->secret);
+
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
         g_free (context->u.keyfile.keyfile);
     else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING)
         g_free (context->u.keyring.key_desc);
-    else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_VOLUME_KEY)
-        g_free (context->u.volume_key.volume_key);
 
     g_free (context);
 }
@@ -788,10 +1086,17 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_copy (BDCryptoKeyslotContext *
 
     BDCryptoKeyslotContext *new_context = g_new0 (BDCryptoKeyslotContext, 1);
     new_context->type = context->type;
+    new_context->keyslot_hint = context->keyslot_hint;
+    new_context->token_hint = context->token_hint;
+
+    /* the secret is shared, not copied */
+    if (context->secret) {
+        g_atomic_int_inc (&(context->secret->ref_count));
+        new_context->secret = context->secret;
+    }
 
     if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        new_context->u.passphrase.pass_data = g_new0 (guint8, context->u.passphrase.data_len);
-        memcpy (new_context->u.passphrase.pass_data, context->u.passphrase.pass_data, context->u.passphrase.data_len);
+        new_context->u.passphrase.pass_data = context->u.passphrase.pass_data;
         new_context->u.passphrase.data_len = context->u.passphrase.data_len;
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
         new_context->u.keyfile.keyfile = g_strdup (context->u.keyfile.keyfile);
@@ -800,8 +1105,7 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_copy (BDCryptoKeyslotContext *
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING)
         new_context->u.keyring.key_desc = g_strdup (context->u.keyring.key_desc);
     else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_VOLUME_KEY) {
-        new_context->u.volume_key.volume_key = g_new0 (guint8, context->u.volume_key.volume_key_size);
-        memcpy (new_context->u.volume_key.volume_key, context->u.volume_key.volume_key, context->u.volume_key.volume_key_size);
+        new_context->u.volume_key.volume_key = context->u.volume_key.volume_key;
         new_context->u.volume_key.volume_key_size = context->u.volume_key.volume_key_size;
     }
 
@@ -821,6 +1125,7 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_copy (BDCryptoKeyslotContext *
  */
 BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_passphrase (const guint8 *pass_data, gsize data_len, GError **error) {
     BDCryptoKeyslotContext *context = NULL;
+    BDCryptoSecureBuffer *secret = NULL;
 
     if (!pass_data || data_len == 0) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_NO_KEY,
@@ -828,13 +1133,18 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_passphrase (const guint8 *
         return NULL;
     }
 
+    secret = secure_buffer_new (pass_data, data_len, error);
+    if (!secret)
+        return NULL;
+
     context = g_new0 (BDCryptoKeyslotContext, 1);
 
     context->type = BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE;
+    context->keyslot_hint = CRYPT_ANY_SLOT;
+    context->token_hint = CRYPT_ANY_TOKEN;
+    context->secret = &(secret->parent);
 
-    context->u.passphrase.pass_data = g_new0 (guint8, data_len);
-    memcpy (context->u.passphrase.pass_data, pass_data, data_len);
-
+    context->u.passphrase.pass_data = secret->data;
     context->u.passphrase.data_len = data_len;
 
     return context;
@@ -847,6 +1157,9 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_passphrase (const guint8 *
  * @key_size: number of bytes to read from @keyfile or 0 for unlimited
  * @error: (out) (optional): place to store error (if any)
  *
+ * The key is read from @keyfile when the context is used for the first time and
+ * it is then kept in locked memory and shared by all copies of the context.
+ *
  * Returns (transfer full): new %BDCryptoKeyslotContext initialized by key file or
  *                          %NULL in case of error
  *
@@ -858,6 +1171,10 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_keyfile (const gchar *keyf
     context = g_new0 (BDCryptoKeyslotContext, 1);
 
     context->type = BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE;
+    context->keyslot_hint = CRYPT_ANY_SLOT;
+    context->token_hint = CRYPT_ANY_TOKEN;
+    /* the key file is read when the context is used for the first time */
+    context->secret = &(secure_buffer_new (NULL, 0, NULL)->parent);
 
     context->u.keyfile.keyfile = g_strdup (keyfile);
     context->u.keyfile.keyfile_offset = keyfile_offset;
@@ -885,6 +1202,8 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_keyring (const gchar *key_
     context = g_new0 (BDCryptoKeyslotContext, 1);
 
     context->type = BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING;
+    context->keyslot_hint = CRYPT_ANY_SLOT;
+    context->token_hint = CRYPT_ANY_TOKEN;
 
     context->u.keyring.key_desc = g_strdup (key_desc);
 
@@ -904,6 +1223,7 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_keyring (const gchar *key_
  */
 BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_volume_key (const guint8 *volume_key, gsize volume_key_size, GError **error) {
     BDCryptoKeyslotContext *context = NULL;
+    BDCryptoSecureBuffer *secret = NULL;
 
     if (!volume_key || volume_key_size == 0) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_NO_KEY,
@@ -911,371 +1231,1854 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_volume_key (const guint8 *
         return NULL;
     }
 
+    secret = secure_buffer_new (volume_key, volume_key_size, error);
+    if (!secret)
+        return NULL;
+
     context = g_new0 (BDCryptoKeyslotContext, 1);
 
     context->type = BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_VOLUME_KEY;
+    context->keyslot_hint = CRYPT_ANY_SLOT;
+    context->token_hint = CRYPT_ANY_TOKEN;
+    context->secret = &(secret->parent);
 
-    context->u.volume_key.volume_key = g_new0 (guint8, volume_key_size);
-    memcpy (context->u.volume_key.volume_key, volume_key, volume_key_size);
-
+    context->u.volume_key.volume_key = secret->data;
     context->u.volume_key.volume_key_size = volume_key_size;
 
     return context;
 }
 
-
-
-gboolean _crypto_luks_format (const gchar *device,
-                              const gchar *cipher,
-                              guint64 key_size,
-                              BDCryptoKeyslotContext *context,
-                              guint64 min_entropy,
-                              BDCryptoLUKSVersion luks_version,
-                              BDCryptoLUKSExtra *extra,
-                              BDCryptoLUKSHWEncryptionType hw_encryption,
-#ifdef LIBCRYPTSETUP_27
-                              BDCryptoKeyslotContext *opal_context,
-#else
-                              BDCryptoKeyslotContext *opal_context G_GNUC_UNUSED,
+/* added in cryptsetup 2.4.0 */
+#ifndef LIBCRYPTSETUP_24
+static int crypt_token_max (const char *type G_GNUC_UNUSED) {
+    return 32;
+}
 #endif
-                               GError **error) {
-    struct crypt_device *cd = NULL;
-    gint ret;
-    gchar **cipher_specs = NULL;
-    guint32 current_entropy = 0;
-    gint dev_random_fd = -1;
-    gchar *key_buffer = NULL;
-    gsize buf_len = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    const gchar* crypt_version = NULL;
-    GError *l_error = NULL;
-
-#ifdef LIBCRYPTSETUP_27
-    struct crypt_params_hw_opal opal_params = {
-		.user_key_size = DEFAULT_OPAL_KEYSIZE_BITS / 8
-	};
 
-    gboolean is_opal = (hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_ONLY || hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_AND_SW);
-#endif
+/**
+ * bd_crypto_keyslot_context_set_keyslot_hint:
+ * @context: key slot context to set the hint for
+ * @keyslot: keyslot to try first when unlocking a LUKS device with @context or
+ *           -1 to remove the hint
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Without a hint, unlocking a LUKS device tries the key from @context against
+ * all the active keyslots one by one and each attempt runs the (possibly memory
+ * and time expensive) PBKDF of the keyslot. With a hint, @keyslot is tried
+ * first and all keyslots are tried only if it doesn't accept the key.
+ *
+ * Returns: whether the hint was successfully set or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_crypto_keyslot_context_set_keyslot_hint (BDCryptoKeyslotContext *context, gint keyslot, GError **error) {
+    if (keyslot < CRYPT_ANY_SLOT || keyslot >= crypt_keyslot_max (CRYPT_LUKS2)) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Invalid keyslot %d", keyslot);
+        return FALSE;
+    }
 
-    msg = g_strdup_printf ("Started formatting '%s' as LUKS device", device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    context->keyslot_hint = keyslot;
+    return TRUE;
+}
 
-    if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS1)
-        crypt_version = CRYPT_LUKS1;
-    else if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS2)
-        crypt_version = CRYPT_LUKS2;
-    else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
-                     "Unknown or unsupported LUKS version specified");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+/**
+ * bd_crypto_keyslot_context_set_token_hint:
+ * @context: key slot context to set the hint for
+ * @token: LUKS 2 token whose keyslot should be tried first when unlocking a LUKS
+ *         device with @context or -1 to remove the hint
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Same as bd_crypto_keyslot_context_set_keyslot_hint(), but the keyslot to try
+ * first is the (first) keyslot assigned to @token in the LUKS 2 header. Ignored
+ * for LUKS 1 devices and if a keyslot hint is set for @context.
+ *
+ * Returns: whether the hint was successfully set or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_crypto_keyslot_context_set_token_hint (BDCryptoKeyslotContext *context, gint token, GError **error) {
+    if (token < CRYPT_ANY_TOKEN || token >= crypt_token_max (CRYPT_LUKS2)) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Invalid token %d", token);
         return FALSE;
     }
 
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+    context->token_hint = token;
+    return TRUE;
+}
+
+/* opt-in cache of the keyslots that last accepted the given keys, see bd_crypto_set_keyslot_cache() */
+#define KEYSLOT_CACHE_SALT_LEN 32
+
+static GMutex keyslot_cache_lock;
+static gboolean keyslot_cache_enabled = FALSE;
+static GHashTable *keyslot_cache = NULL;    /* "UUID:fingerprint" -> keyslot + 1 */
+static guint8 keyslot_cache_salt[KEYSLOT_CACHE_SALT_LEN];
+
+/* a failure of the hinted keyslot for which all the keyslots should be tried */
+#define KEYSLOT_HINT_MISSED(ret) ((ret) == -EPERM || (ret) == -ENOENT || (ret) == -EINVAL)
+
+/* key for the keyslot cache for the LUKS device loaded in @cd and the given key
+ * (or %NULL if the cache is disabled), the key material is never stored, only
+ * its HMAC keyed by a random per-process salt */
+static gchar* keyslot_cache_key (struct crypt_device *cd, BDCryptoKeyslotContextType type, const gchar *key, gsize key_len) {
+    const gchar *uuid = NULL;
+    GHmac *hmac = NULL;
+    guint8 type_byte = (guint8) type;
+    gchar *ret = NULL;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (!keyslot_cache_enabled) {
+        g_mutex_unlock (&keyslot_cache_lock);
+        return NULL;
     }
+    hmac = g_hmac_new (G_CHECKSUM_SHA256, keyslot_cache_salt, KEYSLOT_CACHE_SALT_LEN);
+    g_mutex_unlock (&keyslot_cache_lock);
 
-    if (hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_SW_ONLY || hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_AND_SW) {
-        cipher = cipher ? cipher : DEFAULT_LUKS_CIPHER;
-        cipher_specs = g_strsplit (cipher, "-", 2);
-        if (g_strv_length (cipher_specs) != 2) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_SPEC,
-                        "Invalid cipher specification: '%s'", cipher);
-            crypt_free (cd);
-            g_strfreev (cipher_specs);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
+    uuid = crypt_get_uuid (cd);
+    if (!uuid) {
+        g_hmac_unref (hmac);
+        return NULL;
+    }
 
-        if (key_size == 0) {
-            if (g_str_has_prefix (cipher_specs[1], "xts-"))
-                key_size = DEFAULT_LUKS_KEYSIZE_BITS * 2;
-            else
-                key_size = DEFAULT_LUKS_KEYSIZE_BITS;
+    g_hmac_update (hmac, &type_byte, 1);
+    g_hmac_update (hmac, (const guchar *) key, key_len);
+    ret = g_strdup_printf ("%s:%s", uuid, g_hmac_get_string (hmac));
+    g_hmac_unref (hmac);
+
+    return ret;
+}
+
+static gint keyslot_cache_lookup (const gchar *cache_key) {
+    gint keyslot = CRYPT_ANY_SLOT;
+
+    if (!cache_key)
+        return CRYPT_ANY_SLOT;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (keyslot_cache)
+        keyslot = GPOINTER_TO_INT (g_hash_table_lookup (keyslot_cache, cache_key)) - 1;
+    g_mutex_unlock (&keyslot_cache_lock);
+
+    return keyslot;
+}
+
+static void keyslot_cache_store (const gchar *cache_key, gint keyslot) {
+    if (!cache_key || keyslot < 0)
+        return;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (keyslot_cache)
+        g_hash_table_replace (keyslot_cache, g_strdup (cache_key), GINT_TO_POINTER (keyslot + 1));
+    g_mutex_unlock (&keyslot_cache_lock);
+}
+
+static void keyslot_cache_remove (const gchar *cache_key) {
+    if (!cache_key)
+        return;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (keyslot_cache)
+        g_hash_table_remove (keyslot_cache, cache_key);
+    g_mutex_unlock (&keyslot_cache_lock);
+}
+
+/* drops the cached keyslots of the device with @uuid (all devices if %NULL),
+ * only entries for @keyslot unless it's CRYPT_ANY_SLOT */
+static void keyslot_cache_drop (const gchar *uuid, gint keyslot) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    gpointer value = NULL;
+    gsize uuid_len = uuid ? strlen (uuid) : 0;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (keyslot_cache) {
+        g_hash_table_iter_init (&iter, keyslot_cache);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+            if (uuid && (strncmp (key, uuid, uuid_len) != 0 || ((const gchar *) key)[uuid_len] != ':'))
+                continue;
+            if (keyslot != CRYPT_ANY_SLOT && GPOINTER_TO_INT (value) - 1 != keyslot)
+                continue;
+            g_hash_table_iter_remove (&iter);
         }
-    } else
-        cipher_specs = g_new0 (gchar*, 2);
+    }
+    g_mutex_unlock (&keyslot_cache_lock);
+}
 
-#ifdef LIBCRYPTSETUP_27
-    if (is_opal)
-        key_size += DEFAULT_OPAL_KEYSIZE_BITS;
-#endif
+/* keyslot to try first for @context on the LUKS device loaded in @cd */
+static gint get_keyslot_hint (struct crypt_device *cd, BDCryptoKeyslotContext *context, const gchar *cache_key) {
+    gint keyslot = CRYPT_ANY_SLOT;
+    gint i = 0;
 
-    /* key_size should be in bytes */
-    key_size = key_size / 8;
+    if (context->keyslot_hint != CRYPT_ANY_SLOT)
+        keyslot = context->keyslot_hint;
+    else if (context->token_hint != CRYPT_ANY_TOKEN && g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) == 0) {
+        for (i = 0; i < crypt_keyslot_max (CRYPT_LUKS2) && keyslot == CRYPT_ANY_SLOT; i++)
+            if (crypt_token_is_assigned (cd, context->token_hint, i) == 0)
+                keyslot = i;
+    }
+    if (keyslot == CRYPT_ANY_SLOT)
+        keyslot = keyslot_cache_lookup (cache_key);
 
-    /* wait for enough random data entropy (if requested) */
-    if (min_entropy > 0) {
-        dev_random_fd = open ("/dev/random", O_RDONLY);
-        if (dev_random_fd >= 0) {
-            ioctl (dev_random_fd, RNDGETENTCNT, &current_entropy);
-            while (current_entropy < min_entropy) {
-                bd_utils_report_progress (progress_id, 0, "Waiting for enough random data entropy");
-                sleep (1);
-                ioctl (dev_random_fd, RNDGETENTCNT, &current_entropy);
+    if (keyslot != CRYPT_ANY_SLOT)
+        bd_utils_log_format (BD_UTILS_LOG_INFO, "Trying keyslot %d of '%s' first", keyslot, crypt_get_device_name (cd));
+
+    return keyslot;
+}
+
+/* whether all the keyslots should be tried after trying the hinted @keyslot with result @ret */
+static gboolean keyslot_hint_missed (struct crypt_device *cd, gint keyslot, gint ret) {
+    if (keyslot == CRYPT_ANY_SLOT || !KEYSLOT_HINT_MISSED (ret))
+        return FALSE;
+
+    bd_utils_log_format (BD_UTILS_LOG_INFO, "Keyslot %d of '%s' didn't accept the key, trying all keyslots",
+                         keyslot, crypt_get_device_name (cd));
+    return TRUE;
+}
+
+static gint activate_by_passphrase_hinted (struct crypt_device *cd, const gchar *name, BDCryptoKeyslotContext *context,
+                                           const gchar *key, gsize key_len, guint32 flags) {
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key, key_len);
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gint ret = 0;
+
+    ret = crypt_activate_by_passphrase (cd, name, keyslot, key, key_len, flags);
+    if (keyslot_hint_missed (cd, keyslot, ret))
+        ret = crypt_activate_by_passphrase (cd, name, CRYPT_ANY_SLOT, key, key_len, flags);
+    keyslot_cache_store (cache_key, ret);
+
+    return ret;
+}
+
+static gint activate_by_keyring_hinted (struct crypt_device *cd, const gchar *name, BDCryptoKeyslotContext *context,
+                                        guint32 flags) {
+    const gchar *key_desc = context->u.keyring.key_desc;
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key_desc, strlen (key_desc));
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gint ret = 0;
+
+    ret = crypt_activate_by_keyring (cd, name, key_desc, keyslot, flags);
+    if (keyslot_hint_missed (cd, keyslot, ret))
+        ret = crypt_activate_by_keyring (cd, name, key_desc, CRYPT_ANY_SLOT, flags);
+    keyslot_cache_store (cache_key, ret);
+
+    return ret;
+}
+
+static gint resume_by_passphrase_hinted (struct crypt_device *cd, const gchar *name, BDCryptoKeyslotContext *context,
+                                         const gchar *key, gsize key_len) {
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key, key_len);
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gint ret = 0;
+
+    ret = crypt_resume_by_passphrase (cd, name, keyslot, key, key_len);
+    if (keyslot_hint_missed (cd, keyslot, ret))
+        ret = crypt_resume_by_passphrase (cd, name, CRYPT_ANY_SLOT, key, key_len);
+    keyslot_cache_store (cache_key, ret);
+
+    return ret;
+}
+
+static gint volume_key_get_hinted (struct crypt_device *cd, BDCryptoKeyslotContext *context, const gchar *key, gsize key_len,
+                                   gchar *volume_key, gsize *volume_key_size) {
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key, key_len);
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gint ret = 0;
+
+    ret = crypt_volume_key_get (cd, keyslot, volume_key, volume_key_size, key, key_len);
+    if (keyslot_hint_missed (cd, keyslot, ret))
+        ret = crypt_volume_key_get (cd, CRYPT_ANY_SLOT, volume_key, volume_key_size, key, key_len);
+    keyslot_cache_store (cache_key, ret);
+
+    return ret;
+}
+
+/* volume keys stashed by bd_crypto_luks_open_stash_key() are "user" keys in
+   the session keyring, named after the dm-crypt device, accessible only to
+   the processes possessing the session keyring and removed automatically
+   after VK_STASH_TIMEOUT seconds */
+#define VK_STASH_TIMEOUT (24 * 60 * 60)
+#define VK_STASH_PERM (KEY_POS_VIEW|KEY_POS_READ|KEY_POS_SEARCH|KEY_POS_LINK)
+
+static gchar* vk_stash_key_desc (const gchar *name) {
+    g_autofree gchar *dm_name = g_path_get_basename (name);
+
+    return g_strdup_printf ("libblockdev:luks-vk:%s", dm_name);
+}
+
+static gboolean stash_volume_key (const gchar *name, const gchar *volume_key, gsize volume_key_size, GError **error) {
+    g_autofree gchar *key_desc = vk_stash_key_desc (name);
+    key_serial_t key = 0;
+
+    /* "user" keys are readable by all processes of the user by default, create
+       the key in the private thread keyring first and only link it into the
+       session keyring once the access is restricted */
+    key = add_key ("user", key_desc, volume_key, volume_key_size, KEY_SPEC_THREAD_KEYRING);
+    if (key < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYRING,
+                     "Failed to stash the volume key in kernel keyring: %s", strerror_l (errno, c_locale));
+        return FALSE;
+    }
+
+    if (keyctl_setperm (key, VK_STASH_PERM) != 0 || keyctl_set_timeout (key, VK_STASH_TIMEOUT) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYRING,
+                     "Failed to restrict access to the stashed volume key: %s", strerror_l (errno, c_locale));
+        keyctl_invalidate (key);
+        return FALSE;
+    }
+
+    if (keyctl_link (key, KEY_SPEC_SESSION_KEYRING) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYRING,
+                     "Failed to stash the volume key in kernel keyring: %s", strerror_l (errno, c_locale));
+        keyctl_invalidate (key);
+        return FALSE;
+    }
+
+    if (keyctl_unlink (key, KEY_SPEC_THREAD_KEYRING) != 0)
+        bd_utils_log_format (BD_UTILS_LOG_WARNING, "Failed to unlink the stashed volume key for '%s' from the thread keyring: %s",
+                             name, strerror_l (errno, c_locale));
+
+    return TRUE;
+}
+
+static gint resume_by_stashed_key (struct crypt_device *cd, const gchar *name) {
+    g_autofree gchar *key_desc = vk_stash_key_desc (name);
+    key_serial_t key = 0;
+    void *volume_key = NULL;
+    long key_size = 0;
+    gint ret = 0;
+
+    key = keyctl_search (KEY_SPEC_SESSION_KEYRING, "user", key_desc, 0);
+    if (key < 0)
+        return -errno;
+
+    key_size = keyctl_read_alloc (key, &volume_key);
+    if (key_size < 0)
+        return -errno;
+
+    ret = crypt_resume_by_volume_key (cd, name, volume_key, key_size);
+    explicit_bzero (volume_key, key_size);
+    free (volume_key);
+
+    return ret;
+}
+
+static void drop_stashed_key (const gchar *name) {
+    g_autofree gchar *key_desc = vk_stash_key_desc (name);
+    key_serial_t key = 0;
+
+    key = keyctl_search (KEY_SPEC_SESSION_KEYRING, "user", key_desc, 0);
+    if (key >= 0 && keyctl_invalidate (key) != 0)
+        bd_utils_log_format (BD_UTILS_LOG_WARNING, "Failed to remove stashed volume key for '%s' from kernel keyring: %s",
+                             name, strerror_l (errno, c_locale));
+}
+
+static gint keyslot_add_hinted (struct crypt_device *cd, BDCryptoKeyslotContext *context, const gchar *key, gsize key_len,
+                                BDCryptoKeyslotContext *ncontext, const gchar *nkey, gsize nkey_len) {
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key, key_len);
+    g_autofree gchar *ncache_key = keyslot_cache_key (cd, ncontext->type, nkey, nkey_len);
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gchar *volume_key = NULL;
+    gsize volume_key_size = 0;
+    gint ret = 0;
+
+    if (keyslot != CRYPT_ANY_SLOT) {
+        /* crypt_keyslot_add_by_passphrase() has no way to say which keyslot
+           should be unlocked, get the volume key from the hinted one instead */
+        volume_key_size = crypt_get_volume_key_size (cd);
+        volume_key = crypt_safe_alloc (volume_key_size);
+        if (volume_key) {
+            ret = crypt_volume_key_get (cd, keyslot, volume_key, &volume_key_size, key, key_len);
+            if (ret >= 0) {
+                keyslot_cache_store (cache_key, ret);
+                ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, volume_key, volume_key_size, nkey, nkey_len);
+                crypt_safe_free (volume_key);
+                keyslot_cache_store (ncache_key, ret);
+                return ret;
             }
-            close (dev_random_fd);
-        } else {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
-                         "Failed to check random data entropy level");
+            crypt_safe_free (volume_key);
+            if (!keyslot_hint_missed (cd, keyslot, ret))
+                return ret;
+        }
+    }
+
+    ret = crypt_keyslot_add_by_passphrase (cd, CRYPT_ANY_SLOT, key, key_len, nkey, nkey_len);
+    keyslot_cache_store (ncache_key, ret);
+
+    return ret;
+}
+
+static gint keyslot_change_hinted (struct crypt_device *cd, BDCryptoKeyslotContext *context, const gchar *key, gsize key_len,
+                                   BDCryptoKeyslotContext *ncontext, const gchar *nkey, gsize nkey_len) {
+    g_autofree gchar *cache_key = keyslot_cache_key (cd, context->type, key, key_len);
+    g_autofree gchar *ncache_key = keyslot_cache_key (cd, ncontext->type, nkey, nkey_len);
+    gint keyslot = get_keyslot_hint (cd, context, cache_key);
+    gint ret = 0;
+
+    ret = crypt_keyslot_change_by_passphrase (cd, keyslot, CRYPT_ANY_SLOT, key, key_len, nkey, nkey_len);
+    if (keyslot_hint_missed (cd, keyslot, ret))
+        ret = crypt_keyslot_change_by_passphrase (cd, CRYPT_ANY_SLOT, CRYPT_ANY_SLOT, key, key_len, nkey, nkey_len);
+    if (ret >= 0) {
+        keyslot_cache_remove (cache_key);
+        keyslot_cache_store (ncache_key, ret);
+    }
+
+    return ret;
+}
+
+/**
+ * bd_crypto_set_keyslot_cache:
+ * @enabled: whether to enable or disable the cache
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Enables or disables caching of the keyslots that accepted the keys used to
+ * unlock LUKS devices. With the cache enabled, the keyslot that last accepted
+ * a key on a device (identified by its UUID) is tried first the next time the
+ * same key is used for the device instead of trying all the keyslots one by
+ * one (see also bd_crypto_keyslot_context_set_keyslot_hint()).
+ *
+ * Only a salted hash of the keys is kept in the process' memory, never the keys
+ * themselves. An outdated entry only costs one extra keyslot check. Disabling
+ * the cache drops all the cached entries.
+ *
+ * Returns: whether the cache was successfully enabled/disabled or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_crypto_set_keyslot_cache (gboolean enabled, GError **error) {
+    gboolean ret = TRUE;
+
+    g_mutex_lock (&keyslot_cache_lock);
+    if (enabled && !keyslot_cache) {
+        if (getrandom (keyslot_cache_salt, KEYSLOT_CACHE_SALT_LEN, 0) != KEYSLOT_CACHE_SALT_LEN) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                         "Failed to generate salt for the keyslot cache: %s", strerror_l (errno, c_locale));
+            ret = FALSE;
+        } else
+            keyslot_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    } else if (!enabled && keyslot_cache) {
+        g_hash_table_destroy (keyslot_cache);
+        keyslot_cache = NULL;
+    }
+    keyslot_cache_enabled = enabled && ret;
+    g_mutex_unlock (&keyslot_cache_lock);
+
+    return ret;
+}
+
+/**
+ * bd_crypto_invalidate_keyslot_cache:
+ * @device: (nullable): LUKS device to drop the cached keyslots for or %NULL for all devices
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the cached keyslots were successfully dropped or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_crypto_invalidate_keyslot_cache (const gchar *device, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+
+    if (!device) {
+        keyslot_cache_drop (NULL, CRYPT_ANY_SLOT);
+        return TRUE;
+    }
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    keyslot_cache_drop (crypt_get_uuid (cd), CRYPT_ANY_SLOT);
+    crypt_free (cd);
+
+    return TRUE;
+}
+
+
+/* calibrated PBKDF cost parameters, see bd_crypto_set_pbkdf_cache() */
+static GMutex pbkdf_cache_lock;
+static gboolean pbkdf_cache_enabled = FALSE;
+static GHashTable *pbkdf_cache = NULL;    /* "type:hash:time_ms:max_memory_kb:parallel_threads:key_size" -> PBKDFCacheEntry */
+
+typedef struct PBKDFCacheEntry {
+    guint32 iterations;
+    guint32 max_memory_kb;
+    guint32 parallel_threads;
+} PBKDFCacheEntry;
+
+/* fills the calibrated cost parameters into @pbkdf, running the benchmark only
+   if they are not cached yet (or if @force is %TRUE) */
+static gboolean pbkdf_cache_calibrate (struct crypt_pbkdf_type *pbkdf, gsize key_size, gboolean force, GError **error) {
+    struct crypt_pbkdf_type bench_pbkdf = ZERO_INIT;
+    g_autofree gchar *cache_key = NULL;
+    PBKDFCacheEntry *entry = NULL;
+    gint ret = 0;
+
+    /* iterations set manually, nothing to calibrate */
+    if (pbkdf->flags & CRYPT_PBKDF_NO_BENCHMARK)
+        return TRUE;
+
+    cache_key = g_strdup_printf ("%s:%s:%"G_GUINT32_FORMAT":%"G_GUINT32_FORMAT":%"G_GUINT32_FORMAT":%"G_GSIZE_FORMAT,
+                                 pbkdf->type, pbkdf->hash, pbkdf->time_ms, pbkdf->max_memory_kb,
+                                 pbkdf->parallel_threads, key_size);
+
+    g_mutex_lock (&pbkdf_cache_lock);
+    if (!pbkdf_cache_enabled && !force) {
+        g_mutex_unlock (&pbkdf_cache_lock);
+        return TRUE;
+    }
+    entry = (pbkdf_cache && !force) ? g_hash_table_lookup (pbkdf_cache, cache_key) : NULL;
+    if (entry) {
+        pbkdf->iterations = entry->iterations;
+        pbkdf->max_memory_kb = entry->max_memory_kb;
+        pbkdf->parallel_threads = entry->parallel_threads;
+        pbkdf->flags |= CRYPT_PBKDF_NO_BENCHMARK;
+        g_mutex_unlock (&pbkdf_cache_lock);
+        return TRUE;
+    }
+    g_mutex_unlock (&pbkdf_cache_lock);
+
+    /* the benchmark takes time, don't hold the lock while running it */
+    bench_pbkdf = *pbkdf;
+    ret = crypt_benchmark_pbkdf (NULL, &bench_pbkdf, "foobarfo", 8, "0123456789abcdef0123456789abcdef", 32,
+                                 key_size, NULL, NULL);
+    if (ret < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                     "Failed to benchmark '%s' PBKDF: %s", pbkdf->type, strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    g_mutex_lock (&pbkdf_cache_lock);
+    if (pbkdf_cache) {
+        entry = g_new0 (PBKDFCacheEntry, 1);
+        entry->iterations = bench_pbkdf.iterations;
+        entry->max_memory_kb = bench_pbkdf.max_memory_kb;
+        entry->parallel_threads = bench_pbkdf.parallel_threads;
+        g_hash_table_replace (pbkdf_cache, g_steal_pointer (&cache_key), entry);
+    }
+    g_mutex_unlock (&pbkdf_cache_lock);
+
+    pbkdf->iterations = bench_pbkdf.iterations;
+    pbkdf->max_memory_kb = bench_pbkdf.max_memory_kb;
+    pbkdf->parallel_threads = bench_pbkdf.parallel_threads;
+    pbkdf->flags |= CRYPT_PBKDF_NO_BENCHMARK;
+
+    return TRUE;
+}
+
+/* sets the cached (calibrated) PBKDF parameters for the new keyslots on @cd,
+   @luks_type is used for the defaults if no PBKDF is set on @cd yet */
+static void pbkdf_cache_apply (struct crypt_device *cd, const gchar *luks_type, gsize key_size) {
+    const struct crypt_pbkdf_type *current = NULL;
+    struct crypt_pbkdf_type pbkdf = ZERO_INIT;
+    g_autofree gchar *type = NULL;
+    g_autofree gchar *hash = NULL;
+    GError *l_error = NULL;
+    gint ret = 0;
+
+    g_mutex_lock (&pbkdf_cache_lock);
+    if (!pbkdf_cache_enabled) {
+        g_mutex_unlock (&pbkdf_cache_lock);
+        return;
+    }
+    g_mutex_unlock (&pbkdf_cache_lock);
+
+    current = crypt_get_pbkdf_type (cd);
+    if (!current)
+        current = crypt_get_pbkdf_default (luks_type ? luks_type : CRYPT_LUKS2);
+    if (!current)
+        return;
+
+    /* the strings belong to @cd and may be freed when setting the new parameters */
+    pbkdf = *current;
+    type = g_strdup (current->type);
+    hash = g_strdup (current->hash);
+    pbkdf.type = type;
+    pbkdf.hash = hash;
+
+    if (!pbkdf_cache_calibrate (&pbkdf, key_size, FALSE, &l_error)) {
+        bd_utils_log_format (BD_UTILS_LOG_WARNING, "Not using cached PBKDF parameters: %s", l_error->message);
+        g_clear_error (&l_error);
+        return;
+    }
+
+    ret = crypt_set_pbkdf_type (cd, &pbkdf);
+    if (ret != 0)
+        bd_utils_log_format (BD_UTILS_LOG_WARNING, "Failed to set cached PBKDF parameters: %s",
+                             strerror_l (-ret, c_locale));
+}
+
+/**
+ * bd_crypto_set_pbkdf_cache:
+ * @enabled: whether to enable or disable the cache
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Enables or disables caching of the calibrated PBKDF cost parameters. Unless
+ * the number of iterations is specified, libcryptsetup benchmarks the PBKDF
+ * every time a new keyslot is created (by bd_crypto_luks_format(),
+ * bd_crypto_luks_add_key() or bd_crypto_luks_change_key()). With the cache
+ * enabled, the benchmark runs only once for each combination of PBKDF type,
+ * hash, time cost, memory cost, parallel cost and volume key size and the
+ * calibrated parameters are reused for the following keyslots. Disabling the
+ * cache drops all the cached parameters, use bd_crypto_luks_pbkdf_calibrate()
+ * to recalibrate a single combination.
+ *
+ * Returns: whether the cache was successfully enabled/disabled or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_crypto_set_pbkdf_cache (gboolean enabled, GError **error G_GNUC_UNUSED) {
+    g_mutex_lock (&pbkdf_cache_lock);
+    if (enabled && !pbkdf_cache)
+        pbkdf_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    else if (!enabled && pbkdf_cache) {
+        g_hash_table_destroy (pbkdf_cache);
+        pbkdf_cache = NULL;
+    }
+    pbkdf_cache_enabled = enabled;
+    g_mutex_unlock (&pbkdf_cache_lock);
+
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_pbkdf_calibrate:
+ * @pbkdf: (nullable): PBKDF specification to calibrate or %NULL for the LUKS 2 default
+ * @key_size: size of the volume key (in bits) or 0 for default
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Runs the PBKDF benchmark for @pbkdf now and, if the PBKDF cache is enabled
+ * (see bd_crypto_set_pbkdf_cache()), replaces the cached parameters with the
+ * new ones. The result has the iterations set and can also be used directly
+ * for bd_crypto_luks_format() (see #BDCryptoLUKSExtra) to skip the benchmark.
+ *
+ * Returns: (transfer full): calibrated PBKDF parameters or %NULL in case of error
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_CREATE
+ */
+BDCryptoLUKSPBKDF* bd_crypto_luks_pbkdf_calibrate (BDCryptoLUKSPBKDF *pbkdf, guint64 key_size, GError **error) {
+    struct crypt_pbkdf_type *params = NULL;
+    const struct crypt_pbkdf_type *default_pbkdf = NULL;
+    BDCryptoLUKSPBKDF *ret = NULL;
+    GError *l_error = NULL;
+
+    params = get_pbkdf_params (pbkdf, &l_error);
+    if (params == NULL && l_error != NULL) {
+        g_propagate_prefixed_error (error, l_error, "Failed to get PBKDF parameters.");
+        return NULL;
+    }
+
+    if (params == NULL) {
+        default_pbkdf = crypt_get_pbkdf_default (CRYPT_LUKS2);
+        if (!default_pbkdf) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                         "Failed to get default values for pbkdf.");
+            return NULL;
+        }
+        params = g_new0 (struct crypt_pbkdf_type, 1);
+        *params = *default_pbkdf;
+    }
+
+    if (key_size == 0)
+        key_size = DEFAULT_LUKS_KEYSIZE_BITS * 2;
+
+    if (!pbkdf_cache_calibrate (params, key_size / 8, TRUE, error)) {
+        g_free (params);
+        return NULL;
+    }
+
+    ret = bd_crypto_luks_pbkdf_new (params->type, params->hash, params->max_memory_kb, params->iterations,
+                                    params->time_ms, params->parallel_threads);
+    g_free (params);
+
+    return ret;
+}
+
+
+gboolean _crypto_luks_format (const gchar *device,
+                              const gchar *cipher,
+                              guint64 key_size,
+                              BDCryptoKeyslotContext *context,
+                              guint64 min_entropy,
+                              BDCryptoLUKSVersion luks_version,
+                              BDCryptoLUKSExtra *extra,
+                              BDCryptoLUKSHWEncryptionType hw_encryption,
+#ifdef LIBCRYPTSETUP_27
+                              BDCryptoKeyslotContext *opal_context,
+#else
+                              BDCryptoKeyslotContext *opal_context G_GNUC_UNUSED,
+#endif
+                               GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret;
+    gchar **cipher_specs = NULL;
+    guint32 current_entropy = 0;
+    gint dev_random_fd = -1;
+    gchar *key_buffer = NULL;
+    gsize buf_len = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    const gchar* crypt_version = NULL;
+    GError *l_error = NULL;
+
+#ifdef LIBCRYPTSETUP_27
+    struct crypt_params_hw_opal opal_params = {
+		.user_key_size = DEFAULT_OPAL_KEYSIZE_BITS / 8
+	};
+
+    gboolean is_opal = (hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_ONLY || hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_AND_SW);
+#endif
+
+    msg = g_strdup_printf ("Started formatting '%s' as LUKS device", device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS1)
+        crypt_version = CRYPT_LUKS1;
+    else if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS2)
+        crypt_version = CRYPT_LUKS2;
+    else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                     "Unknown or unsupported LUKS version specified");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_SW_ONLY || hw_encryption == BD_CRYPTO_LUKS_HW_ENCRYPTION_OPAL_HW_AND_SW) {
+        cipher = cipher ? cipher : DEFAULT_LUKS_CIPHER;
+        cipher_specs = g_strsplit (cipher, "-", 2);
+        if (g_strv_length (cipher_specs) != 2) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_SPEC,
+                        "Invalid cipher specification: '%s'", cipher);
+            crypt_free (cd);
+            g_strfreev (cipher_specs);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+
+        if (key_size == 0) {
+            if (g_str_has_prefix (cipher_specs[1], "xts-"))
+                key_size = DEFAULT_LUKS_KEYSIZE_BITS * 2;
+            else
+                key_size = DEFAULT_LUKS_KEYSIZE_BITS;
+        }
+    } else
+        cipher_specs = g_new0 (gchar*, 2);
+
+#ifdef LIBCRYPTSETUP_27
+    if (is_opal)
+        key_size += DEFAULT_OPAL_KEYSIZE_BITS;
+#endif
+
+    /* key_size should be in bytes */
+    key_size = key_size / 8;
+
+    /* wait for enough random data entropy (if requested) */
+    if (min_entropy > 0) {
+        dev_random_fd = open ("/dev/random", O_RDONLY);
+        if (dev_random_fd >= 0) {
+            ioctl (dev_random_fd, RNDGETENTCNT, &current_entropy);
+            while (current_entropy < min_entropy) {
+                bd_utils_report_progress (progress_id, 0, "Waiting for enough random data entropy");
+                sleep (1);
+                ioctl (dev_random_fd, RNDGETENTCNT, &current_entropy);
+            }
+            close (dev_random_fd);
+        } else {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
+                         "Failed to check random data entropy level");
+            crypt_free (cd);
+            g_strfreev (cipher_specs);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+    }
+
+#ifdef LIBCRYPTSETUP_27
+    if (is_opal) {
+        if (opal_context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+            opal_params.admin_key = (char *) opal_context->u.passphrase.pass_data;
+            opal_params.admin_key_size = opal_context->u.passphrase.data_len;
+        } else {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                         "Only 'passphrase' context type is valid for OPAL format.");
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            crypt_free (cd);
+            g_strfreev (cipher_specs);
+            return FALSE;
+        }
+    }
+
+    if (is_opal) {
+        /* XXX: workaround for a bug in cryptsetup where crypt_format_luks2_opal doesn't
+         *      initialize crypto backend leading to an abort during the call, setting
+         *      the pbkdf parameters will run the initialization so just get the default
+         *      params and set them
+         *      See also: https://gitlab.com/cryptsetup/cryptsetup/-/commit/42f4a68705384eeecb5b31b71cc8a8fe19bca916
+         */
+        const struct crypt_pbkdf_type *pbkdf_default;
+        pbkdf_default = crypt_get_pbkdf_default (CRYPT_LUKS2);
+        crypt_set_pbkdf_type (cd, pbkdf_default);
+    }
+#endif
+
+    /* user-specified LUKS 2 PBKDF is calibrated below */
+    if (!(extra && extra->pbkdf && luks_version == BD_CRYPTO_LUKS_VERSION_LUKS2))
+        pbkdf_cache_apply (cd, crypt_version, key_size);
+
+    if (extra) {
+        if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS1) {
+
+            if (extra->integrity || extra->sector_size || extra->label || extra->subsystem || extra->pbkdf) {
+                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                             "Invalid extra arguments specified. Only `data_alignment`"
+                             "and `data_device` are valid for LUKS 1.");
+                crypt_free (cd);
+                g_strfreev (cipher_specs);
+                bd_utils_report_finished (progress_id, l_error->message);
+                g_propagate_error (error, l_error);
+                return FALSE;
+            }
+
+            struct crypt_params_luks1 params = ZERO_INIT;
+            params.data_alignment = extra->data_alignment;
+            params.data_device = extra->data_device;
+            ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
+                                NULL, NULL, key_size, &params);
+        }
+        else if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS2) {
+            struct crypt_params_luks2 params = ZERO_INIT;
+            struct crypt_pbkdf_type *pbkdf = get_pbkdf_params (extra->pbkdf, &l_error);
+
+            if (pbkdf == NULL && l_error != NULL) {
+                crypt_free (cd);
+                g_strfreev (cipher_specs);
+                bd_utils_report_finished (progress_id, l_error->message);
+                g_propagate_prefixed_error (error, l_error,
+                                            "Failed to get PBKDF parameters for '%s'.", device);
+                return FALSE;
+            }
+
+            if (pbkdf && !pbkdf_cache_calibrate (pbkdf, key_size, FALSE, &l_error)) {
+                bd_utils_log_format (BD_UTILS_LOG_WARNING, "Not using cached PBKDF parameters: %s", l_error->message);
+                g_clear_error (&l_error);
+            }
+
+            params.pbkdf = pbkdf;
+            params.integrity = extra->integrity;
+            params.integrity_params = NULL;
+            params.data_alignment = extra->data_alignment;
+            params.data_device = extra->data_device;
+            params.sector_size = extra->sector_size ? extra->sector_size : DEFAULT_LUKS2_SECTOR_SIZE;
+            params.label = extra->label;
+            params.subsystem = extra->subsystem;
+
+#ifdef LIBCRYPTSETUP_27
+            if (is_opal)
+                ret = crypt_format_luks2_opal (cd, cipher_specs[0], cipher_specs[1],
+                                               NULL, NULL, key_size, &params, &opal_params);
+            else
+#endif
+                ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
+                                    NULL, NULL, key_size, &params);
+            g_free (pbkdf);
+        }
+    } else {
+#ifdef LIBCRYPTSETUP_27
+        if (is_opal) {
+            struct crypt_params_luks2 params = ZERO_INIT;
+            params.pbkdf = crypt_get_pbkdf_default (CRYPT_LUKS2);
+            ret = crypt_format_luks2_opal (cd, cipher_specs[0], cipher_specs[1],
+                                            NULL, NULL, key_size, &params, &opal_params);
+        } else
+#endif
+            ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
+                                NULL, NULL, key_size, NULL);
+    }
+    g_strfreev (cipher_specs);
+
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
+                     "Failed to format device: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    bd_utils_report_progress (progress_id, 50, "Format created");
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, NULL, 0,
+                                               (const char *) context->u.passphrase.pass_data,
+                                               context->u.passphrase.data_len);
+        if (ret < 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
+                         "Failed to add passphrase: %s", strerror_l (-ret, c_locale));
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+        bd_utils_report_progress (progress_id, 100, "Added key");
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile,
+                         strerror_l (-ret, c_locale));
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+        ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, NULL, 0,
+                                               (const char*) key_buffer, buf_len);
+        if (ret < 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
+                         "Failed to add key file: %s", strerror_l (-ret, c_locale));
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+        bd_utils_report_progress (progress_id, 100, "Added key");
+    } else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS format.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    crypt_free (cd);
+
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_format:
+ * @device: a device to format as LUKS
+ * @cipher: (nullable): cipher specification (type-mode, e.g. "aes-xts-plain64") or %NULL to use the default
+ * @key_size: size of the volume key in bits or 0 to use the default
+ * @context: key slot context (passphrase/keyfile/token...) for this LUKS device
+ * @min_entropy: minimum random data entropy (in bits) required to format @device as LUKS
+ * @luks_version: whether to use LUKS v1 or LUKS v2
+ * @extra: (nullable): extra arguments for LUKS format creation
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Formats the given @device as LUKS according to the other parameters given. If
+ * @min_entropy is specified (greater than 0), the function waits for enough
+ * entropy to be available in the random data pool (WHICH MAY POTENTIALLY TAKE
+ * FOREVER).
+ *
+ * Supported @context types for this function: passphrase, key file
+ *
+ * Returns: whether the given @device was successfully formatted as LUKS or not
+ * (the @error) contains the error in such cases)
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_CREATE
+ */
+gboolean bd_crypto_luks_format (const gchar *device, const gchar *cipher, guint64 key_size, BDCryptoKeyslotContext *context, guint64 min_entropy, BDCryptoLUKSVersion luks_version, BDCryptoLUKSExtra *extra,GError **error) {
+    return _crypto_luks_format (device, cipher, key_size, context, min_entropy, luks_version, extra, BD_CRYPTO_LUKS_HW_ENCRYPTION_SW_ONLY, NULL, error);
+}
+
+static gboolean get_crypt_activate_flags (BDCryptoLUKSPersistentFlags flags, guint32 *crypt_flags, GError **error) {
+    *crypt_flags = 0;
+
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_ALLOW_DISCARDS)
+        *crypt_flags |= CRYPT_ACTIVATE_ALLOW_DISCARDS;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_SAME_CPU_CRYPT)
+        *crypt_flags |= CRYPT_ACTIVATE_SAME_CPU_CRYPT;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS)
+        *crypt_flags |= CRYPT_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_JOURNAL)
+        *crypt_flags |= CRYPT_ACTIVATE_NO_JOURNAL;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_READ_WORKQUEUE)
+        *crypt_flags |= CRYPT_ACTIVATE_NO_READ_WORKQUEUE;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_WRITE_WORKQUEUE)
+        *crypt_flags |= CRYPT_ACTIVATE_NO_WRITE_WORKQUEUE;
+    if (flags & BD_CRYPTO_LUKS_ACTIVATE_HIGH_PRIORITY) {
+#ifdef LIBCRYPTSETUP_28
+        *crypt_flags |= CRYPT_ACTIVATE_HIGH_PRIORITY;
+#else
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                     "Libcryptsetup 2.8 or newer is needed for 'high priority' flag support");
+        return FALSE;
+#endif
+    }
+
+    return TRUE;
+}
+
+static gboolean _is_dm_name_valid (const gchar *name, GError **error) {
+    if (strlen (name) >= 128) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Device name can be at most 127 characters long.");
+        return FALSE;
+    }
+
+    if (strchr (name, '/')) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Device name cannot contain '/' character.");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean _crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, guint32 crypt_flags, gboolean stash_key, GError **error) {
+    struct crypt_device *cd = NULL;
+    gchar *key_buffer = NULL;
+    gsize buf_len = 0;
+    gchar *volume_key = NULL;
+    gsize volume_key_size = 0;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    if (!_is_dm_name_valid (name, error))
+        return FALSE;
+
+    msg = g_strdup_printf ("Started opening '%s' LUKS device", device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (stash_key) {
+        if (context->type != BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE && context->type != BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                         "Only 'passphrase' and 'key file' context types are valid for LUKS open with volume key stash.");
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            crypt_free (cd);
+            return FALSE;
+        }
+
+        volume_key_size = crypt_get_volume_key_size (cd);
+        volume_key = crypt_safe_alloc (volume_key_size);
+        if (!volume_key) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to allocate memory for the volume key");
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            crypt_free (cd);
+            return FALSE;
+        }
+    }
+
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        if (stash_key)
+            ret = volume_key_get_hinted (cd, context, (const char *) context->u.passphrase.pass_data,
+                                         context->u.passphrase.data_len, volume_key, &volume_key_size);
+        else
+            ret = activate_by_passphrase_hinted (cd, name, context,
+                                                 (const char *) context->u.passphrase.pass_data,
+                                                 context->u.passphrase.data_len, crypt_flags);
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
+            crypt_safe_free (volume_key);
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+        if (stash_key)
+            ret = volume_key_get_hinted (cd, context, key_buffer, buf_len, volume_key, &volume_key_size);
+        else
+            ret = activate_by_passphrase_hinted (cd, name, context, key_buffer, buf_len, crypt_flags);
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING)
+        ret = activate_by_keyring_hinted (cd, name, context, crypt_flags);
+    else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase', 'key file' and 'keyring' context types are valid for LUKS open.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    /* the passphrase was already checked (the expensive part) when getting
+       the volume key, activate the device directly with it */
+    if (stash_key && ret >= 0)
+        ret = crypt_activate_by_volume_key (cd, name, volume_key, volume_key_size, crypt_flags);
+
+    if (ret < 0) {
+        crypt_safe_free (volume_key);
+        if (ret == -EPERM)
+          g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                       "Failed to activate device: Incorrect passphrase.");
+        else
+          g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                       "Failed to activate device: %s", strerror_l (-ret, c_locale));
+
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (stash_key) {
+        if (!stash_volume_key (name, volume_key, volume_key_size, &l_error)) {
+            crypt_safe_free (volume_key);
+            ret = crypt_deactivate (cd, name);
+            if (ret != 0)
+                bd_utils_log_format (BD_UTILS_LOG_ERR, "Failed to deactivate device %s", name);
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+        crypt_safe_free (volume_key);
+    }
+
+    crypt_free (cd);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_open:
+ * @device: the device to open
+ * @name: name for the LUKS device
+ * @context: key slot context (passphrase/keyfile/token...) to open this LUKS @device
+ * @read_only: whether to open as read-only or not (meaning read-write)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Supported @context types for this function: passphrase, key file, keyring
+ *
+ * Returns: whether the @device was successfully opened or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ *
+ * Example of using %bd_crypto_luks_open with %BDCryptoKeyslotContext:
+ *
+ * |[<!-- language="C" -->
+ * BDCryptoKeyslotContext *context = NULL;
+ *
+ * context = bd_crypto_keyslot_context_new_passphrase ("passphrase", 10, NULL);
+ * bd_crypto_luks_open ("/dev/vda1", "luks-device", context, FALSE, NULL);
+ * ]|
+ */
+gboolean bd_crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, gboolean read_only, GError **error) {
+    return _crypto_luks_open (device, name, context, read_only ? CRYPT_ACTIVATE_READONLY : 0, FALSE, error);
+}
+
+/**
+ * bd_crypto_luks_open_with_flags:
+ * @device: the device to open
+ * @name: name for the LUKS device
+ * @context: key slot context (passphrase/keyfile/token...) to open this LUKS @device
+ * @flags: activation flags for the dm-crypt device
+ * @read_only: whether to open as read-only or not (meaning read-write)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Same as bd_crypto_luks_open(), but the dm-crypt device is activated with
+ * @flags (in addition to the persistent flags stored in a LUKS 2 header, see
+ * bd_crypto_luks_set_persistent_flags()). This allows trying the performance
+ * related flags (see also bd_crypto_tune_flags()) without changing the header
+ * and using them with LUKS 1 devices.
+ *
+ * Supported @context types for this function: passphrase, key file, keyring
+ *
+ * Returns: whether the @device was successfully opened or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ */
+gboolean bd_crypto_luks_open_with_flags (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSPersistentFlags flags, gboolean read_only, GError **error) {
+    guint32 crypt_flags = 0;
+
+    if (!get_crypt_activate_flags (flags, &crypt_flags, error))
+        return FALSE;
+    if (read_only)
+        crypt_flags |= CRYPT_ACTIVATE_READONLY;
+
+    return _crypto_luks_open (device, name, context, crypt_flags, FALSE, error);
+}
+
+/**
+ * bd_crypto_luks_open_stash_key:
+ * @device: the device to open
+ * @name: name for the LUKS device
+ * @context: key slot context (passphrase/keyfile/token...) to open this LUKS @device
+ * @read_only: whether to open as read-only or not (meaning read-write)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Same as bd_crypto_luks_open(), but the volume key of @device is also stashed
+ * in the session kernel keyring so that bd_crypto_luks_resume() can resume the
+ * device without the (slow) key derivation from @context. The stashed key is
+ * removed by bd_crypto_luks_close() or automatically after 24 hours.
+ *
+ * Note: The volume key is stored as a "user" key that can be read by every
+ *       process possessing the session keyring (e.g. with `keyctl read`), the
+ *       other processes of the user cannot access it. Anybody who can read it
+ *       can decrypt @device without knowing the passphrase, even after the
+ *       passphrase is changed or removed. A "logon" key can't be used instead,
+ *       the volume key needs to be read back to verify it when resuming.
+ *
+ * Supported @context types for this function: passphrase, key file
+ *
+ * Returns: whether the @device was successfully opened (and its volume key
+ * stashed) or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ */
+gboolean bd_crypto_luks_open_stash_key (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, gboolean read_only, GError **error) {
+    return _crypto_luks_open (device, name, context, read_only ? CRYPT_ACTIVATE_READONLY : 0, TRUE, error);
+}
+
+/* keyslot opening @device with @context will try first, resolved the same way
+   as when activating (keyslot hint, token hint, keyslot cache) */
+static gint get_context_keyslot_hint (struct crypt_device *cd, BDCryptoKeyslotContext *context) {
+    g_autofree gchar *cache_key = NULL;
+    gchar *key_buffer = NULL;
+    gsize buf_len = 0;
+
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE)
+        cache_key = keyslot_cache_key (cd, context->type, (const gchar *) context->u.passphrase.pass_data,
+                                       context->u.passphrase.data_len);
+    else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        /* the key file is loaded into the context anyway when opening */
+        if (keyfile_context_get_key (cd, context, &key_buffer, &buf_len) == 0)
+            cache_key = keyslot_cache_key (cd, context->type, key_buffer, buf_len);
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING)
+        cache_key = keyslot_cache_key (cd, context->type, context->u.keyring.key_desc,
+                                       strlen (context->u.keyring.key_desc));
+
+    return get_keyslot_hint (cd, context, cache_key);
+}
+
+/* memory (in KiB) and CPU threads the KDF of the keyslots @context can unlock on @device may need */
+static guint64 get_luks_kdf_cost (const gchar *device, BDCryptoKeyslotContext *context, guint *threads) {
+    struct crypt_device *cd = NULL;
+    struct crypt_pbkdf_type pbkdf = ZERO_INIT;
+    crypt_keyslot_info status;
+    guint64 memory = 0;
+    gint hint = CRYPT_ANY_SLOT;
+    gint keyslot = 0;
+
+    *threads = 1;
+    if (crypt_init (&cd, device) != 0)
+        return 0;
+    if (crypt_load (cd, CRYPT_LUKS, NULL) != 0) {
+        crypt_free (cd);
+        return 0;
+    }
+
+    /* only the hinted keyslot is tried unless it doesn't accept the key */
+    hint = get_context_keyslot_hint (cd, context);
+    for (keyslot = 0; keyslot < crypt_keyslot_max (crypt_get_type (cd)); keyslot++) {
+        if (hint != CRYPT_ANY_SLOT && keyslot != hint)
+            continue;
+        status = crypt_keyslot_status (cd, keyslot);
+        if (status != CRYPT_SLOT_ACTIVE && status != CRYPT_SLOT_ACTIVE_LAST)
+            continue;
+        if (crypt_keyslot_get_pbkdf (cd, keyslot, &pbkdf) != 0)
+            continue;
+        /* keyslots are tried one by one so the most expensive one is what matters */
+        memory = MAX (memory, pbkdf.max_memory_kb);
+        *threads = MAX (*threads, pbkdf.parallel_threads);
+    }
+
+    crypt_free (cd);
+    return memory;
+}
+
+/* MemAvailable from /proc/meminfo in KiB or 0 if not known */
+static guint64 get_available_memory (void) {
+    g_autofree gchar *contents = NULL;
+    gchar *line = NULL;
+
+    if (!g_file_get_contents ("/proc/meminfo", &contents, NULL, NULL))
+        return 0;
+
+    line = strstr (contents, "MemAvailable:");
+    if (!line)
+        return 0;
+
+    return g_ascii_strtoull (line + strlen ("MemAvailable:"), NULL, 10);
+}
+
+typedef struct LUKSOpenJob {
+    const gchar **devices;
+    const gchar **names;
+    BDCryptoKeyslotContext **contexts;
+    gboolean read_only;
+    BDCryptoLUKSOpenResult **results;
+    guint n_devices;
+
+    /* resources available for the KDFs running in parallel */
+    GMutex lock;
+    GCond cond;
+    guint64 memory_budget;
+    guint64 memory_used;
+    guint threads_budget;
+    guint threads_used;
+} LUKSOpenJob;
+
+static gboolean luks_open_task (guint i, gpointer data) {
+    LUKSOpenJob *job = (LUKSOpenJob *) data;
+    BDCryptoLUKSOpenResult *result = NULL;
+    GError *l_error = NULL;
+    guint64 memory = 0;
+    guint threads = 0;
+    gint64 start = 0;
+    gint64 unlock_start = 0;
+
+    result = g_new0 (BDCryptoLUKSOpenResult, 1);
+    result->device = g_strdup (job->devices[i]);
+    result->name = g_strdup (job->names[i]);
+
+    start = g_get_monotonic_time ();
+    memory = get_luks_kdf_cost (job->devices[i], job->contexts[i], &threads);
+    result->kdf_memory = memory;
+
+    /* wait for enough memory and CPUs for the KDF, but always let at least
+       one device through, even if it needs more than the budget */
+    g_mutex_lock (&(job->lock));
+    while ((job->memory_used > 0 || job->threads_used > 0) &&
+           (job->memory_used + memory > job->memory_budget || job->threads_used + threads > job->threads_budget))
+        g_cond_wait (&(job->cond), &(job->lock));
+    job->memory_used += memory;
+    job->threads_used += threads;
+    g_mutex_unlock (&(job->lock));
+
+    unlock_start = g_get_monotonic_time ();
+    result->wait_time = unlock_start - start;
+    result->success = bd_crypto_luks_open (job->devices[i], job->names[i], job->contexts[i], job->read_only, &l_error);
+    result->duration = g_get_monotonic_time () - unlock_start;
+    if (!result->success) {
+        result->error_msg = g_strdup (l_error->message);
+        g_clear_error (&l_error);
+    }
+
+    g_mutex_lock (&(job->lock));
+    job->memory_used -= memory;
+    job->threads_used -= threads;
+    g_cond_broadcast (&(job->cond));
+    g_mutex_unlock (&(job->lock));
+
+    job->results[i] = result;
+
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_open_many:
+ * @devices: (array zero-terminated=1): the devices to open
+ * @names: (array zero-terminated=1): names for the LUKS devices (one for each of @devices)
+ * @contexts: (array zero-terminated=1): key slot contexts to open the @devices with (one for each of @devices)
+ * @read_only: whether to open as read-only or not (meaning read-write)
+ * @max_jobs: maximum number of devices opened in parallel (0 to choose automatically)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Opens many LUKS devices at once, same as calling bd_crypto_luks_open() for
+ * each of them, but using up to @max_jobs threads. The key derivation
+ * functions (KDF) of the keyslots (especially the memory-hard Argon2 used by
+ * LUKS 2) are the expensive part of opening a LUKS device, so the number of
+ * devices being opened in parallel is further limited so that the KDFs running
+ * at the same time don't need more CPU threads than there are CPUs and more
+ * memory than half of the currently available memory. The requirements of
+ * each device are taken from its keyslots' PBKDF parameters (only from the
+ * hinted keyslot if @contexts have keyslot hints).
+ *
+ * Returns: (transfer full) (array zero-terminated=1): results of opening the
+ * @devices (in the order of @devices) or %NULL in case of error (invalid
+ * arguments)
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ */
+BDCryptoLUKSOpenResult** bd_crypto_luks_open_many (const gchar **devices, const gchar **names, BDCryptoKeyslotContext **contexts, gboolean read_only, guint max_jobs, GError **error) {
+    LUKSOpenJob job = ZERO_INIT;
+    guint i = 0;
+
+    job.n_devices = devices ? g_strv_length ((gchar **) devices) : 0;
+    if ((names ? g_strv_length ((gchar **) names) : 0) != job.n_devices ||
+        (contexts ? g_strv_length ((gchar **) contexts) : 0) != job.n_devices) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Number of devices, names and contexts must be the same");
+        return NULL;
+    }
+
+    for (i = 0; i < job.n_devices; i++)
+        if (!_is_dm_name_valid (names[i], error))
+            return NULL;
+
+    job.devices = devices;
+    job.names = names;
+    job.contexts = contexts;
+    job.read_only = read_only;
+    job.results = g_new0 (BDCryptoLUKSOpenResult *, job.n_devices + 1);
+    job.threads_budget = g_get_num_processors ();
+    job.memory_budget = get_available_memory () / 2;
+    if (job.memory_budget == 0)
+        job.memory_budget = G_MAXUINT64;
+    g_mutex_init (&(job.lock));
+    g_cond_init (&(job.cond));
+
+    if (max_jobs == 0)
+        max_jobs = g_get_num_processors ();
+    bd_utils_run_parallel ("bd-crypto-open", job.n_devices, max_jobs, luks_open_task, &job);
+
+    g_mutex_clear (&(job.lock));
+    g_cond_clear (&(job.cond));
+
+    return job.results;
+}
+
+static gboolean _crypto_close (const gchar *device, const gchar *tech_name, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    msg = g_strdup_printf ("Started closing %s device '%s'", tech_name, device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    ret = crypt_init_by_name (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = crypt_deactivate (cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to deactivate device: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    crypt_free (cd);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_close:
+ * @luks_device: LUKS device to close
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * The volume key stashed by bd_crypto_luks_open_stash_key() (if any) is removed
+ * from the kernel keyring when the device is closed.
+ *
+ * Returns: whether the given @luks_device was successfully closed or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ */
+gboolean bd_crypto_luks_close (const gchar *luks_device, GError **error) {
+    if (!_crypto_close (luks_device, "LUKS", error))
+        return FALSE;
+
+    drop_stashed_key (luks_device);
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_add_key:
+ * @device: device to add new key to
+ * @context: key slot context (passphrase/keyfile/token...) for this LUKS @device
+ * @ncontext: new key slot context (passphrase/keyfile/token...) to add to this LUKS @device
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Supported @context types for this function: passphrase, key file
+ *
+ * Returns: whether the @ncontext was successfully added to @device
+ * or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_ADD_KEY
+ */
+gboolean bd_crypto_luks_add_key (const gchar *device, BDCryptoKeyslotContext *context, BDCryptoKeyslotContext *ncontext, GError **error) {
+    gchar *key_buf = NULL;
+    gsize buf_len = 0;
+    gchar *nkey_buf = NULL;
+    gsize nbuf_len = 0;
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    GError *l_error = NULL;
+    gchar *msg = NULL;
+
+    msg = g_strdup_printf ("Started adding key to the LUKS device '%s'", device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, context, &key_buf, &buf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to load key from file '%s': %s", context->u.keyfile.keyfile,
+                         strerror_l (-ret, c_locale));
             crypt_free (cd);
-            g_strfreev (cipher_specs);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
             return FALSE;
         }
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        key_buf = (char *) context->u.passphrase.pass_data;
+        buf_len = context->u.passphrase.data_len;
+    } else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS add key.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
     }
 
-#ifdef LIBCRYPTSETUP_27
-    if (is_opal) {
-        if (opal_context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-            opal_params.admin_key = (char *) opal_context->u.passphrase.pass_data;
-            opal_params.admin_key_size = opal_context->u.passphrase.data_len;
-        } else {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                         "Only 'passphrase' context type is valid for OPAL format.");
+    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, ncontext, &nkey_buf, &nbuf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to load key from file '%s': %s", ncontext->u.keyfile.keyfile,
+                         strerror_l (-ret, c_locale));
+            crypt_free (cd);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
-            crypt_free (cd);
-            g_strfreev (cipher_specs);
             return FALSE;
         }
+    } else if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        nkey_buf = (char *) ncontext->u.passphrase.pass_data;
+        nbuf_len = ncontext->u.passphrase.data_len;
+    } else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS add key.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
     }
 
-    if (is_opal) {
-        /* XXX: workaround for a bug in cryptsetup where crypt_format_luks2_opal doesn't
-         *      initialize crypto backend leading to an abort during the call, setting
-         *      the pbkdf parameters will run the initialization so just get the default
-         *      params and set them
-         *      See also: https://gitlab.com/cryptsetup/cryptsetup/-/commit/42f4a68705384eeecb5b31b71cc8a8fe19bca916
-         */
-        const struct crypt_pbkdf_type *pbkdf_default;
-        pbkdf_default = crypt_get_pbkdf_default (CRYPT_LUKS2);
-        crypt_set_pbkdf_type (cd, pbkdf_default);
-    }
-#endif
+    pbkdf_cache_apply (cd, crypt_get_type (cd), crypt_get_volume_key_size (cd));
+    ret = keyslot_add_hinted (cd, context, key_buf, buf_len, ncontext, nkey_buf, nbuf_len);
 
-    if (extra) {
-        if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS1) {
+    crypt_free (cd);
 
-            if (extra->integrity || extra->sector_size || extra->label || extra->subsystem || extra->pbkdf) {
-                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
-                             "Invalid extra arguments specified. Only `data_alignment`"
-                             "and `data_device` are valid for LUKS 1.");
-                crypt_free (cd);
-                g_strfreev (cipher_specs);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
-                return FALSE;
-            }
+    if (ret < 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
+                     "Failed to add key: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
 
-            struct crypt_params_luks1 params = ZERO_INIT;
-            params.data_alignment = extra->data_alignment;
-            params.data_device = extra->data_device;
-            ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
-                                NULL, NULL, key_size, &params);
-        }
-        else if (luks_version == BD_CRYPTO_LUKS_VERSION_LUKS2) {
-            struct crypt_params_luks2 params = ZERO_INIT;
-            struct crypt_pbkdf_type *pbkdf = get_pbkdf_params (extra->pbkdf, &l_error);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
 
-            if (pbkdf == NULL && l_error != NULL) {
-                crypt_free (cd);
-                g_strfreev (cipher_specs);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_prefixed_error (error, l_error,
-                                            "Failed to get PBKDF parameters for '%s'.", device);
-                return FALSE;
-            }
+/**
+ * bd_crypto_luks_remove_key:
+ * @device: device to add new key to
+ * @context: key slot context (passphrase/keyfile/token...) to remove from this LUKS @device
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Supported @context types for this function: passphrase, key file
+ *
+ * Returns: whether the key was successfully removed or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REMOVE_KEY
+ */
+gboolean bd_crypto_luks_remove_key (const gchar *device, BDCryptoKeyslotContext *context, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    gchar *key_buf = NULL;
+    gsize buf_len = 0;
+    GError *l_error = NULL;
 
-            params.pbkdf = pbkdf;
-            params.integrity = extra->integrity;
-            params.integrity_params = NULL;
-            params.data_alignment = extra->data_alignment;
-            params.data_device = extra->data_device;
-            params.sector_size = extra->sector_size ? extra->sector_size : DEFAULT_LUKS2_SECTOR_SIZE;
-            params.label = extra->label;
-            params.subsystem = extra->subsystem;
+    msg = g_strdup_printf ("Started removing key from the LUKS device '%s'", device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
 
-#ifdef LIBCRYPTSETUP_27
-            if (is_opal)
-                ret = crypt_format_luks2_opal (cd, cipher_specs[0], cipher_specs[1],
-                                               NULL, NULL, key_size, &params, &opal_params);
-            else
-#endif
-                ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
-                                    NULL, NULL, key_size, &params);
-            g_free (pbkdf);
-        }
-    } else {
-#ifdef LIBCRYPTSETUP_27
-        if (is_opal) {
-            struct crypt_params_luks2 params = ZERO_INIT;
-            params.pbkdf = crypt_get_pbkdf_default (CRYPT_LUKS2);
-            ret = crypt_format_luks2_opal (cd, cipher_specs[0], cipher_specs[1],
-                                            NULL, NULL, key_size, &params, &opal_params);
-        } else
-#endif
-            ret = crypt_format (cd, crypt_version, cipher_specs[0], cipher_specs[1],
-                                NULL, NULL, key_size, NULL);
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
     }
-    g_strfreev (cipher_specs);
 
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
     if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
-                     "Failed to format device: %s", strerror_l (-ret, c_locale));
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    bd_utils_report_progress (progress_id, 50, "Format created");
     if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, NULL, 0,
-                                               (const char *) context->u.passphrase.pass_data,
-                                               context->u.passphrase.data_len);
-        if (ret < 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
-                         "Failed to add passphrase: %s", strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
-        bd_utils_report_progress (progress_id, 100, "Added key");
+        ret = activate_by_passphrase_hinted (cd, NULL, context,
+                                             (const char *) context->u.passphrase.pass_data,
+                                             context->u.passphrase.data_len, 0);
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+        ret = keyfile_context_get_key (cd, context, &key_buf, &buf_len);
         if (ret != 0) {
             g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile,
-                         strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
-        ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, NULL, 0,
-                                               (const char*) key_buffer, buf_len);
-        crypt_safe_free (key_buffer);
-        if (ret < 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
-                         "Failed to add key file: %s", strerror_l (-ret, c_locale));
+                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
             crypt_free (cd);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
             return FALSE;
         }
-        bd_utils_report_progress (progress_id, 100, "Added key");
+        ret = activate_by_passphrase_hinted (cd, NULL, context, key_buf, buf_len, 0);
     } else {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS format.");
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS remove key.");
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         crypt_free (cd);
         return FALSE;
     }
 
-    crypt_free (cd);
+    if (ret < 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEY_SLOT,
+                     "Failed to determine key slot: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    keyslot_cache_drop (crypt_get_uuid (cd), ret);
+    ret = crypt_keyslot_destroy (cd, ret);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REMOVE_KEY,
+                     "Failed to remove key: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
 
+    crypt_free (cd);
     bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_format:
- * @device: a device to format as LUKS
- * @cipher: (nullable): cipher specification (type-mode, e.g. "aes-xts-plain64") or %NULL to use the default
- * @key_size: size of the volume key in bits or 0 to use the default
- * @context: key slot context (passphrase/keyfile/token...) for this LUKS device
- * @min_entropy: minimum random data entropy (in bits) required to format @device as LUKS
- * @luks_version: whether to use LUKS v1 or LUKS v2
- * @extra: (nullable): extra arguments for LUKS format creation
+ * bd_crypto_luks_change_key:
+ * @device: device to change key of
+ * @context: key slot context (passphrase/keyfile/token...) for this LUKS @device
+ * @ncontext: new key slot context (passphrase/keyfile/token...) to add to this LUKS @device
  * @error: (out) (optional): place to store error (if any)
  *
- * Formats the given @device as LUKS according to the other parameters given. If
- * @min_entropy is specified (greater than 0), the function waits for enough
- * entropy to be available in the random data pool (WHICH MAY POTENTIALLY TAKE
- * FOREVER).
- *
  * Supported @context types for this function: passphrase, key file
  *
- * Returns: whether the given @device was successfully formatted as LUKS or not
- * (the @error) contains the error in such cases)
+ * Returns: whether the key was successfully changed or not
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_CREATE
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_ADD_KEY&%BD_CRYPTO_TECH_MODE_REMOVE_KEY
  */
-gboolean bd_crypto_luks_format (const gchar *device, const gchar *cipher, guint64 key_size, BDCryptoKeyslotContext *context, guint64 min_entropy, BDCryptoLUKSVersion luks_version, BDCryptoLUKSExtra *extra,GError **error) {
-    return _crypto_luks_format (device, cipher, key_size, context, min_entropy, luks_version, extra, BD_CRYPTO_LUKS_HW_ENCRYPTION_SW_ONLY, NULL, error);
-}
+gboolean bd_crypto_luks_change_key (const gchar *device, BDCryptoKeyslotContext *context, BDCryptoKeyslotContext *ncontext, GError **error) {
+    struct crypt_device *cd = NULL;
+    gchar *key_buf = NULL;
+    gsize buf_len = 0;
+    gchar *nkey_buf = NULL;
+    gsize nbuf_len = 0;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
 
-static gboolean _is_dm_name_valid (const gchar *name, GError **error) {
-    if (strlen (name) >= 128) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
-                     "Device name can be at most 127 characters long.");
+    msg = g_strdup_printf ("Started changing key on the LUKS device '%s'", device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    if (strchr (name, '/')) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
-                     "Device name cannot contain '/' character.");
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, context, &key_buf, &buf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to load key from file '%s': %s", context->u.keyfile.keyfile,
+                         strerror_l (-ret, c_locale));
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        key_buf = (char *) context->u.passphrase.pass_data;
+        buf_len = context->u.passphrase.data_len;
+    } else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS change key.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, ncontext, &nkey_buf, &nbuf_len);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                         "Failed to load key from file '%s': %s", ncontext->u.keyfile.keyfile,
+                         strerror_l (-ret, c_locale));
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
+        }
+    } else if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+        nkey_buf = (char *) ncontext->u.passphrase.pass_data;
+        nbuf_len = ncontext->u.passphrase.data_len;
+    } else {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS change key.");
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    pbkdf_cache_apply (cd, crypt_get_type (cd), crypt_get_volume_key_size (cd));
+    ret = keyslot_change_hinted (cd, context, key_buf, buf_len, ncontext, nkey_buf, nbuf_len);
+
+    crypt_free (cd);
+
+    if (ret < 0) {
+        if (ret == -EPERM)
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to change the passphrase: No keyslot with given passphrase found.");
+        else
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
+                         "Failed to change the passphrase: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
         return FALSE;
     }
 
+    bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_open:
- * @device: the device to open
- * @name: name for the LUKS device
- * @context: key slot context (passphrase/keyfile/token...) to open this LUKS @device
- * @read_only: whether to open as read-only or not (meaning read-write)
- * @error: (out) (optional): place to store error (if any)
- *
- * Supported @context types for this function: passphrase, key file, keyring
- *
- * Returns: whether the @device was successfully opened or not
+ * bd_crypto_luks_resize:
+ * @luks_device: opened LUKS device to resize
+ * @size: requested size in sectors or 0 to adapt to the backing device
+ * @context: (nullable): key slot context (passphrase/keyfile/token...) for this LUKS @device
+ * @error: (out) (optional): place to store error (if any)
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
+ * Supported @context types for this function: passphrase, key file
  *
- * Example of using %bd_crypto_luks_open with %BDCryptoKeyslotContext:
+ * Returns: whether the @luks_device was successfully resized or not
  *
- * |[<!-- language="C" -->
- * BDCryptoKeyslotContext *context = NULL;
+ * You need to specify either @context for LUKS 2 devices that
+ * don't have verified key loaded in kernel.
+ * For LUKS 1 devices you can set @context %NULL.
  *
- * context = bd_crypto_keyslot_context_new_passphrase ("passphrase", 10, NULL);
- * bd_crypto_luks_open ("/dev/vda1", "luks-device", context, FALSE, NULL);
- * ]|
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_RESIZE
  */
-gboolean bd_crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, gboolean read_only, GError **error) {
+gboolean bd_crypto_luks_resize (const gchar *luks_device, guint64 size, BDCryptoKeyslotContext *context, GError **error) {
     struct crypt_device *cd = NULL;
-    gchar *key_buffer = NULL;
-    gsize buf_len = 0;
+    struct crypt_active_device cad;
     gint ret = 0;
     guint64 progress_id = 0;
     gchar *msg = NULL;
+    gchar *key_buffer = NULL;
+    gsize buf_len = 0;
     GError *l_error = NULL;
 
-    if (!_is_dm_name_valid (name, error))
-        return FALSE;
-
-    msg = g_strdup_printf ("Started opening '%s' LUKS device", device);
+    msg = g_strdup_printf ("Started resizing LUKS device '%s'", luks_device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
-    ret = crypt_init (&cd, device);
+    ret = crypt_init_by_name (&cd, luks_device);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
@@ -1284,55 +3087,73 @@ gboolean bd_crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKe
         return FALSE;
     }
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    ret = crypt_get_active_device (cd, luks_device, &cad);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+                     "Failed to get information about '%s': %s",
+                     luks_device, strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        ret = crypt_activate_by_passphrase (cd, name, CRYPT_ANY_SLOT,
-                                            (const char *) context->u.passphrase.pass_data,
-                                            context->u.passphrase.data_len,
-                                            read_only ? CRYPT_ACTIVATE_READONLY : 0);
-    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
+    if (context) {
+        if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+            ret = activate_by_passphrase_hinted (cd, NULL, context,
+                                                 (const char *) context->u.passphrase.pass_data,
+                                                 context->u.passphrase.data_len,
+                                                 cad.flags & CRYPT_ACTIVATE_KEYRING_KEY);
+        } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+            ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
+            if (ret != 0) {
+                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                             "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
+                crypt_free (cd);
+                bd_utils_report_finished (progress_id, l_error->message);
+                g_propagate_error (error, l_error);
+                return FALSE;
+            }
+            ret = activate_by_passphrase_hinted (cd, NULL, context, key_buffer, buf_len,
+                                                 cad.flags & CRYPT_ACTIVATE_KEYRING_KEY);
+        } else {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                        "Only 'passphrase' and 'key file' context types are valid for LUKS resize.");
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            crypt_free (cd);
+            return FALSE;
+        }
+
+        if (ret < 0) {
+            if (ret == -EPERM)
+              g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                           "Failed to activate device: Incorrect passphrase.");
+            else
+              g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                           "Failed to activate device: %s", strerror_l (-ret, c_locale));
             crypt_free (cd);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
             return FALSE;
         }
-        ret = crypt_activate_by_passphrase (cd, name, CRYPT_ANY_SLOT, key_buffer, buf_len,
-                                            read_only ? CRYPT_ACTIVATE_READONLY : 0);
-        crypt_safe_free (key_buffer);
-    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYRING)
-        ret = crypt_activate_by_keyring (cd, name, context->u.keyring.key_desc, CRYPT_ANY_SLOT,
-                                         read_only ? CRYPT_ACTIVATE_READONLY : 0);
-    else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase', 'key file' and 'keyring' context types are valid for LUKS open.");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        crypt_free (cd);
-        return FALSE;
     }
 
-    if (ret < 0) {
-        if (ret == -EPERM)
-          g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                       "Failed to activate device: Incorrect passphrase.");
-        else
-          g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                       "Failed to activate device: %s", strerror_l (-ret, c_locale));
+    ret = crypt_resize (cd, luks_device, size);
+    if (ret != 0) {
+        if (ret == -EPERM && g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) == 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_RESIZE_PERM,
+                         "Insufficient permissions to resize device. You need to specify"
+                         " passphrase or keyfile to resize LUKS 2 devices that don't"
+                         " have verified key loaded in kernel.");
+            crypt_free (cd);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return FALSE;
 
+        }
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_RESIZE_FAILED,
+                     "Failed to resize device: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
@@ -1344,18 +3165,27 @@ gboolean bd_crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKe
     return TRUE;
 }
 
-static gboolean _crypto_close (const gchar *device, const gchar *tech_name, GError **error) {
+/**
+ * bd_crypto_luks_suspend:
+ * @luks_device: LUKS device to suspend
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the given @luks_device was successfully suspended or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_SUSPEND_RESUME
+ */
+gboolean bd_crypto_luks_suspend (const gchar *luks_device, GError **error) {
     struct crypt_device *cd = NULL;
     gint ret = 0;
     guint64 progress_id = 0;
     gchar *msg = NULL;
     GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started closing %s device '%s'", tech_name, device);
+    msg = g_strdup_printf ("Started suspending LUKS device '%s'", luks_device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
-    ret = crypt_init_by_name (&cd, device);
+    ret = crypt_init_by_name (&cd, luks_device);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
@@ -1364,10 +3194,10 @@ static gboolean _crypto_close (const gchar *device, const gchar *tech_name, GErr
         return FALSE;
     }
 
-    ret = crypt_deactivate (cd, device);
+    ret = crypt_suspend (cd, luks_device);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to deactivate device: %s", strerror_l (-ret, c_locale));
+                     "Failed to suspend device: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
@@ -1380,48 +3210,35 @@ static gboolean _crypto_close (const gchar *device, const gchar *tech_name, GErr
 }
 
 /**
- * bd_crypto_luks_close:
- * @luks_device: LUKS device to close
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the given @luks_device was successfully closed or not
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
- */
-gboolean bd_crypto_luks_close (const gchar *luks_device, GError **error) {
-    return _crypto_close (luks_device, "LUKS", error);
-}
-
-/**
- * bd_crypto_luks_add_key:
- * @device: device to add new key to
- * @context: key slot context (passphrase/keyfile/token...) for this LUKS @device
- * @ncontext: new key slot context (passphrase/keyfile/token...) to add to this LUKS @device
+ * bd_crypto_luks_resume:
+ * @luks_device: LUKS device to resume
+ * @context: (nullable): key slot context (passphrase/keyfile/token...) for @luks_device
+ *           or %NULL to use the volume key stashed by bd_crypto_luks_open_stash_key()
  * @error: (out) (optional): place to store error (if any)
  *
  * Supported @context types for this function: passphrase, key file
  *
- * Returns: whether the @ncontext was successfully added to @device
- * or not
+ * Resuming with the stashed volume key skips the key derivation and so keeps
+ * the time the I/O on @luks_device is frozen as short as possible.
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_ADD_KEY
+ * Returns: whether the given @luks_device was successfully resumed or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_SUSPEND_RESUME
  */
-gboolean bd_crypto_luks_add_key (const gchar *device, BDCryptoKeyslotContext *context, BDCryptoKeyslotContext *ncontext, GError **error) {
-    gchar *key_buf = NULL;
-    gsize buf_len = 0;
-    gchar *nkey_buf = NULL;
-    gsize nbuf_len = 0;
+gboolean bd_crypto_luks_resume (const gchar *luks_device, BDCryptoKeyslotContext *context, GError **error) {
     struct crypt_device *cd = NULL;
+    gchar *key_buffer = NULL;
+    gsize buf_len = 0;
     gint ret = 0;
     guint64 progress_id = 0;
-    GError *l_error = NULL;
     gchar *msg = NULL;
+    GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started adding key to the LUKS device '%s'", device);
+    msg = g_strdup_printf ("Started resuming '%s' LUKS device", luks_device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
-    ret = crypt_init (&cd, device);
+    ret = crypt_init_by_name (&cd, luks_device);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
@@ -1440,98 +3257,132 @@ gboolean bd_crypto_luks_add_key (const gchar *device, BDCryptoKeyslotContext *co
         return FALSE;
     }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buf, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to load key from file '%s': %s", context->u.keyfile.keyfile,
-                         strerror_l (-ret, c_locale));
+    if (!context) {
+        ret = resume_by_stashed_key (cd, luks_device);
+        if (ret == -ENOKEY) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYRING,
+                         "No volume key stashed in kernel keyring for '%s'", luks_device);
             crypt_free (cd);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
             return FALSE;
         }
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        key_buf = (char *) context->u.passphrase.pass_data;
-        buf_len = context->u.passphrase.data_len;
-    } else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS add key.");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, ncontext->u.keyfile.keyfile, &nkey_buf, &nbuf_len,
-                                         ncontext->u.keyfile.keyfile_offset, ncontext->u.keyfile.key_size, 0);
+        ret = resume_by_passphrase_hinted (cd, luks_device, context,
+                                           (const char *) context->u.passphrase.pass_data,
+                                           context->u.passphrase.data_len);
+    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
         if (ret != 0) {
             g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to load key from file '%s': %s", ncontext->u.keyfile.keyfile,
-                         strerror_l (-ret, c_locale));
+                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
             crypt_free (cd);
-            if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-                crypt_safe_free (key_buf);
             bd_utils_report_finished (progress_id, l_error->message);
             g_propagate_error (error, l_error);
             return FALSE;
         }
-    } else if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        nkey_buf = (char *) ncontext->u.passphrase.pass_data;
-        nbuf_len = ncontext->u.passphrase.data_len;
+        ret = resume_by_passphrase_hinted (cd, luks_device, context, key_buffer, buf_len);
     } else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS add key.");
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                        "Only 'passphrase' and 'key file' context types are valid for LUKS resume.");
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            crypt_free (cd);
+            return FALSE;
+    }
+
+    if (ret < 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to resume device: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
-        crypt_free (cd);
         return FALSE;
     }
 
-    ret = crypt_keyslot_add_by_passphrase (cd, CRYPT_ANY_SLOT, key_buf, buf_len, nkey_buf, nbuf_len);
-
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-        crypt_safe_free (key_buf);
-    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-        crypt_safe_free (nkey_buf);
     crypt_free (cd);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
 
-    if (ret < 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
-                     "Failed to add key: %s", strerror_l (-ret, c_locale));
+/**
+ * bd_crypto_luks_kill_slot:
+ * @device: device to kill slot on
+ * @slot: keyslot to destroy
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Note: This can destroy last remaining keyslot without confirmation making
+ *       the LUKS device permanently inaccessible.
+ *
+ * Returns: whether the given @slot was successfully destroyed or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REMOVE_KEY
+ */
+gboolean bd_crypto_luks_kill_slot (const gchar *device, gint slot, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    msg = g_strdup_printf ("Started killing slot %d on LUKS device '%s'", slot, device);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    keyslot_cache_drop (crypt_get_uuid (cd), slot);
+    ret = crypt_keyslot_destroy (cd, slot);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to destroy keyslot: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
+    crypt_free (cd);
     bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_remove_key:
- * @device: device to add new key to
- * @context: key slot context (passphrase/keyfile/token...) to remove from this LUKS @device
+ * bd_crypto_luks_header_backup:
+ * @device: device to backup the LUKS header
+ * @backup_file: file to save the header backup to
  * @error: (out) (optional): place to store error (if any)
  *
- * Supported @context types for this function: passphrase, key file
- *
- * Returns: whether the key was successfully removed or not
+ * Returns: whether the given backup of @device was successfully written to
+ *          @backup_file or not
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REMOVE_KEY
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_BACKUP_RESTORE
  */
-gboolean bd_crypto_luks_remove_key (const gchar *device, BDCryptoKeyslotContext *context, GError **error) {
+gboolean bd_crypto_luks_header_backup (const gchar *device, const gchar *backup_file, GError **error) {
     struct crypt_device *cd = NULL;
     gint ret = 0;
     guint64 progress_id = 0;
     gchar *msg = NULL;
-    gchar *key_buf = NULL;
-    gsize buf_len = 0;
     GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started removing key from the LUKS device '%s'", device);
+    msg = g_strdup_printf ("Started header backup of LUKS device '%s'", device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
@@ -1554,44 +3405,10 @@ gboolean bd_crypto_luks_remove_key (const gchar *device, BDCryptoKeyslotContext
         return FALSE;
     }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        ret = crypt_activate_by_passphrase (cd, NULL, CRYPT_ANY_SLOT,
-                                            (const char *) context->u.passphrase.pass_data,
-                                            context->u.passphrase.data_len, 0);
-    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buf, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
-        ret = crypt_activate_by_passphrase (cd, NULL, CRYPT_ANY_SLOT, key_buf, buf_len, 0);
-        crypt_safe_free (key_buf);
-    } else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS remove key.");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    if (ret < 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEY_SLOT,
-                     "Failed to determine key slot: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
-    }
-
-    ret = crypt_keyslot_destroy (cd, ret);
+    ret = crypt_header_backup (cd, NULL, backup_file);
     if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REMOVE_KEY,
-                     "Failed to remove key: %s", strerror_l (-ret, c_locale));
+        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to backup LUKS header: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
@@ -1604,30 +3421,25 @@ gboolean bd_crypto_luks_remove_key (const gchar *device, BDCryptoKeyslotContext
 }
 
 /**
- * bd_crypto_luks_change_key:
- * @device: device to change key of
- * @context: key slot context (passphrase/keyfile/token...) for this LUKS @device
- * @ncontext: new key slot context (passphrase/keyfile/token...) to add to this LUKS @device
+ * bd_crypto_luks_header_restore:
+ * @device: device to restore the LUKS header to
+ * @backup_file: existing file with a LUKS header backup
  * @error: (out) (optional): place to store error (if any)
  *
- * Supported @context types for this function: passphrase, key file
+ * Returns: whether the given @device LUKS header was successfully restored
+ *          from @backup_file
  *
- * Returns: whether the key was successfully changed or not
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_ADD_KEY&%BD_CRYPTO_TECH_MODE_REMOVE_KEY
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_BACKUP_RESTORE
  */
-gboolean bd_crypto_luks_change_key (const gchar *device, BDCryptoKeyslotContext *context, BDCryptoKeyslotContext *ncontext, GError **error) {
+gboolean bd_crypto_luks_header_restore (const gchar *device, const gchar *backup_file, GError **error) {
     struct crypt_device *cd = NULL;
-    gchar *key_buf = NULL;
-    gsize buf_len = 0;
-    gchar *nkey_buf = NULL;
-    gsize nbuf_len = 0;
     gint ret = 0;
     guint64 progress_id = 0;
     gchar *msg = NULL;
     GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started changing key on the LUKS device '%s'", device);
+    msg = g_strdup_printf ("Started LUKS header restore on device '%s'", device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
@@ -1640,677 +3452,1047 @@ gboolean bd_crypto_luks_change_key (const gchar *device, BDCryptoKeyslotContext
         return FALSE;
     }
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    ret = crypt_header_restore (cd, NULL, backup_file);
     if (ret != 0) {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
+                     "Failed to restore LUKS header: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buf, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to load key from file '%s': %s", context->u.keyfile.keyfile,
-                         strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
-    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        key_buf = (char *) context->u.passphrase.pass_data;
-        buf_len = context->u.passphrase.data_len;
-    } else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS change key.");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    crypt_free (cd);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_set_label:
+ * @device: device to set label on
+ * @label: (nullable): label to set
+ * @subsystem: (nullable): subsystem to set
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the given @label and @subsystem were successfully set or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ */
+gboolean bd_crypto_luks_set_label (const gchar *device, const gchar *label, const gchar *subsystem, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         return FALSE;
     }
 
-    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, ncontext->u.keyfile.keyfile, &key_buf, &buf_len,
-                                         ncontext->u.keyfile.keyfile_offset, ncontext->u.keyfile.key_size, 0);
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to load key from file '%s': %s", ncontext->u.keyfile.keyfile,
-                         strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-                crypt_safe_free (key_buf);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
-    } else if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        nkey_buf = (char *) ncontext->u.passphrase.pass_data;
-        nbuf_len = ncontext->u.passphrase.data_len;
-    } else {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                     "Only 'passphrase' and 'key file' context types are valid for LUKS change key.");
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    if (g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                     "Label can be set only on LUKS 2 devices: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
         return FALSE;
     }
 
-    ret = crypt_keyslot_change_by_passphrase (cd, CRYPT_ANY_SLOT, CRYPT_ANY_SLOT,
-                                              key_buf, buf_len, nkey_buf, nbuf_len);
+    ret = crypt_set_label (cd, label, subsystem);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to set label: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-        crypt_safe_free (key_buf);
-    if (ncontext->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE)
-        crypt_safe_free (nkey_buf);
     crypt_free (cd);
 
-    if (ret < 0) {
-        if (ret == -EPERM)
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                         "Failed to change the passphrase: No keyslot with given passphrase found.");
-        else
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
-                         "Failed to change the passphrase: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_set_uuid:
+ * @device: device to set UUID on
+ * @uuid: (nullable): UUID to set or %NULL to generate a new one
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the given @uuid was successfully set or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ */
+gboolean bd_crypto_luks_set_uuid (const gchar *device, const gchar *uuid, GError **error) {
+    struct crypt_device *cd = NULL;
+    gint ret = 0;
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    ret = crypt_set_uuid (cd, uuid);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to set UUID: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    crypt_free (cd);
+
+    return TRUE;
+}
+
+/**
+ * bd_crypto_luks_convert:
+ * @device:  a LUKS device to convert to a different version of LUKS
+ * @target_version: the LUKS version to convert to
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the @device was converted to @target_version.
+ *          False, if the @device is already in the @target_version format.
+ *
+ * Warning: LUKS header loss is possible. See bd_crypto_luks_header_backup() and bd_crypto_luks_header_restore()
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ */
+gboolean bd_crypto_luks_convert (const gchar *device, BDCryptoLUKSVersion target_version, GError **error) {
+    struct crypt_device *cd = NULL;
+    const char *cd_type;
+    const char *target_type;
+    gint ret = 0;
+
+    ret = crypt_init (&cd, device);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    cd_type = crypt_get_type (cd);
+    if (g_strcmp0 (cd_type, CRYPT_LUKS1) != 0 &&
+        g_strcmp0 (cd_type, CRYPT_LUKS2) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_CONVERT_FAILED,
+                     "It is possible to convert only between LUKS1 and LUKS2 formats. Device %s is of type: %s", device, cd_type);
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    target_type = target_version == BD_CRYPTO_LUKS_VERSION_LUKS1 ? CRYPT_LUKS1 : CRYPT_LUKS2;
+    if (g_strcmp0 (cd_type, target_type) == 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_CONVERT_FAILED,
+                     "Conversion to the %s type was requested, but device %s is already of type: %s", target_type, device, cd_type);
+        crypt_free (cd);
         return FALSE;
     }
 
-    bd_utils_report_finished (progress_id, "Completed");
+    ret = crypt_convert (cd, target_type, NULL);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Conversion failed: %s", strerror_l (-ret, c_locale));
+        crypt_free (cd);
+        return FALSE;
+    }
+
+    crypt_free (cd);
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_resize:
- * @luks_device: opened LUKS device to resize
- * @size: requested size in sectors or 0 to adapt to the backing device
- * @context: (nullable): key slot context (passphrase/keyfile/token...) for this LUKS @device
+ * bd_crypto_luks_set_persistent_flags:
+ * @device: a LUKS device to set the persistent flags on
+ * @flags: flags to set
  * @error: (out) (optional): place to store error (if any)
  *
- * Supported @context types for this function: passphrase, key file
- *
- * Returns: whether the @luks_device was successfully resized or not
+ * Note: This function is valid only for LUKS2.
  *
- * You need to specify either @context for LUKS 2 devices that
- * don't have verified key loaded in kernel.
- * For LUKS 1 devices you can set @context %NULL.
+ * Returns: whether the given @flags were successfully set or not
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_RESIZE
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
  */
-gboolean bd_crypto_luks_resize (const gchar *luks_device, guint64 size, BDCryptoKeyslotContext *context, GError **error) {
+gboolean bd_crypto_luks_set_persistent_flags (const gchar *device, BDCryptoLUKSPersistentFlags flags, GError **error) {
     struct crypt_device *cd = NULL;
-    struct crypt_active_device cad;
     gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    gchar *key_buffer = NULL;
-    gsize buf_len = 0;
-    GError *l_error = NULL;
-
-    msg = g_strdup_printf ("Started resizing LUKS device '%s'", luks_device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    guint32 crypt_flags = 0;
 
-    ret = crypt_init_by_name (&cd, luks_device);
+    ret = crypt_init (&cd, device);
     if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    ret = crypt_get_active_device (cd, luks_device, &cad);
+    ret = crypt_load (cd, CRYPT_LUKS, NULL);
     if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to get information about '%s': %s",
-                     luks_device, strerror_l (-ret, c_locale));
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to load device: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    if (context) {
-        if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-            ret = crypt_activate_by_passphrase (cd, NULL, CRYPT_ANY_SLOT,
-                                                (const char *) context->u.passphrase.pass_data,
-                                                context->u.passphrase.data_len,
-                                                cad.flags & CRYPT_ACTIVATE_KEYRING_KEY);
-        } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-            ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                             context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
-            if (ret != 0) {
-                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                             "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
-                crypt_free (cd);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
-                return FALSE;
-            }
-            ret = crypt_activate_by_passphrase (cd, NULL, CRYPT_ANY_SLOT, key_buffer, buf_len,
-                                                cad.flags & CRYPT_ACTIVATE_KEYRING_KEY);
-            crypt_safe_free (key_buffer);
-        } else {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                        "Only 'passphrase' and 'key file' context types are valid for LUKS resize.");
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            crypt_free (cd);
-            return FALSE;
-        }
+    if (g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Persistent flags can be set only on LUKS v2");
+        crypt_free (cd);
+        return FALSE;
+    }
 
-        if (ret < 0) {
-            if (ret == -EPERM)
-              g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                           "Failed to activate device: Incorrect passphrase.");
-            else
-              g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                           "Failed to activate device: %s", strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-        }
+    if (!get_crypt_activate_flags (flags, &crypt_flags, error)) {
+        crypt_free (cd);
+        return FALSE;
     }
 
-    ret = crypt_resize (cd, luks_device, size);
+    ret = crypt_persistent_flags_set (cd, CRYPT_FLAGS_ACTIVATION, crypt_flags);
     if (ret != 0) {
-        if (ret == -EPERM && g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) == 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_RESIZE_PERM,
-                         "Insufficient permissions to resize device. You need to specify"
-                         " passphrase or keyfile to resize LUKS 2 devices that don't"
-                         " have verified key loaded in kernel.");
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
-
-        }
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_RESIZE_FAILED,
-                     "Failed to resize device: %s", strerror_l (-ret, c_locale));
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to set flags: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     crypt_free (cd);
-    bd_utils_report_finished (progress_id, "Completed");
+
     return TRUE;
 }
 
-/**
- * bd_crypto_luks_suspend:
- * @luks_device: LUKS device to suspend
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the given @luks_device was successfully suspended or not
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_SUSPEND_RESUME
- */
-gboolean bd_crypto_luks_suspend (const gchar *luks_device, GError **error) {
-    struct crypt_device *cd = NULL;
-    gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
+/* default size of the temporary device used by bd_crypto_tune_flags() */
+#define TUNE_DEFAULT_SIZE (64 MiB)
+#define TUNE_SEQ_BLOCK (1 MiB)
+#define TUNE_RAND_BLOCK 4096
+#define TUNE_RAND_OPS 1024
+
+/* the performance related flags, all their combinations are tried */
+static const BDCryptoLUKSPersistentFlags tune_flags[] = {
+    BD_CRYPTO_LUKS_ACTIVATE_NO_READ_WORKQUEUE,
+    BD_CRYPTO_LUKS_ACTIVATE_NO_WRITE_WORKQUEUE,
+    BD_CRYPTO_LUKS_ACTIVATE_SAME_CPU_CRYPT,
+    BD_CRYPTO_LUKS_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS,
+};
+#ifdef LIBCRYPTSETUP_24
+static const guint32 tune_sector_sizes[] = {512, 4096};
+#else
+/* sector size for plain devices is supported since cryptsetup 2.4.0 */
+static const guint32 tune_sector_sizes[] = {512};
+#endif
 
-    msg = g_strdup_printf ("Started suspending LUKS device '%s'", luks_device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+static gint compare_tune_results (gconstpointer a, gconstpointer b) {
+    const BDCryptoTuneResult *res_a = *(const BDCryptoTuneResult **) a;
+    const BDCryptoTuneResult *res_b = *(const BDCryptoTuneResult **) b;
 
-    ret = crypt_init_by_name (&cd, luks_device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    if (res_a->total_time == res_b->total_time)
+        return 0;
+    return res_a->total_time < res_b->total_time ? -1 : 1;
+}
+
+/* runs the benchmark on the (already activated) @dm_device, the same amount of
+   work is done for every flags combination so the total times can be compared */
+static gboolean tune_run_benchmark (const gchar *dm_device, guint64 size, BDCryptoTuneResult *result, GError **error) {
+    guint8 *buf = NULL;
+    GRand *rand = NULL;
+    guint64 offset = 0;
+    gint64 start = 0;
+    gint64 seq_write_time = 0;
+    gint64 seq_read_time = 0;
+    gint64 rand_read_time = 0;
+    gint64 rand_write_time = 0;
+    ssize_t ret = 0;
+    gint fd = -1;
+    guint i = 0;
+
+    fd = open (dm_device, O_RDWR | O_DIRECT | O_CLOEXEC);
+    if (fd < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to open '%s': %s", dm_device, strerror_l (errno, c_locale));
         return FALSE;
     }
 
-    ret = crypt_suspend (cd, luks_device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to suspend device: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    /* O_DIRECT needs an aligned buffer */
+    if (posix_memalign ((void **) &buf, 4096, TUNE_SEQ_BLOCK) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to allocate memory for the benchmark");
+        close (fd);
         return FALSE;
     }
+    memset (buf, 0xa5, TUNE_SEQ_BLOCK);
+
+    start = g_get_monotonic_time ();
+    for (offset = 0; ret >= 0 && offset < size; offset += TUNE_SEQ_BLOCK)
+        ret = pwrite (fd, buf, TUNE_SEQ_BLOCK, offset);
+    if (ret >= 0)
+        ret = fdatasync (fd);
+    seq_write_time = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (offset = 0; ret >= 0 && offset < size; offset += TUNE_SEQ_BLOCK)
+        ret = pread (fd, buf, TUNE_SEQ_BLOCK, offset);
+    seq_read_time = g_get_monotonic_time () - start;
+
+    /* same "random" offsets for all the runs */
+    rand = g_rand_new_with_seed ((guint32) size);
+    start = g_get_monotonic_time ();
+    for (i = 0; ret >= 0 && i < TUNE_RAND_OPS; i++) {
+        offset = (guint64) g_rand_int_range (rand, 0, MIN (size / TUNE_RAND_BLOCK, G_MAXINT32)) * TUNE_RAND_BLOCK;
+        ret = pread (fd, buf, TUNE_RAND_BLOCK, offset);
+    }
+    rand_read_time = g_get_monotonic_time () - start;
+
+    start = g_get_monotonic_time ();
+    for (i = 0; ret >= 0 && i < TUNE_RAND_OPS; i++) {
+        offset = (guint64) g_rand_int_range (rand, 0, MIN (size / TUNE_RAND_BLOCK, G_MAXINT32)) * TUNE_RAND_BLOCK;
+        ret = pwrite (fd, buf, TUNE_RAND_BLOCK, offset);
+    }
+    if (ret >= 0)
+        ret = fdatasync (fd);
+    rand_write_time = g_get_monotonic_time () - start;
+    g_rand_free (rand);
+
+    if (ret < 0)
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Benchmark I/O on '%s' failed: %s", dm_device, strerror_l (errno, c_locale));
+    free (buf);
+    close (fd);
+    if (ret < 0)
+        return FALSE;
+
+    result->seq_write = size * G_USEC_PER_SEC / MAX (seq_write_time, 1);
+    result->seq_read = size * G_USEC_PER_SEC / MAX (seq_read_time, 1);
+    result->rand_read_latency = rand_read_time * 1000 / TUNE_RAND_OPS;
+    result->rand_write_latency = rand_write_time * 1000 / TUNE_RAND_OPS;
+    result->total_time = seq_write_time + seq_read_time + rand_read_time + rand_write_time;
 
-    crypt_free (cd);
-    bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_resume:
- * @luks_device: LUKS device to resume
- * @context: (nullable): key slot context (passphrase/keyfile/token...) for @luks_device
+ * bd_crypto_tune_flags:
+ * @cipher: (nullable): cipher specification (type-mode, e.g. "aes-xts-plain64") or %NULL to use the default
+ * @key_size: size of the volume key in bits or 0 to use the default
+ * @size: size of the temporary device used for the benchmark in bytes or 0 to use the default (64 MiB)
  * @error: (out) (optional): place to store error (if any)
  *
- * Supported @context types for this function: passphrase, key file
+ * Benchmarks dm-crypt with all combinations of the performance related
+ * activation flags (%BD_CRYPTO_LUKS_ACTIVATE_NO_READ_WORKQUEUE,
+ * %BD_CRYPTO_LUKS_ACTIVATE_NO_WRITE_WORKQUEUE, %BD_CRYPTO_LUKS_ACTIVATE_SAME_CPU_CRYPT
+ * and %BD_CRYPTO_LUKS_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS) and encryption sector sizes
+ * (512 and 4096 bytes, only 512 with libcryptsetup older than 2.4) to find the
+ * best settings for the CPU(s) of the current machine.
  *
- * Returns: whether the given @luks_device was successfully resumed or not
+ * A temporary (plain) dm-crypt device with a random key is created on top of a
+ * loop device backed by a file in /dev/shm (so that the storage is as fast as
+ * possible and only the encryption is measured) and sequential and random (4 KiB)
+ * reads and writes are done on it with direct I/O for each combination.
+ * Combinations not supported by the running kernel are skipped.
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_SUSPEND_RESUME
+ * The flags can then be used with bd_crypto_luks_open_with_flags() or stored in
+ * the LUKS 2 header with bd_crypto_luks_set_persistent_flags(), the sector size
+ * can be set when formatting the device (see #BDCryptoLUKSExtra).
+ *
+ * Returns: (transfer full) (array zero-terminated=1): results of the benchmark
+ * sorted from the best (the recommended settings) to the worst or %NULL in case
+ * of error
+ *
+ * Tech category: %BD_CRYPTO_TECH_PLAIN-%BD_CRYPTO_TECH_MODE_OPEN_CLOSE
  */
-gboolean bd_crypto_luks_resume (const gchar *luks_device, BDCryptoKeyslotContext *context, GError **error) {
+BDCryptoTuneResult** bd_crypto_tune_flags (const gchar *cipher, guint64 key_size, guint64 size, GError **error) {
     struct crypt_device *cd = NULL;
-    gchar *key_buffer = NULL;
-    gsize buf_len = 0;
-    gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
+    struct crypt_params_plain params = ZERO_INIT;
+    g_autofree gchar *file = NULL;
+    g_autofree gchar *dm_name = NULL;
+    g_autofree gchar *dm_device = NULL;
+    g_autofree gchar *cipher_type = NULL;
+    const gchar *cipher_mode = NULL;
+    guint8 *volume_key = NULL;
+    BDCryptoTuneResult *result = NULL;
+    GPtrArray *results = NULL;
     GError *l_error = NULL;
+    guint32 crypt_flags = 0;
+    guint n_combinations = 1 << G_N_ELEMENTS (tune_flags);
+    guint64 progress_id = 0;
+    guint flags_idx = 0;
+    guint sector_idx = 0;
+    guint i = 0;
+    gint fd = -1;
+    gint ret = 0;
 
-    msg = g_strdup_printf ("Started resuming '%s' LUKS device", luks_device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    if (!cipher)
+        cipher = DEFAULT_LUKS_CIPHER;
+    if (key_size == 0)
+        key_size = DEFAULT_LUKS_KEYSIZE_BITS;
+    if (size == 0)
+        size = TUNE_DEFAULT_SIZE;
+    size = MAX (size / TUNE_SEQ_BLOCK, 1) * TUNE_SEQ_BLOCK;
+
+    cipher_mode = strchr (cipher, '-');
+    if (!cipher_mode || key_size % 8 != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_SPEC,
+                     "Invalid cipher specification or key size: '%s', %"G_GUINT64_FORMAT, cipher, key_size);
+        return NULL;
+    }
+    cipher_type = g_strndup (cipher, cipher_mode - cipher);
+    cipher_mode++;
 
-    ret = crypt_init_by_name (&cd, luks_device);
+    file = g_build_filename (g_file_test ("/dev/shm", G_FILE_TEST_IS_DIR) ? "/dev/shm" : g_get_tmp_dir (),
+                             "bd-crypto-tune-XXXXXX", NULL);
+    fd = g_mkstemp (file);
+    if (fd < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to create the temporary file for the benchmark: %s", strerror_l (errno, c_locale));
+        return NULL;
+    }
+    ret = ftruncate (fd, size);
+    close (fd);
     if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to create the temporary file for the benchmark: %s", strerror_l (errno, c_locale));
+        unlink (file);
+        return NULL;
     }
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+    volume_key = crypt_safe_alloc (key_size / 8);
+    if (!volume_key || getrandom (volume_key, key_size / 8, 0) != (gssize) (key_size / 8)) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to generate the key for the benchmark");
+        crypt_safe_free (volume_key);
+        unlink (file);
+        return NULL;
     }
 
-    if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
-        ret = crypt_resume_by_passphrase (cd, luks_device, CRYPT_ANY_SLOT,
-                                          (const char *) context->u.passphrase.pass_data,
-                                          context->u.passphrase.data_len);
-    } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+    /* the name of the temporary file is unique, even between threads */
+    dm_name = g_path_get_basename (file);
+    dm_device = g_strdup_printf ("/dev/mapper/%s", dm_name);
+    results = g_ptr_array_new_with_free_func ((GDestroyNotify) bd_crypto_tune_result_free);
+    progress_id = bd_utils_report_started ("Started dm-crypt benchmark");
+
+    for (sector_idx = 0; !l_error && sector_idx < G_N_ELEMENTS (tune_sector_sizes); sector_idx++) {
+        /* libcryptsetup attaches (and later detaches) a loop device for the file */
+        ret = crypt_init (&cd, file);
         if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
-                         "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
-            crypt_free (cd);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
-            return FALSE;
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+            break;
         }
-        ret = crypt_resume_by_passphrase (cd, luks_device, CRYPT_ANY_SLOT, key_buffer, buf_len);
-        crypt_safe_free (key_buffer);
-    } else {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
-                        "Only 'passphrase' and 'key file' context types are valid for LUKS resume.");
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
+
+#ifdef LIBCRYPTSETUP_24
+        params.sector_size = tune_sector_sizes[sector_idx];
+#endif
+        ret = crypt_format (cd, CRYPT_PLAIN, cipher_type, cipher_mode, NULL, NULL, key_size / 8, &params);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
+                         "Failed to set up the benchmark device: %s", strerror_l (-ret, c_locale));
             crypt_free (cd);
-            return FALSE;
+            break;
+        }
+
+        for (flags_idx = 0; !l_error && flags_idx < n_combinations; flags_idx++) {
+            result = g_new0 (BDCryptoTuneResult, 1);
+            result->sector_size = tune_sector_sizes[sector_idx];
+            for (i = 0; i < G_N_ELEMENTS (tune_flags); i++)
+                if (flags_idx & (1 << i))
+                    result->flags |= tune_flags[i];
+            get_crypt_activate_flags (result->flags, &crypt_flags, NULL);
+
+            ret = crypt_activate_by_volume_key (cd, dm_name, (const char *) volume_key, key_size / 8, crypt_flags);
+            if (ret < 0) {
+                /* flags not supported by the kernel */
+                bd_crypto_tune_result_free (result);
+                continue;
+            }
+
+            if (tune_run_benchmark (dm_device, size, result, &l_error))
+                g_ptr_array_add (results, result);
+            else
+                bd_crypto_tune_result_free (result);
+
+            ret = crypt_deactivate (cd, dm_name);
+            if (ret != 0 && !l_error)
+                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                             "Failed to deactivate the benchmark device: %s", strerror_l (-ret, c_locale));
+
+            bd_utils_report_progress (progress_id,
+                                      100 * (sector_idx * n_combinations + flags_idx + 1) / (G_N_ELEMENTS (tune_sector_sizes) * n_combinations),
+                                      "dm-crypt benchmark in progress");
+        }
+
+        crypt_free (cd);
     }
 
-    if (ret < 0) {
+    crypt_safe_free (volume_key);
+    unlink (file);
+
+    if (!l_error && results->len == 0)
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to resume device: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
+                     "Failed to activate the benchmark device with any of the flags combinations");
+    if (l_error) {
+        g_ptr_array_free (results, TRUE);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
-        return FALSE;
+        return NULL;
     }
 
-    crypt_free (cd);
+    g_ptr_array_sort (results, compare_tune_results);
+    g_ptr_array_set_free_func (results, NULL);
+    g_ptr_array_add (results, NULL);
+
     bd_utils_report_finished (progress_id, "Completed");
-    return TRUE;
+    return (BDCryptoTuneResult **) g_ptr_array_free (results, FALSE);
 }
 
-/**
- * bd_crypto_luks_kill_slot:
- * @device: device to kill slot on
- * @slot: keyslot to destroy
- * @error: (out) (optional): place to store error (if any)
- *
- * Note: This can destroy last remaining keyslot without confirmation making
- *       the LUKS device permanently inaccessible.
- *
- * Returns: whether the given @slot was successfully destroyed or not
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REMOVE_KEY
- */
-gboolean bd_crypto_luks_kill_slot (const gchar *device, gint slot, GError **error) {
-    struct crypt_device *cd = NULL;
-    gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
+/* re-encryption jobs currently running in this process, so that they can be cancelled */
+static GMutex reencrypt_jobs_lock;
+static GHashTable *reencrypt_jobs = NULL;    /* canonical device path -> ReencryptJob */
+
+/* libcryptsetup calls the progress callback (where the rate limit is applied)
+   after each hotzone, if the caller doesn't specify the hotzone size, make it
+   small enough for the rate to stay smooth */
+#define REENCRYPT_RATE_HOTZONES_PER_SEC 4
+#define REENCRYPT_RATE_SLEEP_SLICE (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct ReencryptJob {
+    gint cancelled;
+    guint64 progress_id;
+    guint64 max_rate;
+    gboolean started;
+    gint64 start_time;
+    guint64 start_offset;
+    gint last_percent;
+} ReencryptJob;
+
+static gchar* reencrypt_job_key (const gchar *device) {
+    gchar *path = realpath (device, NULL);
+    gchar *ret = g_strdup (path ? path : device);
+
+    free (path);
+    return ret;
+}
 
-    msg = g_strdup_printf ("Started killing slot %d on LUKS device '%s'", slot, device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+#ifdef LIBCRYPTSETUP_24
+static gboolean reencrypt_job_register (const gchar *device, ReencryptJob *job, GError **error) {
+    gchar *key = reencrypt_job_key (device);
+    gboolean ret = TRUE;
+
+    g_mutex_lock (&reencrypt_jobs_lock);
+    if (!reencrypt_jobs)
+        reencrypt_jobs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    if (g_hash_table_contains (reencrypt_jobs, key)) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_STATE,
+                     "Re-encryption of '%s' is already running", device);
+        g_free (key);
+        ret = FALSE;
+    } else
+        g_hash_table_insert (reencrypt_jobs, key, job);
+    g_mutex_unlock (&reencrypt_jobs_lock);
 
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
-    }
+    return ret;
+}
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+static void reencrypt_job_unregister (const gchar *device) {
+    gchar *key = reencrypt_job_key (device);
+
+    g_mutex_lock (&reencrypt_jobs_lock);
+    if (reencrypt_jobs) {
+        g_hash_table_remove (reencrypt_jobs, key);
+        if (g_hash_table_size (reencrypt_jobs) == 0) {
+            g_hash_table_destroy (reencrypt_jobs);
+            reencrypt_jobs = NULL;
+        }
     }
+    g_mutex_unlock (&reencrypt_jobs_lock);
+    g_free (key);
+}
 
-    ret = crypt_keyslot_destroy (cd, slot);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to destroy keyslot: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+static int reencrypt_progress (uint64_t size, uint64_t offset, void *usrptr) {
+    ReencryptJob *job = (ReencryptJob *) usrptr;
+    gint64 expected = 0;
+    gint64 elapsed = 0;
+    gint percent = 0;
+
+    if (!job->started) {
+        /* resumed re-encryption doesn't start from the beginning, measure the rate from here */
+        job->started = TRUE;
+        job->start_time = g_get_monotonic_time ();
+        job->start_offset = offset;
+    }
+
+    percent = size > 0 ? (gint) ((gdouble) offset * 100 / size) : 100;
+    if (percent != job->last_percent) {
+        bd_utils_report_progress (job->progress_id, percent, "Re-encryption in progress");
+        job->last_percent = percent;
+    }
+
+    if (job->max_rate > 0 && offset < size) {
+        /* wait until the average rate since the start drops to the limit, in
+           short slices to react to cancellation quickly */
+        expected = (gint64) ((gdouble) (offset - job->start_offset) / job->max_rate * G_USEC_PER_SEC);
+        elapsed = g_get_monotonic_time () - job->start_time;
+        while (elapsed < expected && !g_atomic_int_get (&job->cancelled)) {
+            g_usleep (MIN (expected - elapsed, REENCRYPT_RATE_SLEEP_SLICE));
+            elapsed = g_get_monotonic_time () - job->start_time;
+        }
     }
 
-    crypt_free (cd);
-    bd_utils_report_finished (progress_id, "Completed");
-    return TRUE;
+    /* non-zero return value interrupts the re-encryption leaving it in a resumable state */
+    return g_atomic_int_get (&job->cancelled) ? 1 : 0;
 }
 
-/**
- * bd_crypto_luks_header_backup:
- * @device: device to backup the LUKS header
- * @backup_file: file to save the header backup to
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the given backup of @device was successfully written to
- *          @backup_file or not
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_BACKUP_RESTORE
- */
-gboolean bd_crypto_luks_header_backup (const gchar *device, const gchar *backup_file, GError **error) {
-    struct crypt_device *cd = NULL;
+static guint64 reencrypt_hotzone_sectors (BDCryptoLUKSReencryptParams *params) {
+    if (!params)
+        return 0;
+    if (params->max_hotzone_size)
+        return params->max_hotzone_size / SECTOR_SIZE;
+    if (params->max_rate)
+        return MAX (params->max_rate / REENCRYPT_RATE_HOTZONES_PER_SEC / (1 MiB), 1) * (1 MiB) / SECTOR_SIZE;
+    return 0;
+}
+
+static gboolean reencrypt_init (struct crypt_device *cd, const gchar *device, const gchar *name, BDCryptoKeyslotContext *context,
+                                const gchar *key, gsize key_len, BDCryptoLUKSReencryptParams *params, gboolean resume, GError **error) {
+    struct crypt_params_reencrypt rparams = ZERO_INIT;
+    struct crypt_params_luks2 luks2_params = ZERO_INIT;
+    struct crypt_pbkdf_type *pbkdf = NULL;
+    BDCryptoLUKSReencryptMode mode = params ? params->mode : BD_CRYPTO_LUKS_REENCRYPT_MODE_REENCRYPT;
+    crypt_reencrypt_info ri;
+    gchar **cipher_specs = NULL;
+    const gchar *cipher = NULL;
+    const gchar *cipher_mode = NULL;
+    gsize key_size = 0;
+    gint keyslot_new = CRYPT_ANY_SLOT;
     gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
     GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started header backup of LUKS device '%s'", device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    if (resume) {
+        ri = crypt_reencrypt_status (cd, &rparams);
+        if (ri == CRYPT_REENCRYPT_NONE) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_STATE,
+                         "No re-encryption in progress on '%s'", device);
+            return FALSE;
+        } else if (ri == CRYPT_REENCRYPT_INVALID) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Invalid re-encryption metadata on '%s'", device);
+            return FALSE;
+        }
 
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+        rparams.flags = CRYPT_REENCRYPT_RESUME_ONLY;
+        if (reencrypt_hotzone_sectors (params))
+            rparams.max_hotzone_size = reencrypt_hotzone_sectors (params);
+        ret = crypt_reencrypt_init_by_passphrase (cd, name, key, key_len, context->keyslot_hint, CRYPT_ANY_SLOT,
+                                                  NULL, NULL, &rparams);
+        if (ret < 0) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REENCRYPT_FAILED,
+                         "Failed to resume re-encryption of '%s': %s", device, strerror_l (-ret, c_locale));
+            return FALSE;
+        }
+        return TRUE;
     }
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device's parameters: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    if (mode != BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT && crypt_reencrypt_status (cd, NULL) != CRYPT_REENCRYPT_NONE) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_STATE,
+                     "Re-encryption of '%s' was already started, it needs to be resumed", device);
         return FALSE;
     }
 
-    ret = crypt_header_backup (cd, NULL, backup_file);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to backup LUKS header: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
+    rparams.resilience = params && params->resilience ? params->resilience : "checksum";
+    rparams.hash = params && params->hash ? params->hash : "sha256";
+    rparams.device_size = params ? params->device_size / SECTOR_SIZE : 0;
+    rparams.max_hotzone_size = reencrypt_hotzone_sectors (params);
+    rparams.direction = CRYPT_REENCRYPT_FORWARD;
+
+    if (mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_DECRYPT) {
+        rparams.mode = CRYPT_REENCRYPT_DECRYPT;
+        ret = crypt_reencrypt_init_by_passphrase (cd, name, key, key_len, context->keyslot_hint, CRYPT_ANY_SLOT,
+                                                  NULL, NULL, &rparams);
+        if (ret < 0) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REENCRYPT_FAILED,
+                         "Failed to initialize decryption of '%s': %s", device, strerror_l (-ret, c_locale));
+            return FALSE;
+        }
+        return TRUE;
     }
 
-    crypt_free (cd);
-    bd_utils_report_finished (progress_id, "Completed");
-    return TRUE;
-}
+    if (params && params->cipher) {
+        cipher_specs = g_strsplit (params->cipher, "-", 2);
+        if (g_strv_length (cipher_specs) != 2) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_SPEC,
+                         "Invalid cipher specification: '%s'", params->cipher);
+            g_strfreev (cipher_specs);
+            return FALSE;
+        }
+        cipher = cipher_specs[0];
+        cipher_mode = cipher_specs[1];
+    } else if (mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT) {
+        cipher_specs = g_strsplit (DEFAULT_LUKS_CIPHER, "-", 2);
+        cipher = cipher_specs[0];
+        cipher_mode = cipher_specs[1];
+    } else {
+        cipher = crypt_get_cipher (cd);
+        cipher_mode = crypt_get_cipher_mode (cd);
+    }
 
-/**
- * bd_crypto_luks_header_restore:
- * @device: device to restore the LUKS header to
- * @backup_file: existing file with a LUKS header backup
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the given @device LUKS header was successfully restored
- *          from @backup_file
- *
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_BACKUP_RESTORE
- */
-gboolean bd_crypto_luks_header_restore (const gchar *device, const gchar *backup_file, GError **error) {
-    struct crypt_device *cd = NULL;
-    gint ret = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
+    if (params && params->key_size)
+        key_size = params->key_size / 8;
+    else if (mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_REENCRYPT && !(params && params->cipher))
+        key_size = crypt_get_volume_key_size (cd);
+    else if (g_str_has_prefix (cipher_mode, "xts-"))
+        key_size = DEFAULT_LUKS_KEYSIZE_BITS * 2 / 8;
+    else
+        key_size = DEFAULT_LUKS_KEYSIZE_BITS / 8;
 
-    msg = g_strdup_printf ("Started LUKS header restore on device '%s'", device);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    pbkdf = get_pbkdf_params (params ? params->pbkdf : NULL, &l_error);
+    if (pbkdf == NULL && l_error != NULL) {
+        g_strfreev (cipher_specs);
+        g_propagate_prefixed_error (error, l_error,
+                                    "Failed to get PBKDF parameters for '%s'.", device);
+        return FALSE;
+    }
 
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    if (mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT) {
+        /* the data stays where it is, the (detached) header is created first */
+        luks2_params.pbkdf = pbkdf;
+        luks2_params.sector_size = params->sector_size ? params->sector_size : DEFAULT_LUKS2_SECTOR_SIZE;
+        ret = crypt_format (cd, CRYPT_LUKS2, cipher, cipher_mode, NULL, NULL, key_size, &luks2_params);
+        if (ret != 0) {
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_FORMAT_FAILED,
+                         "Failed to format the LUKS header for '%s': %s", device, strerror_l (-ret, c_locale));
+            g_strfreev (cipher_specs);
+            g_free (pbkdf);
+            return FALSE;
+        }
+
+        ret = crypt_keyslot_add_by_volume_key (cd, CRYPT_ANY_SLOT, NULL, 0, key, key_len);
+    } else {
+        if (pbkdf) {
+            ret = crypt_set_pbkdf_type (cd, pbkdf);
+            if (ret != 0) {
+                g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                             "Failed to set PBKDF parameters for '%s': %s", device, strerror_l (-ret, c_locale));
+                g_strfreev (cipher_specs);
+                g_free (pbkdf);
+                return FALSE;
+            }
+        }
+
+        /* keyslot with a new (unbound) volume key for the same passphrase */
+        ret = crypt_keyslot_add_by_key (cd, CRYPT_ANY_SLOT, NULL, key_size, key, key_len, CRYPT_VOLUME_KEY_NO_SEGMENT);
+    }
+    g_free (pbkdf);
+    if (ret < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_ADD_KEY,
+                     "Failed to add keyslot for the new volume key to '%s': %s", device, strerror_l (-ret, c_locale));
+        g_strfreev (cipher_specs);
         return FALSE;
     }
+    keyslot_new = ret;
+
+    luks2_params.pbkdf = NULL;
+    luks2_params.sector_size = params && params->sector_size ? params->sector_size : crypt_get_sector_size (cd);
+    rparams.luks2 = &luks2_params;
+
+    if (mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT) {
+        /* device being encrypted can only be activated once the re-encryption metadata is in place */
+        rparams.mode = CRYPT_REENCRYPT_ENCRYPT;
+        rparams.flags = name ? CRYPT_REENCRYPT_INITIALIZE_ONLY : 0;
+        ret = crypt_reencrypt_init_by_passphrase (cd, NULL, key, key_len, CRYPT_ANY_SLOT, keyslot_new,
+                                                  cipher, cipher_mode, &rparams);
+        if (ret >= 0 && name) {
+            ret = crypt_activate_by_passphrase (cd, name, keyslot_new, key, key_len, 0);
+            if (ret >= 0) {
+                rparams.flags = CRYPT_REENCRYPT_RESUME_ONLY;
+                ret = crypt_reencrypt_init_by_passphrase (cd, name, key, key_len, CRYPT_ANY_SLOT, keyslot_new,
+                                                          NULL, NULL, &rparams);
+            }
+        }
+    } else {
+        rparams.mode = CRYPT_REENCRYPT_REENCRYPT;
+        ret = crypt_reencrypt_init_by_passphrase (cd, name, key, key_len, context->keyslot_hint, keyslot_new,
+                                                  cipher, cipher_mode, &rparams);
+        if (ret < 0)
+            crypt_keyslot_destroy (cd, keyslot_new);
+    }
+    g_strfreev (cipher_specs);
 
-    ret = crypt_header_restore (cd, NULL, backup_file);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to restore LUKS header: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    if (ret < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REENCRYPT_FAILED,
+                     "Failed to initialize re-encryption of '%s': %s", device, strerror_l (-ret, c_locale));
         return FALSE;
     }
 
-    crypt_free (cd);
-    bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
-/**
- * bd_crypto_luks_set_label:
- * @device: device to set label on
- * @label: (nullable): label to set
- * @subsystem: (nullable): subsystem to set
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the given @label and @subsystem were successfully set or not
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
- */
-gboolean bd_crypto_luks_set_label (const gchar *device, const gchar *label, const gchar *subsystem, GError **error) {
+static gboolean _crypto_luks_reencrypt (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context,
+                                        BDCryptoLUKSReencryptParams *params, gboolean resume, GError **error) {
     struct crypt_device *cd = NULL;
+    ReencryptJob job = ZERO_INIT;
+    BDCryptoLUKSReencryptMode mode = params ? params->mode : BD_CRYPTO_LUKS_REENCRYPT_MODE_REENCRYPT;
+    const gchar *header = params ? params->header : NULL;
+    const gchar *key = NULL;
+    gchar *key_buffer = NULL;
+    gsize key_len = 0;
+    gchar *msg = NULL;
+    gboolean success = TRUE;
+    gboolean header_created = FALSE;
+    gboolean initialized = FALSE;
+    gint fd = -1;
     gint ret = 0;
+    GError *l_error = NULL;
 
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+    if (context->type != BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE &&
+        context->type != BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
+                     "Only 'passphrase' and 'key file' context types are valid for LUKS re-encryption.");
         return FALSE;
     }
 
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
+    if (!resume && !header && mode != BD_CRYPTO_LUKS_REENCRYPT_MODE_REENCRYPT) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_PARAMS,
+                     "Encryption and decryption are supported only for devices with a detached LUKS header.");
         return FALSE;
     }
 
-    if (g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
-                     "Label can be set only on LUKS 2 devices: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        return FALSE;
-    }
+    if (name && !_is_dm_name_valid (name, error))
+        return FALSE;
+
+    if (!reencrypt_job_register (device, &job, error))
+        return FALSE;
+
+    job.max_rate = params ? params->max_rate : 0;
+    job.last_percent = -1;
+
+    msg = g_strdup_printf ("Started %s of LUKS device '%s'", resume ? "resuming re-encryption" : "re-encryption", device);
+    job.progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    if (header && !resume && mode == BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT) {
+        /* same as cryptsetup, create the header file, libcryptsetup expands it as needed */
+        fd = open (header, O_CREAT|O_EXCL|O_WRONLY|O_CLOEXEC, S_IRUSR|S_IWUSR);
+        if (fd < 0)
+            ret = -errno;
+        else {
+            header_created = TRUE;
+            ret = -posix_fallocate (fd, 0, 4096);
+            close (fd);
+        }
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to create the LUKS header file '%s': %s", header, strerror_l (-ret, c_locale));
+            success = FALSE;
+        }
+    }
+
+    if (success) {
+        if (header)
+            ret = crypt_init_data_device (&cd, header, device);
+        else
+            ret = crypt_init (&cd, device);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+            success = FALSE;
+        }
+    }
+
+    if (success && (resume || mode != BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT)) {
+        ret = crypt_load (cd, CRYPT_LUKS2, NULL);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Failed to load LUKS 2 header from '%s': %s", header ? header : device, strerror_l (-ret, c_locale));
+            success = FALSE;
+        }
+    }
+
+    if (success) {
+        if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_PASSPHRASE) {
+            key = (const gchar *) context->u.passphrase.pass_data;
+            key_len = context->u.passphrase.data_len;
+        } else {
+            ret = keyfile_context_get_key (cd, context, &key_buffer, &key_len);
+            if (ret != 0) {
+                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
+                             "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
+                success = FALSE;
+            }
+            key = key_buffer;
+        }
+    }
+
+    if (success)
+        success = initialized = reencrypt_init (cd, device, name, context, key, key_len, params, resume, &l_error);
 
-    ret = crypt_set_label (cd, label, subsystem);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to set label: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        return FALSE;
+    if (success) {
+        bd_utils_report_progress (job.progress_id, 0, "Re-encryption initialized");
+        ret = crypt_reencrypt_run (cd, reencrypt_progress, &job);
+        if (ret != 0) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_REENCRYPT_FAILED,
+                         "Re-encryption of '%s' failed: %s", device, strerror_l (-ret, c_locale));
+            success = FALSE;
+        } else if (g_atomic_int_get (&job.cancelled)) {
+            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_CANCELLED,
+                         "Re-encryption of '%s' was cancelled, it can be resumed later", device);
+            success = FALSE;
+        }
     }
 
+    /* keyslots bound to the old volume key are gone */
+    if (success && mode != BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT)
+        keyslot_cache_drop (crypt_get_uuid (cd), CRYPT_ANY_SLOT);
+
     crypt_free (cd);
+    reencrypt_job_unregister (device);
 
+    /* the header file created above is useless (and would make a retry fail)
+       unless the encryption was initialized and can be resumed from it */
+    if (!success && header_created && !initialized && unlink (header) != 0)
+        bd_utils_log_format (BD_UTILS_LOG_WARNING, "Failed to remove the LUKS header file '%s': %s",
+                             header, strerror_l (errno, c_locale));
+
+    if (!success) {
+        bd_utils_report_finished (job.progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    bd_utils_report_finished (job.progress_id, "Completed");
     return TRUE;
 }
+#else
+static gboolean _crypto_luks_reencrypt (const gchar *device G_GNUC_UNUSED, const gchar *name G_GNUC_UNUSED, BDCryptoKeyslotContext *context G_GNUC_UNUSED,
+                                        BDCryptoLUKSReencryptParams *params G_GNUC_UNUSED, gboolean resume G_GNUC_UNUSED, GError **error) {
+    g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
+                 "LUKS re-encryption requires libcryptsetup >= 2.4.0");
+    return FALSE;
+}
+#endif
 
 /**
- * bd_crypto_luks_set_uuid:
- * @device: device to set UUID on
- * @uuid: (nullable): UUID to set or %NULL to generate a new one
+ * bd_crypto_luks_reencrypt:
+ * @device: device to re-encrypt, encrypt or decrypt
+ * @name: (nullable): name of the active LUKS mapping of @device for online re-encryption or %NULL
+ *                    for offline re-encryption (for %BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT the device
+ *                    is activated under this name once the re-encryption is initialized)
+ * @context: key slot context (passphrase/keyfile/token...) to unlock @device, it is also used for the
+ *           new key slot bound to the new volume key
+ * @params: (nullable): re-encryption parameters or %NULL to re-encrypt @device with a new volume key
+ *                      keeping its current cipher
  * @error: (out) (optional): place to store error (if any)
  *
- * Returns: whether the given @uuid was successfully set or not
+ * Changes the volume key (and optionally the cipher) of a LUKS 2 device, or encrypts/decrypts
+ * a device in place. Progress is reported using the progress reporting functions, the
+ * re-encryption can be cancelled with bd_crypto_luks_reencrypt_cancel() and resumed later with
+ * bd_crypto_luks_reencrypt_resume(). Use @params->max_rate to keep the re-encryption from
+ * starving other I/O on the device.
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ * Note: Only the key slot unlocked by @context is preserved, all other key slots are
+ *       removed when the re-encryption finishes.
+ *       Encryption and decryption are supported only for devices with a detached header
+ *       (see @params->header), the header file is created for %BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT.
+ *
+ * Returns: whether the re-encryption of @device finished successfully or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REENCRYPT
  */
-gboolean bd_crypto_luks_set_uuid (const gchar *device, const gchar *uuid, GError **error) {
-    struct crypt_device *cd = NULL;
-    gint ret = 0;
-
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        return FALSE;
-    }
-
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    ret = crypt_set_uuid (cd, uuid);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to set UUID: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    crypt_free (cd);
-
-    return TRUE;
+gboolean bd_crypto_luks_reencrypt (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSReencryptParams *params, GError **error) {
+    return _crypto_luks_reencrypt (device, name, context, params, FALSE, error);
 }
 
 /**
- * bd_crypto_luks_convert:
- * @device:  a LUKS device to convert to a different version of LUKS
- * @target_version: the LUKS version to convert to
+ * bd_crypto_luks_reencrypt_resume:
+ * @device: device with an interrupted re-encryption
+ * @name: (nullable): name of the active LUKS mapping of @device for online re-encryption or %NULL
+ * @context: key slot context (passphrase/keyfile/token...) to unlock @device
+ * @params: (nullable): re-encryption parameters or %NULL, only @params->header,
+ *                      @params->max_hotzone_size and @params->max_rate are used,
+ *                      the rest is loaded from the re-encryption metadata
  * @error: (out) (optional): place to store error (if any)
  *
- * Returns: whether the @device was converted to @target_version.
- *          False, if the @device is already in the @target_version format.
+ * Resumes re-encryption of @device cancelled by bd_crypto_luks_reencrypt_cancel() or
+ * interrupted by a crash.
  *
- * Warning: LUKS header loss is possible. See bd_crypto_luks_header_backup() and bd_crypto_luks_header_restore()
+ * Returns: whether the re-encryption of @device finished successfully or not
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REENCRYPT
  */
-gboolean bd_crypto_luks_convert (const gchar *device, BDCryptoLUKSVersion target_version, GError **error) {
-    struct crypt_device *cd = NULL;
-    const char *cd_type;
-    const char *target_type;
-    gint ret = 0;
-
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        return FALSE;
-    }
-
-    ret = crypt_load (cd, CRYPT_LUKS, NULL);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to load device: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    cd_type = crypt_get_type (cd);
-    if (g_strcmp0 (cd_type, CRYPT_LUKS1) != 0 &&
-        g_strcmp0 (cd_type, CRYPT_LUKS2) != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_CONVERT_FAILED,
-                     "It is possible to convert only between LUKS1 and LUKS2 formats. Device %s is of type: %s", device, cd_type);
-        crypt_free (cd);
-        return FALSE;
-    }
-
-    target_type = target_version == BD_CRYPTO_LUKS_VERSION_LUKS1 ? CRYPT_LUKS1 : CRYPT_LUKS2;
-    if (g_strcmp0 (cd_type, target_type) == 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_CONVERT_FAILED,
-                     "Conversion to the %s type was requested, but device %s is already of type: %s", target_type, device, cd_type);
-        crypt_free (cd);
-        return FALSE;
-    }
+gboolean bd_crypto_luks_reencrypt_resume (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSReencryptParams *params, GError **error) {
+    return _crypto_luks_reencrypt (device, name, context, params, TRUE, error);
+}
 
-    ret = crypt_convert (cd, target_type, NULL);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Conversion failed: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
+/**
+ * bd_crypto_luks_reencrypt_cancel:
+ * @device: device being re-encrypted
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Asks the re-encryption of @device running in this process (in a different
+ * thread) to stop. The re-encryption stops after the current hotzone, its
+ * bd_crypto_luks_reencrypt() call fails with %BD_CRYPTO_ERROR_CANCELLED and
+ * it can be resumed later with bd_crypto_luks_reencrypt_resume().
+ *
+ * Returns: whether the re-encryption of @device was asked to stop or not
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_REENCRYPT
+ */
+gboolean bd_crypto_luks_reencrypt_cancel (const gchar *device, GError **error) {
+    gchar *key = reencrypt_job_key (device);
+    ReencryptJob *job = NULL;
+
+    g_mutex_lock (&reencrypt_jobs_lock);
+    if (reencrypt_jobs)
+        job = g_hash_table_lookup (reencrypt_jobs, key);
+    if (job)
+        g_atomic_int_set (&job->cancelled, 1);
+    g_mutex_unlock (&reencrypt_jobs_lock);
+    g_free (key);
+
+    if (!job) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_STATE,
+                     "No re-encryption of '%s' is running", device);
         return FALSE;
     }
 
-    crypt_free (cd);
     return TRUE;
 }
 
 /**
- * bd_crypto_luks_set_persistent_flags:
- * @device: a LUKS device to set the persistent flags on
- * @flags: flags to set
+ * bd_crypto_luks_reencrypt_status:
+ * @device: LUKS 2 device (or detached LUKS 2 header) to get the re-encryption status of
  * @error: (out) (optional): place to store error (if any)
  *
- * Note: This function is valid only for LUKS2.
- *
- * Returns: whether the given @flags were successfully set or not
+ * Returns: re-encryption status of @device or %BD_CRYPTO_LUKS_REENCRYPT_STATUS_INVALID
+ *          in case of error
  *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_MODIFY
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_QUERY
  */
-gboolean bd_crypto_luks_set_persistent_flags (const gchar *device, BDCryptoLUKSPersistentFlags flags, GError **error) {
+BDCryptoLUKSReencryptStatus bd_crypto_luks_reencrypt_status (const gchar *device, GError **error) {
     struct crypt_device *cd = NULL;
+    crypt_reencrypt_info ri;
     gint ret = 0;
-    guint32 crypt_flags = 0;
 
     ret = crypt_init (&cd, device);
     if (ret != 0) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        return FALSE;
+        return BD_CRYPTO_LUKS_REENCRYPT_STATUS_INVALID;
     }
 
     ret = crypt_load (cd, CRYPT_LUKS, NULL);
@@ -2318,182 +4500,187 @@ gboolean bd_crypto_luks_set_persistent_flags (const gchar *device, BDCryptoLUKSP
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to load device: %s", strerror_l (-ret, c_locale));
         crypt_free (cd);
-        return FALSE;
+        return BD_CRYPTO_LUKS_REENCRYPT_STATUS_INVALID;
     }
 
-    if (g_strcmp0 (crypt_get_type (cd), CRYPT_LUKS2) != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Persistent flags can be set only on LUKS v2");
-        crypt_free (cd);
-        return FALSE;
-    }
+    ri = crypt_reencrypt_status (cd, NULL);
+    crypt_free (cd);
 
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_ALLOW_DISCARDS)
-        crypt_flags |= CRYPT_ACTIVATE_ALLOW_DISCARDS;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_SAME_CPU_CRYPT)
-        crypt_flags |= CRYPT_ACTIVATE_SAME_CPU_CRYPT;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS)
-        crypt_flags |= CRYPT_ACTIVATE_SUBMIT_FROM_CRYPT_CPUS;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_JOURNAL)
-        crypt_flags |= CRYPT_ACTIVATE_NO_JOURNAL;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_READ_WORKQUEUE)
-        crypt_flags |= CRYPT_ACTIVATE_NO_READ_WORKQUEUE;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_NO_WRITE_WORKQUEUE)
-        crypt_flags |= CRYPT_ACTIVATE_NO_WRITE_WORKQUEUE;
-    if (flags & BD_CRYPTO_LUKS_ACTIVATE_HIGH_PRIORITY) {
-#ifdef LIBCRYPTSETUP_28
-        crypt_flags |= CRYPT_ACTIVATE_HIGH_PRIORITY;
-#else
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_TECH_UNAVAIL,
-                     "Libcryptsetup 2.8 or newer is needed for 'high priority' flag support");
-        crypt_free (cd);
-        return FALSE;
-#endif
+    switch (ri) {
+        case CRYPT_REENCRYPT_NONE:
+            return BD_CRYPTO_LUKS_REENCRYPT_STATUS_NONE;
+        case CRYPT_REENCRYPT_CLEAN:
+            return BD_CRYPTO_LUKS_REENCRYPT_STATUS_CLEAN;
+        case CRYPT_REENCRYPT_CRASH:
+            return BD_CRYPTO_LUKS_REENCRYPT_STATUS_CRASH;
+        default:
+            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                         "Invalid re-encryption metadata on '%s'", device);
+            return BD_CRYPTO_LUKS_REENCRYPT_STATUS_INVALID;
     }
+}
 
+/* LUKS2 binary header (see struct luks2_hdr_disk in cryptsetup), only the
+   fields we need, all numbers are big-endian */
+#define LUKS2_BIN_HDR_READ_SIZE 512
+#define LUKS2_MAGIC_LEN 6
+#define LUKS2_HDR_SIZE_OFFSET 8
+#define LUKS2_SEQID_OFFSET 16
+#define LUKS2_LABEL_OFFSET 24
+#define LUKS2_CSUM_ALG_OFFSET 72
+#define LUKS2_CSUM_ALG_LEN 32
+#define LUKS2_SUBSYSTEM_OFFSET 208
+#define LUKS2_HDR_OFFSET_OFFSET 256
+#define LUKS2_CSUM_OFFSET 448
+#define LUKS2_CSUM_LEN 64
+#define LUKS2_LABEL_LEN 48
+/* the binary header is followed by the JSON area, both are covered by the checksum */
+#define LUKS2_HDR_BIN_LEN 4096
+#define LUKS2_HDR_MAX_SIZE (4 * 1024 * 1024)
+
+static const gchar luks2_magic_primary[LUKS2_MAGIC_LEN] = {'L', 'U', 'K', 'S', '\xba', '\xbe'};
+static const gchar luks2_magic_secondary[LUKS2_MAGIC_LEN] = {'S', 'K', 'U', 'L', '\xba', '\xbe'};
+
+/* possible offsets of the secondary header if the primary one is damaged */
+static const guint64 luks2_secondary_offsets[] = {0x4000, 0x8000, 0x10000, 0x20000, 0x40000,
+                                                  0x80000, 0x100000, 0x200000, 0x400000};
+
+static guint64 read_be64 (const guint8 *buf) {
+    guint64 value = 0;
+
+    memcpy (&value, buf, sizeof (value));
+    return GUINT64_FROM_BE (value);
+}
 
-    ret = crypt_persistent_flags_set (cd, CRYPT_FLAGS_ACTIVATION, crypt_flags);
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to set flags: %s", strerror_l (-ret, c_locale));
-        crypt_free (cd);
+/* verifies the checksum of the whole header (binary header and the JSON area)
+   the same way cryptsetup does, a torn or stale header must not be trusted */
+static gboolean check_luks2_hdr_checksum (gint fd, guint64 offset, const guint8 *buf) {
+    g_autofree guint8 *hdr = NULL;
+    g_autofree gchar *alg = NULL;
+    GChecksum *checksum = NULL;
+    GChecksumType type;
+    guint8 digest[LUKS2_CSUM_LEN];
+    gsize digest_len = sizeof (digest);
+    guint64 hdr_size = 0;
+    gboolean ret = FALSE;
+
+    hdr_size = read_be64 (buf + LUKS2_HDR_SIZE_OFFSET);
+    if (hdr_size < LUKS2_HDR_BIN_LEN || hdr_size > LUKS2_HDR_MAX_SIZE || hdr_size % LUKS2_HDR_BIN_LEN != 0 ||
+        read_be64 (buf + LUKS2_HDR_OFFSET_OFFSET) != offset)
+        return FALSE;
+
+    alg = g_strndup ((const gchar *) buf + LUKS2_CSUM_ALG_OFFSET, LUKS2_CSUM_ALG_LEN);
+    if (g_strcmp0 (alg, "sha256") == 0)
+        type = G_CHECKSUM_SHA256;
+    else if (g_strcmp0 (alg, "sha512") == 0)
+        type = G_CHECKSUM_SHA512;
+    else if (g_strcmp0 (alg, "sha1") == 0)
+        type = G_CHECKSUM_SHA1;
+    else {
+        bd_utils_log_format (BD_UTILS_LOG_DEBUG, "Unsupported LUKS2 header checksum algorithm '%s'", alg);
         return FALSE;
     }
 
-    crypt_free (cd);
+    hdr = g_malloc (hdr_size);
+    if (pread (fd, hdr, hdr_size, offset) != (ssize_t) hdr_size)
+        return FALSE;
+    /* the checksum is calculated with the checksum field zeroed */
+    memset (hdr + LUKS2_CSUM_OFFSET, 0, LUKS2_CSUM_LEN);
 
-    return TRUE;
-}
+    checksum = g_checksum_new (type);
+    g_checksum_update (checksum, hdr, hdr_size);
+    g_checksum_get_digest (checksum, digest, &digest_len);
+    g_checksum_free (checksum);
+
+    ret = memcmp (digest, buf + LUKS2_CSUM_OFFSET, digest_len) == 0;
+    if (!ret)
+        bd_utils_log_format (BD_UTILS_LOG_DEBUG, "Checksum mismatch in the LUKS2 header at offset %"G_GUINT64_FORMAT, offset);
 
-static gint synced_close (gint fd) {
-    gint ret = 0;
-    ret = fsync (fd);
-    if (close (fd) != 0)
-        ret = 1;
     return ret;
 }
 
-static gboolean get_subsystem_label (const gchar *device, gchar **subsystem, gchar **label, GError **error) {
-    blkid_probe probe = NULL;
-    gint fd = 0;
-    gint status = 0;
-    const gchar *value = NULL;
+static gboolean read_luks2_bin_header (gint fd, guint64 offset, const gchar *magic, guint8 *buf) {
+    if (pread (fd, buf, LUKS2_BIN_HDR_READ_SIZE, offset) != LUKS2_BIN_HDR_READ_SIZE)
+        return FALSE;
 
-    probe = blkid_new_probe ();
-    if (!probe) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to create a probe for the device '%s'", device);
+    if (memcmp (buf, magic, LUKS2_MAGIC_LEN) != 0)
         return FALSE;
-    }
+
+    return check_luks2_hdr_checksum (fd, offset, buf);
+}
+
+/* reads label and subsystem directly from the LUKS2 binary header (the valid one
+   with the highest sequence ID, just like cryptsetup does) instead of running a
+   full blkid probe on the device */
+static gboolean get_subsystem_label (const gchar *device, gchar **subsystem, gchar **label, GError **error) {
+    guint8 primary[LUKS2_BIN_HDR_READ_SIZE];
+    guint8 secondary[LUKS2_BIN_HDR_READ_SIZE];
+    const guint8 *hdr = NULL;
+    gboolean have_primary = FALSE;
+    guint i = 0;
+    gint fd = -1;
 
     fd = open (device, O_RDONLY|O_CLOEXEC);
     if (fd == -1) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to create a probe for the device '%s'", device);
-        blkid_free_probe (probe);
+                     "Failed to open the device '%s'", device);
         return FALSE;
     }
 
-    status = blkid_probe_set_device (probe, fd, 0, 0);
-    if (status != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to create a probe for the device '%s'", device);
-        blkid_free_probe (probe);
-        synced_close (fd);
-        return FALSE;
+    have_primary = read_luks2_bin_header (fd, 0, luks2_magic_primary, primary);
+    if (have_primary) {
+        hdr = primary;
+        /* the secondary header is located right after the primary one */
+        if (read_luks2_bin_header (fd, read_be64 (primary + LUKS2_HDR_SIZE_OFFSET), luks2_magic_secondary, secondary) &&
+            read_be64 (secondary + LUKS2_SEQID_OFFSET) > read_be64 (primary + LUKS2_SEQID_OFFSET))
+            hdr = secondary;
+    } else {
+        for (i = 0; !hdr && i < G_N_ELEMENTS (luks2_secondary_offsets); i++)
+            if (read_luks2_bin_header (fd, luks2_secondary_offsets[i], luks2_magic_secondary, secondary))
+                hdr = secondary;
     }
+    close (fd);
 
-    blkid_probe_enable_partitions (probe, 1);
-
-    status = blkid_do_probe (probe);
-    if (status != 0) {
+    if (!hdr) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to probe the device '%s'", device);
-        blkid_free_probe (probe);
-        synced_close (fd);
+                     "Failed to read LUKS2 header of the device '%s'", device);
         return FALSE;
     }
 
-    status = blkid_probe_has_value (probe, "LABEL");
-
-    if (status == 0)
-        *label = g_strdup ("");
-    else {
-        status = blkid_probe_lookup_value (probe, "LABEL", &value, NULL);
-        if (status != 0) {
-            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                         "Failed to get label for the device '%s'", device);
-            blkid_free_probe (probe);
-            synced_close (fd);
-            return FALSE;
-        }
-
-        if (value)
-            *label = g_strdup (value);
-        else
-            *label = g_strdup ("");
-    }
-
-    status = blkid_probe_has_value (probe, "SUBSYSTEM");
-    if (status == 0)
-        *subsystem = g_strdup ("");
-    else {
-        status = blkid_probe_lookup_value (probe, "SUBSYSTEM", &value, NULL);
-        if (status != 0) {
-            g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                         "Failed to get subsystem for the device '%s'", device);
-            blkid_free_probe (probe);
-            synced_close (fd);
-            return FALSE;
-        }
-
-        if (value)
-            *subsystem = g_strdup (value);
-        else
-            *subsystem = g_strdup ("");
-    }
-
-    blkid_free_probe (probe);
-    synced_close (fd);
+    *label = g_strndup ((const gchar *) hdr + LUKS2_LABEL_OFFSET, LUKS2_LABEL_LEN);
+    *subsystem = g_strndup ((const gchar *) hdr + LUKS2_SUBSYSTEM_OFFSET, LUKS2_LABEL_LEN);
 
     return TRUE;
 }
 
-/**
- * bd_crypto_luks_info:
- * @device: a device to get information about
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns (transfer full): information about the @device or %NULL in case of error
- *
- * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_QUERY
- */
-BDCryptoLUKSInfo* bd_crypto_luks_info (const gchar *device, GError **error) {
-    struct crypt_device *cd = NULL;
-    BDCryptoLUKSInfo *info = NULL;
-    const gchar *version = NULL;
-    gint ret;
-    gboolean success = FALSE;
+/* initializes @cd for the LUKS @device (or an active LUKS mapping with the name @device) */
+static gint luks_init_and_load (const gchar *device, struct crypt_device **cd) {
+    gint ret = 0;
 
-    ret = crypt_init (&cd, device);
+    ret = crypt_init (cd, device);
     if (ret != 0) {
         /* not a block device, try init_by_name */
-        crypt_free (cd);
-        ret = crypt_init_by_name (&cd, device);
+        crypt_free (*cd);
+        *cd = NULL;
+        ret = crypt_init_by_name (cd, device);
     } else {
-        ret = crypt_load (cd, CRYPT_LUKS, NULL);
+        ret = crypt_load (*cd, CRYPT_LUKS, NULL);
         if (ret != 0) {
             /* not a LUKS device, try init_by_name */
-            crypt_free (cd);
-            ret = crypt_init_by_name (&cd, device);
+            crypt_free (*cd);
+            *cd = NULL;
+            ret = crypt_init_by_name (cd, device);
         }
     }
 
-    if (ret != 0) {
-        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
-        return NULL;
-    }
+    return ret;
+}
+
+static BDCryptoLUKSInfo* get_luks_info (struct crypt_device *cd, GError **error) {
+    BDCryptoLUKSInfo *info = NULL;
+    const gchar *version = NULL;
+    gint ret;
+    gboolean success = FALSE;
 
     info = g_new0 (BDCryptoLUKSInfo, 1);
 
@@ -2518,9 +4705,8 @@ BDCryptoLUKSInfo* bd_crypto_luks_info (const gchar *device, GError **error) {
     info->metadata_size = SECTOR_SIZE * crypt_get_data_offset (cd);
 
     if (info->version == BD_CRYPTO_LUKS_VERSION_LUKS2) {
-        success = get_subsystem_label (crypt_get_device_name (cd) , &(info->subsystem), &(info->label), error);
+        success = get_subsystem_label (crypt_get_metadata_device_name (cd), &(info->subsystem), &(info->label), error);
         if (!success) {
-            crypt_free (cd);
             bd_crypto_luks_info_free (info);
             return NULL;
         }
@@ -2555,6 +4741,31 @@ BDCryptoLUKSInfo* bd_crypto_luks_info (const gchar *device, GError **error) {
     info->hw_encryption = BD_CRYPTO_LUKS_HW_ENCRYPTION_UNKNOWN;
 #endif
 
+    return info;
+}
+
+/**
+ * bd_crypto_luks_info:
+ * @device: a device to get information about
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns (transfer full): information about the @device or %NULL in case of error
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_QUERY
+ */
+BDCryptoLUKSInfo* bd_crypto_luks_info (const gchar *device, GError **error) {
+    struct crypt_device *cd = NULL;
+    BDCryptoLUKSInfo *info = NULL;
+    gint ret;
+
+    ret = luks_init_and_load (device, &cd);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return NULL;
+    }
+
+    info = get_luks_info (cd, error);
     crypt_free (cd);
 
     return info;
@@ -2672,13 +4883,41 @@ BDCryptoIntegrityInfo* bd_crypto_integrity_info (const gchar *device, GError **e
     return info;
 }
 
-/* added in cryptsetup 2.4.0 */
-#ifndef LIBCRYPTSETUP_24
-static int crypt_token_max (const char *type G_GNUC_UNUSED) {
-    return 32;
-}
-#endif
+static BDCryptoLUKSTokenInfo** get_luks_token_info (struct crypt_device *cd) {
+    GPtrArray *tokens = NULL;
+    BDCryptoLUKSTokenInfo *info = NULL;
+    crypt_token_info token_info;
+    const gchar *type = NULL;
+    gint ret;
+    gint token_it, keyslot_it;
+
+    tokens = g_ptr_array_new ();
+
+    for (token_it = 0; token_it < crypt_token_max (CRYPT_LUKS2); token_it++) {
+        token_info = crypt_token_status (cd, token_it, &type);
+        if (token_info == CRYPT_TOKEN_INVALID || token_info == CRYPT_TOKEN_INACTIVE)
+            continue;
+
+        info = g_new0 (BDCryptoLUKSTokenInfo, 1);
+        info->id = token_it;
+        info->type = g_strdup (type);
+        info->keyslot = -1;
+
+        for (keyslot_it = 0; keyslot_it < crypt_keyslot_max (CRYPT_LUKS2); keyslot_it++) {
+            ret = crypt_token_is_assigned (cd, token_it, keyslot_it);
+            if (ret == 0) {
+                info->keyslot = keyslot_it;
+                break;
+            }
+        }
+
+        g_ptr_array_add (tokens, info);
+    }
 
+    /* returning NULL-terminated array of BDCryptoLUKSTokenInfo */
+    g_ptr_array_add (tokens, NULL);
+    return (BDCryptoLUKSTokenInfo **) g_ptr_array_free (tokens, FALSE);
+}
 
 /**
  * bd_crypto_luks_token_info:
@@ -2691,27 +4930,10 @@ static int crypt_token_max (const char *type G_GNUC_UNUSED) {
  */
 BDCryptoLUKSTokenInfo** bd_crypto_luks_token_info (const gchar *device, GError **error) {
     struct crypt_device *cd = NULL;
-    GPtrArray *tokens = NULL;
-    BDCryptoLUKSTokenInfo *info = NULL;
-    crypt_token_info token_info;
-    const gchar *type = NULL;
+    BDCryptoLUKSTokenInfo **tokens = NULL;
     gint ret;
-    gint token_it, keyslot_it;
-
-    ret = crypt_init (&cd, device);
-    if (ret != 0) {
-        /* not a block device, try init_by_name */
-        crypt_free (cd);
-        ret = crypt_init_by_name (&cd, device);
-    } else {
-        ret = crypt_load (cd, CRYPT_LUKS, NULL);
-        if (ret != 0) {
-            /* not a LUKS device, try init_by_name */
-            crypt_free (cd);
-            ret = crypt_init_by_name (&cd, device);
-        }
-    }
 
+    ret = luks_init_and_load (device, &cd);
     if (ret != 0) {
         g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
                      "Failed to initialize device: %s", strerror_l (-ret, c_locale));
@@ -2723,63 +4945,283 @@ BDCryptoLUKSTokenInfo** bd_crypto_luks_token_info (const gchar *device, GError *
         return NULL;
     }
 
-    tokens = g_ptr_array_new ();
+    tokens = get_luks_token_info (cd);
+    crypt_free (cd);
 
-    for (token_it = 0; token_it < crypt_token_max (CRYPT_LUKS2); token_it++) {
-        token_info = crypt_token_status (cd, token_it, &type);
-        if (token_info == CRYPT_TOKEN_INVALID || token_info == CRYPT_TOKEN_INACTIVE)
+    return tokens;
+}
+
+static BDCryptoLUKSKeyslotInfo** get_luks_keyslot_info (struct crypt_device *cd) {
+    GPtrArray *keyslots = NULL;
+    BDCryptoLUKSKeyslotInfo *info = NULL;
+    crypt_keyslot_info status;
+    struct crypt_pbkdf_type pbkdf = ZERO_INIT;
+    gint keyslot_it;
+
+    keyslots = g_ptr_array_new ();
+
+    for (keyslot_it = 0; keyslot_it < crypt_keyslot_max (crypt_get_type (cd)); keyslot_it++) {
+        status = crypt_keyslot_status (cd, keyslot_it);
+        if (status != CRYPT_SLOT_ACTIVE && status != CRYPT_SLOT_ACTIVE_LAST && status != CRYPT_SLOT_UNBOUND)
             continue;
 
-        info = g_new0 (BDCryptoLUKSTokenInfo, 1);
-        info->id = token_it;
-        info->type = g_strdup (type);
-        info->keyslot = -1;
+        info = g_new0 (BDCryptoLUKSKeyslotInfo, 1);
+        info->id = keyslot_it;
+        info->last = status == CRYPT_SLOT_ACTIVE_LAST;
+        info->unbound = status == CRYPT_SLOT_UNBOUND;
+        if (crypt_keyslot_get_pbkdf (cd, keyslot_it, &pbkdf) == 0)
+            info->pbkdf = g_strdup (pbkdf.type);
 
-        for (keyslot_it = 0; keyslot_it < crypt_keyslot_max (CRYPT_LUKS2); keyslot_it++) {
-            ret = crypt_token_is_assigned (cd, token_it, keyslot_it);
-            if (ret == 0) {
-                info->keyslot = keyslot_it;
-                break;
-            }
-        }
+        g_ptr_array_add (keyslots, info);
+    }
 
-        g_ptr_array_add (tokens, info);
+    /* returning NULL-terminated array of BDCryptoLUKSKeyslotInfo */
+    g_ptr_array_add (keyslots, NULL);
+    return (BDCryptoLUKSKeyslotInfo **) g_ptr_array_free (keyslots, FALSE);
+}
+
+static BDCryptoLUKSHeaderInfo* get_luks_header_info (const gchar *device, GError **error) {
+    struct crypt_device *cd = NULL;
+    BDCryptoLUKSHeaderInfo *header = NULL;
+    BDCryptoLUKSInfo *info = NULL;
+    gint ret;
+
+    ret = luks_init_and_load (device, &cd);
+    if (ret != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to initialize device: %s", strerror_l (-ret, c_locale));
+        return NULL;
+    }
+
+    info = get_luks_info (cd, error);
+    if (!info) {
+        crypt_free (cd);
+        return NULL;
     }
 
+    header = g_new0 (BDCryptoLUKSHeaderInfo, 1);
+    header->device = g_strdup (device);
+    header->info = info;
+    header->keyslots = get_luks_keyslot_info (cd);
+    if (info->version == BD_CRYPTO_LUKS_VERSION_LUKS2)
+        header->tokens = get_luks_token_info (cd);
+    else
+        header->tokens = g_new0 (BDCryptoLUKSTokenInfo *, 1);
+
     crypt_free (cd);
 
-    /* returning NULL-terminated array of BDCryptoLUKSTokenInfo */
-    g_ptr_array_add (tokens, NULL);
-    return (BDCryptoLUKSTokenInfo **) g_ptr_array_free (tokens, FALSE);
+    return header;
 }
 
-static int _wipe_progress (guint64 size, guint64 offset, void *usrptr) {
-    /* "convert" the progress from 0-100 to 50-100 because wipe starts at 50 in bd_crypto_integrity_format */
-    gdouble progress = 50 + (((gdouble) offset / size) * 100) / 2;
-    bd_utils_report_progress (*(guint64 *) usrptr, progress, "Integrity device wipe in progress");
+/**
+ * bd_crypto_luks_header_info:
+ * @device: a device to get information about
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full): information about the @device (see
+ * bd_crypto_luks_info()) together with its keyslots and tokens or %NULL in
+ * case of error
+ *
+ * The LUKS header is loaded only once, use this function instead of calling
+ * bd_crypto_luks_info() and bd_crypto_luks_token_info() separately.
+ *
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_QUERY
+ */
+BDCryptoLUKSHeaderInfo* bd_crypto_luks_header_info (const gchar *device, GError **error) {
+    return get_luks_header_info (device, error);
+}
 
-    return 0;
+typedef struct HeaderInfoJob {
+    const gchar **devices;
+    BDCryptoLUKSHeaderInfo **headers;
+} HeaderInfoJob;
+
+static gboolean header_info_task (guint i, gpointer data) {
+    HeaderInfoJob *job = (HeaderInfoJob *) data;
+
+    /* devices that are not LUKS devices are simply skipped */
+    job->headers[i] = get_luks_header_info (job->devices[i], NULL);
+
+    return TRUE;
 }
 
 /**
- * bd_crypto_integrity_format:
- * @device: a device to format as integrity
- * @algorithm: integrity algorithm specification (e.g. "crc32c" or "sha256")
- * @wipe: whether to wipe the device after format; a device that is not initially wiped will contain invalid checksums
- * @context: (nullable): key slot context (passphrase/keyfile/token...) for this device
- * @extra: (nullable): extra arguments for integrity format creation
+ * bd_crypto_luks_header_info_many:
+ * @devices: (array zero-terminated=1): devices to get information about
+ * @max_jobs: maximum number of devices processed in parallel (0 to choose automatically)
  * @error: (out) (optional): place to store error (if any)
  *
- * Formats the given @device as integrity according to the other parameters given.
- *
- * Supported @context types for this function: volume key
+ * Gets the same information as bd_crypto_luks_header_info() for many devices
+ * at once using up to @max_jobs threads. Devices that are not LUKS devices (or
+ * cannot be read) are skipped.
  *
- * Returns: whether the given @device was successfully formatted as integrity or not
- * (the @error) contains the error in such cases)
+ * Returns: (transfer full) (array zero-terminated=1): information about the
+ * LUKS devices among @devices (in the order of @devices)
  *
- * Tech category: %BD_CRYPTO_TECH_INTEGRITY-%BD_CRYPTO_TECH_MODE_CREATE
+ * Tech category: %BD_CRYPTO_TECH_LUKS-%BD_CRYPTO_TECH_MODE_QUERY
  */
-gboolean bd_crypto_integrity_format (const gchar *device, const gchar *algorithm, gboolean wipe, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error) {
+BDCryptoLUKSHeaderInfo** bd_crypto_luks_header_info_many (const gchar **devices, guint max_jobs, GError **error G_GNUC_UNUSED) {
+    HeaderInfoJob job = ZERO_INIT;
+    GPtrArray *ret = NULL;
+    guint n_devices = 0;
+    guint i = 0;
+
+    n_devices = devices ? g_strv_length ((gchar **) devices) : 0;
+    job.devices = devices;
+    job.headers = g_new0 (BDCryptoLUKSHeaderInfo *, n_devices);
+
+    if (max_jobs == 0)
+        max_jobs = MIN (g_get_num_processors (), HEADER_INFO_MAX_JOBS);
+    bd_utils_run_parallel ("bd-crypto-info", n_devices, max_jobs, header_info_task, &job);
+
+    ret = g_ptr_array_new ();
+    for (i = 0; i < n_devices; i++)
+        if (job.headers[i])
+            g_ptr_array_add (ret, job.headers[i]);
+    g_ptr_array_add (ret, NULL);
+    g_free (job.headers);
+
+    return (BDCryptoLUKSHeaderInfo **) g_ptr_array_free (ret, FALSE);
+}
+
+static int _wipe_progress (guint64 size, guint64 offset, void *usrptr) {
+    /* "convert" the progress from 0-100 to 50-100 because wipe starts at 50 in bd_crypto_integrity_format */
+    gdouble progress = 50 + (((gdouble) offset / size) * 100) / 2;
+    bd_utils_report_progress (*(guint64 *) usrptr, progress, "Integrity device wipe in progress");
+
+    return 0;
+}
+
+/* regions of the integrity device are wiped in chunks of this size, the chunks
+   are distributed between the worker threads */
+#define INTEGRITY_WIPE_CHUNK (64 MiB)
+#define INTEGRITY_WIPE_BLOCK (4 MiB)
+
+typedef struct IntegrityWipeJob {
+    gint fd;
+    guint64 size;
+    guint n_chunks;
+    gint zeroout;
+    gint failed;
+    const guint8 *zeroes;
+    guint64 progress_id;
+    GMutex lock;
+    guint64 done;
+    gint last_percent;
+} IntegrityWipeJob;
+
+static gboolean integrity_wipe_task (guint i, gpointer data) {
+    IntegrityWipeJob *job = (IntegrityWipeJob *) data;
+    guint64 range[2] = {0, 0};
+    guint64 start = 0;
+    guint64 offset = 0;
+    guint64 end = 0;
+    ssize_t written = 0;
+    gint percent = 0;
+    gint ret = 0;
+
+    start = (guint64) i * INTEGRITY_WIPE_CHUNK;
+    end = MIN (start + INTEGRITY_WIPE_CHUNK, job->size);
+    offset = start;
+
+    /* let the kernel zero the range if possible (no data is copied from
+       the userspace), fall back to direct writes otherwise */
+    if (g_atomic_int_get (&(job->zeroout))) {
+        range[0] = start;
+        range[1] = end - start;
+        if (ioctl (job->fd, BLKZEROOUT, &range) == 0)
+            offset = end;
+        else if (errno == EOPNOTSUPP || errno == ENOTTY || errno == EINVAL)
+            g_atomic_int_set (&(job->zeroout), 0);
+        else
+            ret = errno;
+    }
+
+    while (ret == 0 && offset < end) {
+        written = pwrite (job->fd, job->zeroes, MIN (INTEGRITY_WIPE_BLOCK, end - offset), offset);
+        if (written > 0)
+            offset += written;
+        else if (written == 0)
+            ret = EIO;
+        else if (errno != EINTR)
+            ret = errno;
+    }
+
+    if (ret != 0) {
+        /* stops the other tasks too */
+        g_atomic_int_compare_and_exchange (&(job->failed), 0, ret);
+        return FALSE;
+    }
+
+    /* progress is reported from one thread at a time */
+    g_mutex_lock (&(job->lock));
+    job->done += end - start;
+    percent = 50 + (gint) (job->done * 50 / job->size);
+    if (percent > job->last_percent) {
+        job->last_percent = percent;
+        bd_utils_report_progress (job->progress_id, percent, "Integrity device wipe in progress");
+    }
+    g_mutex_unlock (&(job->lock));
+
+    return TRUE;
+}
+
+/* zeroes the (activated) integrity device @dm_device using up to @max_jobs threads */
+static gboolean integrity_wipe_parallel (const gchar *dm_device, guint max_jobs, guint64 progress_id, GError **error) {
+    IntegrityWipeJob job = ZERO_INIT;
+    guint8 *zeroes = NULL;
+
+    job.fd = open (dm_device, O_WRONLY | O_DIRECT | O_CLOEXEC);
+    if (job.fd < 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to open '%s': %s", dm_device, strerror_l (errno, c_locale));
+        return FALSE;
+    }
+
+    if (ioctl (job.fd, BLKGETSIZE64, &(job.size)) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to get size of '%s': %s", dm_device, strerror_l (errno, c_locale));
+        close (job.fd);
+        return FALSE;
+    }
+
+    /* O_DIRECT needs an aligned buffer */
+    if (posix_memalign ((void **) &zeroes, 4096, INTEGRITY_WIPE_BLOCK) != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to allocate memory for the wipe");
+        close (job.fd);
+        return FALSE;
+    }
+    memset (zeroes, 0, INTEGRITY_WIPE_BLOCK);
+
+    job.zeroes = zeroes;
+    job.zeroout = 1;
+    job.n_chunks = (guint) ((job.size + INTEGRITY_WIPE_CHUNK - 1) / INTEGRITY_WIPE_CHUNK);
+    job.progress_id = progress_id;
+    job.last_percent = 50;
+    g_mutex_init (&(job.lock));
+
+    if (max_jobs == 0)
+        max_jobs = MIN (g_get_num_processors (), INTEGRITY_WIPE_MAX_JOBS);
+    bd_utils_run_parallel ("bd-integrity-wipe", job.n_chunks, max_jobs, integrity_wipe_task, &job);
+
+    if (job.failed == 0 && fsync (job.fd) != 0)
+        job.failed = errno;
+
+    g_mutex_clear (&(job.lock));
+    free (zeroes);
+    close (job.fd);
+
+    if (job.failed != 0) {
+        g_set_error (error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                     "Failed to wipe '%s': %s", dm_device, strerror_l (job.failed, c_locale));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean _crypto_integrity_format (const gchar *device, const gchar *algorithm, gboolean wipe, gboolean parallel, guint max_jobs, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error) {
     struct crypt_device *cd = NULL;
     gint ret;
     guint64 progress_id = 0;
@@ -2857,14 +5299,19 @@ gboolean bd_crypto_integrity_format (const gchar *device, const gchar *algorithm
         }
 
         bd_utils_report_progress (progress_id, 50, "Starting to wipe the newly created integrity device");
-        ret = crypt_wipe (cd, tmp_path, CRYPT_WIPE_ZERO, 0, 0, 1048576,
-                          0, &_wipe_progress, &progress_id);
+        if (parallel) {
+            if (!integrity_wipe_parallel (tmp_path, max_jobs, progress_id, &l_error))
+                g_prefix_error (&l_error, "Failed to wipe the newly created integrity device: ");
+        } else {
+            ret = crypt_wipe (cd, tmp_path, CRYPT_WIPE_ZERO, 0, 0, 1048576,
+                              0, &_wipe_progress, &progress_id);
+            if (ret != 0)
+                g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
+                             "Failed to wipe the newly created integrity device: %s",
+                             strerror_l (-ret, c_locale));
+        }
         bd_utils_report_progress (progress_id, 100, "Wipe finished");
-        if (ret != 0) {
-            g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_DEVICE,
-                         "Failed to wipe the newly created integrity device: %s",
-                         strerror_l (-ret, c_locale));
-
+        if (l_error) {
             ret = crypt_deactivate (cd, tmp_name);
             if (ret != 0)
                 bd_utils_log_format (BD_UTILS_LOG_ERR, "Failed to deactivate temporary device %s", tmp_name);
@@ -2878,15 +5325,61 @@ gboolean bd_crypto_integrity_format (const gchar *device, const gchar *algorithm
         ret = crypt_deactivate (cd, tmp_name);
         if (ret != 0)
             bd_utils_log_format (BD_UTILS_LOG_ERR, "Failed to deactivate temporary device %s", tmp_name);
-
-    } else
-        bd_utils_report_finished (progress_id, "Completed");
+    }
 
     crypt_free (cd);
+    bd_utils_report_finished (progress_id, "Completed");
 
     return TRUE;
 }
 
+/**
+ * bd_crypto_integrity_format:
+ * @device: a device to format as integrity
+ * @algorithm: integrity algorithm specification (e.g. "crc32c" or "sha256")
+ * @wipe: whether to wipe the device after format; a device that is not initially wiped will contain invalid checksums
+ * @context: (nullable): key slot context (passphrase/keyfile/token...) for this device
+ * @extra: (nullable): extra arguments for integrity format creation
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Formats the given @device as integrity according to the other parameters given.
+ *
+ * Supported @context types for this function: volume key
+ *
+ * Returns: whether the given @device was successfully formatted as integrity or not
+ * (the @error) contains the error in such cases)
+ *
+ * Tech category: %BD_CRYPTO_TECH_INTEGRITY-%BD_CRYPTO_TECH_MODE_CREATE
+ */
+gboolean bd_crypto_integrity_format (const gchar *device, const gchar *algorithm, gboolean wipe, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error) {
+    return _crypto_integrity_format (device, algorithm, wipe, FALSE, 0, context, extra, error);
+}
+
+/**
+ * bd_crypto_integrity_format_parallel:
+ * @device: a device to format as integrity
+ * @algorithm: integrity algorithm specification (e.g. "crc32c" or "sha256")
+ * @max_jobs: maximum number of regions of @device wiped in parallel (0 to choose automatically)
+ * @context: (nullable): key slot context (passphrase/keyfile/token...) for this device
+ * @extra: (nullable): extra arguments for integrity format creation
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Formats the given @device as integrity the same way as bd_crypto_integrity_format()
+ * with wipe, but the initial wipe splits the device into regions which are
+ * zeroed in parallel by up to @max_jobs threads. The regions are zeroed with
+ * the BLKZEROOUT ioctl if possible or with large direct I/O writes otherwise.
+ *
+ * Supported @context types for this function: volume key
+ *
+ * Returns: whether the given @device was successfully formatted as integrity or not
+ * (the @error) contains the error in such cases)
+ *
+ * Tech category: %BD_CRYPTO_TECH_INTEGRITY-%BD_CRYPTO_TECH_MODE_CREATE
+ */
+gboolean bd_crypto_integrity_format_parallel (const gchar *device, const gchar *algorithm, guint max_jobs, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error) {
+    return _crypto_integrity_format (device, algorithm, TRUE, TRUE, max_jobs, context, extra, error);
+}
+
 /**
  * bd_crypto_integrity_open:
  * @device: integrity device to open
@@ -3530,8 +6023,7 @@ gboolean bd_crypto_bitlk_open (const gchar *device, const gchar *name, BDCryptoK
                                             context->u.passphrase.data_len,
                                             read_only ? CRYPT_ACTIVATE_READONLY : 0);
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+        ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
         if (ret != 0) {
             g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
                          "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
@@ -3542,7 +6034,6 @@ gboolean bd_crypto_bitlk_open (const gchar *device, const gchar *name, BDCryptoK
         }
         ret = crypt_activate_by_passphrase (cd, name, CRYPT_ANY_SLOT, key_buffer, buf_len,
                                             read_only ? CRYPT_ACTIVATE_READONLY : 0);
-        crypt_safe_free (key_buffer);
     } else {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
                      "Only 'passphrase' and 'key file' context types are valid for BITLK open.");
@@ -3645,8 +6136,7 @@ gboolean bd_crypto_fvault2_open (const gchar *device, const gchar *name, BDCrypt
                                             context->u.passphrase.data_len,
                                             read_only ? CRYPT_ACTIVATE_READONLY : 0);
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buffer, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+        ret = keyfile_context_get_key (cd, context, &key_buffer, &buf_len);
         if (ret != 0) {
             g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
                          "Failed to read key from file '%s': %s", context->u.keyfile.keyfile, strerror_l (-ret, c_locale));
@@ -3657,7 +6147,6 @@ gboolean bd_crypto_fvault2_open (const gchar *device, const gchar *name, BDCrypt
         }
         ret = crypt_activate_by_passphrase (cd, name, CRYPT_ANY_SLOT, key_buffer, buf_len,
                                             read_only ? CRYPT_ACTIVATE_READONLY : 0);
-        crypt_safe_free (key_buffer);
     } else {
         g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_INVALID_CONTEXT,
                      "Only 'passphrase' and 'key file' context types are valid for FVAULT2 open.");
@@ -3957,8 +6446,7 @@ gboolean bd_crypto_opal_reset_device (const gchar *device, BDCryptoKeyslotContex
         key_buf = (char *) context->u.passphrase.pass_data;
         buf_len = context->u.passphrase.data_len;
     } else if (context->type == BD_CRYPTO_KEYSLOT_CONTEXT_TYPE_KEYFILE) {
-        ret = crypt_keyfile_device_read (cd, context->u.keyfile.keyfile, &key_buf, &buf_len,
-                                         context->u.keyfile.keyfile_offset, context->u.keyfile.key_size, 0);
+        ret = keyfile_context_get_key (cd, context, &key_buf, &buf_len);
         if (ret != 0) {
             g_set_error (&l_error, BD_CRYPTO_ERROR, BD_CRYPTO_ERROR_KEYFILE_FAILED,
                          "Failed to read key from file '%s': %s", context->u.keyfile.keyfile,
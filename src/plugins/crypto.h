@@ -26,6 +26,8 @@ typedef enum {
     BD_CRYPTO_ERROR_KEYFILE_FAILED,
     BD_CRYPTO_ERROR_INVALID_CONTEXT,
     BD_CRYPTO_ERROR_CONVERT_FAILED,
+    BD_CRYPTO_ERROR_REENCRYPT_FAILED,
+    BD_CRYPTO_ERROR_CANCELLED,
 } BDCryptoError;
 
 #define BD_CRYPTO_BACKUP_PASSPHRASE_CHARSET "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz./"
@@ -43,6 +45,7 @@ typedef enum {
     BD_CRYPTO_TECH_KEYRING,
     BD_CRYPTO_TECH_FVAULT2,
     BD_CRYPTO_TECH_SED_OPAL,
+    BD_CRYPTO_TECH_PLAIN,
 } BDCryptoTech;
 
 typedef enum {
@@ -55,6 +58,7 @@ typedef enum {
     BD_CRYPTO_TECH_MODE_SUSPEND_RESUME = 1 << 6,
     BD_CRYPTO_TECH_MODE_BACKUP_RESTORE = 1 << 7,
     BD_CRYPTO_TECH_MODE_MODIFY         = 1 << 8,
+    BD_CRYPTO_TECH_MODE_REENCRYPT      = 1 << 9,
 } BDCryptoTechMode;
 
 typedef enum {
@@ -261,6 +265,132 @@ typedef struct BDCryptoLUKSTokenInfo {
 void bd_crypto_luks_token_info_free (BDCryptoLUKSTokenInfo *info);
 BDCryptoLUKSTokenInfo* bd_crypto_luks_token_info_copy (BDCryptoLUKSTokenInfo *info);
 
+/**
+ * BDCryptoLUKSKeyslotInfo:
+ * @id: ID of the keyslot
+ * @last: whether this is the last active keyslot
+ * @unbound: whether the keyslot is unbound (not assigned to the data segment, LUKS 2 only)
+ * @pbkdf: (nullable): PBKDF used by the keyslot (e.g. "argon2id")
+ */
+typedef struct BDCryptoLUKSKeyslotInfo {
+    guint id;
+    gboolean last;
+    gboolean unbound;
+    gchar *pbkdf;
+} BDCryptoLUKSKeyslotInfo;
+
+void bd_crypto_luks_keyslot_info_free (BDCryptoLUKSKeyslotInfo *info);
+BDCryptoLUKSKeyslotInfo* bd_crypto_luks_keyslot_info_copy (BDCryptoLUKSKeyslotInfo *info);
+
+/**
+ * BDCryptoLUKSHeaderInfo:
+ * @device: the device the information was loaded from
+ * @info: general information about the LUKS device
+ * @keyslots: (array zero-terminated=1): active (and unbound) keyslots
+ * @tokens: (array zero-terminated=1): tokens (always empty for LUKS 1)
+ */
+typedef struct BDCryptoLUKSHeaderInfo {
+    gchar *device;
+    BDCryptoLUKSInfo *info;
+    BDCryptoLUKSKeyslotInfo **keyslots;
+    BDCryptoLUKSTokenInfo **tokens;
+} BDCryptoLUKSHeaderInfo;
+
+void bd_crypto_luks_header_info_free (BDCryptoLUKSHeaderInfo *info);
+BDCryptoLUKSHeaderInfo* bd_crypto_luks_header_info_copy (BDCryptoLUKSHeaderInfo *info);
+
+/**
+ * BDCryptoLUKSOpenResult:
+ * @device: the device that was opened
+ * @name: name of the opened LUKS device
+ * @success: whether the device was successfully opened or not
+ * @error_msg: (nullable): error message if opening the device failed
+ * @kdf_memory: memory (in KiB) reserved for the keyslot KDF while opening the device
+ * @wait_time: time (in microseconds) spent waiting for enough memory and CPUs for the KDF
+ * @duration: time (in microseconds) it took to open the device
+ */
+typedef struct BDCryptoLUKSOpenResult {
+    gchar *device;
+    gchar *name;
+    gboolean success;
+    gchar *error_msg;
+    guint64 kdf_memory;
+    guint64 wait_time;
+    guint64 duration;
+} BDCryptoLUKSOpenResult;
+
+void bd_crypto_luks_open_result_free (BDCryptoLUKSOpenResult *result);
+BDCryptoLUKSOpenResult* bd_crypto_luks_open_result_copy (BDCryptoLUKSOpenResult *result);
+
+/**
+ * BDCryptoTuneResult:
+ * @flags: activation flags used for this run of the benchmark
+ * @sector_size: encryption sector size used for this run of the benchmark
+ * @seq_read: sequential read throughput (in bytes per second)
+ * @seq_write: sequential write throughput (in bytes per second)
+ * @rand_read_latency: average latency of random 4 KiB reads (in nanoseconds)
+ * @rand_write_latency: average latency of random 4 KiB writes (in nanoseconds)
+ * @total_time: time (in microseconds) the whole benchmark run took, lower is better
+ */
+typedef struct BDCryptoTuneResult {
+    BDCryptoLUKSPersistentFlags flags;
+    guint32 sector_size;
+    guint64 seq_read;
+    guint64 seq_write;
+    guint64 rand_read_latency;
+    guint64 rand_write_latency;
+    guint64 total_time;
+} BDCryptoTuneResult;
+
+void bd_crypto_tune_result_free (BDCryptoTuneResult *result);
+BDCryptoTuneResult* bd_crypto_tune_result_copy (BDCryptoTuneResult *result);
+
+typedef enum {
+    BD_CRYPTO_LUKS_REENCRYPT_MODE_REENCRYPT = 0,
+    BD_CRYPTO_LUKS_REENCRYPT_MODE_ENCRYPT,
+    BD_CRYPTO_LUKS_REENCRYPT_MODE_DECRYPT,
+} BDCryptoLUKSReencryptMode;
+
+typedef enum {
+    BD_CRYPTO_LUKS_REENCRYPT_STATUS_NONE = 0,
+    BD_CRYPTO_LUKS_REENCRYPT_STATUS_CLEAN,
+    BD_CRYPTO_LUKS_REENCRYPT_STATUS_CRASH,
+    BD_CRYPTO_LUKS_REENCRYPT_STATUS_INVALID,
+} BDCryptoLUKSReencryptStatus;
+
+/**
+ * BDCryptoLUKSReencryptParams:
+ * @mode: whether to re-encrypt, encrypt or decrypt the device
+ * @cipher: new cipher specification (e.g. "aes-xts-plain64") or NULL to keep the current
+ *          one (default for encryption), not used for decryption
+ * @key_size: new volume key size in bits or 0 for default
+ * @sector_size: new encryption sector size or 0 to keep the current one (default for encryption)
+ * @pbkdf: key derivation function specification for the new key slot or NULL for default
+ * @header: detached LUKS header file or NULL, required for encryption and decryption
+ * @resilience: resilience mode ("checksum", "journal" or "none") or NULL for "checksum"
+ * @hash: hash for the "checksum" resilience mode or NULL for "sha256"
+ * @max_hotzone_size: maximum size of the area re-encrypted in one step or 0 for default
+ * @device_size: size of the data area to re-encrypt or 0 for the whole device
+ * @max_rate: maximum re-encryption rate (in bytes per second) or 0 for unlimited
+ */
+typedef struct BDCryptoLUKSReencryptParams {
+    BDCryptoLUKSReencryptMode mode;
+    gchar *cipher;
+    guint64 key_size;
+    guint32 sector_size;
+    BDCryptoLUKSPBKDF *pbkdf;
+    gchar *header;
+    gchar *resilience;
+    gchar *hash;
+    guint64 max_hotzone_size;
+    guint64 device_size;
+    guint64 max_rate;
+} BDCryptoLUKSReencryptParams;
+
+void bd_crypto_luks_reencrypt_params_free (BDCryptoLUKSReencryptParams *params);
+BDCryptoLUKSReencryptParams* bd_crypto_luks_reencrypt_params_copy (BDCryptoLUKSReencryptParams *params);
+BDCryptoLUKSReencryptParams* bd_crypto_luks_reencrypt_params_new (BDCryptoLUKSReencryptMode mode, const gchar *cipher, guint64 key_size, guint32 sector_size, BDCryptoLUKSPBKDF *pbkdf, const gchar *header, const gchar *resilience, const gchar *hash, guint64 max_hotzone_size, guint64 device_size, guint64 max_rate);
+
 typedef struct _BDCryptoKeyslotContext BDCryptoKeyslotContext;
 
 void bd_crypto_keyslot_context_free (BDCryptoKeyslotContext *context);
@@ -270,6 +400,8 @@ BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_passphrase (const guint8 *
 BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_keyfile (const gchar *keyfile, guint64 keyfile_offset, gsize key_size, GError **error);
 BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_keyring (const gchar *key_desc, GError **error);
 BDCryptoKeyslotContext* bd_crypto_keyslot_context_new_volume_key (const guint8 *volume_key, gsize volume_key_size, GError **error);
+gboolean bd_crypto_keyslot_context_set_keyslot_hint (BDCryptoKeyslotContext *context, gint keyslot, GError **error);
+gboolean bd_crypto_keyslot_context_set_token_hint (BDCryptoKeyslotContext *context, gint token, GError **error);
 
 /*
  * If using the plugin as a standalone library, the following functions should
@@ -288,8 +420,16 @@ gchar* bd_crypto_generate_backup_passphrase(GError **error);
 gboolean bd_crypto_device_is_luks (const gchar *device, GError **error);
 const gchar* bd_crypto_luks_status (const gchar *luks_device, GError **error);
 
+gboolean bd_crypto_set_keyslot_cache (gboolean enabled, GError **error);
+gboolean bd_crypto_invalidate_keyslot_cache (const gchar *device, GError **error);
+gboolean bd_crypto_set_pbkdf_cache (gboolean enabled, GError **error);
+BDCryptoLUKSPBKDF* bd_crypto_luks_pbkdf_calibrate (BDCryptoLUKSPBKDF *pbkdf, guint64 key_size, GError **error);
+
 gboolean bd_crypto_luks_format (const gchar *device, const gchar *cipher, guint64 key_size, BDCryptoKeyslotContext *context, guint64 min_entropy, BDCryptoLUKSVersion luks_version, BDCryptoLUKSExtra *extra,GError **error);
 gboolean bd_crypto_luks_open (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, gboolean read_only, GError **error);
+gboolean bd_crypto_luks_open_with_flags (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSPersistentFlags flags, gboolean read_only, GError **error);
+gboolean bd_crypto_luks_open_stash_key (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, gboolean read_only, GError **error);
+BDCryptoLUKSOpenResult** bd_crypto_luks_open_many (const gchar **devices, const gchar **names, BDCryptoKeyslotContext **contexts, gboolean read_only, guint max_jobs, GError **error);
 gboolean bd_crypto_luks_close (const gchar *luks_device, GError **error);
 gboolean bd_crypto_luks_add_key (const gchar *device, BDCryptoKeyslotContext *context, BDCryptoKeyslotContext *ncontext, GError **error);
 gboolean bd_crypto_luks_remove_key (const gchar *device, BDCryptoKeyslotContext *context, GError **error);
@@ -304,13 +444,21 @@ gboolean bd_crypto_luks_set_label (const gchar *device, const gchar *label, cons
 gboolean bd_crypto_luks_set_uuid (const gchar *device, const gchar *uuid, GError **error);
 gboolean bd_crypto_luks_convert (const gchar *device, BDCryptoLUKSVersion target_version, GError **error);
 gboolean bd_crypto_luks_set_persistent_flags (const gchar *device, BDCryptoLUKSPersistentFlags flags, GError **error);
+BDCryptoTuneResult** bd_crypto_tune_flags (const gchar *cipher, guint64 key_size, guint64 size, GError **error);
+gboolean bd_crypto_luks_reencrypt (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSReencryptParams *params, GError **error);
+gboolean bd_crypto_luks_reencrypt_resume (const gchar *device, const gchar *name, BDCryptoKeyslotContext *context, BDCryptoLUKSReencryptParams *params, GError **error);
+gboolean bd_crypto_luks_reencrypt_cancel (const gchar *device, GError **error);
+BDCryptoLUKSReencryptStatus bd_crypto_luks_reencrypt_status (const gchar *device, GError **error);
 
 BDCryptoLUKSInfo* bd_crypto_luks_info (const gchar *device, GError **error);
 BDCryptoBITLKInfo* bd_crypto_bitlk_info (const gchar *device, GError **error);
 BDCryptoIntegrityInfo* bd_crypto_integrity_info (const gchar *device, GError **error);
 BDCryptoLUKSTokenInfo** bd_crypto_luks_token_info (const gchar *device, GError **error);
+BDCryptoLUKSHeaderInfo* bd_crypto_luks_header_info (const gchar *device, GError **error);
+BDCryptoLUKSHeaderInfo** bd_crypto_luks_header_info_many (const gchar **devices, guint max_jobs, GError **error);
 
 gboolean bd_crypto_integrity_format (const gchar *device, const gchar *algorithm, gboolean wipe, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error);
+gboolean bd_crypto_integrity_format_parallel (const gchar *device, const gchar *algorithm, guint max_jobs, BDCryptoKeyslotContext *context, BDCryptoIntegrityExtra *extra, GError **error);
 gboolean bd_crypto_integrity_open (const gchar *device, const gchar *name, const gchar *algorithm, BDCryptoKeyslotContext *context, BDCryptoIntegrityOpenFlags flags, BDCryptoIntegrityExtra *extra, GError **error);
 gboolean bd_crypto_integrity_close (const gchar *integrity_device, GError **error);
 
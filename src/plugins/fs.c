@@ -42,6 +42,8 @@ extern gboolean bd_fs_exfat_is_tech_avail (BDFSTech tech, guint64 mode, GError *
 extern gboolean bd_fs_btrfs_is_tech_avail (BDFSTech tech, guint64 mode, GError **error);
 extern gboolean bd_fs_udf_is_tech_avail (BDFSTech tech, guint64 mode, GError **error);
 
+extern void bd_fs_generic_close (void);
+
 /**
  * bd_fs_error_quark: (skip)
  */
@@ -72,7 +74,8 @@ gboolean bd_fs_init (void) {
  *
  */
 void bd_fs_close (void) {
-    /* nothing to do here */
+    /* release temporary mounts kept around by the generic functions */
+    bd_fs_generic_close ();
 }
 
 /**
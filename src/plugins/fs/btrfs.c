@@ -20,6 +20,11 @@
 #include <blockdev/utils.h>
 #include <check_deps.h>
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/btrfs.h>
 
 #include "btrfs.h"
 #include "fs.h"
@@ -157,6 +162,9 @@ gboolean bd_fs_btrfs_mkfs (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_MKFSBTRFS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -177,6 +185,9 @@ gboolean bd_fs_btrfs_check (const gchar *device, const BDExtraArg **extra, GErro
     if (!check_deps (&avail_deps, DEPS_BTRFSCK_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (argv, extra, error);
 }
 
@@ -197,6 +208,9 @@ gboolean bd_fs_btrfs_repair (const gchar *device, const BDExtraArg **extra, GErr
     if (!check_deps (&avail_deps, DEPS_BTRFSCK_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (argv, extra, error);
 }
 
@@ -407,6 +421,49 @@ BDFSBtrfsInfo* bd_fs_btrfs_get_info (const gchar *mpoint, GError **error) {
     return ret;
 }
 
+/**
+ * btrfs_resize_native: (skip)
+ * @mpoint: mountpoint of the btrfs filesystem to resize
+ * @new_size: new requested size for the filesystem in bytes (0 for the size of
+ *            the underlying block device)
+ *
+ * Resizes the mounted single-device btrfs filesystem using the BTRFS_IOC_RESIZE
+ * ioctl (the same one 'btrfs filesystem resize' uses).
+ *
+ * Returns: whether the filesystem was successfully resized to @new_size, %FALSE
+ *          also for multi-device filesystems
+ */
+static gboolean btrfs_resize_native (const gchar *mpoint, guint64 new_size) {
+    struct btrfs_ioctl_fs_info_args fs_info;
+    struct btrfs_ioctl_vol_args args;
+    gboolean ret = FALSE;
+    gint fd = -1;
+
+    fd = open (mpoint, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (fd == -1)
+        return FALSE;
+
+    /* multi-device volumes are not supported, same as with the btrfs tool */
+    memset (&fs_info, 0, sizeof (fs_info));
+    if (ioctl (fd, BTRFS_IOC_FS_INFO, &fs_info) != 0 || fs_info.num_devices != 1) {
+        close (fd);
+        return FALSE;
+    }
+
+    /* with just one device, max_id is the ID of that device */
+    memset (&args, 0, sizeof (args));
+    if (new_size == 0)
+        g_snprintf (args.name, sizeof (args.name), "%"G_GUINT64_FORMAT":max", (guint64) fs_info.max_id);
+    else
+        g_snprintf (args.name, sizeof (args.name), "%"G_GUINT64_FORMAT":%"G_GUINT64_FORMAT,
+                    (guint64) fs_info.max_id, new_size);
+
+    ret = ioctl (fd, BTRFS_IOC_RESIZE, &args) == 0;
+
+    close (fd);
+    return ret;
+}
+
 /**
  * bd_fs_btrfs_resize:
  * @mpoint: a mountpoint of the to be resized btrfs filesystem
@@ -418,6 +475,9 @@ BDFSBtrfsInfo* bd_fs_btrfs_get_info (const gchar *mpoint, GError **error) {
  * Returns: whether the @mpoint filesystem was successfully resized to @new_size
  * or not
  *
+ * If @extra is %NULL, the file system is resized with the BTRFS_IOC_RESIZE
+ * ioctl directly, the 'btrfs' utility is only used as a fallback.
+ *
  * Note: This function WON'T WORK for multi device btrfs filesystems,
  *       for more complicated setups use the btrfs plugin instead.
  *
@@ -428,6 +488,10 @@ gboolean bd_fs_btrfs_resize (const gchar *mpoint, guint64 new_size, const BDExtr
     gboolean ret = FALSE;
     BDFSBtrfsInfo *info = NULL;
 
+    /* 'btrfs filesystem resize' is used as a fallback so that it can report errors */
+    if (!extra && btrfs_resize_native (mpoint, new_size))
+        return TRUE;
+
     if (!check_deps (&avail_deps, DEPS_BTRFS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
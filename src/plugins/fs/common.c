@@ -21,6 +21,7 @@
 #include <blkid.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
@@ -153,3 +154,23 @@ check_uuid (const gchar *uuid, GError **error) {
 
     return TRUE;
 }
+
+/**
+ * get_devno_size: (skip)
+ * @devno: device number of the block device
+ *
+ * Returns: size of the block device in bytes (as reported in sysfs) or 0
+ *          in case of error
+ */
+G_GNUC_INTERNAL guint64
+get_devno_size (dev_t devno) {
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+
+    path = g_strdup_printf ("/sys/dev/block/%u:%u/size", major (devno), minor (devno));
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return 0;
+
+    /* size is always in 512B sectors */
+    return g_ascii_strtoull (contents, NULL, 10) * 512;
+}
@@ -1,5 +1,6 @@
 #include <glib.h>
 #include <blkid.h>
+#include <sys/types.h>
 
 #ifndef BD_FS_COMMON
 #define BD_FS_COMMON
@@ -10,5 +11,9 @@
 gint synced_close (gint fd);
 gboolean get_uuid_label (const gchar *device, gchar **uuid, gchar **label, GError **error);
 gboolean check_uuid (const gchar *uuid, GError **error);
+guint64 get_devno_size (dev_t devno);
+
+/* implemented in generic.c */
+gboolean mount_pool_drop (const gchar *device, GError **error);
 
 #endif  /* BD_FS_COMMON */
@@ -160,6 +160,9 @@ gboolean bd_fs_exfat_mkfs (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_MKEXFAT_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -182,6 +185,9 @@ gboolean bd_fs_exfat_check (const gchar *device, const BDExtraArg **extra, GErro
     if (!check_deps (&avail_deps, DEPS_FSCKEXFAT_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     ret = bd_utils_exec_and_report_status_error (args, extra, &status, error);
     if (!ret && (status == 1)) {
         /* no error should be reported for exit code 1 */
@@ -210,6 +216,9 @@ gboolean bd_fs_exfat_repair (const gchar *device, const BDExtraArg **extra, GErr
     if (!check_deps (&avail_deps, DEPS_FSCKEXFAT_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     ret = bd_utils_exec_and_report_status_error (args, extra, &status, error);
     if (!ret && (status == 1)) {
         /* no error should be reported for exit code 1 */
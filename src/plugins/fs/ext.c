@@ -19,6 +19,13 @@
 
 #include <ext2fs.h>
 #include <e2p.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/types.h>
+#include <linux/magic.h>
 
 #include <blockdev/utils.h>
 #include <check_deps.h>
@@ -27,6 +34,11 @@
 #include "fs.h"
 #include "ext.h"
 
+#ifndef EXT4_IOC_RESIZE_FS
+/* not part of the kernel UAPI headers */
+#define EXT4_IOC_RESIZE_FS _IOW ('f', 16, __u64)
+#endif
+
 #define EXT2 "ext2"
 #define EXT3 "ext3"
 #define EXT4 "ext4"
@@ -288,6 +300,9 @@ static gboolean ext_mkfs (const gchar *device, const BDExtraArg **extra, const g
     if (!check_deps (&avail_deps, DEPS_MKE2FS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -348,6 +363,9 @@ static gboolean ext_check (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_E2FSCK_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     if (bd_utils_prog_reporting_initialized ()) {
         ret = bd_utils_exec_and_report_progress (args_progress, extra, extract_e2fsck_progress, &status, error);
     } else {
@@ -418,6 +436,9 @@ static gboolean ext_repair (const gchar *device, gboolean unsafe, const BDExtraA
     if (!check_deps (&avail_deps, DEPS_E2FSCK_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     if (bd_utils_prog_reporting_initialized ()) {
         ret = bd_utils_exec_and_report_progress (args_progress, extra, extract_e2fsck_progress, &status, error);
     } else {
@@ -795,10 +816,69 @@ BDFSExt4Info* bd_fs_ext4_get_info (const gchar *device, GError **error) {
     return (BDFSExt4Info*) ext_get_info (device, error);
 }
 
+/**
+ * ext_grow_native: (skip)
+ * @device: the device the file system of which to grow
+ * @new_size: new requested size for the file system in bytes (0 for the size of
+ *            the underlying block device)
+ *
+ * Grows the ext filesystem on @device using the EXT4_IOC_RESIZE_FS ioctl if
+ * it is mounted.
+ *
+ * Returns: whether the filesystem was successfully grown to @new_size, %FALSE
+ *          also if @device is not mounted or @new_size is smaller than the
+ *          current size
+ */
+static gboolean ext_grow_native (const gchar *device, guint64 new_size) {
+    g_autofree gchar *mountpoint = NULL;
+    struct statfs stfs;
+    struct stat st;
+    __u64 new_blocks = 0;
+    gboolean ret = FALSE;
+    gint fd = -1;
+
+    mountpoint = bd_fs_get_mountpoint (device, NULL);
+    if (!mountpoint)
+        return FALSE;
+
+    if (new_size == 0) {
+        if (stat (device, &st) != 0 || !S_ISBLK (st.st_mode))
+            return FALSE;
+        new_size = get_devno_size (st.st_rdev);
+    }
+
+    fd = open (mountpoint, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (fd == -1)
+        return FALSE;
+
+    if (fstatfs (fd, &stfs) != 0 || stfs.f_type != EXT4_SUPER_MAGIC || stfs.f_bsize == 0) {
+        close (fd);
+        return FALSE;
+    }
+
+    /* f_blocks doesn't include the metadata overhead so it is always smaller
+       than the real size, the kernel refuses to shrink in the remaining cases */
+    new_blocks = new_size / stfs.f_bsize;
+    if (new_blocks < (__u64) stfs.f_blocks) {
+        close (fd);
+        return FALSE;
+    }
+
+    ret = ioctl (fd, EXT4_IOC_RESIZE_FS, &new_blocks) == 0;
+
+    close (fd);
+    return ret;
+}
+
 static gboolean ext_resize (const gchar *device, guint64 new_size, const BDExtraArg **extra, GError **error) {
     const gchar *args[4] = {"resize2fs", device, NULL, NULL};
     gboolean ret = FALSE;
 
+    /* mounted filesystem can be grown directly, resize2fs is used as a fallback
+       for everything else (offline resize, shrink, errors) */
+    if (!extra && ext_grow_native (device, new_size))
+        return TRUE;
+
     if (!check_deps (&avail_deps, DEPS_RESIZE2FS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
@@ -856,6 +936,9 @@ gboolean bd_fs_ext3_resize (const gchar *device, guint64 new_size, const BDExtra
  *
  * Returns: whether the file system on @device was successfully resized or not
  *
+ * Note: If @extra is %NULL and the file system is mounted, it is grown with the
+ *       EXT4_IOC_RESIZE_FS ioctl directly, 'resize2fs' is only used as a fallback.
+ *
  * Tech category: %BD_FS_TECH_EXT4-%BD_FS_TECH_MODE_RESIZE
  */
 gboolean bd_fs_ext4_resize (const gchar *device, guint64 new_size, const BDExtraArg **extra, GError **error) {
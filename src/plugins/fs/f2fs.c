@@ -213,6 +213,9 @@ gboolean bd_fs_f2fs_mkfs (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_MKFSF2FS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -235,6 +238,9 @@ gboolean bd_fs_f2fs_check (const gchar *device, const BDExtraArg **extra, GError
     if (!bd_fs_f2fs_is_tech_avail (BD_FS_TECH_F2FS, BD_FS_TECH_MODE_CHECK, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     ret = bd_utils_exec_and_report_status_error (args, extra, &status, error);
     if (!ret && (status == 255)) {
         /* no error should be reported for exit code 255 -- there are errors on the filesystem */
@@ -261,6 +267,9 @@ gboolean bd_fs_f2fs_repair (const gchar *device, const BDExtraArg **extra, GErro
     if (!check_deps (&avail_deps, DEPS_FSCKF2FS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -17,14 +17,21 @@
  * Author: Vratislav Podzimek <vpodzime@redhat.com>
  */
 
+#define _GNU_SOURCE
+#include <unistd.h>
+
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <blkid.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <sys/ioctl.h>
+#include <sys/vfs.h>
 #include <linux/fs.h>
+#include <linux/magic.h>
 #include <fcntl.h>
 #include <errno.h>
 
@@ -392,6 +399,9 @@ gboolean bd_fs_wipe (const gchar *device, gboolean all, gboolean force, GError *
     gint mode = 0;
     GError *l_error = NULL;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     msg = g_strdup_printf ("Started wiping signatures from the device '%s'", device);
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
@@ -539,6 +549,350 @@ gboolean bd_fs_clean (const gchar *device, gboolean force, GError **error) {
       return TRUE;
 }
 
+/* upper bound for a single discard/zeroout request, smaller requests mean
+   more frequent progress updates and faster reaction to errors */
+#define ZERO_MAX_CHUNK (256 MiB)
+/* buffer size used for the O_DIRECT write loop */
+#define ZERO_WRITE_BUF (4 MiB)
+/* maximum number of worker threads used for zeroing a device */
+#define ZERO_MAX_THREADS 16
+
+/**
+ * get_queue_limit: (skip)
+ * @dev_st: stat of the block device
+ * @limit: name of the queue limit (file in the 'queue' sysfs directory)
+ *
+ * Returns: value of the @limit for the device (or its parent for partitions),
+ *          0 if not available
+ */
+static guint64 get_queue_limit (const struct stat *dev_st, const gchar *limit) {
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+    gboolean success = FALSE;
+
+    path = g_strdup_printf ("/sys/dev/block/%u:%u/queue/%s", major (dev_st->st_rdev), minor (dev_st->st_rdev), limit);
+    success = g_file_get_contents (path, &contents, NULL, NULL);
+    if (!success) {
+        /* partitions don't have the 'queue' directory, use the parent disk */
+        g_free (path);
+        path = g_strdup_printf ("/sys/dev/block/%u:%u/../queue/%s", major (dev_st->st_rdev), minor (dev_st->st_rdev), limit);
+        success = g_file_get_contents (path, &contents, NULL, NULL);
+    }
+    if (!success)
+        return 0;
+
+    return g_ascii_strtoull (contents, NULL, 10);
+}
+
+typedef struct ZeroJob {
+    gint fd;
+    gint direct_fd;
+    BDFSZeroMethod method;
+    guint64 size;
+    guint64 chunk_size;
+
+    GMutex lock;
+    GCond cond;
+    guint64 next_offset;
+    guint64 done;
+    guint running;
+    gint error_code;
+    guint64 error_offset;
+} ZeroJob;
+
+static gint zero_chunk (ZeroJob *job, guint64 offset, guint64 length, guint8 *buf) {
+    guint64 range[2] = { offset, length };
+    guint64 written = 0;
+    ssize_t ret = 0;
+
+    switch (job->method) {
+        case BD_FS_ZERO_SECURE_DISCARD:
+            return ioctl (job->fd, BLKSECDISCARD, &range) == 0 ? 0 : errno;
+        case BD_FS_ZERO_DISCARD:
+            return ioctl (job->fd, BLKDISCARD, &range) == 0 ? 0 : errno;
+        case BD_FS_ZERO_ZEROOUT:
+            return ioctl (job->fd, BLKZEROOUT, &range) == 0 ? 0 : errno;
+        case BD_FS_ZERO_WRITE:
+            while (written < length) {
+                ret = pwrite (job->direct_fd, buf, MIN (ZERO_WRITE_BUF, length - written), offset + written);
+                if (ret < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return errno;
+                } else if (ret == 0)
+                    return EIO;
+                written += ret;
+            }
+            return 0;
+        default:
+            break;
+    }
+
+    return EINVAL;
+}
+
+static gpointer zero_worker (gpointer data) {
+    ZeroJob *job = (ZeroJob *) data;
+    guint8 *buf = NULL;
+    guint64 offset = 0;
+    guint64 length = 0;
+    gint status = 0;
+
+    if (job->method == BD_FS_ZERO_WRITE) {
+        /* O_DIRECT needs an aligned buffer */
+        if (posix_memalign ((void **) &buf, 4096, ZERO_WRITE_BUF) != 0)
+            status = ENOMEM;
+        else
+            memset (buf, 0, ZERO_WRITE_BUF);
+    }
+
+    while (status == 0) {
+        g_mutex_lock (&job->lock);
+        if (job->error_code != 0 || job->next_offset >= job->size) {
+            g_mutex_unlock (&job->lock);
+            break;
+        }
+        offset = job->next_offset;
+        length = MIN (job->chunk_size, job->size - offset);
+        job->next_offset += length;
+        g_mutex_unlock (&job->lock);
+
+        status = zero_chunk (job, offset, length, buf);
+
+        g_mutex_lock (&job->lock);
+        if (status == 0)
+            job->done += length;
+        g_cond_signal (&job->cond);
+        g_mutex_unlock (&job->lock);
+    }
+
+    g_mutex_lock (&job->lock);
+    if (status != 0 && job->error_code == 0) {
+        job->error_code = status;
+        job->error_offset = offset;
+    }
+    job->running--;
+    g_cond_signal (&job->cond);
+    g_mutex_unlock (&job->lock);
+
+    free (buf);
+    return NULL;
+}
+
+static const gchar* zero_method_str (BDFSZeroMethod method) {
+    switch (method) {
+        case BD_FS_ZERO_SECURE_DISCARD:
+            return "secure discard";
+        case BD_FS_ZERO_DISCARD:
+            return "discard";
+        case BD_FS_ZERO_ZEROOUT:
+            return "zeroout";
+        case BD_FS_ZERO_WRITE:
+            return "write";
+        default:
+            return "auto";
+    }
+}
+
+/**
+ * bd_fs_zero_device:
+ * @device: the device to clear
+ * @method: method to use for clearing @device, see #BDFSZeroMethod
+ * @threads: number of parallel requests to issue (0 to choose automatically)
+ * @force: whether to clear a @device that is in use (e.g. mounted)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Clears the whole @device. With %BD_FS_ZERO_AUTO the method is selected based
+ * on the device queue limits: %BD_FS_ZERO_ZEROOUT if the device supports the
+ * WRITE ZEROES command, %BD_FS_ZERO_WRITE otherwise. Discard based methods are
+ * never selected automatically because discarded blocks are not guaranteed to
+ * read back as zeroes on all devices.
+ *
+ * The device is processed in chunks by @threads worker threads and the progress
+ * is reported using bd_utils_report_progress().
+ *
+ * Returns: whether @device was successfully cleared or not
+ *
+ * Tech category: %BD_FS_TECH_GENERIC-%BD_FS_TECH_MODE_WIPE
+ */
+gboolean bd_fs_zero_device (const gchar *device, BDFSZeroMethod method, guint threads, gboolean force, GError **error) {
+    ZeroJob job = { 0 };
+    struct stat dev_st;
+    GThread **workers = NULL;
+    guint64 progress_id = 0;
+    guint64 granularity = 0;
+    guint64 max_bytes = 0;
+    guint64 chunk_size = 0;
+    guint8 last_completion = 0;
+    guint8 completion = 0;
+    gint mode = 0;
+    guint i = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
+    mode = O_RDWR | O_CLOEXEC;
+    if (!force)
+        mode |= O_EXCL;
+
+    job.fd = open (device, mode);
+    if (job.fd == -1) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                     "Failed to open the device '%s': %s",
+                     device, strerror_l (errno, _C_LOCALE));
+        return FALSE;
+    }
+    job.direct_fd = -1;
+
+    if (fstat (job.fd, &dev_st) != 0 || !S_ISBLK (dev_st.st_mode)) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_INVAL,
+                     "'%s' is not a block device", device);
+        close (job.fd);
+        return FALSE;
+    }
+
+    if (ioctl (job.fd, BLKGETSIZE64, &(job.size)) != 0) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                     "Failed to get size of the device '%s': %s",
+                     device, strerror_l (errno, _C_LOCALE));
+        close (job.fd);
+        return FALSE;
+    }
+
+    if (method == BD_FS_ZERO_AUTO) {
+        if (get_queue_limit (&dev_st, "write_zeroes_max_bytes") > 0)
+            method = BD_FS_ZERO_ZEROOUT;
+        else
+            method = BD_FS_ZERO_WRITE;
+    }
+    job.method = method;
+
+    switch (method) {
+        case BD_FS_ZERO_SECURE_DISCARD:
+        case BD_FS_ZERO_DISCARD:
+            max_bytes = get_queue_limit (&dev_st, "discard_max_bytes");
+            granularity = get_queue_limit (&dev_st, "discard_granularity");
+            if (max_bytes == 0) {
+                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
+                             "The device '%s' doesn't support discard", device);
+                close (job.fd);
+                return FALSE;
+            }
+            break;
+        case BD_FS_ZERO_ZEROOUT:
+            /* the kernel falls back to writing zeroes if WRITE ZEROES is not supported */
+            max_bytes = get_queue_limit (&dev_st, "write_zeroes_max_bytes");
+            break;
+        case BD_FS_ZERO_WRITE:
+            job.direct_fd = open (device, O_WRONLY | O_DIRECT | O_CLOEXEC);
+            if (job.direct_fd == -1) {
+                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                             "Failed to open the device '%s': %s",
+                             device, strerror_l (errno, _C_LOCALE));
+                close (job.fd);
+                return FALSE;
+            }
+            break;
+        default:
+            g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_INVAL,
+                         "Invalid zeroing method specified");
+            close (job.fd);
+            return FALSE;
+    }
+
+    /* bigger requests are split by the kernel anyway, but keep the chunks
+       aligned to what the device can handle in one request */
+    chunk_size = ZERO_MAX_CHUNK;
+    if (max_bytes > 0 && max_bytes < chunk_size)
+        chunk_size = max_bytes;
+    if (granularity == 0)
+        granularity = get_queue_limit (&dev_st, "logical_block_size");
+    if (granularity == 0)
+        granularity = 512;
+    if (chunk_size > granularity)
+        chunk_size -= chunk_size % granularity;
+    else
+        chunk_size = granularity;
+    job.chunk_size = chunk_size;
+
+    if (threads == 0)
+        threads = MIN (g_get_num_processors (), ZERO_MAX_THREADS);
+    threads = CLAMP (threads, 1, (guint) MAX (1, (job.size + chunk_size - 1) / chunk_size));
+
+    msg = g_strdup_printf ("Started clearing the device '%s' (%s)", device, zero_method_str (method));
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    g_mutex_init (&job.lock);
+    g_cond_init (&job.cond);
+
+    workers = g_new0 (GThread *, threads);
+    g_mutex_lock (&job.lock);
+    for (i = 0; i < threads; i++) {
+        workers[i] = g_thread_try_new ("bd-zero", zero_worker, &job, NULL);
+        if (!workers[i])
+            break;
+        job.running++;
+    }
+    if (job.running == 0) {
+        g_mutex_unlock (&job.lock);
+        g_set_error (&l_error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                     "Failed to start worker threads for clearing the device '%s'", device);
+        goto out;
+    }
+
+    /* progress is reported from this thread, the worker threads
+       just signal completion of every chunk */
+    while (job.running > 0) {
+        g_cond_wait (&job.cond, &job.lock);
+        completion = job.size > 0 ? (100 * job.done) / job.size : 100;
+        if (completion != last_completion) {
+            last_completion = completion;
+            g_mutex_unlock (&job.lock);
+            bd_utils_report_progress (progress_id, completion, NULL);
+            g_mutex_lock (&job.lock);
+        }
+    }
+    g_mutex_unlock (&job.lock);
+
+    if (job.error_code != 0) {
+        if (job.error_code == EOPNOTSUPP && (method == BD_FS_ZERO_SECURE_DISCARD || method == BD_FS_ZERO_DISCARD))
+            g_set_error (&l_error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
+                         "The device '%s' doesn't support %s", device, zero_method_str (method));
+        else
+            g_set_error (&l_error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                         "Failed to clear the device '%s' at offset %"G_GUINT64_FORMAT" using %s: %s",
+                         device, job.error_offset, zero_method_str (method),
+                         strerror_l (job.error_code, _C_LOCALE));
+    }
+
+out:
+    for (i = 0; i < threads && workers[i]; i++)
+        g_thread_join (workers[i]);
+    g_free (workers);
+    g_mutex_clear (&job.lock);
+    g_cond_clear (&job.cond);
+
+    if (job.direct_fd != -1 && l_error == NULL && fdatasync (job.direct_fd) != 0)
+        g_set_error (&l_error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                     "Failed to sync the device '%s': %s",
+                     device, strerror_l (errno, _C_LOCALE));
+    if (job.direct_fd != -1)
+        close (job.direct_fd);
+    close (job.fd);
+
+    if (l_error) {
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
 /**
  * bd_fs_get_fstype:
  * @device: the device to probe
@@ -653,7 +1007,345 @@ gchar* bd_fs_get_fstype (const gchar *device,  GError **error) {
 }
 
 /**
- * fs_mount:
+ * PooledMount: (skip)
+ * @mountpoint: temporary mountpoint the device is mounted at
+ * @read_only: whether the device is mounted read-only
+ * @refcount: number of operations currently using the mount
+ * @expires: monotonic time when the mount should be released (only valid if
+ *           @refcount is 0)
+ * @busy: whether the device is being mounted or unmounted right now (this is
+ *        done without @mount_pool_lock held, wait for @mount_pool_busy_cond)
+ */
+typedef struct PooledMount {
+    gchar *mountpoint;
+    gboolean read_only;
+    guint refcount;
+    gint64 expires;
+    gboolean busy;
+} PooledMount;
+
+/* temporary mounts created for FS operations, device -> PooledMount */
+static GHashTable *mount_pool = NULL;
+/* idle timeout (in seconds) for the temporary mounts, 0 means pool disabled */
+static guint mount_pool_timeout = 0;
+static GThread *mount_pool_reaper = NULL;
+static GMutex mount_pool_lock;
+static GCond mount_pool_cond;
+/* signalled when a pooled mount stops being busy */
+static GCond mount_pool_busy_cond;
+/* serializes starting and stopping of the reaper thread */
+static GMutex mount_pool_reaper_lock;
+
+static void pooled_mount_free (PooledMount *pm) {
+    g_free (pm->mountpoint);
+    g_free (pm);
+}
+
+static gchar* mount_pool_key (const gchar *device) {
+    gchar *key = NULL;
+
+    key = bd_utils_resolve_device (device, NULL);
+    if (!key)
+        key = g_strdup (device);
+
+    return key;
+}
+
+static gboolean pooled_mount_release (PooledMount *pm, gboolean lazy, GError **error) {
+    if (!bd_fs_unmount (pm->mountpoint, lazy, FALSE, NULL, error))
+        return FALSE;
+    g_rmdir (pm->mountpoint);
+    return TRUE;
+}
+
+/**
+ * mount_pool_lookup: (skip)
+ * @key: key of the pooled mount to look up
+ *
+ * Waits for the mount or unmount of @key running in a different thread (if any)
+ * to finish. Must be called with @mount_pool_lock held.
+ *
+ * Returns: (transfer none): the pooled mount of @key or %NULL if there is none
+ */
+static PooledMount* mount_pool_lookup (const gchar *key) {
+    PooledMount *pm = NULL;
+
+    pm = g_hash_table_lookup (mount_pool, key);
+    while (pm && pm->busy) {
+        g_cond_wait (&mount_pool_busy_cond, &mount_pool_lock);
+        pm = g_hash_table_lookup (mount_pool, key);
+    }
+
+    return pm;
+}
+
+/**
+ * mount_pool_release: (skip)
+ * @key: key of @pm in the pool
+ * @pm: idle pooled mount to release
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Unmounts @pm and removes it from the pool. Must be called with @mount_pool_lock
+ * held, the lock is temporarily released for the unmount.
+ *
+ * Returns: whether @pm was successfully unmounted or not
+ */
+static gboolean mount_pool_release (const gchar *key, PooledMount *pm, GError **error) {
+    gboolean ret = FALSE;
+
+    pm->busy = TRUE;
+    g_mutex_unlock (&mount_pool_lock);
+    ret = pooled_mount_release (pm, FALSE, error);
+    g_mutex_lock (&mount_pool_lock);
+
+    pm->busy = FALSE;
+    if (ret)
+        g_hash_table_remove (mount_pool, key);
+    g_cond_broadcast (&mount_pool_busy_cond);
+
+    return ret;
+}
+
+/**
+ * mount_pool_release_idle: (skip)
+ * @expired_only: whether to only release mounts idle for longer than the timeout
+ * @lazy: whether to use lazy unmount for the busy mounts
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Unmounts the temporary mounts not used by any operation. Must be called with
+ * @mount_pool_lock held, the lock is temporarily released for the unmounts.
+ *
+ * Returns: whether all the idle mounts were successfully unmounted or not
+ */
+static gboolean mount_pool_release_idle (gboolean expired_only, gboolean lazy, GError **error) {
+    GHashTableIter iter;
+    gpointer key = NULL;
+    gpointer value = NULL;
+    PooledMount *pm = NULL;
+    GPtrArray *keys = NULL;
+    GPtrArray *mounts = NULL;
+    gboolean *released = NULL;
+    GError *l_error = NULL;
+    gint64 now = 0;
+    gboolean ret = TRUE;
+    guint i = 0;
+
+    if (!mount_pool)
+        return TRUE;
+
+    now = g_get_monotonic_time ();
+    keys = g_ptr_array_new_with_free_func (g_free);
+    mounts = g_ptr_array_new ();
+    g_hash_table_iter_init (&iter, mount_pool);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        pm = (PooledMount *) value;
+        if (pm->refcount > 0 || pm->busy || (expired_only && pm->expires > now))
+            continue;
+        pm->busy = TRUE;
+        g_ptr_array_add (keys, g_strdup (key));
+        g_ptr_array_add (mounts, pm);
+    }
+
+    if (mounts->len > 0) {
+        released = g_new0 (gboolean, mounts->len);
+
+        g_mutex_unlock (&mount_pool_lock);
+        for (i = 0; i < mounts->len; i++) {
+            pm = (PooledMount *) mounts->pdata[i];
+            released[i] = pooled_mount_release (pm, lazy, &l_error);
+            if (released[i])
+                continue;
+            if (ret) {
+                g_propagate_prefixed_error (error, l_error, "Failed to unmount '%s': ", pm->mountpoint);
+                l_error = NULL;
+                ret = FALSE;
+            } else
+                g_clear_error (&l_error);
+        }
+        g_mutex_lock (&mount_pool_lock);
+
+        for (i = 0; i < mounts->len; i++) {
+            pm = (PooledMount *) mounts->pdata[i];
+            pm->busy = FALSE;
+            if (released[i])
+                g_hash_table_remove (mount_pool, keys->pdata[i]);
+            else
+                /* still busy (e.g. opened by someone else), try again later */
+                pm->expires = now + mount_pool_timeout * G_TIME_SPAN_SECOND;
+        }
+        g_cond_broadcast (&mount_pool_busy_cond);
+        g_free (released);
+    }
+
+    g_ptr_array_free (mounts, TRUE);
+    g_ptr_array_free (keys, TRUE);
+
+    return ret;
+}
+
+static gpointer mount_pool_reaper_thread (gpointer data G_GNUC_UNUSED) {
+    GHashTableIter iter;
+    gpointer value = NULL;
+    PooledMount *pm = NULL;
+    gint64 next = 0;
+
+    g_mutex_lock (&mount_pool_lock);
+    while (mount_pool_timeout > 0) {
+        mount_pool_release_idle (TRUE, FALSE, NULL);
+
+        next = g_get_monotonic_time () + mount_pool_timeout * G_TIME_SPAN_SECOND;
+        g_hash_table_iter_init (&iter, mount_pool);
+        while (g_hash_table_iter_next (&iter, NULL, &value)) {
+            pm = (PooledMount *) value;
+            if (pm->refcount == 0 && !pm->busy)
+                next = MIN (next, pm->expires);
+        }
+
+        g_cond_wait_until (&mount_pool_cond, &mount_pool_lock, next);
+    }
+    g_mutex_unlock (&mount_pool_lock);
+
+    return NULL;
+}
+
+/**
+ * mount_pool_drop: (skip)
+ * @device: device to drop the temporary mount for
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Unmounts the idle temporary mount of @device (if any). This needs to be
+ * called before operations that require the device to be unmounted.
+ *
+ * Returns: whether @device is not (temporarily) mounted anymore or not
+ */
+gboolean mount_pool_drop (const gchar *device, GError **error) {
+    g_autofree gchar *key = NULL;
+    PooledMount *pm = NULL;
+    GError *l_error = NULL;
+    gboolean ret = TRUE;
+
+    g_mutex_lock (&mount_pool_lock);
+    if (!mount_pool || g_hash_table_size (mount_pool) == 0) {
+        g_mutex_unlock (&mount_pool_lock);
+        return TRUE;
+    }
+
+    key = mount_pool_key (device);
+    pm = mount_pool_lookup (key);
+    if (pm && pm->refcount > 0) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                     "Device '%s' is mounted (temporarily, by another operation)", device);
+        ret = FALSE;
+    } else if (pm && !mount_pool_release (key, pm, &l_error)) {
+        g_propagate_prefixed_error (error, l_error,
+                                    "Device '%s' is mounted (temporarily) and failed to unmount it: ", device);
+        ret = FALSE;
+    }
+    g_mutex_unlock (&mount_pool_lock);
+
+    return ret;
+}
+
+/**
+ * bd_fs_set_mount_pool_timeout:
+ * @timeout: idle timeout (in seconds) for the temporary mounts, 0 to disable
+ *           the pool
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Operations that need the filesystem to be mounted (like resizing XFS or
+ * getting information about Btrfs) mount the device to a temporary directory
+ * and unmount it again when done. With the temporary mount pool enabled, the
+ * temporary mounts are kept around and reused by subsequent operations on the
+ * same device until they are idle for @timeout seconds, the pool is disabled or
+ * the plugin is closed. Operations that need the device unmounted (mkfs, check,
+ * repair, wipe,...) release its idle temporary mount automatically and fail if
+ * it is being used by another operation.
+ *
+ * Disabling the pool unmounts all the idle temporary mounts.
+ *
+ * Returns: whether the timeout was successfully set or not
+ *
+ * Tech category: %BD_FS_TECH_MOUNT (no mode, ignored)
+ */
+gboolean bd_fs_set_mount_pool_timeout (guint timeout, GError **error) {
+    GThread *reaper = NULL;
+    gboolean ret = TRUE;
+
+    g_mutex_lock (&mount_pool_reaper_lock);
+    g_mutex_lock (&mount_pool_lock);
+    mount_pool_timeout = timeout;
+    if (timeout > 0) {
+        if (!mount_pool)
+            mount_pool = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) pooled_mount_free);
+        if (!mount_pool_reaper) {
+            mount_pool_reaper = g_thread_try_new ("bd-fs-mount-pool", mount_pool_reaper_thread, NULL, error);
+            if (!mount_pool_reaper) {
+                mount_pool_timeout = 0;
+                g_prefix_error (error, "Failed to start the temporary mount pool thread: ");
+                ret = FALSE;
+            }
+        }
+        /* wake up the reaper to pick up the new timeout */
+        g_cond_signal (&mount_pool_cond);
+        g_mutex_unlock (&mount_pool_lock);
+        g_mutex_unlock (&mount_pool_reaper_lock);
+        return ret;
+    }
+
+    reaper = mount_pool_reaper;
+    mount_pool_reaper = NULL;
+    g_cond_signal (&mount_pool_cond);
+    g_mutex_unlock (&mount_pool_lock);
+
+    /* the reaper lock makes sure no new reaper is started before the old one is gone */
+    if (reaper)
+        g_thread_join (reaper);
+
+    g_mutex_lock (&mount_pool_lock);
+    ret = mount_pool_release_idle (FALSE, FALSE, error);
+    g_mutex_unlock (&mount_pool_lock);
+    g_mutex_unlock (&mount_pool_reaper_lock);
+
+    return ret;
+}
+
+/**
+ * bd_fs_flush_mount_pool:
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Unmounts all idle temporary mounts from the temporary mount pool (see
+ * bd_fs_set_mount_pool_timeout()) right away.
+ *
+ * Returns: whether all the idle temporary mounts were successfully unmounted or not
+ *
+ * Tech category: %BD_FS_TECH_MOUNT (no mode, ignored)
+ */
+gboolean bd_fs_flush_mount_pool (GError **error) {
+    gboolean ret = FALSE;
+
+    g_mutex_lock (&mount_pool_lock);
+    ret = mount_pool_release_idle (FALSE, FALSE, error);
+    g_mutex_unlock (&mount_pool_lock);
+
+    return ret;
+}
+
+/**
+ * bd_fs_generic_close: (skip)
+ *
+ * Releases all the temporary mounts, called from bd_fs_close().
+ */
+void bd_fs_generic_close (void) {
+    bd_fs_set_mount_pool_timeout (0, NULL);
+
+    g_mutex_lock (&mount_pool_lock);
+    /* make sure nothing stays mounted after the plugin is gone */
+    mount_pool_release_idle (FALSE, TRUE, NULL);
+    g_mutex_unlock (&mount_pool_lock);
+}
+
+/**
+ * fs_mount_tmp:
  * @device: the device to mount for an FS operation
  * @fstype: (nullable): filesystem type on @device
  * @read_only: whether to mount @device ro or rw
@@ -661,14 +1353,13 @@ gchar* bd_fs_get_fstype (const gchar *device,  GError **error) {
  *                  not (was already mounted before)
  * @error: (out) (optional): place to store error (if any)
  *
- * This is just a helper function for FS operations that need @device to be mounted.
  * If the device is already mounted, this will just return the existing mountpoint.
  * If the device is not mounted, we will mount it to a temporary directory and set
  * @unmount to %TRUE.
  *
  * Returns: (transfer full): mountpoint @device is mounted at (or %NULL in case of error)
  */
-static gchar* fs_mount (const gchar *device, gchar *fstype, gboolean read_only, gboolean *unmount, GError **error) {
+static gchar* fs_mount_tmp (const gchar *device, gchar *fstype, gboolean read_only, gboolean *unmount, GError **error) {
     gchar *mountpoint = NULL;
     gboolean ret = FALSE;
     GError *l_error = NULL;
@@ -698,9 +1389,148 @@ static gchar* fs_mount (const gchar *device, gchar *fstype, gboolean read_only,
             return NULL;
         }
     } else
-        *unmount = FALSE;
+        *unmount = FALSE;
+
+    return mountpoint;
+}
+
+/**
+ * fs_mount:
+ * @device: the device to mount for an FS operation
+ * @fstype: (nullable): filesystem type on @device
+ * @read_only: whether to mount @device ro or rw
+ * @unmount: (out): whether caller should call fs_unmount() when done
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * This is just a helper function for FS operations that need @device to be mounted.
+ * If the device is already mounted, this will just return the existing mountpoint.
+ * If the device is not mounted, we will mount it to a temporary directory (or reuse
+ * the temporary mount from the pool) and set @unmount to %TRUE.
+ *
+ * Returns: (transfer full): mountpoint @device is mounted at (or %NULL in case of error)
+ */
+static gchar* fs_mount (const gchar *device, gchar *fstype, gboolean read_only, gboolean *unmount, GError **error) {
+    g_autofree gchar *key = NULL;
+    gchar *mountpoint = NULL;
+    PooledMount *pm = NULL;
+    GError *l_error = NULL;
+
+    g_mutex_lock (&mount_pool_lock);
+    if (mount_pool_timeout == 0) {
+        g_mutex_unlock (&mount_pool_lock);
+        return fs_mount_tmp (device, fstype, read_only, unmount, error);
+    }
+
+    key = mount_pool_key (device);
+    pm = mount_pool_lookup (key);
+    if (pm) {
+        if (!pm->read_only || read_only) {
+            pm->refcount++;
+            *unmount = TRUE;
+            mountpoint = g_strdup (pm->mountpoint);
+            g_mutex_unlock (&mount_pool_lock);
+            return mountpoint;
+        }
+
+        /* we need a read-write mount, but the pooled one is read-only */
+        if (pm->refcount > 0) {
+            g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                         "Device '%s' is mounted read-only by another operation", device);
+            g_mutex_unlock (&mount_pool_lock);
+            return NULL;
+        }
+        if (!mount_pool_release (key, pm, &l_error)) {
+            g_propagate_prefixed_error (error, l_error, "Failed to unmount '%s': ", device);
+            g_mutex_unlock (&mount_pool_lock);
+            return NULL;
+        }
+    }
+
+    /* add a placeholder so that other operations on the device wait for the mount */
+    pm = g_new0 (PooledMount, 1);
+    pm->read_only = read_only;
+    pm->refcount = 1;
+    pm->busy = TRUE;
+    g_hash_table_insert (mount_pool, g_strdup (key), pm);
+    g_mutex_unlock (&mount_pool_lock);
+
+    mountpoint = fs_mount_tmp (device, fstype, read_only, unmount, error);
+
+    g_mutex_lock (&mount_pool_lock);
+    pm->busy = FALSE;
+    if (mountpoint && *unmount)
+        pm->mountpoint = g_strdup (mountpoint);
+    else
+        /* mounting failed or the device was already mounted, nothing to pool */
+        g_hash_table_remove (mount_pool, key);
+    g_cond_broadcast (&mount_pool_busy_cond);
+    g_mutex_unlock (&mount_pool_lock);
+
+    return mountpoint;
+}
+
+/**
+ * fs_unmount:
+ * @device: the device mounted by fs_mount()
+ * @mountpoint: mountpoint returned by fs_mount()
+ * @unmount: @unmount returned by fs_mount()
+ * @op_success: whether the operation on the mounted @device succeeded
+ * @op_desc: description of the operation for the error message
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Counterpart of fs_mount(), unmounts @device if it was mounted by fs_mount()
+ * or returns it to the temporary mount pool.
+ *
+ * Returns: %FALSE if @op_success is %TRUE but unmounting @device failed, %TRUE
+ *          otherwise (errors from unmount are ignored if the operation failed
+ *          because the error from the operation is more important)
+ */
+static gboolean fs_unmount (const gchar *device, const gchar *mountpoint, gboolean unmount,
+                            gboolean op_success, const gchar *op_desc, GError **error) {
+    g_autofree gchar *key = NULL;
+    PooledMount *pm = NULL;
+    GError *local_error = NULL;
+
+    if (!unmount)
+        return TRUE;
+
+    g_mutex_lock (&mount_pool_lock);
+    if (mount_pool) {
+        key = mount_pool_key (device);
+        pm = g_hash_table_lookup (mount_pool, key);
+        if (pm && g_strcmp0 (pm->mountpoint, mountpoint) == 0) {
+            pm->refcount--;
+            if (pm->refcount > 0) {
+                g_mutex_unlock (&mount_pool_lock);
+                return TRUE;
+            } else if (mount_pool_timeout > 0) {
+                pm->expires = g_get_monotonic_time () + mount_pool_timeout * G_TIME_SPAN_SECOND;
+                g_cond_signal (&mount_pool_cond);
+                g_mutex_unlock (&mount_pool_lock);
+                return TRUE;
+            }
+            /* pool was disabled in the meantime, just unmount */
+            g_hash_table_remove (mount_pool, key);
+        }
+    }
+    g_mutex_unlock (&mount_pool_lock);
+
+    if (!bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error)) {
+        if (op_success) {
+            g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
+                         "Failed to unmount '%s' after %s: %s",
+                         device, op_desc, local_error->message);
+            g_clear_error (&local_error);
+            return FALSE;
+        } else
+            /* both the operation and unmount were unsuccessful but the error
+               from the operation is more important so just ignore the
+               unmount error */
+            g_clear_error (&local_error);
+    } else
+        g_rmdir (mountpoint);
 
-    return mountpoint;
+    return TRUE;
 }
 
 /**
@@ -718,44 +1548,35 @@ static gchar* fs_mount (const gchar *device, gchar *fstype, gboolean read_only,
  */
 static gboolean xfs_resize_device (const gchar *device, guint64 new_size, const BDExtraArg **extra, GError **error) {
     g_autofree gchar* mountpoint = NULL;
-    gboolean ret = FALSE;
     gboolean success = FALSE;
     gboolean unmount = FALSE;
-    GError *local_error = NULL;
     BDFSXfsInfo* xfs_info = NULL;
-
-    xfs_info = bd_fs_xfs_get_info (device, error);
-    if (!xfs_info) {
-        return FALSE;
-    }
+    struct statfs stfs;
+    guint64 block_size = 0;
 
     mountpoint = fs_mount (device, "xfs", FALSE, &unmount, error);
     if (!mountpoint)
         return FALSE;
 
-    new_size = (new_size + xfs_info->block_size - 1) / xfs_info->block_size;
-    bd_fs_xfs_info_free (xfs_info);
+    /* statfs on XFS reports the filesystem block size, no need to run xfs_db */
+    if (statfs (mountpoint, &stfs) == 0 && stfs.f_type == XFS_SUPER_MAGIC)
+        block_size = stfs.f_bsize;
+    else {
+        xfs_info = bd_fs_xfs_get_info (device, error);
+        if (!xfs_info) {
+            fs_unmount (device, mountpoint, unmount, FALSE, "getting info", NULL);
+            return FALSE;
+        }
+        block_size = xfs_info->block_size;
+        bd_fs_xfs_info_free (xfs_info);
+    }
+
+    new_size = (new_size + block_size - 1) / block_size;
 
     success = bd_fs_xfs_resize (mountpoint, new_size, extra, error);
 
-    if (unmount) {
-        ret = bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error);
-        if (!ret) {
-            if (success) {
-                /* resize was successful but unmount failed */
-                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
-                             "Failed to unmount '%s' after resizing it: %s",
-                             device, local_error->message);
-                g_clear_error (&local_error);
-                return FALSE;
-            } else
-                /* both resize and unmount were unsuccessful but the error
-                   from the resize is more important so just ignore the
-                   unmount error */
-                g_clear_error (&local_error);
-        } else
-            g_rmdir (mountpoint);
-    }
+    if (!fs_unmount (device, mountpoint, unmount, success, "resizing it", error))
+        return FALSE;
 
     return success;
 }
@@ -782,10 +1603,8 @@ static gboolean f2fs_resize_device (const gchar *device, guint64 new_size, GErro
 
 static gboolean nilfs2_resize_device (const gchar *device, guint64 new_size, GError **error) {
     g_autofree gchar* mountpoint = NULL;
-    gboolean ret = FALSE;
     gboolean success = FALSE;
     gboolean unmount = FALSE;
-    GError *local_error = NULL;
 
     mountpoint = fs_mount (device, "nilfs2", FALSE, &unmount, error);
     if (!mountpoint)
@@ -793,24 +1612,8 @@ static gboolean nilfs2_resize_device (const gchar *device, guint64 new_size, GEr
 
     success = bd_fs_nilfs2_resize (device, new_size, error);
 
-    if (unmount) {
-        ret = bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error);
-        if (!ret) {
-            if (success) {
-                /* resize was successful but unmount failed */
-                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
-                             "Failed to unmount '%s' after resizing it: %s",
-                             device, local_error->message);
-                g_clear_error (&local_error);
-                return FALSE;
-            } else
-                /* both resize and unmount were unsuccessful but the error
-                   from the resize is more important so just ignore the
-                   unmount error */
-                g_clear_error (&local_error);
-        } else
-            g_rmdir (mountpoint);
-    }
+    if (!fs_unmount (device, mountpoint, unmount, success, "resizing it", error))
+        return FALSE;
 
     return success;
 }
@@ -818,8 +1621,6 @@ static gboolean nilfs2_resize_device (const gchar *device, guint64 new_size, GEr
 static BDFSBtrfsInfo* btrfs_get_info (const gchar *device, GError **error) {
     g_autofree gchar* mountpoint = NULL;
     gboolean unmount = FALSE;
-    gboolean ret = FALSE;
-    GError *local_error = NULL;
     BDFSBtrfsInfo* btrfs_info = NULL;
 
     mountpoint = fs_mount (device, "btrfs", TRUE, &unmount, error);
@@ -828,24 +1629,9 @@ static BDFSBtrfsInfo* btrfs_get_info (const gchar *device, GError **error) {
 
     btrfs_info = bd_fs_btrfs_get_info (mountpoint, error);
 
-    if (unmount) {
-        ret = bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error);
-        if (!ret) {
-            if (btrfs_info) {
-                /* info was successful but unmount failed */
-                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
-                             "Failed to unmount '%s' after getting info: %s",
-                             device, local_error->message);
-                g_clear_error (&local_error);
-                bd_fs_btrfs_info_free (btrfs_info);
-                return NULL;
-            } else
-                /* both info and unmount were unsuccessful but the error
-                   from the info is more important so just ignore the
-                   unmount error */
-                g_clear_error (&local_error);
-        } else
-            g_rmdir (mountpoint);
+    if (!fs_unmount (device, mountpoint, unmount, btrfs_info != NULL, "getting info", error)) {
+        bd_fs_btrfs_info_free (btrfs_info);
+        return NULL;
     }
 
     return btrfs_info;
@@ -853,10 +1639,8 @@ static BDFSBtrfsInfo* btrfs_get_info (const gchar *device, GError **error) {
 
 static gboolean btrfs_resize_device (const gchar *device, guint64 new_size, GError **error) {
     g_autofree gchar* mountpoint = NULL;
-    gboolean ret = FALSE;
     gboolean success = FALSE;
     gboolean unmount = FALSE;
-    GError *local_error = NULL;
 
     mountpoint = fs_mount (device, "btrfs", FALSE, &unmount, error);
     if (!mountpoint)
@@ -864,34 +1648,16 @@ static gboolean btrfs_resize_device (const gchar *device, guint64 new_size, GErr
 
     success = bd_fs_btrfs_resize (mountpoint, new_size, NULL, error);
 
-    if (unmount) {
-        ret = bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error);
-        if (!ret) {
-            if (success) {
-                /* resize was successful but unmount failed */
-                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
-                             "Failed to unmount '%s' after resizing it: %s",
-                             device, local_error->message);
-                g_clear_error (&local_error);
-                return FALSE;
-            } else
-                /* both resize and unmount were unsuccessful but the error
-                   from the resize is more important so just ignore the
-                   unmount error */
-                g_clear_error (&local_error);
-        } else
-            g_rmdir (mountpoint);
-    }
+    if (!fs_unmount (device, mountpoint, unmount, success, "resizing it", error))
+        return FALSE;
 
     return success;
 }
 
 static gboolean btrfs_set_label (const gchar *device, const gchar *label, GError **error) {
     g_autofree gchar* mountpoint = NULL;
-    gboolean ret = FALSE;
     gboolean success = FALSE;
     gboolean unmount = FALSE;
-    GError *local_error = NULL;
 
     mountpoint = fs_mount (device, "btrfs", FALSE, &unmount, error);
     if (!mountpoint)
@@ -899,28 +1665,22 @@ static gboolean btrfs_set_label (const gchar *device, const gchar *label, GError
 
     success = bd_fs_btrfs_set_label (mountpoint, label, error);
 
-    if (unmount) {
-        ret = bd_fs_unmount (mountpoint, FALSE, FALSE, NULL, &local_error);
-        if (!ret) {
-            if (success) {
-                /* resize was successful but unmount failed */
-                g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_UNMOUNT_FAIL,
-                             "Failed to unmount '%s' after setting label: %s",
-                             device, local_error->message);
-                g_clear_error (&local_error);
-                return FALSE;
-            } else
-                /* both set label and unmount were unsuccessful but the error
-                   from the set label is more important so just ignore the
-                   unmount error */
-                g_clear_error (&local_error);
-        } else
-            g_rmdir (mountpoint);
-    }
+    if (!fs_unmount (device, mountpoint, unmount, success, "setting label", error))
+        return FALSE;
 
     return success;
 }
 
+/* whether @op on @fstype is done on a temporarily mounted device */
+static gboolean op_needs_mount (const gchar *fstype, BDFSOpType op) {
+    if (op == BD_FS_RESIZE)
+        return g_strcmp0 (fstype, "xfs") == 0 || g_strcmp0 (fstype, "nilfs2") == 0 ||
+               g_strcmp0 (fstype, "btrfs") == 0;
+    if (op == BD_FS_LABEL)
+        return g_strcmp0 (fstype, "btrfs") == 0;
+    return FALSE;
+}
+
 static gboolean device_operation (const gchar *device, const gchar *fstype, BDFSOpType op, guint64 new_size, const gchar *label, const gchar *uuid, GError **error) {
     const gchar* op_name = NULL;
     g_autofree gchar* detected_fstype = NULL;
@@ -949,6 +1709,10 @@ static gboolean device_operation (const gchar *device, const gchar *fstype, BDFS
     } else
         detected_fstype = g_strdup (fstype);
 
+    /* release the pooled temporary mount for operations that don't use it */
+    if (device && !op_needs_mount (detected_fstype, op) && !mount_pool_drop (device, error))
+        return FALSE;
+
     if (g_strcmp0 (detected_fstype, "ext2") == 0 || g_strcmp0 (detected_fstype, "ext3") == 0
                                                  || g_strcmp0 (detected_fstype, "ext4") == 0) {
         switch (op) {
@@ -1546,75 +2310,176 @@ guint64 bd_fs_get_min_size (const gchar *device, const gchar *fstype, GError **e
     }
 }
 
-static gboolean query_fs_operation (const gchar *fs_type, BDFSOpType op, gchar **required_utility, BDFSResizeFlags *mode, BDFSMkfsOptionsFlags *options, GError **error) {
-    gboolean ret;
-    const BDFSInfo *fsinfo = NULL;
-    const gchar* op_name = NULL;
-    const gchar* exec_util = NULL;
-    BDFSTech tech;
-
-    if (required_utility != NULL)
-        *required_utility = NULL;
-
-    if (mode != NULL)
-        *mode = 0;
-
-    if (options != NULL)
-        *options = 0;
-
-    tech = fstype_to_tech (fs_type);
-    if (tech == BD_FS_TECH_GENERIC) {
-        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
-                     "Filesystem '%s' is not supported.", fs_type);
-        return FALSE;
-    }
-    fsinfo = &fs_info[tech];
+/**
+ * fs_op_util: (skip)
+ * @tech: filesystem tech to get the utility for
+ * @op: operation to get the utility for
+ * @op_name: (out) (optional): name of the operation (for error messages)
+ *
+ * Returns: utility required for @op on @tech, "" if no utility is needed or
+ *          %NULL if @op is not supported for @tech
+ */
+static const gchar* fs_op_util (BDFSTech tech, BDFSOpType op, const gchar **op_name) {
+    const BDFSInfo *fsinfo = &fs_info[tech];
+    const gchar *name = NULL;
+    const gchar *exec_util = NULL;
 
     switch (op) {
         case BD_FS_MKFS:
-            op_name = "Creating";
+            name = "Creating";
             exec_util = fsinfo->mkfs_util;
             break;
         case BD_FS_RESIZE:
-            op_name = "Resizing";
+            name = "Resizing";
             exec_util = fsinfo->resize_util;
             break;
         case BD_FS_REPAIR:
-            op_name = "Repairing";
+            name = "Repairing";
             exec_util = fsinfo->repair_util;
             break;
         case BD_FS_CHECK:
-            op_name = "Checking";
+            name = "Checking";
             exec_util = fsinfo->check_util;
             break;
         case BD_FS_LABEL:
-            op_name = "Setting the label of";
+            name = "Setting the label of";
             exec_util = fsinfo->label_util;
             break;
         case BD_FS_UUID:
-            op_name = "Setting UUID of";
+            name = "Setting UUID of";
             exec_util = fsinfo->uuid_util;
             break;
         case BD_FS_GET_SIZE:
-            op_name = "Getting size of";
+            name = "Getting size of";
             exec_util = fsinfo->info_util;
             break;
         case BD_FS_GET_FREE_SPACE:
-            op_name = "Getting free space on";
-            exec_util = fsinfo->info_util;
+            name = "Getting free space on";
+            /* some filesystems can't tell us free space even if we have the tools */
+            if (tech == BD_FS_TECH_XFS || tech == BD_FS_TECH_F2FS || tech == BD_FS_TECH_EXFAT || tech == BD_FS_TECH_UDF)
+                exec_util = NULL;
+            else
+                exec_util = fsinfo->info_util;
             break;
         case BD_FS_GET_INFO:
-            op_name = "Getting filesystem info of";
+            name = "Getting filesystem info of";
             exec_util = fsinfo->info_util;
             break;
         case BD_FS_GET_MIN_SIZE:
-            op_name = "Getting minimum size of";
+            name = "Getting minimum size of";
             exec_util = fsinfo->minsize_util;
             break;
         default:
             g_assert_not_reached ();
     }
 
+    if (op_name)
+        *op_name = name;
+
+    return exec_util;
+}
+
+/* operations covered by the capability cache, in the same order as #BDFSCapabilityFlags */
+static const BDFSOpType cap_ops[] = {
+    BD_FS_MKFS, BD_FS_RESIZE, BD_FS_REPAIR, BD_FS_CHECK, BD_FS_LABEL, BD_FS_UUID,
+    BD_FS_GET_SIZE, BD_FS_GET_FREE_SPACE, BD_FS_GET_INFO, BD_FS_GET_MIN_SIZE,
+};
+#define CAP_OPS_LEN G_N_ELEMENTS (cap_ops)
+
+/* availability of the utilities required for the operations, computed once
+   and invalidated when $PATH changes */
+static GMutex caps_cache_lock;
+static gboolean caps_cache_valid = FALSE;
+static gchar *caps_cache_path = NULL;
+static BDFSCapabilityFlags caps_cache[BD_FS_LAST_FS];
+
+/**
+ * caps_cache_ensure: (skip)
+ *
+ * Makes sure the capability cache is up to date. Must be called with
+ * @caps_cache_lock held.
+ */
+static void caps_cache_ensure (void) {
+    const gchar *path = g_getenv ("PATH");
+    g_autoptr(GHashTable) utils = NULL;
+    const gchar *util = NULL;
+    gchar *util_path = NULL;
+    gpointer found = NULL;
+    gboolean avail = FALSE;
+    guint tech = 0;
+    guint i = 0;
+
+    if (caps_cache_valid && g_strcmp0 (path, caps_cache_path) == 0)
+        return;
+
+    /* many operations share the same utility, check each of them just once */
+    utils = g_hash_table_new (g_str_hash, g_str_equal);
+    for (tech = BD_FS_OFFSET; tech < BD_FS_LAST_FS; tech++) {
+        caps_cache[tech] = 0;
+        for (i = 0; i < CAP_OPS_LEN; i++) {
+            util = fs_op_util (tech, cap_ops[i], NULL);
+            if (util == NULL)
+                continue;
+            if (strlen (util) == 0)
+                avail = TRUE;
+            else if (g_hash_table_lookup_extended (utils, util, NULL, &found))
+                avail = GPOINTER_TO_INT (found);
+            else {
+                util_path = g_find_program_in_path (util);
+                avail = util_path != NULL;
+                g_free (util_path);
+                g_hash_table_insert (utils, (gpointer) util, GINT_TO_POINTER (avail));
+            }
+            if (avail)
+                caps_cache[tech] |= 1 << i;
+        }
+    }
+
+    g_free (caps_cache_path);
+    caps_cache_path = g_strdup (path);
+    caps_cache_valid = TRUE;
+}
+
+static gboolean caps_cache_op_avail (BDFSTech tech, BDFSOpType op) {
+    gboolean ret = FALSE;
+    guint i = 0;
+
+    for (i = 0; i < CAP_OPS_LEN; i++)
+        if (cap_ops[i] == op)
+            break;
+    g_return_val_if_fail (i < CAP_OPS_LEN, FALSE);
+
+    g_mutex_lock (&caps_cache_lock);
+    caps_cache_ensure ();
+    ret = (caps_cache[tech] & (1 << i)) != 0;
+    g_mutex_unlock (&caps_cache_lock);
+
+    return ret;
+}
+
+static gboolean query_fs_operation (const gchar *fs_type, BDFSOpType op, gchar **required_utility, BDFSResizeFlags *mode, BDFSMkfsOptionsFlags *options, GError **error) {
+    gboolean ret;
+    const gchar* op_name = NULL;
+    const gchar* exec_util = NULL;
+    BDFSTech tech;
+
+    if (required_utility != NULL)
+        *required_utility = NULL;
+
+    if (mode != NULL)
+        *mode = 0;
+
+    if (options != NULL)
+        *options = 0;
+
+    tech = fstype_to_tech (fs_type);
+    if (tech == BD_FS_TECH_GENERIC) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
+                     "Filesystem '%s' is not supported.", fs_type);
+        return FALSE;
+    }
+
+    exec_util = fs_op_util (tech, op, &op_name);
     if (exec_util == NULL) {
         g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
                      "%s filesystem '%s' is not supported.", op_name, fs_type);
@@ -1631,13 +2496,120 @@ static gboolean query_fs_operation (const gchar *fs_type, BDFSOpType op, gchar *
         return TRUE;
     }
 
-    ret = bd_utils_check_util_version (exec_util, NULL, "", NULL, NULL);
+    ret = caps_cache_op_avail (tech, op);
     if (!ret && required_utility != NULL)
         *required_utility = g_strdup (exec_util);
 
     return ret;
 }
 
+/**
+ * bd_fs_capabilities_copy: (skip)
+ * @data: (nullable): %BDFSCapabilities to copy
+ *
+ * Creates a new copy of @data.
+ */
+BDFSCapabilities* bd_fs_capabilities_copy (BDFSCapabilities *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDFSCapabilities *ret = g_new0 (BDFSCapabilities, 1);
+
+    ret->type = g_strdup (data->type);
+    ret->supported = data->supported;
+    ret->available = data->available;
+    ret->resize = data->resize;
+    ret->mkfs = data->mkfs;
+    ret->mkfs_util = g_strdup (data->mkfs_util);
+    ret->check_util = g_strdup (data->check_util);
+    ret->repair_util = g_strdup (data->repair_util);
+    ret->resize_util = g_strdup (data->resize_util);
+    ret->minsize_util = g_strdup (data->minsize_util);
+    ret->label_util = g_strdup (data->label_util);
+    ret->info_util = g_strdup (data->info_util);
+    ret->uuid_util = g_strdup (data->uuid_util);
+
+    return ret;
+}
+
+/**
+ * bd_fs_capabilities_free: (skip)
+ * @data: (nullable): %BDFSCapabilities to free
+ *
+ * Frees @data.
+ */
+void bd_fs_capabilities_free (BDFSCapabilities *data) {
+    if (data == NULL)
+        return;
+
+    g_free (data->type);
+    g_free (data->mkfs_util);
+    g_free (data->check_util);
+    g_free (data->repair_util);
+    g_free (data->resize_util);
+    g_free (data->minsize_util);
+    g_free (data->label_util);
+    g_free (data->info_util);
+    g_free (data->uuid_util);
+    g_free (data);
+}
+
+/**
+ * bd_fs_get_capabilities:
+ * @error: (out) (optional): currently unused
+ *
+ * Returns the complete matrix of operations supported by this plugin and
+ * available on this system (all required utilities are installed) for all
+ * the supported filesystems. This is equivalent to calling all the
+ * `bd_fs_can_` functions for all the filesystems returned by
+ * bd_fs_supported_filesystems(), but much cheaper.
+ *
+ * The availability of the utilities is checked only once and cached, the cache
+ * is invalidated when the `PATH` environment variable changes.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): capabilities of all the
+ *                                                     supported filesystems
+ *
+ * Tech category: always available
+ */
+BDFSCapabilities** bd_fs_get_capabilities (GError **error G_GNUC_UNUSED) {
+    BDFSCapabilities **ret = g_new0 (BDFSCapabilities *, BD_FS_LAST_FS - BD_FS_OFFSET + 1);
+    BDFSCapabilityFlags available[BD_FS_LAST_FS];
+    BDFSCapabilities *caps = NULL;
+    const gchar *util = NULL;
+    guint tech = 0;
+    guint i = 0;
+
+    g_mutex_lock (&caps_cache_lock);
+    caps_cache_ensure ();
+    memcpy (available, caps_cache, sizeof (caps_cache));
+    g_mutex_unlock (&caps_cache_lock);
+
+    for (tech = BD_FS_OFFSET; tech < BD_FS_LAST_FS; tech++) {
+        caps = g_new0 (BDFSCapabilities, 1);
+        caps->type = g_strdup (fs_info[tech].type);
+        caps->available = available[tech];
+        caps->resize = fs_features[tech].resize;
+        caps->mkfs = fs_features[tech].mkfs;
+        for (i = 0; i < CAP_OPS_LEN; i++) {
+            util = fs_op_util (tech, cap_ops[i], NULL);
+            if (util)
+                caps->supported |= 1 << i;
+        }
+        caps->mkfs_util = g_strdup (fs_op_util (tech, BD_FS_MKFS, NULL));
+        caps->check_util = g_strdup (fs_op_util (tech, BD_FS_CHECK, NULL));
+        caps->repair_util = g_strdup (fs_op_util (tech, BD_FS_REPAIR, NULL));
+        caps->resize_util = g_strdup (fs_op_util (tech, BD_FS_RESIZE, NULL));
+        caps->minsize_util = g_strdup (fs_op_util (tech, BD_FS_GET_MIN_SIZE, NULL));
+        caps->label_util = g_strdup (fs_op_util (tech, BD_FS_LABEL, NULL));
+        caps->info_util = g_strdup (fs_op_util (tech, BD_FS_GET_INFO, NULL));
+        caps->uuid_util = g_strdup (fs_op_util (tech, BD_FS_UUID, NULL));
+        ret[tech - BD_FS_OFFSET] = caps;
+    }
+
+    return ret;
+}
+
 /**
  * bd_fs_can_mkfs:
  * @type: the filesystem type to be tested for installed mkfs support
@@ -1784,13 +2756,6 @@ gboolean bd_fs_can_get_size (const gchar *type, gchar **required_utility, GError
  * Tech category: %BD_FS_TECH_GENERIC-%BD_FS_TECH_MODE_QUERY
  */
 gboolean bd_fs_can_get_free_space (const gchar *type, gchar **required_utility, GError **error) {
-    /* some filesystems can't tell us free space even if we have the tools */
-    if (g_strcmp0 (type, "xfs") == 0 || g_strcmp0 (type, "f2fs") == 0 || g_strcmp0 (type, "exfat") == 0 || g_strcmp0 (type, "udf") == 0) {
-        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_NOT_SUPPORTED,
-                     "Getting free space on filesystem '%s' is not supported.", type);
-        return FALSE;
-    }
-
     return query_fs_operation (type, BD_FS_GET_FREE_SPACE, required_utility, NULL, NULL, error);
 }
 
@@ -1907,6 +2872,334 @@ gboolean bd_fs_unfreeze (const gchar *mountpoint, GError **error) {
     return fs_freeze (mountpoint, FALSE, error);
 }
 
+/**
+ * bd_fs_freeze_member_copy: (skip)
+ * @data: (nullable): %BDFSFreezeMember to copy
+ *
+ * Creates a new copy of @data.
+ */
+BDFSFreezeMember* bd_fs_freeze_member_copy (BDFSFreezeMember *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDFSFreezeMember *ret = g_new0 (BDFSFreezeMember, 1);
+
+    ret->mountpoint = g_strdup (data->mountpoint);
+    ret->frozen = data->frozen;
+    ret->freeze_start = data->freeze_start;
+    ret->frozen_time = data->frozen_time;
+
+    return ret;
+}
+
+/**
+ * bd_fs_freeze_member_free: (skip)
+ * @data: (nullable): %BDFSFreezeMember to free
+ *
+ * Frees @data.
+ */
+void bd_fs_freeze_member_free (BDFSFreezeMember *data) {
+    if (data == NULL)
+        return;
+
+    g_free (data->mountpoint);
+    g_free (data);
+}
+
+typedef struct FreezeGroupJob {
+    GMutex lock;
+    GCond cond;
+    guint pending;
+    gboolean aborted;
+    GError *error;
+} FreezeGroupJob;
+
+typedef struct FreezeTask {
+    FreezeGroupJob *job;
+    BDFSFreezeMember *member;
+    gboolean freeze;
+    /* whether somebody (the worker or the main thread) already took care of
+       thawing the member after the group was aborted, protected by job->lock */
+    gboolean thawing;
+    /* why the member couldn't be thawed after the group was aborted */
+    GError *thaw_error;
+} FreezeTask;
+
+/* attempts to thaw a member of an aborted group, a member left frozen blocks
+   all writes to the filesystem so it's worth trying more than once */
+#define FREEZE_ABORT_THAW_ATTEMPTS 3
+#define FREEZE_ABORT_THAW_DELAY (100 * G_TIME_SPAN_MILLISECOND)
+
+static void freeze_member_thawed (BDFSFreezeMember *member) {
+    member->frozen = FALSE;
+    member->frozen_time = (guint64) (g_get_monotonic_time () - member->freeze_start);
+}
+
+/* thaws the member of @task frozen as part of an aborted group */
+static void freeze_task_thaw (FreezeTask *task) {
+    GError *l_error = NULL;
+    gboolean success = FALSE;
+    guint attempt = 0;
+
+    for (attempt = 0; !success && attempt < FREEZE_ABORT_THAW_ATTEMPTS; attempt++) {
+        if (attempt > 0) {
+            bd_utils_log_format (BD_UTILS_LOG_WARNING, "Failed to thaw '%s', trying again: %s",
+                                 task->member->mountpoint, l_error->message);
+            g_clear_error (&l_error);
+            g_usleep (FREEZE_ABORT_THAW_DELAY);
+        }
+        success = fs_freeze (task->member->mountpoint, FALSE, &l_error);
+    }
+
+    g_mutex_lock (&task->job->lock);
+    if (success)
+        freeze_member_thawed (task->member);
+    else
+        task->thaw_error = l_error;
+    g_mutex_unlock (&task->job->lock);
+}
+
+static gpointer freeze_worker (gpointer data) {
+    FreezeTask *task = (FreezeTask *) data;
+    FreezeGroupJob *job = task->job;
+    GError *l_error = NULL;
+    gboolean thaw = FALSE;
+    gint64 start = 0;
+    gboolean success = FALSE;
+
+    /* writes to the filesystem are blocked from the moment the freeze starts */
+    start = g_get_monotonic_time ();
+    success = fs_freeze (task->member->mountpoint, task->freeze, &l_error);
+
+    g_mutex_lock (&job->lock);
+    if (success) {
+        if (task->freeze) {
+            task->member->freeze_start = start;
+            task->member->frozen = TRUE;
+            /* frozen too late, the group is already being thawed so this
+               member has to be thawed right away (unless the main thread
+               is already doing that) */
+            thaw = job->aborted && !task->thawing;
+            if (thaw)
+                task->thawing = TRUE;
+        } else
+            freeze_member_thawed (task->member);
+    } else if (!job->error)
+        job->error = l_error;
+    else
+        g_clear_error (&l_error);
+    g_mutex_unlock (&job->lock);
+
+    if (thaw)
+        freeze_task_thaw (task);
+
+    g_mutex_lock (&job->lock);
+    job->pending--;
+    g_cond_signal (&job->cond);
+    g_mutex_unlock (&job->lock);
+
+    return NULL;
+}
+
+/**
+ * freeze_group_run: (skip)
+ * @members: members of the group to (un)freeze
+ * @freeze: whether to freeze or unfreeze @members (only the frozen ones are unfrozen)
+ * @timeout: deadline for the operation in milliseconds (0 for no deadline)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Runs the FIFREEZE/FITHAW ioctls for all @members in parallel, each from its
+ * own thread. On error or timeout the remaining members frozen later are
+ * thawed by their own threads. All the threads are joined before returning.
+ * Members that couldn't be thawed after an error or timeout are listed in the
+ * returned error.
+ */
+static gboolean freeze_group_run (BDFSFreezeMember **members, gboolean freeze, guint timeout, GError **error) {
+    FreezeGroupJob job;
+    g_autofree FreezeTask *tasks = NULL;
+    g_autofree GThread **workers = NULL;
+    BDFSFreezeMember **member_p = NULL;
+    GString *still_frozen = NULL;
+    GError *l_error = NULL;
+    gint64 deadline = 0;
+    gboolean timed_out = FALSE;
+    gboolean thaw = FALSE;
+    guint n_tasks = 0;
+    guint i = 0;
+
+    for (member_p = members; *member_p; member_p++)
+        n_tasks++;
+    tasks = g_new0 (FreezeTask, n_tasks);
+    workers = g_new0 (GThread *, n_tasks);
+
+    g_mutex_init (&job.lock);
+    g_cond_init (&job.cond);
+    job.pending = 0;
+    job.aborted = FALSE;
+    job.error = NULL;
+
+    if (timeout > 0)
+        deadline = g_get_monotonic_time () + (gint64) timeout * G_TIME_SPAN_MILLISECOND;
+
+    g_mutex_lock (&job.lock);
+    for (i = 0; i < n_tasks; i++) {
+        if (members[i]->frozen == freeze)
+            continue;
+        tasks[i].job = &job;
+        tasks[i].member = members[i];
+        tasks[i].freeze = freeze;
+        job.pending++;
+        workers[i] = g_thread_try_new ("bd-fs-freeze", freeze_worker, &tasks[i], NULL);
+        if (!workers[i]) {
+            /* no more threads, just do it from this one */
+            g_mutex_unlock (&job.lock);
+            freeze_worker (&tasks[i]);
+            g_mutex_lock (&job.lock);
+        }
+    }
+
+    while (job.pending > 0) {
+        /* stop waiting for the rest of the group if something went wrong,
+           the frozen members need to be thawed as soon as possible */
+        if (freeze && job.error)
+            break;
+        if (deadline == 0)
+            g_cond_wait (&job.cond, &job.lock);
+        else if (!g_cond_wait_until (&job.cond, &job.lock, deadline) && job.pending > 0) {
+            timed_out = TRUE;
+            break;
+        }
+    }
+    if (freeze && (job.error || timed_out))
+        job.aborted = TRUE;
+    g_mutex_unlock (&job.lock);
+
+    if (freeze && job.aborted) {
+        /* thaw whatever got frozen so far, members frozen after this point
+           are thawed by their threads */
+        for (i = 0; i < n_tasks; i++) {
+            if (!tasks[i].member)
+                continue;
+            g_mutex_lock (&job.lock);
+            thaw = members[i]->frozen && !tasks[i].thawing;
+            if (thaw)
+                tasks[i].thawing = TRUE;
+            g_mutex_unlock (&job.lock);
+
+            if (thaw)
+                freeze_task_thaw (&tasks[i]);
+        }
+    }
+
+    for (i = 0; i < n_tasks; i++)
+        if (workers[i])
+            g_thread_join (workers[i]);
+
+    g_mutex_clear (&job.lock);
+    g_cond_clear (&job.cond);
+
+    /* the caller needs to know the stall is not over */
+    for (i = 0; i < n_tasks; i++) {
+        if (!tasks[i].thaw_error)
+            continue;
+        if (!still_frozen)
+            still_frozen = g_string_new (NULL);
+        else
+            g_string_append (still_frozen, ", ");
+        g_string_append_printf (still_frozen, "%s (%s)", members[i]->mountpoint, tasks[i].thaw_error->message);
+        g_clear_error (&tasks[i].thaw_error);
+    }
+
+    if (job.error)
+        l_error = job.error;
+    else if (timed_out)
+        l_error = g_error_new (BD_FS_ERROR, BD_FS_ERROR_FAIL,
+                               "Timed out waiting for the filesystems to %s", freeze ? "freeze" : "unfreeze");
+
+    if (l_error && still_frozen) {
+        g_set_error (error, l_error->domain, l_error->code,
+                     "%s; still frozen: %s", l_error->message, still_frozen->str);
+        g_error_free (l_error);
+        g_string_free (still_frozen, TRUE);
+        return FALSE;
+    } else if (l_error) {
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * bd_fs_freeze_group:
+ * @mountpoints: (array zero-terminated=1): mountpoints of the filesystems to freeze
+ * @timeout: deadline for freezing all the filesystems in milliseconds (0 for no deadline)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Freezes all the filesystems mounted on @mountpoints in parallel so that
+ * they are all frozen at the same time for as short as possible. If freezing
+ * any of them fails or they are not all frozen within @timeout, all the
+ * filesystems frozen so far are thawed again and an error is returned. If
+ * some of them can't be thawed, the error lists them as still frozen.
+ *
+ * Note: The function doesn't return before all the freeze requests finish, but
+ *       members frozen after an error or after @timeout expired are thawed
+ *       immediately.
+ *
+ * Returns: (array zero-terminated=1) (transfer full): members of the frozen
+ *          group to be passed to bd_fs_unfreeze_group() or %NULL in case of
+ *          error
+ *
+ */
+BDFSFreezeMember** bd_fs_freeze_group (const gchar **mountpoints, guint timeout, GError **error) {
+    BDFSFreezeMember **members = NULL;
+    guint n_members = 0;
+    guint i = 0;
+
+    if (!mountpoints || !*mountpoints) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_INVAL,
+                     "No mountpoints to freeze specified");
+        return NULL;
+    }
+
+    n_members = g_strv_length ((gchar **) mountpoints);
+    members = g_new0 (BDFSFreezeMember *, n_members + 1);
+    for (i = 0; i < n_members; i++) {
+        members[i] = g_new0 (BDFSFreezeMember, 1);
+        members[i]->mountpoint = g_strdup (mountpoints[i]);
+    }
+
+    if (!freeze_group_run (members, TRUE, timeout, error)) {
+        for (i = 0; i < n_members; i++)
+            bd_fs_freeze_member_free (members[i]);
+        g_free (members);
+        return NULL;
+    }
+
+    return members;
+}
+
+/**
+ * bd_fs_unfreeze_group:
+ * @members: (array zero-terminated=1): members of a group frozen by bd_fs_freeze_group()
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Un-freezes all the frozen @members in parallel and records the time each
+ * of them spent frozen. All members are thawed even if thawing some of them fails.
+ *
+ * Returns: whether all the @members were successfully unfrozen or not
+ *
+ */
+gboolean bd_fs_unfreeze_group (BDFSFreezeMember **members, GError **error) {
+    if (!members) {
+        g_set_error (error, BD_FS_ERROR, BD_FS_ERROR_INVAL,
+                     "No filesystems to unfreeze specified");
+        return FALSE;
+    }
+
+    return freeze_group_run (members, FALSE, 0, error);
+}
+
 extern BDExtraArg** bd_fs_exfat_mkfs_options (BDFSMkfsOptions *options, const BDExtraArg **extra);
 extern BDExtraArg** bd_fs_ext2_mkfs_options (BDFSMkfsOptions *options, const BDExtraArg **extra);
 extern BDExtraArg** bd_fs_ext3_mkfs_options (BDFSMkfsOptions *options, const BDExtraArg **extra);
@@ -1948,6 +3241,9 @@ gboolean bd_fs_mkfs (const gchar *device, const gchar *fstype, BDFSMkfsOptions *
     BDExtraArg **extra_args = NULL;
     gboolean ret = FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     if (g_strcmp0 (fstype, "exfat") == 0) {
         extra_args = bd_fs_exfat_mkfs_options (options, extra);
         ret = bd_fs_exfat_mkfs (device, (const BDExtraArg **) extra_args, error);
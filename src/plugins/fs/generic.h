@@ -7,9 +7,35 @@ gboolean bd_fs_wipe (const gchar *device, gboolean all, gboolean force, GError *
 gboolean bd_fs_clean (const gchar *device, gboolean force, GError **error);
 gchar* bd_fs_get_fstype (const gchar *device,  GError **error);
 
+typedef enum {
+    BD_FS_ZERO_AUTO = 0,
+    BD_FS_ZERO_SECURE_DISCARD,
+    BD_FS_ZERO_DISCARD,
+    BD_FS_ZERO_ZEROOUT,
+    BD_FS_ZERO_WRITE,
+} BDFSZeroMethod;
+
+gboolean bd_fs_zero_device (const gchar *device, BDFSZeroMethod method, guint threads, gboolean force, GError **error);
+
 gboolean bd_fs_freeze (const gchar *mountpoint, GError **error);
 gboolean bd_fs_unfreeze (const gchar *mountpoint, GError **error);
 
+typedef struct BDFSFreezeMember {
+    gchar *mountpoint;
+    gboolean frozen;
+    gint64 freeze_start;
+    guint64 frozen_time;
+} BDFSFreezeMember;
+
+BDFSFreezeMember* bd_fs_freeze_member_copy (BDFSFreezeMember *data);
+void bd_fs_freeze_member_free (BDFSFreezeMember *data);
+
+BDFSFreezeMember** bd_fs_freeze_group (const gchar **mountpoints, guint timeout, GError **error);
+gboolean bd_fs_unfreeze_group (BDFSFreezeMember **members, GError **error);
+
+gboolean bd_fs_set_mount_pool_timeout (guint timeout, GError **error);
+gboolean bd_fs_flush_mount_pool (GError **error);
+
 typedef enum {
     BD_FS_MKFS_LABEL     = 1 << 0,
     BD_FS_MKFS_UUID      = 1 << 1,
@@ -97,4 +123,38 @@ gboolean bd_fs_can_get_free_space (const gchar *type, gchar **required_utility,
 gboolean bd_fs_can_get_info (const gchar *type, gchar **required_utility, GError **error);
 gboolean bd_fs_can_get_min_size (const gchar *type, gchar **required_utility, GError **error);
 
+typedef enum {
+    BD_FS_CAP_MKFS           = 1 << 0,
+    BD_FS_CAP_RESIZE         = 1 << 1,
+    BD_FS_CAP_REPAIR         = 1 << 2,
+    BD_FS_CAP_CHECK          = 1 << 3,
+    BD_FS_CAP_SET_LABEL      = 1 << 4,
+    BD_FS_CAP_SET_UUID       = 1 << 5,
+    BD_FS_CAP_GET_SIZE       = 1 << 6,
+    BD_FS_CAP_GET_FREE_SPACE = 1 << 7,
+    BD_FS_CAP_GET_INFO       = 1 << 8,
+    BD_FS_CAP_GET_MIN_SIZE   = 1 << 9,
+} BDFSCapabilityFlags;
+
+typedef struct BDFSCapabilities {
+    gchar *type;
+    BDFSCapabilityFlags supported;
+    BDFSCapabilityFlags available;
+    BDFSResizeFlags resize;
+    BDFSMkfsOptionsFlags mkfs;
+    gchar *mkfs_util;
+    gchar *check_util;
+    gchar *repair_util;
+    gchar *resize_util;
+    gchar *minsize_util;
+    gchar *label_util;
+    gchar *info_util;
+    gchar *uuid_util;
+} BDFSCapabilities;
+
+BDFSCapabilities* bd_fs_capabilities_copy (BDFSCapabilities *data);
+void bd_fs_capabilities_free (BDFSCapabilities *data);
+
+BDFSCapabilities** bd_fs_get_capabilities (GError **error);
+
 #endif  /* BD_FS_GENERIC */
@@ -172,6 +172,9 @@ gboolean bd_fs_nilfs2_mkfs (const gchar *device, const BDExtraArg **extra, GErro
     if (!check_deps (&avail_deps, DEPS_MKFSNILFS2_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
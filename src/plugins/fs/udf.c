@@ -247,6 +247,9 @@ gboolean bd_fs_udf_mkfs (const gchar *device, const gchar *media_type, gchar *re
     if (!check_deps (&avail_deps, DEPS_MKUDFFS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     if (block_size != 0)
         args[2] = g_strdup_printf ("--blocksize=%"G_GUINT64_FORMAT"", block_size);
     else {
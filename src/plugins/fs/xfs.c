@@ -21,11 +21,50 @@
 #include <check_deps.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/types.h>
 
 #include "xfs.h"
 #include "fs.h"
 #include "common.h"
 
+#ifndef XFS_IOC_FSGROWFSDATA
+/* definitions from xfs/xfs_fs.h to avoid depending on xfsprogs headers */
+struct xfs_fsop_geom_v1 {
+    __u32 blocksize;
+    __u32 rtextsize;
+    __u32 agblocks;
+    __u32 agcount;
+    __u32 logblocks;
+    __u32 sectsize;
+    __u32 inodesize;
+    __u32 imaxpct;
+    __u64 datablocks;
+    __u64 rtblocks;
+    __u64 rtextents;
+    __u64 logstart;
+    unsigned char uuid[16];
+    __u32 sunit;
+    __u32 swidth;
+    __s32 version;
+    __u32 flags;
+    __u32 logsectsize;
+    __u32 rtsectsize;
+    __u32 dirblocksize;
+};
+
+struct xfs_growfs_data {
+    __u64 newblocks;
+    __u32 imaxpct;
+};
+
+#define XFS_IOC_FSGEOMETRY_V1 _IOR ('X', 100, struct xfs_fsop_geom_v1)
+#define XFS_IOC_FSGROWFSDATA _IOW ('X', 110, struct xfs_growfs_data)
+#endif
+
 static volatile guint avail_deps = 0;
 static GMutex deps_check_lock;
 
@@ -173,6 +212,9 @@ gboolean bd_fs_xfs_mkfs (const gchar *device, const BDExtraArg **extra, GError *
     if (!check_deps (&avail_deps, DEPS_MKFSXFS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -198,6 +240,9 @@ gboolean bd_fs_xfs_check (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_XFS_REPAIR_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     ret = bd_utils_exec_and_report_error (args, extra, &l_error);
     if (!ret) {
         if (l_error && g_error_matches (l_error, BD_UTILS_EXEC_ERROR, BD_UTILS_EXEC_ERROR_FAILED)) {
@@ -228,6 +273,9 @@ gboolean bd_fs_xfs_repair (const gchar *device, const BDExtraArg **extra, GError
     if (!check_deps (&avail_deps, DEPS_XFS_REPAIR_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
+    if (!mount_pool_drop (device, error))
+        return FALSE;
+
     return bd_utils_exec_and_report_error (args, extra, error);
 }
 
@@ -428,6 +476,60 @@ BDFSXfsInfo* bd_fs_xfs_get_info (const gchar *device, GError **error) {
     return ret;
 }
 
+/**
+ * xfs_grow_native: (skip)
+ * @mpoint: mountpoint of the XFS filesystem to grow
+ * @new_size: new requested size for the filesystem in blocks (0 for the size of
+ *            the underlying block device)
+ *
+ * Grows the mounted XFS filesystem using the XFS_IOC_FSGROWFSDATA ioctl.
+ *
+ * Returns: whether the filesystem was successfully grown to @new_size, %FALSE
+ *          also if @new_size is smaller than the current size
+ */
+static gboolean xfs_grow_native (const gchar *mpoint, guint64 new_size) {
+    struct xfs_fsop_geom_v1 geo;
+    struct xfs_growfs_data grow;
+    struct stat st;
+    gboolean ret = FALSE;
+    gint fd = -1;
+
+    fd = open (mpoint, O_RDONLY | O_CLOEXEC | O_DIRECTORY);
+    if (fd == -1)
+        return FALSE;
+
+    memset (&geo, 0, sizeof (geo));
+    if (ioctl (fd, XFS_IOC_FSGEOMETRY_V1, &geo) != 0 || geo.blocksize == 0) {
+        close (fd);
+        return FALSE;
+    }
+
+    if (new_size == 0) {
+        if (fstat (fd, &st) != 0) {
+            close (fd);
+            return FALSE;
+        }
+        new_size = get_devno_size (st.st_dev) / geo.blocksize;
+    }
+
+    if (new_size < geo.datablocks) {
+        /* XFS cannot be shrunk, let xfs_growfs report the error */
+        close (fd);
+        return FALSE;
+    } else if (new_size == geo.datablocks) {
+        close (fd);
+        return TRUE;
+    }
+
+    memset (&grow, 0, sizeof (grow));
+    grow.newblocks = new_size;
+    grow.imaxpct = geo.imaxpct;
+    ret = ioctl (fd, XFS_IOC_FSGROWFSDATA, &grow) == 0;
+
+    close (fd);
+    return ret;
+}
+
 /**
  * bd_fs_xfs_resize:
  * @mpoint: the mount point of the file system to resize
@@ -439,6 +541,9 @@ BDFSXfsInfo* bd_fs_xfs_get_info (const gchar *device, GError **error) {
  *
  * Returns: whether the file system mounted on @mpoint was successfully resized or not
  *
+ * Note: If @extra is %NULL, the file system is grown with the XFS_IOC_FSGROWFSDATA
+ *       ioctl directly, 'xfs_growfs' is only used as a fallback.
+ *
  * Tech category: %BD_FS_TECH_XFS-%BD_FS_TECH_MODE_RESIZE
  */
 gboolean bd_fs_xfs_resize (const gchar *mpoint, guint64 new_size, const BDExtraArg **extra, GError **error) {
@@ -446,6 +551,11 @@ gboolean bd_fs_xfs_resize (const gchar *mpoint, guint64 new_size, const BDExtraA
     gchar *size_str = NULL;
     gboolean ret = FALSE;
 
+    /* try to grow the filesystem directly first, xfs_growfs is used as a fallback
+       for everything else so that it can report the errors */
+    if (!extra && xfs_grow_native (mpoint, new_size))
+        return TRUE;
+
     if (!check_deps (&avail_deps, DEPS_XFS_GROWFS_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return FALSE;
 
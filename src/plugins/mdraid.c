@@ -17,14 +17,23 @@
  * Author: Vratislav Podzimek <vpodzime@redhat.com>
  */
 
-#define _XOPEN_SOURCE  /* needed for time.h */
+#define _XOPEN_SOURCE 700  /* needed for time.h, pread() and O_CLOEXEC */
 
 #include <glib.h>
+#include <glib-unix.h>
 #include <unistd.h>
 #include <blockdev/utils.h>
 #include <string.h>
 #include <glob.h>
 #include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/major.h>
+#include <linux/raid/md_u.h>
+#include <linux/raid/md_p.h>
 #include <bs_size.h>
 
 #include "mdraid.h"
@@ -32,6 +41,15 @@
 
 #define MDADM_MIN_VERSION "3.3.2"
 
+/* the highest member number to ask the kernel about */
+#define MD_MAX_DISK_NUMBER 4096
+
+/* the maximum number of parallel jobs bd_md_activate_many() chooses */
+#define MD_ACTIVATE_MAX_JOBS 16
+
+/* how often (in ms) the monitor refreshes progress of a running sync action */
+#define MD_MONITOR_DEFAULT_INTERVAL 1000
+
 /**
  * SECTION: mdraid
  * @short_description: plugin for basic operations with MD RAID
@@ -143,6 +161,112 @@ void bd_md_detail_data_free (BDMDDetailData *data) {
     g_free (data);
 }
 
+/**
+ * bd_md_capacity_copy: (skip)
+ *
+ * Creates a new copy of @data.
+ */
+BDMDCapacity* bd_md_capacity_copy (BDMDCapacity *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDMDCapacity *new_data = g_new0 (BDMDCapacity, 1);
+
+    new_data->size = data->size;
+    new_data->member_data_size = data->member_data_size;
+    new_data->data_offset = data->data_offset;
+    new_data->metadata_size = data->metadata_size;
+    new_data->bitmap_size = data->bitmap_size;
+    new_data->parity_size = data->parity_size;
+
+    return new_data;
+}
+
+/**
+ * bd_md_capacity_free: (skip)
+ *
+ * Frees @data.
+ */
+void bd_md_capacity_free (BDMDCapacity *data) {
+    g_free (data);
+}
+
+/**
+ * bd_md_activate_result_copy: (skip)
+ *
+ * Creates a new copy of @data.
+ */
+BDMDActivateResult* bd_md_activate_result_copy (BDMDActivateResult *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDMDActivateResult *new_data = g_new0 (BDMDActivateResult, 1);
+
+    new_data->uuid = g_strdup (data->uuid);
+    new_data->device = g_strdup (data->device);
+    new_data->members = g_strdupv (data->members);
+    new_data->success = data->success;
+    new_data->error_msg = g_strdup (data->error_msg);
+    new_data->duration = data->duration;
+
+    return new_data;
+}
+
+/**
+ * bd_md_activate_result_free: (skip)
+ *
+ * Frees @data.
+ */
+void bd_md_activate_result_free (BDMDActivateResult *data) {
+    if (data == NULL)
+        return;
+
+    g_free (data->uuid);
+    g_free (data->device);
+    g_strfreev (data->members);
+    g_free (data->error_msg);
+    g_free (data);
+}
+
+/**
+ * bd_md_array_status_copy: (skip)
+ *
+ * Creates a new copy of @data.
+ */
+BDMDArrayStatus* bd_md_array_status_copy (BDMDArrayStatus *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDMDArrayStatus *new_data = g_new0 (BDMDArrayStatus, 1);
+
+    new_data->node = g_strdup (data->node);
+    new_data->array_state = g_strdup (data->array_state);
+    new_data->sync_action = g_strdup (data->sync_action);
+    new_data->degraded = data->degraded;
+    new_data->sync_completed = data->sync_completed;
+    new_data->sync_total = data->sync_total;
+    new_data->progress = data->progress;
+    new_data->speed = data->speed;
+    new_data->eta = data->eta;
+
+    return new_data;
+}
+
+/**
+ * bd_md_array_status_free: (skip)
+ *
+ * Frees @data.
+ */
+void bd_md_array_status_free (BDMDArrayStatus *data) {
+    if (data == NULL)
+        return;
+
+    g_free (data->node);
+    g_free (data->array_state);
+    g_free (data->sync_action);
+    g_free (data);
+}
+
 
 static volatile guint avail_deps = 0;
 static GMutex deps_check_lock;
@@ -156,6 +280,24 @@ static const UtilDep deps[DEPS_LAST] = {
 };
 
 
+typedef struct MDMonitor {
+    guint64 id;
+    GThread *thread;
+    gint wakeup_fds[2];
+    gint mdstat_fd;
+    guint interval;
+    BDMDMonitorFunc func;
+    gpointer user_data;
+    GDestroyNotify notify;
+} MDMonitor;
+
+static GMutex monitors_lock;
+static GHashTable *monitors = NULL;
+static guint64 last_monitor_id = 0;
+
+static void md_monitors_stop_all (void);
+
+
 /**
  * bd_md_init:
  *
@@ -176,7 +318,7 @@ gboolean bd_md_init (void) {
  *
  */
 void bd_md_close (void) {
-    /* nothing to do here */
+    md_monitors_stop_all ();
 }
 
 
@@ -499,6 +641,422 @@ static gchar* get_mdadm_spec_from_input (const gchar *input, GError **error) {
   return mdadm_spec;
 }
 
+/* Native (mdadm-less) implementation of bd_md_examine() and bd_md_detail() for
+ * the 0.90 and 1.x metadata formats. The information is taken from the MD
+ * superblocks, sysfs and the GET_ARRAY_INFO/GET_DISK_INFO ioctls. Anything
+ * else (external metadata like IMSM and DDF, inactive arrays,...) is left to
+ * mdadm. */
+
+typedef struct MDSuperblockInfo {
+    const gchar *metadata;
+    gint level;
+    guint32 layout;
+    guint64 raid_disks;
+    guint64 chunk_size;     /* bytes */
+    guint64 dev_size;       /* bytes used on every member */
+    gchar *uuid;            /* in the mdadm format */
+    gchar *dev_uuid;        /* in the mdadm format, 1.x only */
+    gchar *name;            /* 1.x only */
+    guint64 ctime;
+    guint64 utime;
+    guint64 events;
+} MDSuperblockInfo;
+
+static void md_superblock_info_free (MDSuperblockInfo *info) {
+    if (!info)
+        return;
+
+    g_free (info->uuid);
+    g_free (info->dev_uuid);
+    g_free (info->name);
+    g_free (info);
+}
+
+/* same as mdadm's personality names */
+static const gchar* md_level_name (gint level) {
+    switch (level) {
+        case -5:
+            return "faulty";
+        case -4:
+            return "multipath";
+        case -1:
+            return "linear";
+        case 0:
+            return "raid0";
+        case 1:
+            return "raid1";
+        case 4:
+            return "raid4";
+        case 5:
+            return "raid5";
+        case 6:
+            return "raid6";
+        case 10:
+            return "raid10";
+        default:
+            return NULL;
+    }
+}
+
+/* mdadm reports chunk size only for the striped levels */
+static gboolean md_level_has_chunks (gint level) {
+    return level == 0 || level == 4 || level == 5 || level == 6 || level == 10;
+}
+
+/* array size as reported by mdadm --examine (only for the redundant levels) */
+static guint64 md_array_size (gint level, guint32 layout, guint64 raid_disks, guint64 dev_size) {
+    guint64 data_disks = 0;
+    guint64 denom = 1;
+
+    switch (level) {
+        case 1:
+            data_disks = 1;
+            break;
+        case 4:
+        case 5:
+            data_disks = raid_disks - 1;
+            break;
+        case 6:
+            data_disks = raid_disks - 2;
+            break;
+        case 10:
+            /* near copies * far copies */
+            data_disks = raid_disks;
+            denom = (layout & 0xff) * ((layout >> 8) & 0xff);
+            break;
+        default:
+            return 0;
+    }
+
+    if (denom == 0)
+        return 0;
+
+    return dev_size * data_disks / denom;
+}
+
+/* formats the 16 bytes of a 1.x UUID the way mdadm does */
+static gchar* md_uuid_from_bytes (const guint8 *uuid) {
+    return g_strdup_printf ("%02x%02x%02x%02x:%02x%02x%02x%02x:%02x%02x%02x%02x:%02x%02x%02x%02x",
+                            uuid[0], uuid[1], uuid[2], uuid[3], uuid[4], uuid[5], uuid[6], uuid[7],
+                            uuid[8], uuid[9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]);
+}
+
+static guint32 md_sb1_csum (struct mdp_superblock_1 *sb) {
+    guint32 disk_csum = sb->sb_csum;
+    guint64 new_csum = 0;
+    guint32 *words = (guint32 *) sb;
+    gint size = 256 + GUINT32_FROM_LE (sb->max_dev) * 2;
+    guint32 csum = 0;
+
+    sb->sb_csum = 0;
+    for (; size >= 4; size -= 4)
+        new_csum += GUINT32_FROM_LE (*words++);
+    if (size == 2)
+        new_csum += GUINT16_FROM_LE (*((guint16 *) words));
+    sb->sb_csum = disk_csum;
+
+    csum = (new_csum & 0xffffffff) + (new_csum >> 32);
+    return GUINT32_TO_LE (csum);
+}
+
+static MDSuperblockInfo* md_parse_sb1 (guint8 *buf, guint64 offset, const gchar *metadata) {
+    struct mdp_superblock_1 *sb = (struct mdp_superblock_1 *) buf;
+    MDSuperblockInfo *info = NULL;
+    static const guint8 zero_uuid[16] = { 0 };
+
+    if (GUINT32_FROM_LE (sb->magic) != MD_SB_MAGIC || GUINT32_FROM_LE (sb->major_version) != 1)
+        return NULL;
+
+    /* the superblock has to know where it is and the checksum has to match */
+    if (GUINT64_FROM_LE (sb->super_offset) != offset / 512 ||
+        GUINT32_FROM_LE (sb->max_dev) > (MD_SB_BYTES - 256) / 2 ||
+        md_sb1_csum (sb) != sb->sb_csum)
+        return NULL;
+
+    info = g_new0 (MDSuperblockInfo, 1);
+    info->metadata = metadata;
+    info->level = (gint) GUINT32_FROM_LE (sb->level);
+    info->layout = GUINT32_FROM_LE (sb->layout);
+    info->raid_disks = GUINT32_FROM_LE (sb->raid_disks);
+    info->chunk_size = (guint64) GUINT32_FROM_LE (sb->chunksize) * 512;
+    info->dev_size = GUINT64_FROM_LE (sb->size) * 512;
+    info->uuid = md_uuid_from_bytes (sb->set_uuid);
+    if (memcmp (sb->device_uuid, zero_uuid, 16) != 0)
+        info->dev_uuid = md_uuid_from_bytes (sb->device_uuid);
+    if (sb->set_name[0] != '\0')
+        info->name = g_strndup ((const gchar *) sb->set_name, sizeof (sb->set_name));
+    /* lower 40 bits are seconds, upper 24 bits microseconds */
+    info->ctime = GUINT64_FROM_LE (sb->ctime) & 0xffffffffffULL;
+    info->utime = GUINT64_FROM_LE (sb->utime) & 0xffffffffffULL;
+    info->events = GUINT64_FROM_LE (sb->events);
+
+    return info;
+}
+
+/* same as mdadm's calc_sb0_csum() */
+static guint32 md_sb0_csum (mdp_super_t *sb) {
+    guint32 disk_csum = sb->sb_csum;
+    guint64 new_csum = 0;
+    guint32 *words = (guint32 *) sb;
+    guint i = 0;
+
+    sb->sb_csum = 0;
+    for (i = 0; i < MD_SB_BYTES / 4; i++)
+        new_csum += words[i];
+    sb->sb_csum = disk_csum;
+
+    return (new_csum & 0xffffffff) + (new_csum >> 32);
+}
+
+static MDSuperblockInfo* md_parse_sb0 (guint8 *buf) {
+    mdp_super_t *sb = (mdp_super_t *) buf;
+    MDSuperblockInfo *info = NULL;
+
+    /* 0.90 superblocks are in the host byte order */
+    if (sb->md_magic != MD_SB_MAGIC || sb->major_version != 0 || md_sb0_csum (sb) != sb->sb_csum)
+        return NULL;
+
+    info = g_new0 (MDSuperblockInfo, 1);
+    info->metadata = "0.90";
+    info->level = (gint) sb->level;
+    info->layout = sb->layout;
+    info->raid_disks = sb->raid_disks;
+    info->chunk_size = sb->chunk_size;
+    /* in KiB */
+    info->dev_size = (guint64) sb->size * 1024;
+    info->uuid = g_strdup_printf ("%08x:%08x:%08x:%08x", sb->set_uuid0, sb->set_uuid1, sb->set_uuid2, sb->set_uuid3);
+    info->ctime = sb->ctime;
+    info->utime = sb->utime;
+    info->events = ((guint64) sb->events_hi << 32) | sb->events_lo;
+
+    return info;
+}
+
+/* reads the MD superblock from @device, returns %NULL if there is no 0.90 or
+   1.x superblock (if there are multiple, the most recently created one wins
+   just like with mdadm) */
+static MDSuperblockInfo* md_read_superblock (const gchar *device) {
+    MDSuperblockInfo *ret = NULL;
+    MDSuperblockInfo *info = NULL;
+    guint8 *buf = NULL;
+    guint64 size = 0;
+    guint64 sectors = 0;
+    guint64 offsets[4] = { 0 };
+    static const gchar *versions[4] = { "1.2", "1.1", "1.0", "0.90" };
+    gint fd = -1;
+    guint i = 0;
+
+    fd = open (device, O_RDONLY|O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    if (ioctl (fd, BLKGETSIZE64, &size) != 0 || size < 64 KiB + MD_SB_BYTES) {
+        close (fd);
+        return NULL;
+    }
+    sectors = size / 512;
+
+    offsets[0] = 4 KiB;
+    offsets[1] = 0;
+    offsets[2] = ((sectors - 8 * 2) & ~((guint64) 4 * 2 - 1)) * 512;
+    offsets[3] = MD_NEW_SIZE_SECTORS (sectors) * 512;
+
+    buf = g_malloc (MD_SB_BYTES);
+    for (i = 0; i < G_N_ELEMENTS (offsets); i++) {
+        if (pread (fd, buf, MD_SB_BYTES, offsets[i]) != MD_SB_BYTES)
+            continue;
+
+        if (i < 3)
+            info = md_parse_sb1 (buf, offsets[i], versions[i]);
+        else
+            info = md_parse_sb0 (buf);
+
+        if (!info)
+            continue;
+
+        if (!ret || info->ctime > ret->ctime) {
+            md_superblock_info_free (ret);
+            ret = info;
+        } else
+            md_superblock_info_free (info);
+    }
+    g_free (buf);
+    close (fd);
+
+    return ret;
+}
+
+static BDMDExamineData* examine_native (const gchar *device) {
+    MDSuperblockInfo *info = NULL;
+    BDMDExamineData *data = NULL;
+    const gchar *level = NULL;
+    const gchar *name = NULL;
+
+    info = md_read_superblock (device);
+    if (!info)
+        return NULL;
+
+    level = md_level_name (info->level);
+    if (!level) {
+        md_superblock_info_free (info);
+        return NULL;
+    }
+
+    data = g_new0 (BDMDExamineData, 1);
+    data->level = g_strdup (level);
+    data->num_devices = info->raid_disks;
+    data->name = g_strdup (info->name);
+    data->size = md_array_size (info->level, info->layout, info->raid_disks, info->dev_size);
+    data->uuid = bd_md_canonicalize_uuid (info->uuid, NULL);
+    data->update_time = info->utime;
+    if (info->dev_uuid)
+        data->dev_uuid = bd_md_canonicalize_uuid (info->dev_uuid, NULL);
+    data->events = info->events;
+    data->metadata = g_strdup (info->metadata);
+    if (md_level_has_chunks (info->level))
+        data->chunk_size = info->chunk_size;
+
+    /* the same device mdadm --examine --brief reports (host part of the name
+       is not part of the device name) */
+    if (info->name) {
+        name = strchr (info->name, ':');
+        data->device = g_strdup_printf ("/dev/md/%s", name ? name + 1 : info->name);
+    }
+
+    md_superblock_info_free (info);
+    return data;
+}
+
+static gchar* read_md_sysfs_attr (const gchar *node, const gchar *attr) {
+    g_autofree gchar *path = NULL;
+    gchar *contents = NULL;
+
+    path = g_strdup_printf ("/sys/class/block/%s/%s", node, attr);
+    if (!g_file_get_contents (path, &contents, NULL, NULL))
+        return NULL;
+
+    return g_strstrip (contents);
+}
+
+static BDMDDetailData* detail_native (const gchar *raid_spec, const gchar *mdadm_spec) {
+    g_autofree gchar *node = NULL;
+    g_autofree gchar *metadata = NULL;
+    g_autofree gchar *level = NULL;
+    g_autofree gchar *value = NULL;
+    g_autofree gchar *member = NULL;
+    MDSuperblockInfo *info = NULL;
+    BDMDDetailData *data = NULL;
+    mdu_array_info_t array;
+    mdu_disk_info_t disk;
+    gint fd = -1;
+    gint number = 0;
+    gint found = 0;
+    time_t ctime_val = 0;
+    struct tm tm;
+    char time_str[64];
+    gboolean syncing = FALSE;
+
+    node = get_sysfs_name_from_input (raid_spec, NULL);
+    if (!node)
+        return NULL;
+
+    /* external metadata (containers and their members) is left to mdadm */
+    metadata = read_md_sysfs_attr (node, "md/metadata_version");
+    if (!metadata || g_str_has_prefix (metadata, "external:") || g_strcmp0 (metadata, "none") == 0)
+        return NULL;
+
+    fd = open (mdadm_spec, O_RDONLY|O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    /* fails for inactive arrays */
+    memset (&array, 0, sizeof (array));
+    if (ioctl (fd, GET_ARRAY_INFO, &array) != 0) {
+        close (fd);
+        return NULL;
+    }
+
+    /* the first working member to get name and UUID from */
+    for (number = 0; found < array.nr_disks && number < MD_MAX_DISK_NUMBER; number++) {
+        memset (&disk, 0, sizeof (disk));
+        disk.number = number;
+        if (ioctl (fd, GET_DISK_INFO, &disk) != 0)
+            break;
+        if (disk.major == 0 && disk.minor == 0)
+            continue;
+        found++;
+        if (!(disk.state & (1 << MD_DISK_FAULTY)) && !(disk.state & (1 << MD_DISK_REMOVED))) {
+            member = g_strdup_printf ("/dev/block/%d:%d", disk.major, disk.minor);
+            break;
+        }
+    }
+    close (fd);
+
+    if (!member)
+        return NULL;
+
+    info = md_read_superblock (member);
+    if (!info)
+        return NULL;
+
+    level = read_md_sysfs_attr (node, "md/level");
+    if (!level) {
+        md_superblock_info_free (info);
+        return NULL;
+    }
+
+    data = g_new0 (BDMDDetailData, 1);
+    data->device = g_strdup (mdadm_spec);
+    data->metadata = g_steal_pointer (&metadata);
+    data->level = g_steal_pointer (&level);
+    data->name = g_strdup (info->name);
+    data->uuid = bd_md_canonicalize_uuid (info->uuid, NULL);
+
+    if (array.ctime) {
+        ctime_val = array.ctime;
+        localtime_r (&ctime_val, &tm);
+        strftime (time_str, sizeof (time_str), "%a %b %e %H:%M:%S %Y", &tm);
+        data->creation_time = g_strdup (time_str);
+    }
+
+    /* sizes are in KiB just like in mdadm --detail output */
+    value = read_md_sysfs_attr (node, "size");
+    if (value)
+        data->array_size = g_ascii_strtoull (value, NULL, 10) / 2;
+    g_free (value);
+    value = NULL;
+    if (array.level >= 1) {
+        value = read_md_sysfs_attr (node, "md/component_size");
+        if (value)
+            data->use_dev_size = g_ascii_strtoull (value, NULL, 10);
+        g_free (value);
+        value = NULL;
+    }
+
+    data->raid_devices = array.raid_disks;
+    data->total_devices = array.nr_disks;
+    data->active_devices = array.active_disks;
+    data->working_devices = array.working_disks;
+    data->failed_devices = array.failed_disks;
+    data->spare_devices = array.spare_disks;
+
+    /* mdadm only reports "clean" for non-degraded arrays with no sync running */
+    value = read_md_sysfs_attr (node, "md/sync_action");
+    syncing = value && g_strcmp0 (value, "idle") != 0 && g_strcmp0 (value, "frozen") != 0;
+    g_free (value);
+    value = NULL;
+    data->clean = (array.state & (1 << MD_SB_CLEAN)) && !syncing && data->array_size > 0 &&
+                  array.active_disks >= array.raid_disks;
+    if (data->clean && (array.level == 0 || array.level == -1)) {
+        /* mdadm uses the real array state for these */
+        value = read_md_sysfs_attr (node, "md/array_state");
+        data->clean = g_strcmp0 (value, "clean") == 0;
+    }
+
+    md_superblock_info_free (info);
+    return data;
+}
+
 /**
  * bd_md_get_superblock_size:
  * @member_size: size of an array member
@@ -531,6 +1089,166 @@ guint64 bd_md_get_superblock_size (guint64 member_size, const gchar *version, GE
     return headroom;
 }
 
+/* space (in bytes) mdadm reserves for an internal bitmap next to a v1.x superblock */
+static guint64 md_bitmap_space (guint64 member_size) {
+    if (member_size < (64 KiB))
+        return 0;
+    if (member_size - (64 KiB) >= (200 GiB))
+        return 128 KiB;
+    if (member_size - (4 KiB) > (8 GiB))
+        return 64 KiB;
+    return 4 KiB;
+}
+
+/* RAID level as a number or -1 if unknown/unsupported */
+static gint md_level_from_str (const gchar *level) {
+    if (!level)
+        return -1;
+    if (g_ascii_strncasecmp (level, "raid", 4) == 0)
+        level += 4;
+
+    if (g_strcmp0 (level, "0") == 0 || g_ascii_strcasecmp (level, "stripe") == 0)
+        return 0;
+    else if (g_strcmp0 (level, "1") == 0 || g_ascii_strcasecmp (level, "mirror") == 0)
+        return 1;
+    else if (g_strcmp0 (level, "4") == 0)
+        return 4;
+    else if (g_strcmp0 (level, "5") == 0)
+        return 5;
+    else if (g_strcmp0 (level, "6") == 0)
+        return 6;
+    else if (g_strcmp0 (level, "10") == 0)
+        return 10;
+
+    return -1;
+}
+
+/**
+ * bd_md_plan_capacity:
+ * @level: RAID level (raid0, raid1, raid4, raid5, raid6 or raid10)
+ * @member_sizes: (array length=num_members): sizes of the (active) member devices
+ * @num_members: number of member devices
+ * @version: (nullable): metadata version or %NULL to use the current default version
+ * @chunk_size: chunk size of the array or 0 to use the default (%BD_MD_CHUNK_SIZE)
+ * @bitmap: whether the array will have an internal write-intent bitmap
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Computes capacity of an MD RAID with the given parameters created from
+ * devices of the given sizes without touching any device. The reservations for
+ * the superblock, the internal bitmap and the reshape headroom follow the
+ * defaults mdadm uses, the space used on every member is given by the smallest
+ * of @member_sizes and it is rounded down to a multiple of @chunk_size (64 KiB
+ * for RAID1). RAID10 is expected to use the default layout with two near
+ * copies.
+ *
+ * Returns: (transfer full): capacity information for the RAID or %NULL in case of error
+ *
+ * Tech category: always available
+ */
+BDMDCapacity* bd_md_plan_capacity (const gchar *level, const guint64 *member_sizes, gsize num_members, const gchar *version, guint64 chunk_size, gboolean bitmap, GError **error) {
+    BDMDCapacity *ret = NULL;
+    guint64 member_size = G_MAXUINT64;
+    guint64 data_offset = 0;
+    guint64 end_reserved = 0;
+    guint64 bitmap_size = 0;
+    guint64 data_size = 0;
+    guint64 sb_start = 0;
+    gsize min_members = 0;
+    gint level_num = 0;
+    gsize i = 0;
+
+    level_num = md_level_from_str (level);
+    if (level_num < 0) {
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "Unsupported RAID level '%s'", level ? level : "(null)");
+        return NULL;
+    }
+
+    switch (level_num) {
+        case 0:
+        case 1:
+            min_members = 1;
+            break;
+        case 6:
+            min_members = 4;
+            break;
+        default:
+            min_members = 2;
+    }
+    if (num_members < min_members) {
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "At least %"G_GSIZE_FORMAT" member devices are needed for %s",
+                     min_members, level);
+        return NULL;
+    }
+
+    for (i = 0; i < num_members; i++)
+        member_size = MIN (member_size, member_sizes[i]);
+
+    if (chunk_size == 0)
+        chunk_size = BD_MD_CHUNK_SIZE;
+    if (level_num == 1)
+        chunk_size = 64 KiB;
+
+    if (bitmap)
+        bitmap_size = md_bitmap_space (member_size);
+
+    if (!version || g_strcmp0 (version, "default") == 0 ||
+        g_strcmp0 (version, "1.1") == 0 || g_strcmp0 (version, "1.2") == 0) {
+        /* superblock (at the start or 4 KiB from it), bitmap and reshape
+           headroom all fit into the space before the data */
+        data_offset = bd_md_get_superblock_size (member_size, version, NULL);
+        if (data_offset < (4 KiB) + (4 KiB) + bitmap_size)
+            data_offset = (4 KiB) + (4 KiB) + bitmap_size;
+    } else if (g_strcmp0 (version, "1.0") == 0) {
+        /* superblock at least 8 KiB from the end aligned to 4 KiB, bitmap before it */
+        if (member_size >= (8 KiB))
+            end_reserved = member_size - ((member_size - (8 KiB)) & ~((guint64) (4 KiB) - 1));
+        end_reserved += bitmap_size;
+    } else if (g_strcmp0 (version, "0.90") == 0 || g_strcmp0 (version, "0.9") == 0) {
+        /* superblock in the last 64 KiB aligned block, bitmap inside the reserved space */
+        sb_start = member_size & ~((guint64) (64 KiB) - 1);
+        end_reserved = sb_start >= (64 KiB) ? member_size - (sb_start - (64 KiB)) : member_size;
+    } else {
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "Unsupported metadata version '%s'", version);
+        return NULL;
+    }
+
+    if (member_size > data_offset + end_reserved)
+        data_size = member_size - data_offset - end_reserved;
+    data_size -= data_size % chunk_size;
+
+    ret = g_new0 (BDMDCapacity, 1);
+    ret->member_data_size = data_size;
+    ret->data_offset = data_offset;
+    ret->metadata_size = member_size - data_size;
+    ret->bitmap_size = bitmap_size;
+
+    switch (level_num) {
+        case 0:
+            ret->size = data_size * num_members;
+            break;
+        case 1:
+            ret->size = data_size;
+            break;
+        case 4:
+        case 5:
+            ret->size = data_size * (num_members - 1);
+            break;
+        case 6:
+            ret->size = data_size * (num_members - 2);
+            break;
+        case 10:
+            /* two copies of every chunk */
+            ret->size = ((data_size / chunk_size) * num_members / 2) * chunk_size;
+            break;
+    }
+    ret->parity_size = data_size * num_members - ret->size;
+
+    return ret;
+}
+
 /**
  * bd_md_create:
  * @device_name: name of the device to create
@@ -743,6 +1461,142 @@ gboolean bd_md_activate (const gchar *raid_spec, const gchar **members, const gc
     return ret;
 }
 
+typedef struct MDActivateJob {
+    const gchar **devices;
+    BDMDExamineData **examined;
+    guint n_devices;
+    BDMDActivateResult **results;
+    guint n_results;
+    gboolean start_degraded;
+} MDActivateJob;
+
+static gboolean examine_task (guint i, gpointer data) {
+    MDActivateJob *job = (MDActivateJob *) data;
+
+    /* devices that are not MD members are simply skipped */
+    job->examined[i] = bd_md_examine (job->devices[i], NULL);
+
+    return TRUE;
+}
+
+static gboolean activate_task (guint i, gpointer data) {
+    MDActivateJob *job = (MDActivateJob *) data;
+    BDMDActivateResult *result = job->results[i];
+    g_autofree gchar *md_uuid = NULL;
+    gint64 start = 0;
+    GError *l_error = NULL;
+
+    start = g_get_monotonic_time ();
+
+    md_uuid = bd_md_get_md_uuid (result->uuid, &l_error);
+    if (md_uuid)
+        result->success = bd_md_activate (result->device, (const gchar **) result->members, md_uuid,
+                                          job->start_degraded, NULL, &l_error);
+    if (!result->success) {
+        result->error_msg = g_strdup (l_error ? l_error->message : "Unknown error");
+        g_clear_error (&l_error);
+    }
+
+    result->duration = g_get_monotonic_time () - start;
+
+    return TRUE;
+}
+
+/**
+ * bd_md_activate_many:
+ * @devices: (array zero-terminated=1): candidate member devices
+ * @start_degraded: whether to start the arrays even if they are degraded
+ * @max_jobs: maximum number of devices examined and arrays activated in parallel (0 to choose automatically)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Activates all the MD RAIDs the @devices are members of. All the @devices are
+ * examined first (in parallel), devices that are not MD RAID members are
+ * skipped and the rest is grouped by the array UUID. The arrays are then
+ * activated in parallel, each of them only from its own members. Arrays that
+ * are already active are reported as successfully activated.
+ *
+ * Failure to activate an array doesn't affect activation of the other arrays,
+ * it is only reported in the array's #BDMDActivateResult.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): results of activation of
+ * the arrays found on @devices (in the order of their first member in @devices)
+ * or %NULL in case of error
+ *
+ * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_MODIFY
+ */
+BDMDActivateResult** bd_md_activate_many (const gchar **devices, gboolean start_degraded, guint max_jobs, GError **error) {
+    MDActivateJob job = { 0 };
+    GHashTable *arrays = NULL;
+    GPtrArray *results = NULL;
+    GPtrArray *all_members = NULL;
+    GPtrArray *members = NULL;
+    BDMDActivateResult *result = NULL;
+    BDMDExamineData *ex_data = NULL;
+    gpointer idx = NULL;
+    guint i = 0;
+
+    if (!check_deps (&avail_deps, DEPS_MDADM_MASK, deps, DEPS_LAST, &deps_check_lock, error))
+        return NULL;
+
+    if (max_jobs == 0)
+        max_jobs = MIN (g_get_num_processors (), MD_ACTIVATE_MAX_JOBS);
+
+    job.devices = devices;
+    job.n_devices = devices ? g_strv_length ((gchar **) devices) : 0;
+    job.examined = g_new0 (BDMDExamineData *, job.n_devices);
+    job.start_degraded = start_degraded;
+
+    bd_utils_run_parallel ("bd-md-examine", job.n_devices, max_jobs, examine_task, &job);
+
+    /* UUID -> index of the array in results */
+    arrays = g_hash_table_new (g_str_hash, g_str_equal);
+    results = g_ptr_array_new ();
+    all_members = g_ptr_array_new_with_free_func ((GDestroyNotify) g_ptr_array_unref);
+    for (i = 0; i < job.n_devices; i++) {
+        ex_data = job.examined[i];
+        if (!ex_data || !ex_data->uuid)
+            continue;
+
+        if (!g_hash_table_lookup_extended (arrays, ex_data->uuid, NULL, &idx)) {
+            result = g_new0 (BDMDActivateResult, 1);
+            result->uuid = g_strdup (ex_data->uuid);
+            idx = GUINT_TO_POINTER (results->len);
+            g_ptr_array_add (results, result);
+            g_ptr_array_add (all_members, g_ptr_array_new ());
+            g_hash_table_insert (arrays, result->uuid, idx);
+        }
+        result = g_ptr_array_index (results, GPOINTER_TO_UINT (idx));
+        members = g_ptr_array_index (all_members, GPOINTER_TO_UINT (idx));
+        g_ptr_array_add (members, (gpointer) devices[i]);
+        if (!result->device && ex_data->device)
+            result->device = g_strdup (ex_data->device);
+    }
+
+    for (i = 0; i < results->len; i++) {
+        result = g_ptr_array_index (results, i);
+        members = g_ptr_array_index (all_members, i);
+        g_ptr_array_add (members, NULL);
+        result->members = g_strdupv ((gchar **) members->pdata);
+        if (!result->device)
+            /* arrays without a name (e.g. with the 0.90 metadata) need one,
+               mdadm would ignore the members without it */
+            result->device = g_strdup_printf ("/dev/md/%.8s", result->uuid);
+    }
+    g_ptr_array_free (all_members, TRUE);
+    g_hash_table_destroy (arrays);
+
+    for (i = 0; i < job.n_devices; i++)
+        bd_md_examine_data_free (job.examined[i]);
+    g_free (job.examined);
+
+    job.n_results = results->len;
+    job.results = (BDMDActivateResult **) results->pdata;
+    bd_utils_run_parallel ("bd-md-activate", job.n_results, max_jobs, activate_task, &job);
+
+    g_ptr_array_add (results, NULL);
+    return (BDMDActivateResult **) g_ptr_array_free (results, FALSE);
+}
+
 /**
  * bd_md_run:
  * @raid_spec: specification of the (possibly degraded) RAID device (name, node or path) to be started
@@ -931,6 +1785,9 @@ gboolean bd_md_remove (const gchar *raid_spec, const gchar *device, gboolean fai
  *
  * Returns: information about the MD RAID extracted from the @device
  *
+ * Note: The 0.90 and 1.x superblocks are read directly from @device, mdadm is
+ *       only used for the other metadata formats (e.g. IMSM or DDF).
+ *
  * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_QUERY
  */
 BDMDExamineData* bd_md_examine (const gchar *device, GError **error) {
@@ -946,6 +1803,10 @@ BDMDExamineData* bd_md_examine (const gchar *device, GError **error) {
     guint i = 0;
     gboolean found_array_line = FALSE;
 
+    ret = examine_native (device);
+    if (ret)
+        return ret;
+
     if (!check_deps (&avail_deps, DEPS_MDADM_MASK, deps, DEPS_LAST, &deps_check_lock, error))
         return NULL;
 
@@ -1082,6 +1943,10 @@ BDMDExamineData* bd_md_examine (const gchar *device, GError **error) {
  *
  * Returns: information about the MD RAID @raid_spec
  *
+ * Note: Running arrays with the 0.90 or 1.x metadata are queried using sysfs
+ *       and ioctl() calls directly, mdadm is only used for the other arrays
+ *       (e.g. IMSM or DDF containers and their members).
+ *
  * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_QUERY
  */
 BDMDDetailData* bd_md_detail (const gchar *raid_spec, GError **error) {
@@ -1097,14 +1962,18 @@ BDMDDetailData* bd_md_detail (const gchar *raid_spec, GError **error) {
     guint i = 0;
     BDMDDetailData *ret = NULL;
 
-    if (!check_deps (&avail_deps, DEPS_MDADM_MASK, deps, DEPS_LAST, &deps_check_lock, error))
-        return NULL;
-
     mdadm_spec = get_mdadm_spec_from_input (raid_spec, error);
     if (!mdadm_spec)
         /* error is already populated */
         return NULL;
 
+    ret = detail_native (raid_spec, mdadm_spec);
+    if (ret)
+        return ret;
+
+    if (!check_deps (&avail_deps, DEPS_MDADM_MASK, deps, DEPS_LAST, &deps_check_lock, error))
+        return NULL;
+
     argv[2] = mdadm_spec;
 
     success = bd_utils_exec_and_capture_output (argv, NULL, &output, error);
@@ -1172,6 +2041,56 @@ BDMDDetailData* bd_md_detail (const gchar *raid_spec, GError **error) {
     return ret;
 }
 
+/* 'x' stands for a (lowercase) hex digit, anything else has to match exactly */
+#define MD_UUID_LAYOUT        "xxxxxxxx:xxxxxxxx:xxxxxxxx:xxxxxxxx"
+#define CANONICAL_UUID_LAYOUT "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx"
+#define UUID_HEX_DIGITS 32
+
+static const gboolean uuid_hex_chars[256] = {
+    ['0'] = TRUE, ['1'] = TRUE, ['2'] = TRUE, ['3'] = TRUE, ['4'] = TRUE,
+    ['5'] = TRUE, ['6'] = TRUE, ['7'] = TRUE, ['8'] = TRUE, ['9'] = TRUE,
+    ['a'] = TRUE, ['b'] = TRUE, ['c'] = TRUE, ['d'] = TRUE, ['e'] = TRUE, ['f'] = TRUE,
+};
+
+/* converts @uuid between the MD and canonical forms by validating it against
+   @in_layout and putting its hex digits into @out_layout (both layouts have the
+   same number of hex digits) */
+static gchar* convert_uuid (const gchar *uuid, const gchar *in_layout, const gchar *out_layout, GError **error) {
+    gchar digits[UUID_HEX_DIGITS];
+    const gchar *in_p = uuid;
+    const gchar *layout_p = NULL;
+    gchar *ret = NULL;
+    gchar *out_p = NULL;
+    guint n_digits = 0;
+
+    if (!uuid)
+        goto bad_format;
+
+    for (layout_p = in_layout; *layout_p; layout_p++, in_p++) {
+        if (*layout_p == 'x') {
+            if (!uuid_hex_chars[(guchar) *in_p])
+                goto bad_format;
+            digits[n_digits++] = *in_p;
+        } else if (*in_p != *layout_p)
+            goto bad_format;
+    }
+    if (*in_p != '\0')
+        goto bad_format;
+
+    ret = g_new (gchar, strlen (out_layout) + 1);
+    n_digits = 0;
+    for (layout_p = out_layout, out_p = ret; *layout_p; layout_p++, out_p++)
+        *out_p = (*layout_p == 'x') ? digits[n_digits++] : *layout_p;
+    *out_p = '\0';
+
+    return ret;
+
+ bad_format:
+    g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_BAD_FORMAT,
+                 "malformed or invalid UUID: %s", uuid);
+    return NULL;
+}
+
 /**
  * bd_md_canonicalize_uuid:
  * @uuid: UUID to canonicalize
@@ -1181,68 +2100,25 @@ BDMDDetailData* bd_md_detail (const gchar *raid_spec, GError **error) {
  *
  * This function expects a UUID in the form that mdadm returns. The change is as
  * follows: 3386ff85:f5012621:4a435f06:1eb47236 -> 3386ff85-f501-2621-4a43-5f061eb47236
+ * A trailing note in parentheses (e.g. "(local to host foo)") is ignored.
  *
  * Tech category: always available
  */
 gchar* bd_md_canonicalize_uuid (const gchar *uuid, GError **error) {
-    const gchar *next_set = uuid;
-    gchar *ret = g_new0 (gchar, 37);
-    gchar *dest = ret;
-    GRegex *regex = NULL;
-
-    regex = g_regex_new ("[0-9a-f]{8}:[0-9a-f]{8}:[0-9a-f]{8}:[0-9a-f]{8}", 0, 0, error);
-    if (!regex) {
-        /* error is already populated */
-        g_free (ret);
-        return NULL;
-    }
+    const gchar *note = NULL;
+    gchar *stripped = NULL;
+    gchar *ret = NULL;
 
-    if (!g_regex_match (regex, uuid, 0, NULL)) {
-        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_BAD_FORMAT,
-                     "malformed or invalid UUID: %s", uuid);
-        g_regex_unref (regex);
-        g_free (ret);
-        return NULL;
+    /* mdadm may append a note to the UUID, e.g. "(local to host foo)" */
+    note = uuid ? strstr (uuid, " (") : NULL;
+    if (note && g_str_has_suffix (note, ")")) {
+        stripped = g_strndup (uuid, note - uuid);
+        ret = convert_uuid (stripped, MD_UUID_LAYOUT, CANONICAL_UUID_LAYOUT, error);
+        g_free (stripped);
+        return ret;
     }
-    g_regex_unref (regex);
-
-    /* first 8 symbols */
-    memcpy (dest, next_set, 8);
-    next_set += 9;
-    dest += 8;
-    *dest = '-';
-    dest++;
-
-    /* 4 symbols from the second 8 */
-    memcpy (dest, next_set, 4);
-    next_set += 4;
-    dest += 4;
-    *dest = '-';
-    dest++;
-
-    /* 4 symbols from the second 8 */
-    memcpy (dest, next_set, 4);
-    next_set += 5;
-    dest += 4;
-    *dest = '-';
-    dest++;
-
-    /* 4 symbols from the third 8 */
-    memcpy (dest, next_set, 4);
-    next_set += 4;
-    dest += 4;
-    *dest = '-';
-    dest++;
-
-    /* 4 symbols from the third 8 with no trailing - */
-    memcpy (dest, next_set, 4);
-    next_set += 5;
-    dest += 4;
-
-    /* 9 symbols (8 + \0) from the fourth 8 */
-    memcpy (dest, next_set, 9);
 
-    return ret;
+    return convert_uuid (uuid, MD_UUID_LAYOUT, CANONICAL_UUID_LAYOUT, error);
 }
 
 /**
@@ -1260,62 +2136,7 @@ gchar* bd_md_canonicalize_uuid (const gchar *uuid, GError **error) {
  * Tech category: always available
  */
 gchar* bd_md_get_md_uuid (const gchar *uuid, GError **error) {
-    const gchar *next_set = uuid;
-    gchar *ret = g_new0 (gchar, 37);
-    gchar *dest = ret;
-    GRegex *regex = NULL;
-
-    regex = g_regex_new ("[0-9a-f]{8}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{4}-[0-9a-f]{12}", 0, 0, error);
-    if (!regex) {
-        /* error is already populated */
-        g_free (ret);
-        return NULL;
-    }
-
-    if (!g_regex_match (regex, uuid, 0, NULL)) {
-        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_BAD_FORMAT,
-                     "malformed or invalid UUID: %s", uuid);
-        g_regex_unref (regex);
-        g_free (ret);
-        return NULL;
-    }
-    g_regex_unref (regex);
-
-    /* first 8 symbols */
-    memcpy (dest, next_set, 8);
-    next_set += 9;
-    dest += 8;
-    *dest = ':';
-    dest++;
-
-    /* 4 symbols from the 4 */
-    memcpy (dest, next_set, 4);
-    next_set += 5;
-    dest += 4;
-
-    /* 4 symbols from the second 4 plus :*/
-    memcpy (dest, next_set, 4);
-    next_set += 5;
-    dest += 4;
-    *dest = ':';
-    dest++;
-
-    /* 4 symbols from the third 4 */
-    memcpy (dest, next_set, 4);
-    next_set += 5;
-    dest += 4;
-
-    /* 4 symbols from the 12 */
-    memcpy (dest, next_set, 4);
-    next_set += 4;
-    dest += 4;
-    *dest = ':';
-    dest++;
-
-    /* 9 symbols (8 + \0) from the 12 */
-    memcpy (dest, next_set, 9);
-
-    return ret;
+    return convert_uuid (uuid, CANONICAL_UUID_LAYOUT, MD_UUID_LAYOUT, error);
 }
 
 /**
@@ -1543,3 +2364,454 @@ gboolean bd_md_request_sync_action (const gchar *raid_spec, const gchar *action,
 
     return TRUE;
 }
+
+static guint64 parse_sysfs_number (const gchar *value) {
+    if (!value)
+        return 0;
+
+    while (g_ascii_isspace (*value))
+        value++;
+    if (!g_ascii_isdigit (*value))
+        return 0;
+
+    return g_ascii_strtoull (value, NULL, 10);
+}
+
+static BDMDArrayStatus* array_status_new (const gchar *node, const gchar *array_state, const gchar *degraded,
+                                          const gchar *sync_action, const gchar *sync_completed, const gchar *sync_speed) {
+    BDMDArrayStatus *status = g_new0 (BDMDArrayStatus, 1);
+    const gchar *slash = NULL;
+    guint64 done = 0;
+    guint64 total = 0;
+
+    status->node = g_strdup (node);
+    status->array_state = g_strdup (array_state);
+    status->sync_action = g_strdup (sync_action);
+    status->degraded = parse_sysfs_number (degraded);
+
+    /* "<done> / <total>" in sectors or "none" (or "delayed") if no sync action is running */
+    if (sync_completed) {
+        slash = strchr (sync_completed, '/');
+        if (slash) {
+            done = parse_sysfs_number (sync_completed);
+            total = parse_sysfs_number (slash + 1);
+        }
+    }
+    if (total > 0 && g_strcmp0 (sync_action, "idle") != 0) {
+        status->sync_completed = done * 512;
+        status->sync_total = total * 512;
+        status->progress = (done * 100.0) / total;
+
+        /* sync_speed is in KiB/s ("none" if not running) */
+        status->speed = parse_sysfs_number (sync_speed) * 1024;
+        if (status->speed > 0 && total > done)
+            status->eta = ((total - done) * 512) / status->speed;
+    }
+
+    return status;
+}
+
+static gint compare_nodes (gconstpointer a, gconstpointer b) {
+    return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+static GPtrArray* list_md_nodes (GError **error) {
+    GDir *dir = NULL;
+    const gchar *name = NULL;
+    g_autofree gchar *md_dir = NULL;
+    GPtrArray *nodes = NULL;
+
+    dir = g_dir_open ("/sys/block", 0, error);
+    if (!dir) {
+        g_prefix_error (error, "Failed to list block devices: ");
+        return NULL;
+    }
+
+    nodes = g_ptr_array_new_with_free_func (g_free);
+    while ((name = g_dir_read_name (dir))) {
+        if (!g_str_has_prefix (name, "md"))
+            continue;
+        md_dir = g_strdup_printf ("/sys/block/%s/md", name);
+        if (g_file_test (md_dir, G_FILE_TEST_IS_DIR))
+            g_ptr_array_add (nodes, g_strdup (name));
+        g_clear_pointer (&md_dir, g_free);
+    }
+    g_dir_close (dir);
+
+    g_ptr_array_sort (nodes, compare_nodes);
+    return nodes;
+}
+
+/**
+ * bd_md_get_array_statuses:
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full) (array zero-terminated=1): status of all the MD
+ * arrays in the system (including progress of the sync actions running on
+ * them) or %NULL in case of error
+ *
+ * All the information is read from sysfs, no external tool is run.
+ *
+ * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_QUERY
+ */
+BDMDArrayStatus** bd_md_get_array_statuses (GError **error) {
+    GPtrArray *nodes = NULL;
+    GPtrArray *ret = NULL;
+    const gchar *node = NULL;
+    guint i = 0;
+
+    nodes = list_md_nodes (error);
+    if (!nodes)
+        /* error is already populated */
+        return NULL;
+
+    ret = g_ptr_array_new ();
+    for (i = 0; i < nodes->len; i++) {
+        g_autofree gchar *array_state = NULL;
+        g_autofree gchar *degraded = NULL;
+        g_autofree gchar *sync_action = NULL;
+        g_autofree gchar *sync_completed = NULL;
+        g_autofree gchar *sync_speed = NULL;
+
+        node = g_ptr_array_index (nodes, i);
+        array_state = read_md_sysfs_attr (node, "md/array_state");
+        degraded = read_md_sysfs_attr (node, "md/degraded");
+        sync_action = read_md_sysfs_attr (node, "md/sync_action");
+        sync_completed = read_md_sysfs_attr (node, "md/sync_completed");
+        sync_speed = read_md_sysfs_attr (node, "md/sync_speed");
+        g_ptr_array_add (ret, array_status_new (node, array_state, degraded, sync_action, sync_completed, sync_speed));
+    }
+    g_ptr_array_add (ret, NULL);
+    g_ptr_array_free (nodes, TRUE);
+
+    return (BDMDArrayStatus **) g_ptr_array_free (ret, FALSE);
+}
+
+/* attributes the kernel calls sysfs_notify() on, in the order used in MDMonitoredArray */
+static const gchar * const monitored_attrs[] = {"md/array_state", "md/degraded", "md/sync_action", "md/sync_completed"};
+#define MD_MONITORED_ATTRS G_N_ELEMENTS (monitored_attrs)
+
+typedef struct MDMonitoredArray {
+    gchar *node;
+    gint fds[MD_MONITORED_ATTRS];
+} MDMonitoredArray;
+
+static void monitored_array_free (MDMonitoredArray *array) {
+    guint i = 0;
+
+    for (i = 0; i < MD_MONITORED_ATTRS; i++)
+        if (array->fds[i] >= 0)
+            close (array->fds[i]);
+    g_free (array->node);
+    g_free (array);
+}
+
+static GPtrArray* open_monitored_arrays (void) {
+    GPtrArray *nodes = NULL;
+    GPtrArray *arrays = NULL;
+    MDMonitoredArray *array = NULL;
+    guint i = 0;
+    guint j = 0;
+
+    arrays = g_ptr_array_new_with_free_func ((GDestroyNotify) monitored_array_free);
+    nodes = list_md_nodes (NULL);
+    if (!nodes)
+        return arrays;
+
+    for (i = 0; i < nodes->len; i++) {
+        array = g_new0 (MDMonitoredArray, 1);
+        array->node = g_strdup (g_ptr_array_index (nodes, i));
+        for (j = 0; j < MD_MONITORED_ATTRS; j++) {
+            g_autofree gchar *path = g_strdup_printf ("/sys/block/%s/%s", array->node, monitored_attrs[j]);
+            array->fds[j] = open (path, O_RDONLY|O_CLOEXEC);
+        }
+        g_ptr_array_add (arrays, array);
+    }
+    g_ptr_array_free (nodes, TRUE);
+
+    return arrays;
+}
+
+/* reading the attribute through the polled file descriptor also re-arms the notification */
+static gchar* read_attr_fd (gint fd) {
+    gchar buf[256];
+    ssize_t len = 0;
+
+    if (fd < 0 || lseek (fd, 0, SEEK_SET) < 0)
+        return NULL;
+
+    len = read (fd, buf, sizeof (buf) - 1);
+    if (len < 0)
+        return NULL;
+    buf[len] = '\0';
+
+    return g_strstrip (g_strdup (buf));
+}
+
+static void drain_fd (gint fd) {
+    gchar buf[4096];
+
+    if (lseek (fd, 0, SEEK_SET) < 0)
+        return;
+    while (read (fd, buf, sizeof (buf)) > 0)
+        ;
+}
+
+static gboolean statuses_equal (BDMDArrayStatus **a, BDMDArrayStatus **b) {
+    if (!a || !b)
+        return FALSE;
+
+    for (; *a && *b; a++, b++)
+        if (g_strcmp0 ((*a)->node, (*b)->node) != 0 ||
+            g_strcmp0 ((*a)->array_state, (*b)->array_state) != 0 ||
+            g_strcmp0 ((*a)->sync_action, (*b)->sync_action) != 0 ||
+            (*a)->degraded != (*b)->degraded ||
+            (*a)->sync_completed != (*b)->sync_completed ||
+            (*a)->sync_total != (*b)->sync_total)
+            return FALSE;
+
+    return !*a && !*b;
+}
+
+static void free_statuses (BDMDArrayStatus **statuses) {
+    BDMDArrayStatus **status_p = NULL;
+
+    if (!statuses)
+        return;
+
+    for (status_p = statuses; *status_p; status_p++)
+        bd_md_array_status_free (*status_p);
+    g_free (statuses);
+}
+
+static gpointer monitor_thread (gpointer data) {
+    MDMonitor *monitor = (MDMonitor *) data;
+    GPtrArray *arrays = NULL;
+    MDMonitoredArray *array = NULL;
+    BDMDArrayStatus **statuses = NULL;
+    BDMDArrayStatus **prev_statuses = NULL;
+    struct pollfd *fds = NULL;
+    guint n_fds = 0;
+    guint i = 0;
+    guint j = 0;
+    gboolean rescan = TRUE;
+    gboolean syncing = FALSE;
+    gint ret = 0;
+
+    while (TRUE) {
+        if (rescan) {
+            /* arrays were started or stopped (or something else changed),
+               reading /proc/mdstat makes it pollable again */
+            drain_fd (monitor->mdstat_fd);
+            if (arrays)
+                g_ptr_array_free (arrays, TRUE);
+            arrays = open_monitored_arrays ();
+            rescan = FALSE;
+        }
+
+        syncing = FALSE;
+        statuses = g_new0 (BDMDArrayStatus*, arrays->len + 1);
+        for (i = 0; i < arrays->len; i++) {
+            gchar *values[MD_MONITORED_ATTRS] = {NULL};
+            g_autofree gchar *sync_speed = NULL;
+
+            array = g_ptr_array_index (arrays, i);
+            for (j = 0; j < MD_MONITORED_ATTRS; j++)
+                values[j] = read_attr_fd (array->fds[j]);
+            sync_speed = read_md_sysfs_attr (array->node, "md/sync_speed");
+            statuses[i] = array_status_new (array->node, values[0], values[1], values[2], values[3], sync_speed);
+            syncing = syncing || statuses[i]->sync_total > 0;
+
+            for (j = 0; j < MD_MONITORED_ATTRS; j++)
+                g_free (values[j]);
+        }
+
+        /* speed and ETA only change while a sync action is running and that
+           is when we report periodically, otherwise only changes are reported */
+        if (syncing || !statuses_equal (prev_statuses, statuses))
+            monitor->func (statuses, monitor->user_data);
+        free_statuses (prev_statuses);
+        prev_statuses = statuses;
+
+        n_fds = 2 + arrays->len * MD_MONITORED_ATTRS;
+        fds = g_renew (struct pollfd, fds, n_fds);
+        fds[0].fd = monitor->wakeup_fds[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = monitor->mdstat_fd;
+        fds[1].events = POLLPRI;
+        for (i = 0; i < arrays->len; i++) {
+            array = g_ptr_array_index (arrays, i);
+            for (j = 0; j < MD_MONITORED_ATTRS; j++) {
+                /* negative fds are ignored by poll() */
+                fds[2 + i * MD_MONITORED_ATTRS + j].fd = array->fds[j];
+                fds[2 + i * MD_MONITORED_ATTRS + j].events = POLLPRI;
+            }
+        }
+        for (i = 0; i < n_fds; i++)
+            fds[i].revents = 0;
+
+        ret = poll (fds, n_fds, syncing ? (gint) monitor->interval : -1);
+        if (ret < 0 && errno != EINTR)
+            break;
+        if (fds[0].revents)
+            /* asked to stop */
+            break;
+        if (fds[1].revents & (POLLPRI|POLLERR))
+            rescan = TRUE;
+    }
+
+    free_statuses (prev_statuses);
+    if (arrays)
+        g_ptr_array_free (arrays, TRUE);
+    g_free (fds);
+
+    return NULL;
+}
+
+static void monitor_free (MDMonitor *monitor) {
+    gchar byte = 0;
+
+    if (monitor->thread) {
+        while (write (monitor->wakeup_fds[1], &byte, 1) < 0 && errno == EINTR)
+            ;
+        g_thread_join (monitor->thread);
+    }
+
+    if (monitor->wakeup_fds[0] >= 0)
+        close (monitor->wakeup_fds[0]);
+    if (monitor->wakeup_fds[1] >= 0)
+        close (monitor->wakeup_fds[1]);
+    if (monitor->mdstat_fd >= 0)
+        close (monitor->mdstat_fd);
+    if (monitor->notify)
+        monitor->notify (monitor->user_data);
+    g_free (monitor);
+}
+
+static void md_monitors_stop_all (void) {
+    GList *to_stop = NULL;
+    GList *elem = NULL;
+
+    g_mutex_lock (&monitors_lock);
+    if (monitors) {
+        to_stop = g_hash_table_get_values (monitors);
+        g_hash_table_steal_all (monitors);
+    }
+    g_mutex_unlock (&monitors_lock);
+
+    for (elem = to_stop; elem; elem = elem->next)
+        monitor_free ((MDMonitor *) elem->data);
+    g_list_free (to_stop);
+}
+
+/**
+ * bd_md_monitor_start:
+ * @func: (scope notified) (closure user_data) (destroy notify): function to call with the status of the MD arrays
+ * @user_data: (nullable): data to pass to @func
+ * @notify: (nullable): function to free @user_data with once the monitor is stopped
+ * @interval: how often (in ms) to report progress of running sync actions or 0 for the default (1 second)
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Starts monitoring all the MD arrays in the system. @func is called with the
+ * status of all the arrays once right after the start and then whenever an
+ * array is started or stopped, or its state, degradation or sync action
+ * changes. While a sync action (resync, recovery, check,...) runs on any of the
+ * arrays, @func is also called every @interval ms with updated progress, speed
+ * and ETA.
+ *
+ * All the arrays are watched by a single thread using poll() on
+ * `/proc/mdstat` and the `md/array_state`, `md/degraded`, `md/sync_action` and
+ * `md/sync_completed` sysfs attributes, no external tool is run. @func is
+ * called from the monitoring thread and must not call bd_md_monitor_stop() for
+ * its own monitor.
+ *
+ * Returns: ID of the started monitor (for bd_md_monitor_stop()) or 0 in case of error
+ *
+ * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_QUERY
+ */
+guint64 bd_md_monitor_start (BDMDMonitorFunc func, gpointer user_data, GDestroyNotify notify, guint interval, GError **error) {
+    MDMonitor *monitor = NULL;
+
+    if (!func) {
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "A function to report the status with is required.");
+        if (notify)
+            notify (user_data);
+        return 0;
+    }
+
+    monitor = g_new0 (MDMonitor, 1);
+    monitor->func = func;
+    monitor->user_data = user_data;
+    monitor->notify = notify;
+    monitor->interval = interval > 0 ? interval : MD_MONITOR_DEFAULT_INTERVAL;
+    monitor->wakeup_fds[0] = -1;
+    monitor->wakeup_fds[1] = -1;
+
+    monitor->mdstat_fd = open ("/proc/mdstat", O_RDONLY|O_CLOEXEC);
+    if (monitor->mdstat_fd < 0) {
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_FAIL,
+                     "Failed to open /proc/mdstat: %s", g_strerror (errno));
+        monitor_free (monitor);
+        return 0;
+    }
+
+    if (!g_unix_open_pipe (monitor->wakeup_fds, FD_CLOEXEC, error)) {
+        g_prefix_error (error, "Failed to start the MD monitor: ");
+        monitor_free (monitor);
+        return 0;
+    }
+
+    g_mutex_lock (&monitors_lock);
+    monitor->id = ++last_monitor_id;
+    monitor->thread = g_thread_try_new ("bd-md-monitor", monitor_thread, monitor, error);
+    if (!monitor->thread) {
+        g_mutex_unlock (&monitors_lock);
+        g_prefix_error (error, "Failed to start the MD monitor: ");
+        monitor_free (monitor);
+        return 0;
+    }
+    if (!monitors)
+        monitors = g_hash_table_new (g_int64_hash, g_int64_equal);
+    g_hash_table_insert (monitors, &(monitor->id), monitor);
+    g_mutex_unlock (&monitors_lock);
+
+    return monitor->id;
+}
+
+/**
+ * bd_md_monitor_stop:
+ * @monitor_id: ID of the monitor to stop (as returned by bd_md_monitor_start())
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Stops the monitor and waits for its thread to finish, so @func given to
+ * bd_md_monitor_start() is not called once this function returns.
+ *
+ * Returns: whether the monitor was successfully stopped or not
+ *
+ * Tech category: %BD_MD_TECH_MDRAID-%BD_MD_TECH_MODE_QUERY
+ */
+gboolean bd_md_monitor_stop (guint64 monitor_id, GError **error) {
+    MDMonitor *monitor = NULL;
+
+    g_mutex_lock (&monitors_lock);
+    if (monitors)
+        monitor = g_hash_table_lookup (monitors, &monitor_id);
+    if (!monitor) {
+        g_mutex_unlock (&monitors_lock);
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "No MD monitor with ID %"G_GUINT64_FORMAT" running", monitor_id);
+        return FALSE;
+    }
+    if (monitor->thread == g_thread_self ()) {
+        g_mutex_unlock (&monitors_lock);
+        g_set_error (error, BD_MD_ERROR, BD_MD_ERROR_INVAL,
+                     "An MD monitor cannot be stopped from its own callback");
+        return FALSE;
+    }
+    g_hash_table_remove (monitors, &monitor_id);
+    g_mutex_unlock (&monitors_lock);
+
+    monitor_free (monitor);
+    return TRUE;
+}
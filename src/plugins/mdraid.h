@@ -58,6 +58,47 @@ typedef struct BDMDDetailData {
 void bd_md_detail_data_free (BDMDDetailData *data);
 BDMDDetailData* bd_md_detail_data_copy (BDMDDetailData *data);
 
+typedef struct BDMDCapacity {
+    guint64 size;
+    guint64 member_data_size;
+    guint64 data_offset;
+    guint64 metadata_size;
+    guint64 bitmap_size;
+    guint64 parity_size;
+} BDMDCapacity;
+
+BDMDCapacity* bd_md_capacity_copy (BDMDCapacity *data);
+void bd_md_capacity_free (BDMDCapacity *data);
+
+typedef struct BDMDActivateResult {
+    gchar *uuid;
+    gchar *device;
+    gchar **members;
+    gboolean success;
+    gchar *error_msg;
+    guint64 duration;
+} BDMDActivateResult;
+
+BDMDActivateResult* bd_md_activate_result_copy (BDMDActivateResult *data);
+void bd_md_activate_result_free (BDMDActivateResult *data);
+
+typedef struct BDMDArrayStatus {
+    gchar *node;
+    gchar *array_state;
+    gchar *sync_action;
+    guint64 degraded;
+    guint64 sync_completed;
+    guint64 sync_total;
+    gdouble progress;
+    guint64 speed;
+    guint64 eta;
+} BDMDArrayStatus;
+
+BDMDArrayStatus* bd_md_array_status_copy (BDMDArrayStatus *data);
+void bd_md_array_status_free (BDMDArrayStatus *data);
+
+typedef void (*BDMDMonitorFunc) (BDMDArrayStatus **statuses, gpointer user_data);
+
 typedef enum {
     BD_MD_TECH_MDRAID = 0,
 } BDMDTech;
@@ -84,10 +125,12 @@ void bd_md_close (void);
 gboolean bd_md_is_tech_avail (BDMDTech tech, guint64 mode, GError **error);
 
 guint64 bd_md_get_superblock_size (guint64 member_size, const gchar *version, GError **error);
+BDMDCapacity* bd_md_plan_capacity (const gchar *level, const guint64 *member_sizes, gsize num_members, const gchar *version, guint64 chunk_size, gboolean bitmap, GError **error);
 gboolean bd_md_create (const gchar *device_name, const gchar *level, const gchar **disks, guint64 spares, const gchar *version, const gchar *bitmap, guint64 chunk_size, const BDExtraArg **extra, GError **error);
 gboolean bd_md_destroy (const gchar *device, GError **error);
 gboolean bd_md_deactivate (const gchar *raid_spec, GError **error);
 gboolean bd_md_activate (const gchar *raid_spec, const gchar **members, const gchar *uuid, gboolean start_degraded, const BDExtraArg **extra, GError **error);
+BDMDActivateResult** bd_md_activate_many (const gchar **devices, gboolean start_degraded, guint max_jobs, GError **error);
 gboolean bd_md_run (const gchar *raid_spec, GError **error);
 gboolean bd_md_nominate (const gchar *device, GError **error);
 gboolean bd_md_denominate (const gchar *device, GError **error);
@@ -103,5 +146,8 @@ gchar* bd_md_get_status (const gchar *raid_spec, GError **error);
 gboolean bd_md_set_bitmap_location (const gchar *raid_spec, const gchar *location, GError **error);
 gchar* bd_md_get_bitmap_location (const gchar *raid_spec, GError **error);
 gboolean bd_md_request_sync_action (const gchar *raid_spec, const gchar *action, GError **error);
+BDMDArrayStatus** bd_md_get_array_statuses (GError **error);
+guint64 bd_md_monitor_start (BDMDMonitorFunc func, gpointer user_data, GDestroyNotify notify, guint interval, GError **error);
+gboolean bd_md_monitor_stop (guint64 monitor_id, GError **error);
 
 #endif  /* BD_MD */
@@ -18,7 +18,10 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
 #include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <blockdev/utils.h>
 #include <libfdisk.h>
@@ -106,6 +109,135 @@ void bd_part_disk_spec_free (BDPartDiskSpec *data) {
     g_free (data);
 }
 
+/* operations queued in a BDPartTransaction */
+typedef enum {
+    BD_PART_TRANSACTION_OP_CREATE,
+    BD_PART_TRANSACTION_OP_DELETE,
+    BD_PART_TRANSACTION_OP_RESIZE,
+    BD_PART_TRANSACTION_OP_SET_NAME,
+    BD_PART_TRANSACTION_OP_SET_TYPE,
+    BD_PART_TRANSACTION_OP_SET_ID,
+    BD_PART_TRANSACTION_OP_SET_UUID,
+    BD_PART_TRANSACTION_OP_SET_BOOTABLE,
+    BD_PART_TRANSACTION_OP_SET_ATTRIBUTES,
+} BDPartTransactionOpType;
+
+typedef struct BDPartTransactionOp {
+    BDPartTransactionOpType type;
+    gchar *part;
+    BDPartTypeReq type_req;
+    guint64 start;
+    guint64 size;
+    BDPartAlign align;
+    gchar *value;
+    guint64 attrs;
+} BDPartTransactionOp;
+
+struct _BDPartTransaction {
+    gchar *disk;
+    GList *ops;
+};
+
+BDPartTransaction* bd_part_transaction_copy (BDPartTransaction *trans) {
+    if (trans == NULL)
+        return NULL;
+
+    BDPartTransaction *ret = g_new0 (BDPartTransaction, 1);
+    BDPartTransactionOp *op = NULL;
+    BDPartTransactionOp *new_op = NULL;
+    GList *op_it = NULL;
+
+    ret->disk = g_strdup (trans->disk);
+    for (op_it = trans->ops; op_it; op_it = op_it->next) {
+        op = (BDPartTransactionOp *) op_it->data;
+        new_op = g_new0 (BDPartTransactionOp, 1);
+        new_op->type = op->type;
+        new_op->part = g_strdup (op->part);
+        new_op->type_req = op->type_req;
+        new_op->start = op->start;
+        new_op->size = op->size;
+        new_op->align = op->align;
+        new_op->value = g_strdup (op->value);
+        new_op->attrs = op->attrs;
+        ret->ops = g_list_prepend (ret->ops, new_op);
+    }
+    ret->ops = g_list_reverse (ret->ops);
+
+    return ret;
+}
+
+void bd_part_transaction_free (BDPartTransaction *trans) {
+    if (trans == NULL)
+        return;
+
+    BDPartTransactionOp *op = NULL;
+    GList *op_it = NULL;
+
+    for (op_it = trans->ops; op_it; op_it = op_it->next) {
+        op = (BDPartTransactionOp *) op_it->data;
+        g_free (op->part);
+        g_free (op->value);
+        g_free (op);
+    }
+    g_list_free (trans->ops);
+    g_free (trans->disk);
+    g_free (trans);
+}
+
+BDPartDiskGeometry* bd_part_disk_geometry_copy (BDPartDiskGeometry *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDPartDiskGeometry *ret = g_new0 (BDPartDiskGeometry, 1);
+
+    ret->size = data->size;
+    ret->sector_size = data->sector_size;
+    ret->alignment = data->alignment;
+    ret->alignment_offset = data->alignment_offset;
+
+    return ret;
+}
+
+void bd_part_disk_geometry_free (BDPartDiskGeometry *data) {
+    g_free (data);
+}
+
+BDPartLayoutRequest* bd_part_layout_request_copy (BDPartLayoutRequest *data) {
+    if (data == NULL)
+        return NULL;
+
+    BDPartLayoutRequest *ret = g_new0 (BDPartLayoutRequest, 1);
+
+    ret->size = data->size;
+    ret->percent = data->percent;
+    ret->flags = data->flags;
+    ret->name = g_strdup (data->name);
+    ret->type = g_strdup (data->type);
+
+    return ret;
+}
+
+void bd_part_layout_request_free (BDPartLayoutRequest *data) {
+    if (data == NULL)
+        return;
+
+    g_free (data->name);
+    g_free (data->type);
+    g_free (data);
+}
+
+BDPartLayoutRequest* bd_part_layout_request_new (guint64 size, gdouble percent, guint64 flags, const gchar *name, const gchar *type) {
+    BDPartLayoutRequest *ret = g_new0 (BDPartLayoutRequest, 1);
+
+    ret->size = size;
+    ret->percent = percent;
+    ret->flags = flags;
+    ret->name = g_strdup (name);
+    ret->type = g_strdup (type);
+
+    return ret;
+}
+
 /* "C" locale to get the locale-agnostic error messages */
 static locale_t c_locale = (locale_t) 0;
 
@@ -226,6 +358,8 @@ static void close_context (struct fdisk_context *cxt) {
     fdisk_unref_context (cxt);
 }
 
+static void table_cache_drop (const gchar *disk);
+
 static gboolean write_label (struct fdisk_context *cxt, struct fdisk_table *orig, const gchar *disk, gboolean force, GError **error) {
     gint ret = 0;
     gint dev_fd = 0;
@@ -250,6 +384,8 @@ static gboolean write_label (struct fdisk_context *cxt, struct fdisk_table *orig
        anyway with no harm. */
 
     ret = fdisk_write_disklabel (cxt);
+    /* whatever got written, the cached partition table (if any) is no longer valid */
+    table_cache_drop (disk);
     if (ret != 0) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to write the new disklabel to disk '%s': %s", disk, strerror_l (-ret, c_locale));
@@ -308,6 +444,7 @@ gboolean bd_part_init (void) {
  *
  */
 void bd_part_close (void) {
+    bd_part_set_table_cache (FALSE, NULL);
     c_locale = (locale_t) 0;
 }
 
@@ -397,65 +534,30 @@ gboolean bd_part_create_table (const gchar *disk, BDPartTableType type, gboolean
     return TRUE;
 }
 
-static gchar* get_part_type_guid_and_gpt_flags (const gchar *device, int part_num, guint64 *attrs, char **type_name, GError **error) {
-    struct fdisk_context *cxt = NULL;
-    struct fdisk_label *lb = NULL;
-    struct fdisk_partition *pa = NULL;
+static gchar* get_part_type_guid_and_gpt_flags (struct fdisk_context *cxt, struct fdisk_partition *pa, guint64 *attrs, char **type_name, GError **error) {
     struct fdisk_parttype *ptype = NULL;
-    const gchar *label_name = NULL;
     const gchar *ptype_string = NULL;
-    gchar *ret = NULL;
+    size_t part_num = 0;
     gint status = 0;
 
-    /* first partition in fdisk is 0 */
-    part_num--;
-
-    cxt = get_device_context (device, TRUE, error);
-    if (!cxt) {
-        /* error is already populated */
-        return NULL;
-    }
-
-    lb = fdisk_get_label (cxt, NULL);
-    if (!lb) {
-        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to read partition table on device '%s'", device);
-        close_context (cxt);
-        return NULL;
-    }
-
-    label_name = fdisk_label_get_name (lb);
-    if (g_strcmp0 (label_name, table_type_str[BD_PART_TABLE_GPT]) != 0) {
-        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
-                     "Setting GPT flags is not supported on '%s' partition table", label_name);
-        close_context (cxt);
-        return NULL;
-    }
+    /* everything is read from the already open context, the partition table
+       doesn't need to be read again for every partition */
+    part_num = fdisk_partition_get_partno (pa);
 
     if (attrs) {
         status = fdisk_gpt_get_partition_attrs (cxt, part_num, attrs);
         if (status < 0) {
             g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to read GPT attributes");
-            close_context (cxt);
             return NULL;
         }
     }
 
-    status = fdisk_get_partition (cxt, part_num, &pa);
-    if (status != 0) {
-        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to get partition %d on device '%s'", part_num, device);
-        close_context (cxt);
-        return NULL;
-    }
-
     ptype = fdisk_partition_get_type (pa);
     if (!ptype) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to get partition type for partition %d on device '%s'", part_num, device);
-        fdisk_unref_partition (pa);
-        close_context (cxt);
+                     "Failed to get partition type for partition %zu on device '%s'",
+                     part_num, fdisk_get_devname (cxt));
         return NULL;
     }
 
@@ -463,9 +565,8 @@ static gchar* get_part_type_guid_and_gpt_flags (const gchar *device, int part_nu
     ptype_string = fdisk_parttype_get_name (ptype);
     if (!ptype_string) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to get partition type string for partition %d on device '%s'", part_num, device);
-        fdisk_unref_partition (pa);
-        close_context (cxt);
+                     "Failed to get partition type string for partition %zu on device '%s'",
+                     part_num, fdisk_get_devname (cxt));
         return NULL;
     }
 
@@ -475,17 +576,12 @@ static gchar* get_part_type_guid_and_gpt_flags (const gchar *device, int part_nu
     ptype_string = fdisk_parttype_get_string (ptype);
     if (!ptype_string) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to get partition type for partition %d on device '%s'", part_num, device);
-        fdisk_unref_partition (pa);
-        close_context (cxt);
+                     "Failed to get partition type for partition %zu on device '%s'",
+                     part_num, fdisk_get_devname (cxt));
         return NULL;
     }
 
-    ret = g_strdup (ptype_string);
-
-    fdisk_unref_partition (pa);
-    close_context (cxt);
-    return ret;
+    return g_strdup (ptype_string);
 }
 
 static BDPartSpec* get_part_spec_fdisk (struct fdisk_context *cxt, struct fdisk_partition *pa, GError **error) {
@@ -543,8 +639,7 @@ static BDPartSpec* get_part_spec_fdisk (struct fdisk_context *cxt, struct fdisk_
     if (g_strcmp0 (fdisk_label_get_name (lb), "gpt") == 0) {
         if (ret->type == BD_PART_TYPE_NORMAL) {
           /* only 'normal' partitions have GUIDs */
-          ret->type_guid = get_part_type_guid_and_gpt_flags (devname, fdisk_partition_get_partno (pa) + 1,
-                                                             &(ret->attrs), &(ret->type_name), &l_error);
+          ret->type_guid = get_part_type_guid_and_gpt_flags (cxt, pa, &(ret->attrs), &(ret->type_name), &l_error);
           if (!ret->type_guid && l_error) {
               g_propagate_error (error, l_error);
               bd_part_spec_free (ret);
@@ -570,54 +665,36 @@ static BDPartSpec* get_part_spec_fdisk (struct fdisk_context *cxt, struct fdisk_
     return ret;
 }
 
-/**
- * bd_part_get_part_spec:
- * @disk: disk to remove the partition from
- * @part: partition to get spec for
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: (transfer full): spec of the @part partition from @disk or %NULL in case of error
- *
- * Tech category: %BD_PART_TECH_MODE_QUERY_PART + the tech according to the partition table type
- */
-BDPartSpec* bd_part_get_part_spec (const gchar *disk, const gchar *part, GError **error) {
-    struct fdisk_context *cxt = NULL;
-    struct fdisk_partition *pa = NULL;
-    gint status = 0;
-    gint part_num = 0;
-    BDPartSpec *ret = NULL;
-
-    part_num = get_part_num (part, error);
-    if (part_num == -1)
-        return NULL;
-
-    /* first partition in fdisk is 0 */
-    part_num--;
-
-    cxt = get_device_context (disk, TRUE, error);
-    if (!cxt) {
-        /* error is already populated */
-        return NULL;
-    }
-
-    status = fdisk_get_partition (cxt, part_num, &pa);
-    if (status != 0) {
-        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to get partition %d on device '%s'", part_num, disk);
-        close_context (cxt);
-        return NULL;
-    }
+static BDPartDiskSpec* get_disk_spec_cxt (struct fdisk_context *cxt) {
+    struct fdisk_label *lb = NULL;
+    BDPartDiskSpec *ret = NULL;
+    const gchar *label_name = NULL;
+    BDPartTableType type = BD_PART_TABLE_UNDEF;
+    gboolean found = FALSE;
 
-    ret = get_part_spec_fdisk (cxt, pa, error);
+    ret = g_new0 (BDPartDiskSpec, 1);
+    ret->path = g_strdup (fdisk_get_devname (cxt));
+    ret->sector_size = (guint64) fdisk_get_sector_size (cxt);
+    ret->size = fdisk_get_nsectors (cxt) * ret->sector_size;
 
-    fdisk_unref_partition (pa);
-    close_context (cxt);
+    lb = fdisk_get_label (cxt, NULL);
+    if (lb) {
+        label_name = fdisk_label_get_name (lb);
+        for (type=BD_PART_TABLE_MSDOS; !found && type < BD_PART_TABLE_UNDEF; type++) {
+            if (g_strcmp0 (label_name, table_type_str[type]) == 0) {
+                ret->table_type = type;
+                found = TRUE;
+            }
+        }
+        if (!found)
+            ret->table_type = BD_PART_TABLE_UNDEF;
+    } else
+        ret->table_type = BD_PART_TABLE_UNDEF;
 
     return ret;
 }
 
-static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean freespaces, gboolean metadata, GError **error) {
-    struct fdisk_context *cxt = NULL;
+static BDPartSpec** get_disk_parts_cxt (struct fdisk_context *cxt, gboolean parts, gboolean freespaces, gboolean metadata, GError **error) {
     struct fdisk_table *table = NULL;
     struct fdisk_partition *pa = NULL;
     struct fdisk_iter *itr = NULL;
@@ -626,17 +703,10 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
     GPtrArray *array = NULL;
     gint status = 0;
 
-    cxt = get_device_context (disk, TRUE, error);
-    if (!cxt) {
-        /* error is already populated */
-        return NULL;
-    }
-
     table = fdisk_new_table ();
     if (!table) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to create a new table");
-        close_context (cxt);
         return NULL;
     }
 
@@ -644,7 +714,7 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
     if (!itr) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to create a new iterator");
-        close_context (cxt);
+        fdisk_unref_table (table);
         return NULL;
     }
 
@@ -655,7 +725,6 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
                          "Failed to get partitions");
             fdisk_free_iter (itr);
             fdisk_unref_table (table);
-            close_context (cxt);
             return NULL;
         }
     }
@@ -667,7 +736,6 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
                          "Failed to get free spaces");
             fdisk_free_iter (itr);
             fdisk_unref_table (table);
-            close_context (cxt);
             return NULL;
         }
     }
@@ -679,7 +747,6 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
                      "Failed to sort partitions");
         fdisk_free_iter (itr);
         fdisk_unref_table (table);
-        close_context (cxt);
         return NULL;
     }
 
@@ -691,7 +758,6 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
             g_ptr_array_free (array, TRUE);
             fdisk_free_iter (itr);
             fdisk_unref_table (table);
-            close_context (cxt);
             return NULL;
         }
 
@@ -731,94 +797,489 @@ static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean
 
     fdisk_free_iter (itr);
     fdisk_unref_table (table);
-    close_context (cxt);
 
     g_ptr_array_add (array, NULL);
     return (BDPartSpec **) g_ptr_array_free (array, FALSE);
 }
 
-/**
- * bd_part_get_part_by_pos:
- * @disk: disk to remove the partition from
- * @position: position (in bytes) determining the partition
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: (transfer full): spec of the partition from @disk spanning over the @position or %NULL if no such
- *          partition exists or in case of error (@error is set)
- *
- * Tech category: %BD_PART_TECH_MODE_QUERY_PART + the tech according to the partition table type
- */
-BDPartSpec* bd_part_get_part_by_pos (const gchar *disk, guint64 position, GError **error) {
-    BDPartSpec **parts = NULL;
-    BDPartSpec *ret = NULL;
+/* opt-in cache of the parsed partition tables, see bd_part_set_table_cache() */
+typedef struct PartTableCacheEntry {
+    gchar *disk;                /* the paths in the specs are based on this */
+    dev_t devno;
+    guint64 diskseq;
+    struct timespec udev_mtime;
+    BDPartDiskSpec *disk_spec;
+    BDPartSpec **parts;         /* partitions, free spaces and metadata sorted by start,
+                                   NULL if there is no (supported) partition table */
+    GHashTable *parts_by_num;   /* partition number -> spec in @parts */
+    GPtrArray *free_index;      /* free regions from @parts sorted by size */
+    gboolean logical_free;      /* whether some of the free regions is inside an extended partition */
+} PartTableCacheEntry;
+
+static GMutex table_cache_lock;
+static gboolean table_cache_enabled = FALSE;
+static GHashTable *table_cache = NULL;
+
+static void table_cache_entry_free (PartTableCacheEntry *entry) {
+    BDPartSpec **parts_p = NULL;
+
+    if (!entry)
+        return;
 
-    parts = get_disk_parts (disk, TRUE, TRUE, TRUE, error);
-    if (!parts)
-        return NULL;
+    g_free (entry->disk);
+    bd_part_disk_spec_free (entry->disk_spec);
+    if (entry->parts) {
+        for (parts_p = entry->parts; *parts_p; parts_p++)
+            bd_part_spec_free (*parts_p);
+        g_free (entry->parts);
+    }
+    if (entry->parts_by_num)
+        g_hash_table_destroy (entry->parts_by_num);
+    if (entry->free_index)
+        g_ptr_array_free (entry->free_index, TRUE);
+    g_free (entry);
+}
 
-    for (BDPartSpec **parts_p = parts; *parts_p; parts_p++) {
-        if ((*parts_p)->start <= position && ((*parts_p)->start + (*parts_p)->size) > position) {
-            if ((*parts_p)->type == BD_PART_TYPE_EXTENDED) {
-                /* we don't want to return extended partition here -- there
-                   is either another logical or free space at this position */
-                continue;
-            }
+/* gets the stamp the cache entries are validated against -- the disk sequence
+   number (changes when a different medium appears under the same device) and
+   modification time of the udev database entry (changes with every uevent
+   udev processes for the disk which includes changes of the partition table
+   thanks to the inotify watch udev has on the disk), no I/O on the device is
+   needed for this */
+static gboolean table_cache_get_stamp (const gchar *disk, dev_t *devno, guint64 *diskseq, struct timespec *udev_mtime) {
+    struct stat st;
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+
+    if (stat (disk, &st) != 0 || !S_ISBLK (st.st_mode))
+        return FALSE;
+    *devno = st.st_rdev;
 
-            ret = *parts_p;
-            break;
-        }
-    }
+    /* without udev there's no way to tell the table changed, don't cache */
+    path = g_strdup_printf ("/run/udev/data/b%u:%u", major (*devno), minor (*devno));
+    if (stat (path, &st) != 0)
+        return FALSE;
+    *udev_mtime = st.st_mtim;
 
-    /* free the array except the selected element */
-    for (BDPartSpec **parts_p = parts; *parts_p; parts_p++)
-        if (*parts_p != ret)
-            bd_part_spec_free (*parts_p);
-    g_free (parts);
+    /* diskseq is only available with kernel 5.15 and newer */
+    g_free (path);
+    path = g_strdup_printf ("/sys/dev/block/%u:%u/diskseq", major (*devno), minor (*devno));
+    if (g_file_get_contents (path, &contents, NULL, NULL))
+        *diskseq = g_ascii_strtoull (contents, NULL, 10);
+    else
+        *diskseq = 0;
 
-    return ret;
+    return TRUE;
 }
 
-/**
- * bd_part_get_disk_spec:
- * @disk: disk to get information about
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: (transfer full): information about the given @disk or %NULL (in case of error)
- *
- * Tech category: %BD_PART_TECH_MODE_QUERY_TABLE + the tech according to the partition table type
- */
-BDPartDiskSpec* bd_part_get_disk_spec (const gchar *disk, GError **error) {
+static gint cmp_spec_size (gconstpointer a, gconstpointer b) {
+    const BDPartSpec *spec_a = *((const BDPartSpec **) a);
+    const BDPartSpec *spec_b = *((const BDPartSpec **) b);
+
+    if (spec_a->size < spec_b->size)
+        return -1;
+    else if (spec_a->size > spec_b->size)
+        return 1;
+    else
+        return 0;
+}
+
+static PartTableCacheEntry* table_cache_load (const gchar *disk) {
     struct fdisk_context *cxt = NULL;
-    struct fdisk_label *lb = NULL;
-    BDPartDiskSpec *ret = NULL;
-    const gchar *label_name = NULL;
-    BDPartTableType type = BD_PART_TABLE_UNDEF;
-    gboolean found = FALSE;
+    PartTableCacheEntry *entry = NULL;
+    BDPartSpec **parts_p = NULL;
+    gint part_num = 0;
 
-    cxt = get_device_context (disk, TRUE, error);
-    if (!cxt) {
-        /* error is already populated */
+    cxt = get_device_context (disk, TRUE, NULL);
+    if (!cxt)
         return NULL;
-    }
 
-    ret = g_new0 (BDPartDiskSpec, 1);
-    ret->path = g_strdup (fdisk_get_devname (cxt));
-    ret->sector_size = (guint64) fdisk_get_sector_size (cxt);
-    ret->size = fdisk_get_nsectors (cxt) * ret->sector_size;
+    entry = g_new0 (PartTableCacheEntry, 1);
+    entry->disk_spec = get_disk_spec_cxt (cxt);
+    if (entry->disk_spec->table_type != BD_PART_TABLE_UNDEF)
+        /* failing to get the partitions just means the non-cached code will be
+           used to report the error */
+        entry->parts = get_disk_parts_cxt (cxt, TRUE, TRUE, TRUE, NULL);
+    close_context (cxt);
 
-    lb = fdisk_get_label (cxt, NULL);
-    if (lb) {
-        label_name = fdisk_label_get_name (lb);
-        for (type=BD_PART_TABLE_MSDOS; !found && type < BD_PART_TABLE_UNDEF; type++) {
-            if (g_strcmp0 (label_name, table_type_str[type]) == 0) {
-                ret->table_type = type;
-                found = TRUE;
-            }
+    entry->parts_by_num = g_hash_table_new (g_direct_hash, g_direct_equal);
+    entry->free_index = g_ptr_array_new ();
+    for (parts_p = entry->parts; parts_p && *parts_p; parts_p++) {
+        if ((*parts_p)->type & BD_PART_TYPE_METADATA)
+            continue;
+        if ((*parts_p)->type & BD_PART_TYPE_FREESPACE) {
+            g_ptr_array_add (entry->free_index, *parts_p);
+            if ((*parts_p)->type & BD_PART_TYPE_LOGICAL)
+                entry->logical_free = TRUE;
+        } else if ((*parts_p)->path) {
+            part_num = get_part_num ((*parts_p)->path, NULL);
+            if (part_num > 0)
+                g_hash_table_insert (entry->parts_by_num, GINT_TO_POINTER (part_num), *parts_p);
         }
-        if (!found)
-            ret->table_type = BD_PART_TABLE_UNDEF;
-    } else
-        ret->table_type = BD_PART_TABLE_UNDEF;
+    }
+    g_ptr_array_sort (entry->free_index, cmp_spec_size);
+
+    return entry;
+}
+
+/* returns a valid cache entry for @disk (loading it if needed) or %NULL if
+   @disk cannot be cached, needs to be called with table_cache_lock held */
+static PartTableCacheEntry* table_cache_lookup (const gchar *disk) {
+    PartTableCacheEntry *entry = NULL;
+    dev_t devno = 0;
+    guint64 diskseq = 0;
+    struct timespec udev_mtime = { 0, 0 };
+    guint64 key = 0;
+    guint64 *key_p = NULL;
+
+    if (!table_cache_enabled)
+        return NULL;
+
+    if (!table_cache_get_stamp (disk, &devno, &diskseq, &udev_mtime))
+        return NULL;
+
+    key = (guint64) devno;
+    entry = g_hash_table_lookup (table_cache, &key);
+    if (entry && g_strcmp0 (entry->disk, disk) == 0 && entry->diskseq == diskseq &&
+        entry->udev_mtime.tv_sec == udev_mtime.tv_sec && entry->udev_mtime.tv_nsec == udev_mtime.tv_nsec)
+        return entry;
+
+    /* stale, missing or queried using a different path to the same disk */
+    g_hash_table_remove (table_cache, &key);
+    entry = table_cache_load (disk);
+    if (!entry)
+        return NULL;
+
+    entry->disk = g_strdup (disk);
+    entry->devno = devno;
+    entry->diskseq = diskseq;
+    entry->udev_mtime = udev_mtime;
+    key_p = g_new (guint64, 1);
+    *key_p = key;
+    g_hash_table_insert (table_cache, key_p, entry);
+
+    return entry;
+}
+
+/* drops the cache entry for @disk (or all entries if %NULL) */
+static void table_cache_drop (const gchar *disk) {
+    struct stat st;
+    guint64 key = 0;
+
+    g_mutex_lock (&table_cache_lock);
+    if (table_cache) {
+        if (!disk)
+            g_hash_table_remove_all (table_cache);
+        else if (stat (disk, &st) == 0 && S_ISBLK (st.st_mode)) {
+            key = (guint64) st.st_rdev;
+            g_hash_table_remove (table_cache, &key);
+        }
+    }
+    g_mutex_unlock (&table_cache_lock);
+}
+
+static BDPartDiskSpec* table_cache_get_disk_spec (const gchar *disk) {
+    PartTableCacheEntry *entry = NULL;
+    BDPartDiskSpec *ret = NULL;
+
+    g_mutex_lock (&table_cache_lock);
+    entry = table_cache_lookup (disk);
+    if (entry)
+        ret = bd_part_disk_spec_copy (entry->disk_spec);
+    g_mutex_unlock (&table_cache_lock);
+
+    return ret;
+}
+
+static gboolean table_cache_get_part_spec (const gchar *disk, gint part_num, BDPartSpec **spec) {
+    PartTableCacheEntry *entry = NULL;
+    gboolean ret = FALSE;
+
+    g_mutex_lock (&table_cache_lock);
+    entry = table_cache_lookup (disk);
+    /* non-existing partitions are left to the non-cached code to report the error */
+    if (entry && entry->parts && g_hash_table_contains (entry->parts_by_num, GINT_TO_POINTER (part_num))) {
+        *spec = bd_part_spec_copy (g_hash_table_lookup (entry->parts_by_num, GINT_TO_POINTER (part_num)));
+        ret = TRUE;
+    }
+    g_mutex_unlock (&table_cache_lock);
+
+    return ret;
+}
+
+/* same as get_disk_parts(), but the only supported combinations are the ones
+   used in this file -- metadata only together with partitions and free spaces */
+static BDPartSpec** table_cache_get_disk_parts (const gchar *disk, gboolean parts, gboolean freespaces, gboolean metadata) {
+    PartTableCacheEntry *entry = NULL;
+    BDPartSpec **parts_p = NULL;
+    GPtrArray *array = NULL;
+    gboolean include = FALSE;
+
+    g_mutex_lock (&table_cache_lock);
+    entry = table_cache_lookup (disk);
+    if (!entry || !entry->parts) {
+        g_mutex_unlock (&table_cache_lock);
+        return NULL;
+    }
+
+    array = g_ptr_array_new ();
+    for (parts_p = entry->parts; *parts_p; parts_p++) {
+        if ((*parts_p)->type & BD_PART_TYPE_METADATA)
+            include = metadata;
+        else if ((*parts_p)->type & BD_PART_TYPE_FREESPACE)
+            include = freespaces;
+        else
+            include = parts;
+        if (include)
+            g_ptr_array_add (array, bd_part_spec_copy (*parts_p));
+    }
+    g_mutex_unlock (&table_cache_lock);
+
+    g_ptr_array_add (array, NULL);
+    return (BDPartSpec **) g_ptr_array_free (array, FALSE);
+}
+
+/* same as bd_part_get_best_free_region(), but using the free region index */
+static gboolean table_cache_get_best_free_region (const gchar *disk, BDPartType type, guint64 size, BDPartSpec **spec) {
+    PartTableCacheEntry *entry = NULL;
+    BDPartSpec *region = NULL;
+    BDPartSpec *best = NULL;
+    guint first = 0;
+    guint last = 0;
+    guint mid = 0;
+    guint i = 0;
+
+    g_mutex_lock (&table_cache_lock);
+    entry = table_cache_lookup (disk);
+    if (!entry || !entry->parts) {
+        g_mutex_unlock (&table_cache_lock);
+        return FALSE;
+    }
+
+    /* find the first region bigger than @size */
+    first = 0;
+    last = entry->free_index->len;
+    while (first < last) {
+        mid = first + (last - first) / 2;
+        region = g_ptr_array_index (entry->free_index, mid);
+        if (region->size > size)
+            last = mid;
+        else
+            first = mid + 1;
+    }
+
+    if (type == BD_PART_TYPE_NORMAL || type == BD_PART_TYPE_LOGICAL) {
+        /* the smallest fitting region (not) in an extended partition */
+        for (i = first; !best && i < entry->free_index->len; i++) {
+            region = g_ptr_array_index (entry->free_index, i);
+            if (((region->type & BD_PART_TYPE_LOGICAL) != 0) == (type == BD_PART_TYPE_LOGICAL))
+                best = region;
+        }
+    } else if (type == BD_PART_TYPE_EXTENDED) {
+        /* there can only be one extended partition, otherwise the biggest region */
+        if (!entry->logical_free && first < entry->free_index->len)
+            best = g_ptr_array_index (entry->free_index, entry->free_index->len - 1);
+    }
+
+    *spec = bd_part_spec_copy (best);
+    g_mutex_unlock (&table_cache_lock);
+
+    return TRUE;
+}
+
+static BDPartSpec** get_disk_parts (const gchar *disk, gboolean parts, gboolean freespaces, gboolean metadata, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    BDPartSpec **ret = NULL;
+
+    ret = table_cache_get_disk_parts (disk, parts, freespaces, metadata);
+    if (ret)
+        return ret;
+
+    cxt = get_device_context (disk, TRUE, error);
+    if (!cxt) {
+        /* error is already populated */
+        return NULL;
+    }
+
+    ret = get_disk_parts_cxt (cxt, parts, freespaces, metadata, error);
+    close_context (cxt);
+
+    return ret;
+}
+
+/**
+ * bd_part_set_table_cache:
+ * @enabled: whether to enable or disable the cache
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Enables or disables caching of the parsed partition tables. With the cache
+ * enabled, the query functions (bd_part_get_disk_spec(), bd_part_get_part_spec(),
+ * bd_part_get_part_by_pos(), bd_part_get_disk_parts(), bd_part_get_disk_free_regions()
+ * and bd_part_get_best_free_region()) don't read the partition table from the
+ * disk if it didn't change since it was last read.
+ *
+ * The cached partition tables are validated against the disk sequence number
+ * and the udev database entry of the disk, which is updated on every change
+ * event for the disk. Disks not known to udev are never cached. Changes made
+ * by this plugin invalidate the cached partition table immediately; changes
+ * made by other processes are only noticed once udev processes the
+ * corresponding change event.
+ *
+ * Disabling the cache drops all the cached partition tables.
+ *
+ * Returns: whether the cache was successfully enabled/disabled or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_part_set_table_cache (gboolean enabled, GError **error G_GNUC_UNUSED) {
+    g_mutex_lock (&table_cache_lock);
+    table_cache_enabled = enabled;
+    if (enabled && !table_cache)
+        table_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free,
+                                             (GDestroyNotify) table_cache_entry_free);
+    else if (!enabled && table_cache) {
+        g_hash_table_destroy (table_cache);
+        table_cache = NULL;
+    }
+    g_mutex_unlock (&table_cache_lock);
+
+    return TRUE;
+}
+
+/**
+ * bd_part_invalidate_table_cache:
+ * @disk: (nullable): disk to drop the cached partition table for or %NULL for all disks
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Drops the cached partition table of @disk (or all the cached partition
+ * tables) so that the next query reads it from the disk again. Useful when the
+ * partition table is changed by some other tool and the change needs to be
+ * seen immediately.
+ *
+ * Returns: whether the cached partition table was successfully dropped or not
+ *
+ * Tech category: always available
+ */
+gboolean bd_part_invalidate_table_cache (const gchar *disk, GError **error G_GNUC_UNUSED) {
+    table_cache_drop (disk);
+    return TRUE;
+}
+
+/**
+ * bd_part_get_part_spec:
+ * @disk: disk to remove the partition from
+ * @part: partition to get spec for
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full): spec of the @part partition from @disk or %NULL in case of error
+ *
+ * Tech category: %BD_PART_TECH_MODE_QUERY_PART + the tech according to the partition table type
+ */
+BDPartSpec* bd_part_get_part_spec (const gchar *disk, const gchar *part, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    struct fdisk_partition *pa = NULL;
+    gint status = 0;
+    gint part_num = 0;
+    BDPartSpec *ret = NULL;
+
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
+        return NULL;
+
+    if (table_cache_get_part_spec (disk, part_num, &ret))
+        return ret;
+
+    /* first partition in fdisk is 0 */
+    part_num--;
+
+    cxt = get_device_context (disk, TRUE, error);
+    if (!cxt) {
+        /* error is already populated */
+        return NULL;
+    }
+
+    status = fdisk_get_partition (cxt, part_num, &pa);
+    if (status != 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to get partition %d on device '%s'", part_num, disk);
+        close_context (cxt);
+        return NULL;
+    }
+
+    ret = get_part_spec_fdisk (cxt, pa, error);
+
+    fdisk_unref_partition (pa);
+    close_context (cxt);
+
+    return ret;
+}
+
+
+/**
+ * bd_part_get_part_by_pos:
+ * @disk: disk to remove the partition from
+ * @position: position (in bytes) determining the partition
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full): spec of the partition from @disk spanning over the @position or %NULL if no such
+ *          partition exists or in case of error (@error is set)
+ *
+ * Tech category: %BD_PART_TECH_MODE_QUERY_PART + the tech according to the partition table type
+ */
+BDPartSpec* bd_part_get_part_by_pos (const gchar *disk, guint64 position, GError **error) {
+    BDPartSpec **parts = NULL;
+    BDPartSpec *ret = NULL;
+
+    parts = get_disk_parts (disk, TRUE, TRUE, TRUE, error);
+    if (!parts)
+        return NULL;
+
+    for (BDPartSpec **parts_p = parts; *parts_p; parts_p++) {
+        if ((*parts_p)->start <= position && ((*parts_p)->start + (*parts_p)->size) > position) {
+            if ((*parts_p)->type == BD_PART_TYPE_EXTENDED) {
+                /* we don't want to return extended partition here -- there
+                   is either another logical or free space at this position */
+                continue;
+            }
+
+            ret = *parts_p;
+            break;
+        }
+    }
+
+    /* free the array except the selected element */
+    for (BDPartSpec **parts_p = parts; *parts_p; parts_p++)
+        if (*parts_p != ret)
+            bd_part_spec_free (*parts_p);
+    g_free (parts);
+
+    return ret;
+}
+
+/**
+ * bd_part_get_disk_spec:
+ * @disk: disk to get information about
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full): information about the given @disk or %NULL (in case of error)
+ *
+ * Tech category: %BD_PART_TECH_MODE_QUERY_TABLE + the tech according to the partition table type
+ */
+BDPartDiskSpec* bd_part_get_disk_spec (const gchar *disk, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    BDPartDiskSpec *ret = NULL;
+
+    ret = table_cache_get_disk_spec (disk);
+    if (ret)
+        return ret;
+
+    cxt = get_device_context (disk, TRUE, error);
+    if (!cxt) {
+        /* error is already populated */
+        return NULL;
+    }
+
+    ret = get_disk_spec_cxt (cxt);
 
     close_context (cxt);
 
@@ -874,6 +1335,9 @@ BDPartSpec* bd_part_get_best_free_region (const gchar *disk, BDPartType type, gu
     BDPartSpec **free_reg_p = NULL;
     BDPartSpec *ret = NULL;
 
+    if (table_cache_get_best_free_region (disk, type, size, &ret))
+        return ret;
+
     free_regs = bd_part_get_disk_free_regions (disk, error);
     if (!free_regs)
         /* error should be populated */
@@ -929,31 +1393,11 @@ BDPartSpec* bd_part_get_best_free_region (const gchar *disk, BDPartType type, gu
     return ret;
 }
 
-/**
- * bd_part_create_part:
- * @disk: disk to create partition on
- * @type: type of the partition to create (if %BD_PART_TYPE_REQ_NEXT, the
- *        partition type will be determined automatically based on the existing
- *        partitions)
- * @start: where the partition should start (i.e. offset from the disk start)
- * @size: desired size of the partition (if 0, a max-sized partition is created)
- * @align: alignment to use for the partition
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: (transfer full): specification of the created partition or %NULL in case of error
- *
- * NOTE: The resulting partition may start at a different position than given by
- *       @start and can have different size than @size due to alignment.
- *
- * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
- */
-BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64 start, guint64 size, BDPartAlign align, GError **error) {
-    struct fdisk_context *cxt = NULL;
+/* adds a new partition to the (in-memory) partition table of @cxt, returns the
+   new partition object (to get the partition number from) */
+static struct fdisk_partition* add_part (struct fdisk_context *cxt, BDPartTypeReq type, guint64 start, guint64 size, BDPartAlign align, gboolean *new_extended, GError **error) {
     struct fdisk_partition *npa = NULL;
     gint status = 0;
-    BDPartSpec *ret = NULL;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
     guint64 sector_size = 0;
     guint64 grain_size = 0;
     guint64 end = 0;
@@ -968,41 +1412,19 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
     guint n_parts = 0;
     gboolean on_gpt = FALSE;
     size_t partno = 0;
-    gchar *ppath = NULL;
-    gboolean new_extended = FALSE;
-    GError *l_error = NULL;
-
-    msg = g_strdup_printf ("Started adding partition to '%s'", disk);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
-
-    cxt = get_device_context (disk, FALSE, &l_error);
-    if (!cxt) {
-        /* error is already populated */
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return NULL;
-    }
 
     status = fdisk_get_partitions (cxt, &table);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get existing partitions on the device: %s", strerror_l (-status, c_locale));
-        fdisk_unref_partition (npa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return NULL;
-   }
+    }
 
     npa = fdisk_new_partition ();
     if (!npa) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to create new partition object");
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return NULL;
     }
 
@@ -1017,12 +1439,10 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
 
     status = fdisk_save_user_grain (cxt, grain_size);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to setup alignment");
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+        fdisk_unref_partition (npa);
         return NULL;
     }
 
@@ -1030,12 +1450,10 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
      * effective */
     status = fdisk_reset_device_properties (cxt);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to setup alignment");
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+        fdisk_unref_partition (npa);
         return NULL;
     }
 
@@ -1071,13 +1489,10 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
         size = end - start;
 
         if (fdisk_partition_set_size (npa, size) != 0) {
-            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to set partition size");
             fdisk_unref_table (table);
             fdisk_unref_partition (npa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
             return NULL;
         }
     }
@@ -1091,13 +1506,10 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
       type = BD_PART_TYPE_REQ_NORMAL;
 
     if (on_gpt && type != BD_PART_TYPE_REQ_NORMAL) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Only normal partitions are supported on GPT.");
         fdisk_unref_table (table);
         fdisk_unref_partition (npa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return NULL;
     }
 
@@ -1115,21 +1527,19 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
                 in_pa = pa;
             n_parts++;
         }
-          if (in_pa) {
+        fdisk_free_iter (iter);
+
+        if (in_pa) {
             if (epa == in_pa)
                 /* creating a partition inside an extended partition -> LOGICAL */
                 type = BD_PART_TYPE_REQ_LOGICAL;
             else {
                 /* trying to create a partition inside an existing one, but not
                    an extended one -> error */
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
                              "Cannot create a partition inside an existing non-extended one");
                 fdisk_unref_partition (npa);
-                fdisk_free_iter (iter);
                 fdisk_unref_table (table);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
                 return NULL;
             }
         } else if (epa)
@@ -1140,27 +1550,21 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
             /* already 3 primary partitions -> create an extended partition of
                the biggest possible size and a logical partition as requested in
                it */
-            new_extended = TRUE;
+            *new_extended = TRUE;
             n_epa = fdisk_new_partition ();
             if (!n_epa) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to create new partition object");
                 fdisk_unref_partition (npa);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
+                fdisk_unref_table (table);
                 return NULL;
             }
             if (fdisk_partition_set_start (n_epa, start) != 0) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to set partition start");
                 fdisk_unref_partition (n_epa);
                 fdisk_unref_partition (npa);
-                fdisk_free_iter (iter);
                 fdisk_unref_table (table);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
                 return NULL;
             }
 
@@ -1168,23 +1572,21 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
 
             status = fdisk_partition_next_partno (npa, cxt, &partno);
             if (status != 0) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to get new extended partition number");
+                fdisk_unref_partition (n_epa);
                 fdisk_unref_partition (npa);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
+                fdisk_unref_table (table);
                 return NULL;
             }
 
             status = fdisk_partition_set_partno (npa, partno);
             if (status != 0) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to set new extended partition number");
+                fdisk_unref_partition (n_epa);
                 fdisk_unref_partition (npa);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
+                fdisk_unref_table (table);
                 return NULL;
             }
 
@@ -1194,15 +1596,12 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
             /* "05" for extended partition */
             ptype = fdisk_label_parse_parttype (fdisk_get_label (cxt, NULL), "05");
             if (fdisk_partition_set_type (n_epa, ptype) != 0) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to set partition type");
+                fdisk_unref_parttype (ptype);
                 fdisk_unref_partition (n_epa);
                 fdisk_unref_partition (npa);
-                fdisk_free_iter (iter);
                 fdisk_unref_table (table);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
                 return NULL;
             }
             fdisk_unref_parttype (ptype);
@@ -1210,14 +1609,10 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
             status = fdisk_add_partition (cxt, n_epa, NULL);
             fdisk_unref_partition (n_epa);
             if (status != 0) {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Failed to add new partition to the table: %s", strerror_l (-status, c_locale));
                 fdisk_unref_partition (npa);
-                fdisk_free_iter (iter);
                 fdisk_unref_table (table);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
                 return NULL;
             }
             /* shift the start 2 MiB further as that's where the first logical
@@ -1228,22 +1623,20 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
             /* no extended partition and not 3 primary partitions -> just create
                another primary (NORMAL) partition*/
             type = BD_PART_TYPE_REQ_NORMAL;
-
-        fdisk_free_iter (iter);
     }
 
+    /* the table is only needed for the decisions above */
+    fdisk_unref_table (table);
+
     if (type == BD_PART_TYPE_REQ_EXTENDED) {
-        new_extended = TRUE;
+        *new_extended = TRUE;
         /* "05" for extended partition */
         ptype = fdisk_label_parse_parttype (fdisk_get_label (cxt, NULL), "05");
         if (fdisk_partition_set_type (npa, ptype) != 0) {
-            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to set partition type");
-            fdisk_unref_table (table);
+            fdisk_unref_parttype (ptype);
             fdisk_unref_partition (npa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
             return NULL;
         }
 
@@ -1251,13 +1644,9 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
     }
 
     if (fdisk_partition_set_start (npa, start) != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set partition start");
-        fdisk_unref_table (table);
         fdisk_unref_partition (npa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return NULL;
     }
 
@@ -1270,35 +1659,95 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
     } else {
         status = fdisk_partition_next_partno (npa, cxt, &partno);
         if (status != 0) {
-            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to get new partition number");
-            fdisk_unref_table (table);
             fdisk_unref_partition (npa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
             return NULL;
         }
     }
 
     status = fdisk_partition_set_partno (npa, partno);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set new partition number");
-        fdisk_unref_table (table);
         fdisk_unref_partition (npa);
-        close_context (cxt);
+        return NULL;
+    }
+
+    status = fdisk_add_partition (cxt, npa, NULL);
+    if (status != 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to add new partition to the table: %s", strerror_l (-status, c_locale));
+        fdisk_unref_partition (npa);
+        return NULL;
+    }
+
+    return npa;
+}
+
+static gchar* get_part_path (const gchar *disk, size_t partno) {
+    if (isdigit (disk[strlen (disk) - 1]))
+        return g_strdup_printf ("%sp%zu", disk, partno + 1);
+    else
+        return g_strdup_printf ("%s%zu", disk, partno + 1);
+}
+
+/**
+ * bd_part_create_part:
+ * @disk: disk to create partition on
+ * @type: type of the partition to create (if %BD_PART_TYPE_REQ_NEXT, the
+ *        partition type will be determined automatically based on the existing
+ *        partitions)
+ * @start: where the partition should start (i.e. offset from the disk start)
+ * @size: desired size of the partition (if 0, a max-sized partition is created)
+ * @align: alignment to use for the partition
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: (transfer full): specification of the created partition or %NULL in case of error
+ *
+ * NOTE: The resulting partition may start at a different position than given by
+ *       @start and can have different size than @size due to alignment.
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64 start, guint64 size, BDPartAlign align, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    struct fdisk_partition *npa = NULL;
+    struct fdisk_table *table = NULL;
+    gint status = 0;
+    BDPartSpec *ret = NULL;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    gchar *ppath = NULL;
+    gboolean new_extended = FALSE;
+    GError *l_error = NULL;
+
+    msg = g_strdup_printf ("Started adding partition to '%s'", disk);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    cxt = get_device_context (disk, FALSE, &l_error);
+    if (!cxt) {
+        /* error is already populated */
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return NULL;
     }
 
-    status = fdisk_add_partition (cxt, npa, NULL);
+    /* original layout for the kernel to be informed about the changes */
+    status = fdisk_get_partitions (cxt, &table);
     if (status != 0) {
         g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to add new partition to the table: %s", strerror_l (-status, c_locale));
+                     "Failed to get existing partitions on the device: %s", strerror_l (-status, c_locale));
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    npa = add_part (cxt, type, start, size, align, &new_extended, &l_error);
+    if (!npa) {
         fdisk_unref_table (table);
-        fdisk_unref_partition (npa);
         close_context (cxt);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
@@ -1316,12 +1765,8 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
         return NULL;
     }
 
-    if (fdisk_partition_has_partno (npa)) {
-        if (isdigit (disk[strlen (disk) - 1]))
-            ppath = g_strdup_printf ("%sp%zu", disk, fdisk_partition_get_partno (npa) + 1);
-        else
-            ppath = g_strdup_printf ("%s%zu", disk, fdisk_partition_get_partno (npa) + 1);
-    }
+    if (fdisk_partition_has_partno (npa))
+        ppath = get_part_path (disk, fdisk_partition_get_partno (npa));
 
     /* close the context now, we no longer need it */
     fdisk_unref_table (table);
@@ -1339,6 +1784,28 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
     return ret;
 }
 
+/* removes the partition from the (in-memory) partition table of @cxt */
+static gboolean remove_part (struct fdisk_context *cxt, const gchar *disk, const gchar *part, GError **error) {
+    gint part_num = 0;
+    gint ret = 0;
+
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
+        return FALSE;
+
+    /* /dev/sda1 is the partition number 0 in libfdisk */
+    part_num--;
+
+    ret = fdisk_delete_partition (cxt, (size_t) part_num);
+    if (ret != 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to delete partition '%d' on device '%s': %s", part_num+1, disk, strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * bd_part_delete_part:
  * @disk: disk to remove the partition from
@@ -1350,7 +1817,6 @@ BDPartSpec* bd_part_create_part (const gchar *disk, BDPartTypeReq type, guint64
  * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
  */
 gboolean bd_part_delete_part (const gchar *disk, const gchar *part, GError **error) {
-    gint part_num = 0;
     struct fdisk_context *cxt = NULL;
     struct fdisk_table *table = NULL;
     gint ret = 0;
@@ -1362,15 +1828,12 @@ gboolean bd_part_delete_part (const gchar *disk, const gchar *part, GError **err
     progress_id = bd_utils_report_started (msg);
     g_free (msg);
 
-    part_num = get_part_num (part, &l_error);
-    if (part_num == -1) {
+    if (get_part_num (part, &l_error) == -1) {
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    /* /dev/sda1 is the partition number 0 in libfdisk */
-    part_num--;
     cxt = get_device_context (disk, FALSE, &l_error);
     if (!cxt) {
         /* error is already populated */
@@ -1389,10 +1852,7 @@ gboolean bd_part_delete_part (const gchar *disk, const gchar *part, GError **err
         return FALSE;
    }
 
-    ret = fdisk_delete_partition (cxt, (size_t) part_num);
-    if (ret != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to delete partition '%d' on device '%s': %s", part_num+1, disk, strerror_l (-ret, c_locale));
+    if (!remove_part (cxt, disk, part, &l_error)) {
         fdisk_unref_table (table);
         close_context (cxt);
         bd_utils_report_finished (progress_id, l_error->message);
@@ -1489,78 +1949,44 @@ static gboolean get_max_part_size (struct fdisk_table *tb, guint partno, guint64
     return TRUE;
 }
 
-/**
- * bd_part_resize_part:
- * @disk: disk containing the partition
- * @part: partition to resize
- * @size: new partition size, 0 for maximal size
- * @align: alignment to use for the partition end
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the @part partition was successfully resized on @disk to @size
- *
- * NOTE: The resulting partition may be slightly bigger than requested due to alignment.
- *
- * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
- */
-gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size, BDPartAlign align, GError **error) {
+/* resizes the partition in the (in-memory) partition table of @cxt, @resized is
+   set to whether the partition needed to be resized */
+static gboolean resize_part (struct fdisk_context *cxt, const gchar *disk, const gchar *part, guint64 size, BDPartAlign align, gboolean *resized, GError **error) {
     gint part_num = 0;
-    struct fdisk_context *cxt = NULL;
     struct fdisk_table *table = NULL;
     struct fdisk_partition *pa = NULL;
     gint ret = 0;
     guint64 old_size = 0;
     guint64 sector_size = 0;
     guint64 grain_size = 0;
-    guint64 progress_id = 0;
     guint64 max_size = 0;
     guint64 start = 0;
     guint64 end = 0;
     gint version = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
 
-    msg = g_strdup_printf ("Started resizing partition '%s'", part);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
+    *resized = FALSE;
 
-    part_num = get_part_num (part, &l_error);
-    if (part_num == -1) {
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
         return FALSE;
-    }
 
     /* /dev/sda1 is the partition number 0 in libfdisk */
     part_num--;
-    cxt = get_device_context (disk, FALSE, &l_error);
-    if (!cxt) {
-        /* error is already populated */
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
-    }
 
     /* get existing partitions and free spaces and sort the table */
     ret = fdisk_get_partitions (cxt, &table);
     if (ret != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get existing partitions on the device: %s", strerror_l (-ret, c_locale));
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     ret = fdisk_get_freespaces (cxt, &table);
     if (ret != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get free spaces on the device: %s", strerror_l (-ret, c_locale));
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
@@ -1568,25 +1994,19 @@ gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size
 
     ret = fdisk_get_partition (cxt, part_num, &pa);
     if (ret != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get partition %d on device '%s'", part_num, disk);
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     if (fdisk_partition_has_size (pa))
         old_size = (guint64) fdisk_partition_get_size (pa);
     else {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get size for partition %d on device '%s'", part_num, disk);
         fdisk_unref_partition (pa);
         fdisk_unref_table (table);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
@@ -1600,23 +2020,20 @@ gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size
         grain_size = (guint64) fdisk_get_minimal_iosize (cxt);
     /* else OPTIMAL or unknown -> nothing to do */
 
-    if (!get_max_part_size (table, part_num, &max_size, &l_error)) {
-        g_prefix_error (&l_error, "Failed to get maximal size for '%s': ", part);
+    if (!get_max_part_size (table, part_num, &max_size, error)) {
+        g_prefix_error (error, "Failed to get maximal size for '%s': ", part);
         fdisk_unref_table (table);
         fdisk_unref_partition (pa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
+    /* the table is only needed for the maximal size */
+    fdisk_unref_table (table);
+
     if (size == 0) {
         if (max_size == old_size) {
             bd_utils_log_format (BD_UTILS_LOG_INFO, "Not resizing, partition '%s' is already at its maximum size.", part);
-            fdisk_unref_table (table);
             fdisk_unref_partition (pa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, "Completed");
             return TRUE;
         }
 
@@ -1631,13 +2048,9 @@ gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size
         }
 
         if (fdisk_partition_set_size (pa, max_size) != 0) {
-            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to set size for partition %d on device '%s'", part_num, disk);
-            fdisk_unref_table (table);
             fdisk_unref_partition (pa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
             return FALSE;
         }
     } else {
@@ -1648,10 +2061,7 @@ gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size
 
         if (size == old_size) {
             bd_utils_log_format (BD_UTILS_LOG_INFO, "Not resizing, new size after alignment is the same as the old size.");
-            fdisk_unref_table (table);
             fdisk_unref_partition (pa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, "Completed");
             return TRUE;
         }
 
@@ -1662,63 +2072,121 @@ gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size
                                      size * sector_size, part, max_size * sector_size);
                 size = max_size;
             } else {
-                g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                              "Requested size %"G_GUINT64_FORMAT" is bigger than max size (%"G_GUINT64_FORMAT") for partition '%s'",
                              size * sector_size, max_size * sector_size, part);
-                fdisk_unref_table (table);
                 fdisk_unref_partition (pa);
-                close_context (cxt);
-                bd_utils_report_finished (progress_id, l_error->message);
-                g_propagate_error (error, l_error);
                 return FALSE;
             }
         }
 
         if (fdisk_partition_set_size (pa, size) != 0) {
-            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                          "Failed to set partition size");
-            fdisk_unref_table (table);
             fdisk_unref_partition (pa);
-            close_context (cxt);
-            bd_utils_report_finished (progress_id, l_error->message);
-            g_propagate_error (error, l_error);
             return FALSE;
         }
     }
 
     ret = fdisk_set_partition (cxt, part_num, pa);
     if (ret != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to resize partition '%s': %s", part, strerror_l (-ret, c_locale));
-        fdisk_unref_table (table);
-        fdisk_unref_partition (pa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        return FALSE;
-    }
-
-    if (!write_label (cxt, table, disk, FALSE, &l_error)) {
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        fdisk_unref_table (table);
         fdisk_unref_partition (pa);
-        close_context (cxt);
         return FALSE;
     }
-
-    fdisk_unref_table (table);
+    *resized = TRUE;
 
     /* XXX: double free in libfdisk, see https://github.com/karelzak/util-linux/pull/822
     fdisk_unref_partition (pa); */
-    close_context (cxt);
-
-    bd_utils_report_finished (progress_id, "Completed");
 
     return TRUE;
 }
 
-static gboolean set_part_type (struct fdisk_context *cxt, gint part_num, const gchar *type_str, BDPartTableType table_type, GError **error) {
+/**
+ * bd_part_resize_part:
+ * @disk: disk containing the partition
+ * @part: partition to resize
+ * @size: new partition size, 0 for maximal size
+ * @align: alignment to use for the partition end
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the @part partition was successfully resized on @disk to @size
+ *
+ * NOTE: The resulting partition may be slightly bigger than requested due to alignment.
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+gboolean bd_part_resize_part (const gchar *disk, const gchar *part, guint64 size, BDPartAlign align, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    struct fdisk_table *table = NULL;
+    gboolean resized = FALSE;
+    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    msg = g_strdup_printf ("Started resizing partition '%s'", part);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    if (get_part_num (part, &l_error) == -1) {
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    cxt = get_device_context (disk, FALSE, &l_error);
+    if (!cxt) {
+        /* error is already populated */
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    ret = fdisk_get_partitions (cxt, &table);
+    if (ret != 0) {
+        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to get existing partitions on the device: %s", strerror_l (-ret, c_locale));
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (!resize_part (cxt, disk, part, size, align, &resized, &l_error)) {
+        fdisk_unref_table (table);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (!resized) {
+        /* nothing to do (already the requested size) */
+        fdisk_unref_table (table);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, "Completed");
+        return TRUE;
+    }
+
+    if (!write_label (cxt, table, disk, FALSE, &l_error)) {
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        fdisk_unref_table (table);
+        close_context (cxt);
+        return FALSE;
+    }
+
+    fdisk_unref_table (table);
+    close_context (cxt);
+
+    bd_utils_report_finished (progress_id, "Completed");
+
+    return TRUE;
+}
+
+static gboolean set_part_type (struct fdisk_context *cxt, gint part_num, const gchar *type_str, BDPartTableType table_type, GError **error) {
     struct fdisk_label *lb = NULL;
     struct fdisk_partition *pa = NULL;
     struct fdisk_parttype *ptype = NULL;
@@ -1786,107 +2254,100 @@ static gboolean set_part_type (struct fdisk_context *cxt, gint part_num, const g
     return TRUE;
 }
 
-/**
- * bd_part_set_part_name:
- * @disk: device the partition belongs to
- * @part: partition the name should be set for
- * @name: name to set
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the name was successfully set or not
- *
- * Tech category: %BD_PART_TECH_MODE_MODIFY_PART + the tech according to the partition table type
- */
-gboolean bd_part_set_part_name (const gchar *disk, const gchar *part, const gchar *name, GError **error) {
-    struct fdisk_context *cxt = NULL;
+/* sets name of the partition in the (in-memory) partition table of @cxt */
+static gboolean set_part_name (struct fdisk_context *cxt, const gchar *disk, const gchar *part, const gchar *name, GError **error) {
     struct fdisk_label *lb = NULL;
     struct fdisk_partition *pa = NULL;
     const gchar *label_name = NULL;
     gint part_num = 0;
     gint status = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
-
-    msg = g_strdup_printf ("Started setting name on the partition '%s'", part);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
-
-    cxt = get_device_context (disk, FALSE, error);
-    if (!cxt) {
-        /* error is already populated */
-        return FALSE;
-    }
 
     lb = fdisk_get_label (cxt, NULL);
     if (!lb) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to read partition table on device '%s'", disk);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     label_name = fdisk_label_get_name (lb);
     if (g_strcmp0 (label_name, table_type_str[BD_PART_TABLE_GPT]) != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
                      "Partition names unsupported on the device '%s' ('%s')", disk,
                      label_name);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    part_num = get_part_num (part, &l_error);
-    if (part_num == -1) {
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
         return FALSE;
-    }
 
     /* /dev/sda1 is the partition number 0 in libfdisk */
     part_num--;
 
     status = fdisk_get_partition (cxt, part_num, &pa);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     status = fdisk_partition_set_name (pa, name);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set name on the partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
         fdisk_unref_partition (pa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     status = fdisk_set_partition (cxt, part_num, pa);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set name on the partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
         fdisk_unref_partition (pa);
+        return FALSE;
+    }
+
+    fdisk_unref_partition (pa);
+    return TRUE;
+}
+
+/**
+ * bd_part_set_part_name:
+ * @disk: device the partition belongs to
+ * @part: partition the name should be set for
+ * @name: name to set
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the name was successfully set or not
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_PART + the tech according to the partition table type
+ */
+gboolean bd_part_set_part_name (const gchar *disk, const gchar *part, const gchar *name, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
+
+    msg = g_strdup_printf ("Started setting name on the partition '%s'", part);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    cxt = get_device_context (disk, FALSE, error);
+    if (!cxt) {
+        /* error is already populated */
+        return FALSE;
+    }
+
+    if (!set_part_name (cxt, disk, part, name, &l_error)) {
         close_context (cxt);
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    fdisk_unref_partition (pa);
-
     if (!write_label (cxt, NULL, disk, FALSE, &l_error)) {
         bd_utils_report_finished (progress_id, l_error->message);
         g_propagate_error (error, l_error);
@@ -2017,160 +2478,138 @@ gboolean bd_part_set_part_id (const gchar *disk, const gchar *part, const gchar
     return TRUE;
 }
 
-/**
- * bd_part_set_part_uuid:
- * @disk: device the partition belongs to
- * @part: partition the UUID should be set for
- * @uuid: partition UUID to set
- * @error: (out) (optional): place to store error (if any)
- *
- * Returns: whether the @uuid type was successfully set for @part or not
- *
- * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
- */
-gboolean bd_part_set_part_uuid (const gchar *disk, const gchar *part, const gchar *uuid, GError **error) {
-    struct fdisk_context *cxt = NULL;
+/* sets UUID of the partition in the (in-memory) partition table of @cxt */
+static gboolean set_part_uuid (struct fdisk_context *cxt, const gchar *disk, const gchar *part, const gchar *uuid, GError **error) {
     struct fdisk_partition *pa = NULL;
     struct fdisk_label *lb = NULL;
     const gchar *label_name = NULL;
     gint part_num = 0;
     gint status = 0;
-    guint64 progress_id = 0;
-    gchar *msg = NULL;
-    GError *l_error = NULL;
-
-    msg = g_strdup_printf ("Started setting UUID on the partition '%s'", part);
-    progress_id = bd_utils_report_started (msg);
-    g_free (msg);
-
-    cxt = get_device_context (disk, FALSE, error);
-    if (!cxt) {
-        /* error is already populated */
-        return FALSE;
-    }
 
     lb = fdisk_get_label (cxt, NULL);
     if (!lb) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to read partition table on device '%s'", disk);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     label_name = fdisk_label_get_name (lb);
     if (g_strcmp0 (label_name, table_type_str[BD_PART_TABLE_GPT]) != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
                      "Partition UUIDs unsupported on the device '%s' ('%s')", disk,
                      label_name);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
-    part_num = get_part_num (part, &l_error);
-    if (part_num == -1) {
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
         return FALSE;
-    }
 
     /* /dev/sda1 is the partition number 0 in libfdisk */
     part_num--;
 
     status = fdisk_get_partition (cxt, part_num, &pa);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     status = fdisk_partition_set_uuid (pa, uuid);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set UUID on the partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
         fdisk_unref_partition (pa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     status = fdisk_set_partition (cxt, part_num, pa);
     if (status != 0) {
-        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set UUID on the partition '%s' on device '%s': %s",
                      part, disk, strerror_l (-status, c_locale));
         fdisk_unref_partition (pa);
-        close_context (cxt);
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
         return FALSE;
     }
 
     fdisk_unref_partition (pa);
-
-    if (!write_label (cxt, NULL, disk, FALSE, &l_error)) {
-        bd_utils_report_finished (progress_id, l_error->message);
-        g_propagate_error (error, l_error);
-        close_context (cxt);
-        return FALSE;
-    }
-
-    close_context (cxt);
-    bd_utils_report_finished (progress_id, "Completed");
     return TRUE;
 }
 
 /**
- * bd_part_set_part_bootable:
+ * bd_part_set_part_uuid:
  * @disk: device the partition belongs to
- * @part: partition the bootable flag should be set for
- * @bootable: whether to set or unset the bootable flag
+ * @part: partition the UUID should be set for
+ * @uuid: partition UUID to set
  * @error: (out) (optional): place to store error (if any)
  *
- * Returns: whether the @bootable flag was successfully set for @part or not
+ * Returns: whether the @uuid type was successfully set for @part or not
  *
- * Tech category: %BD_PART_TECH_MBR-%BD_PART_TECH_MODE_MODIFY_PART
+ * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
  */
-gboolean bd_part_set_part_bootable (const gchar *disk, const gchar *part, gboolean bootable, GError **error) {
+gboolean bd_part_set_part_uuid (const gchar *disk, const gchar *part, const gchar *uuid, GError **error) {
     struct fdisk_context *cxt = NULL;
-    gint part_num = 0;
-    struct fdisk_partition *pa = NULL;
-    gint ret = 0;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    GError *l_error = NULL;
 
-    part_num = get_part_num (part, error);
+    msg = g_strdup_printf ("Started setting UUID on the partition '%s'", part);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    cxt = get_device_context (disk, FALSE, error);
+    if (!cxt) {
+        /* error is already populated */
+        return FALSE;
+    }
+
+    if (!set_part_uuid (cxt, disk, part, uuid, &l_error)) {
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return FALSE;
+    }
+
+    if (!write_label (cxt, NULL, disk, FALSE, &l_error)) {
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        close_context (cxt);
+        return FALSE;
+    }
+
+    close_context (cxt);
+    bd_utils_report_finished (progress_id, "Completed");
+    return TRUE;
+}
+
+/* sets/unsets the bootable flag of the partition in the (in-memory) partition
+   table of @cxt, @changed is set to whether the flag needed to be changed */
+static gboolean set_part_bootable (struct fdisk_context *cxt, const gchar *part, gboolean bootable, gboolean *changed, GError **error) {
+    gint part_num = 0;
+    struct fdisk_partition *pa = NULL;
+    gint ret = 0;
+
+    part_num = get_part_num (part, error);
     if (part_num == -1)
         return FALSE;
 
     /* /dev/sda1 is the partition number 0 in libfdisk */
     part_num--;
 
-    cxt = get_device_context (disk, FALSE, error);
-    if (!cxt)
-        return FALSE;
-
     ret = fdisk_get_partition (cxt, part_num, &pa);
     if (ret != 0) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to get partition '%d'.", part_num);
-        close_context (cxt);
         return FALSE;
     }
 
     ret = fdisk_partition_is_bootable (pa);
+    fdisk_unref_partition (pa);
     if ((ret == 1 && bootable) || (ret != 1 && !bootable)) {
         /* boot flag is already set as desired, no change needed */
-        fdisk_unref_partition (pa);
-        close_context (cxt);
+        *changed = FALSE;
         return TRUE;
     }
 
@@ -2178,23 +2617,72 @@ gboolean bd_part_set_part_bootable (const gchar *disk, const gchar *part, gboole
     if (ret != 0) {
         g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
                      "Failed to set partition bootable flag: %s", strerror_l (-ret, c_locale));
-        fdisk_unref_partition (pa);
+        return FALSE;
+    }
+
+    *changed = TRUE;
+    return TRUE;
+}
+
+/**
+ * bd_part_set_part_bootable:
+ * @disk: device the partition belongs to
+ * @part: partition the bootable flag should be set for
+ * @bootable: whether to set or unset the bootable flag
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the @bootable flag was successfully set for @part or not
+ *
+ * Tech category: %BD_PART_TECH_MBR-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_set_part_bootable (const gchar *disk, const gchar *part, gboolean bootable, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    gboolean changed = FALSE;
+
+    if (get_part_num (part, error) == -1)
+        return FALSE;
+
+    cxt = get_device_context (disk, FALSE, error);
+    if (!cxt)
+        return FALSE;
+
+    if (!set_part_bootable (cxt, part, bootable, &changed, error)) {
         close_context (cxt);
         return FALSE;
     }
 
-    if (!write_label (cxt, NULL, disk, FALSE, error)) {
-        fdisk_unref_partition (pa);
+    if (changed && !write_label (cxt, NULL, disk, FALSE, error)) {
         close_context (cxt);
         return FALSE;
     }
 
-    fdisk_unref_partition (pa);
     close_context (cxt);
 
     return TRUE;
 }
 
+/* sets GPT attributes of the partition in the (in-memory) partition table of @cxt */
+static gboolean set_part_attributes (struct fdisk_context *cxt, const gchar *part, guint64 attrs, GError **error) {
+    gint part_num = 0;
+    gint ret = 0;
+
+    part_num = get_part_num (part, error);
+    if (part_num == -1)
+        return FALSE;
+
+    /* /dev/sda1 is the partition number 0 in libfdisk */
+    part_num--;
+
+    ret = fdisk_gpt_set_partition_attrs (cxt, part_num, attrs);
+    if (ret < 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to set GPT attributes: %s", strerror_l (-ret, c_locale));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * bd_part_set_part_attributes:
  * @disk: device the partition belongs to
@@ -2208,24 +2696,16 @@ gboolean bd_part_set_part_bootable (const gchar *disk, const gchar *part, gboole
  */
 gboolean bd_part_set_part_attributes (const gchar *disk, const gchar *part, guint64 attrs, GError **error) {
     struct fdisk_context *cxt = NULL;
-    gint part_num = 0;
-    gint ret = 0;
 
-    part_num = get_part_num (part, error);
-    if (part_num == -1)
+    if (get_part_num (part, error) == -1)
         return FALSE;
 
-    /* /dev/sda1 is the partition number 0 in libfdisk */
-    part_num--;
-
     cxt = get_device_context (disk, FALSE, error);
     if (!cxt)
         return FALSE;
 
-    ret = fdisk_gpt_set_partition_attrs (cxt, part_num, attrs);
-    if (ret < 0) {
-        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
-                     "Failed to set GPT attributes: %s", strerror_l (-ret, c_locale));
+    if (!set_part_attributes (cxt, part, attrs, error)) {
+        close_context (cxt);
         return FALSE;
     }
 
@@ -2239,6 +2719,979 @@ gboolean bd_part_set_part_attributes (const gchar *disk, const gchar *part, guin
     return TRUE;
 }
 
+/**
+ * bd_part_transaction_new:
+ * @disk: disk the transaction should modify
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Creates a new transaction for modifying the partition table on @disk. Changes
+ * queued in the transaction are only applied by bd_part_transaction_commit(),
+ * @disk is not touched before that.
+ *
+ * Returns: (transfer full): a new transaction for @disk or %NULL in case of error
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+BDPartTransaction* bd_part_transaction_new (const gchar *disk, GError **error) {
+    BDPartTransaction *ret = NULL;
+
+    if (!disk || !g_file_test (disk, G_FILE_TEST_EXISTS)) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Disk '%s' doesn't exist", disk ? disk : "");
+        return NULL;
+    }
+
+    ret = g_new0 (BDPartTransaction, 1);
+    ret->disk = g_strdup (disk);
+
+    return ret;
+}
+
+static void part_transaction_op_free (BDPartTransactionOp *op) {
+    g_free (op->part);
+    g_free (op->value);
+    g_free (op);
+}
+
+static BDPartTransactionOp* part_transaction_add_op (BDPartTransaction *trans, BDPartTransactionOpType type, const gchar *part, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    /* make sure the partition is valid before queuing the operation */
+    if (part && get_part_num (part, error) == -1)
+        return NULL;
+
+    op = g_new0 (BDPartTransactionOp, 1);
+    op->type = type;
+    op->part = g_strdup (part);
+    trans->ops = g_list_append (trans->ops, op);
+
+    return op;
+}
+
+/**
+ * bd_part_transaction_create_part:
+ * @trans: transaction to queue the operation in
+ * @type: type of the partition to create (see bd_part_create_part())
+ * @start: where the partition should start (i.e. offset from the disk start)
+ * @size: desired size of the partition (if 0, a max-sized partition is created)
+ * @align: alignment to use for the partition
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Queues creation of a new partition in @trans. See bd_part_create_part() for
+ * details.
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+gboolean bd_part_transaction_create_part (BDPartTransaction *trans, BDPartTypeReq type, guint64 start, guint64 size, BDPartAlign align, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_CREATE, NULL, error);
+    if (!op)
+        return FALSE;
+
+    op->type_req = type;
+    op->start = start;
+    op->size = size;
+    op->align = align;
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_delete_part:
+ * @trans: transaction to queue the operation in
+ * @part: partition to remove
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Queues removal of the @part partition in @trans.
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+gboolean bd_part_transaction_delete_part (BDPartTransaction *trans, const gchar *part, GError **error) {
+    return part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_DELETE, part, error) != NULL;
+}
+
+/**
+ * bd_part_transaction_resize_part:
+ * @trans: transaction to queue the operation in
+ * @part: partition to resize
+ * @size: new partition size, 0 for maximal size
+ * @align: alignment to use for the partition end
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Queues resize of the @part partition in @trans. See bd_part_resize_part()
+ * for details.
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+gboolean bd_part_transaction_resize_part (BDPartTransaction *trans, const gchar *part, guint64 size, BDPartAlign align, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_RESIZE, part, error);
+    if (!op)
+        return FALSE;
+
+    op->size = size;
+    op->align = align;
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_name:
+ * @trans: transaction to queue the operation in
+ * @part: partition the name should be set for
+ * @name: name to set
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_name (BDPartTransaction *trans, const gchar *part, const gchar *name, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_NAME, part, error);
+    if (!op)
+        return FALSE;
+
+    op->value = g_strdup (name);
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_type:
+ * @trans: transaction to queue the operation in
+ * @part: partition the type should be set for
+ * @type_guid: GUID of the type
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_type (BDPartTransaction *trans, const gchar *part, const gchar *type_guid, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_TYPE, part, error);
+    if (!op)
+        return FALSE;
+
+    op->value = g_strdup (type_guid);
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_id:
+ * @trans: transaction to queue the operation in
+ * @part: partition the ID should be set for
+ * @part_id: partition Id
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_MBR-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_id (BDPartTransaction *trans, const gchar *part, const gchar *part_id, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_ID, part, error);
+    if (!op)
+        return FALSE;
+
+    op->value = g_strdup (part_id);
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_uuid:
+ * @trans: transaction to queue the operation in
+ * @part: partition the UUID should be set for
+ * @uuid: partition UUID to set
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_uuid (BDPartTransaction *trans, const gchar *part, const gchar *uuid, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_UUID, part, error);
+    if (!op)
+        return FALSE;
+
+    op->value = g_strdup (uuid);
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_bootable:
+ * @trans: transaction to queue the operation in
+ * @part: partition the bootable flag should be set for
+ * @bootable: whether to set or unset the bootable flag
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_MBR-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_bootable (BDPartTransaction *trans, const gchar *part, gboolean bootable, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_BOOTABLE, part, error);
+    if (!op)
+        return FALSE;
+
+    op->attrs = bootable ? 1 : 0;
+
+    return TRUE;
+}
+
+/**
+ * bd_part_transaction_set_part_attributes:
+ * @trans: transaction to queue the operation in
+ * @part: partition the attributes should be set for
+ * @attrs: GPT attributes to set on @part
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Returns: whether the operation was successfully queued or not
+ *
+ * Tech category: %BD_PART_TECH_GPT-%BD_PART_TECH_MODE_MODIFY_PART
+ */
+gboolean bd_part_transaction_set_part_attributes (BDPartTransaction *trans, const gchar *part, guint64 attrs, GError **error) {
+    BDPartTransactionOp *op = NULL;
+
+    op = part_transaction_add_op (trans, BD_PART_TRANSACTION_OP_SET_ATTRIBUTES, part, error);
+    if (!op)
+        return FALSE;
+
+    op->attrs = attrs;
+
+    return TRUE;
+}
+
+static gboolean part_transaction_apply_op (struct fdisk_context *cxt, const gchar *disk, BDPartTransactionOp *op,
+                                           gboolean *new_extended, GArray *created, GError **error) {
+    struct fdisk_partition *npa = NULL;
+    gboolean changed = FALSE;
+    size_t partno = 0;
+    guint i = 0;
+
+    switch (op->type) {
+        case BD_PART_TRANSACTION_OP_CREATE:
+            npa = add_part (cxt, op->type_req, op->start, op->size, op->align, new_extended, error);
+            if (!npa)
+                return FALSE;
+            if (fdisk_partition_has_partno (npa)) {
+                partno = fdisk_partition_get_partno (npa);
+                /* the same partition number may be created again after
+                   a removal in the same transaction, report it just once */
+                for (i = 0; i < created->len; i++)
+                    if (g_array_index (created, size_t, i) == partno)
+                        break;
+                if (i == created->len)
+                    g_array_append_val (created, partno);
+            }
+            fdisk_unref_partition (npa);
+            return TRUE;
+        case BD_PART_TRANSACTION_OP_DELETE:
+            return remove_part (cxt, disk, op->part, error);
+        case BD_PART_TRANSACTION_OP_RESIZE:
+            return resize_part (cxt, disk, op->part, op->size, op->align, &changed, error);
+        case BD_PART_TRANSACTION_OP_SET_NAME:
+            return set_part_name (cxt, disk, op->part, op->value, error);
+        case BD_PART_TRANSACTION_OP_SET_TYPE:
+            return set_part_type (cxt, get_part_num (op->part, NULL) - 1, op->value, BD_PART_TABLE_GPT, error);
+        case BD_PART_TRANSACTION_OP_SET_ID:
+            return set_part_type (cxt, get_part_num (op->part, NULL) - 1, op->value, BD_PART_TABLE_MSDOS, error);
+        case BD_PART_TRANSACTION_OP_SET_UUID:
+            return set_part_uuid (cxt, disk, op->part, op->value, error);
+        case BD_PART_TRANSACTION_OP_SET_BOOTABLE:
+            return set_part_bootable (cxt, op->part, op->attrs != 0, &changed, error);
+        case BD_PART_TRANSACTION_OP_SET_ATTRIBUTES:
+            return set_part_attributes (cxt, op->part, op->attrs, error);
+        default:
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                         "Unknown operation");
+            return FALSE;
+    }
+}
+
+/**
+ * bd_part_transaction_commit:
+ * @trans: transaction to commit
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Applies all the operations queued in @trans to the partition table of the
+ * disk in the given order, writes the new partition table to the disk and
+ * informs the kernel about the changes. The operations are all validated
+ * against the in-memory partition table first so either all or none of them
+ * are written. The partition table is written only once and the kernel is
+ * only asked to re-read the changed partitions once.
+ *
+ * The queued operations are removed from @trans on success.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): specs of the partitions
+ *          created by @trans (in the order they were queued) or %NULL in case
+ *          of error
+ *
+ * Tech category: %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to the partition table type
+ */
+BDPartSpec** bd_part_transaction_commit (BDPartTransaction *trans, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    struct fdisk_table *table = NULL;
+    struct fdisk_partition *pa = NULL;
+    GArray *created = NULL;
+    GPtrArray *specs = NULL;
+    BDPartSpec *spec = NULL;
+    GList *op_it = NULL;
+    gboolean new_extended = FALSE;
+    guint64 progress_id = 0;
+    gchar *msg = NULL;
+    gint status = 0;
+    guint n_ops = 0;
+    guint n_op = 0;
+    guint i = 0;
+    size_t partno = 0;
+    GError *l_error = NULL;
+
+    n_ops = g_list_length (trans->ops);
+    msg = g_strdup_printf ("Started committing %u changes to '%s'", n_ops, trans->disk);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    cxt = get_device_context (trans->disk, FALSE, &l_error);
+    if (!cxt) {
+        /* error is already populated */
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    /* original layout for the kernel to be informed about the changes */
+    status = fdisk_get_partitions (cxt, &table);
+    if (status != 0) {
+        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to get existing partitions on the device: %s", strerror_l (-status, c_locale));
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    created = g_array_new (FALSE, FALSE, sizeof (size_t));
+
+    /* apply all the operations to the in-memory table, nothing is written to
+       the disk if any of them fails */
+    for (op_it = trans->ops; op_it; op_it = op_it->next) {
+        n_op++;
+        if (!part_transaction_apply_op (cxt, trans->disk, (BDPartTransactionOp *) op_it->data,
+                                        &new_extended, created, &l_error)) {
+            g_prefix_error (&l_error, "Operation %u failed, no changes written: ", n_op);
+            g_array_free (created, TRUE);
+            fdisk_unref_table (table);
+            close_context (cxt);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return NULL;
+        }
+        bd_utils_report_progress (progress_id, (n_op * 100) / (n_ops + 1), NULL);
+    }
+
+    /* for new extended partition we need to force reread whole partition table with
+       libfdisk < 2.36.1 */
+    if (fdisk_label_is_changed (fdisk_get_label (cxt, NULL)) &&
+        !write_label (cxt, table, trans->disk, new_extended && fdisk_version < 2361, &l_error)) {
+        g_array_free (created, TRUE);
+        fdisk_unref_table (table);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    specs = g_ptr_array_new_with_free_func ((GDestroyNotify) (void *) bd_part_spec_free);
+    for (i = 0; i < created->len; i++) {
+        partno = g_array_index (created, size_t, i);
+        /* created and removed in the same transaction */
+        if (!fdisk_is_partition_used (cxt, partno))
+            continue;
+
+        status = fdisk_get_partition (cxt, partno, &pa);
+        if (status != 0) {
+            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                         "Failed to get partition %zu on device '%s'", partno + 1, trans->disk);
+            g_ptr_array_free (specs, TRUE);
+            g_array_free (created, TRUE);
+            fdisk_unref_table (table);
+            close_context (cxt);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return NULL;
+        }
+
+        spec = get_part_spec_fdisk (cxt, pa, &l_error);
+        fdisk_unref_partition (pa);
+        pa = NULL;
+        if (!spec) {
+            g_ptr_array_free (specs, TRUE);
+            g_array_free (created, TRUE);
+            fdisk_unref_table (table);
+            close_context (cxt);
+            bd_utils_report_finished (progress_id, l_error->message);
+            g_propagate_error (error, l_error);
+            return NULL;
+        }
+        g_ptr_array_add (specs, spec);
+    }
+
+    g_array_free (created, TRUE);
+    fdisk_unref_table (table);
+    close_context (cxt);
+
+    g_list_free_full (trans->ops, (GDestroyNotify) part_transaction_op_free);
+    trans->ops = NULL;
+
+    bd_utils_report_finished (progress_id, "Completed");
+
+    g_ptr_array_add (specs, NULL);
+    return (BDPartSpec **) g_ptr_array_free (specs, FALSE);
+}
+
+/* reads a number from the @attr sysfs attribute of the block device @devno */
+static gboolean read_sysfs_attr (dev_t devno, const gchar *attr, gint64 *value, GError **error) {
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *contents = NULL;
+    GError *l_error = NULL;
+
+    path = g_strdup_printf ("/sys/dev/block/%u:%u/%s", major (devno), minor (devno), attr);
+    if (!g_file_get_contents (path, &contents, NULL, &l_error)) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to read '%s': %s", path, l_error->message);
+        g_clear_error (&l_error);
+        return FALSE;
+    }
+
+    *value = g_ascii_strtoll (contents, NULL, 10);
+    return TRUE;
+}
+
+/**
+ * bd_part_get_disk_geometry:
+ * @disk: disk to get the geometry of
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Gets the geometry of @disk needed for planning its partition layout with
+ * bd_part_plan_layout(). The information is read from sysfs, @disk is not
+ * opened.
+ *
+ * Returns: (transfer full): geometry of @disk or %NULL in case of error
+ *
+ * Tech category: %BD_PART_TECH_MODE_QUERY_TABLE + the tech according to the partition table type
+ */
+BDPartDiskGeometry* bd_part_get_disk_geometry (const gchar *disk, GError **error) {
+    struct stat st;
+    BDPartDiskGeometry *ret = NULL;
+    gint64 sectors = 0;
+    gint64 sector_size = 0;
+    gint64 optimal_io = 0;
+    gint64 offset = 0;
+
+    if (stat (disk, &st) != 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to get information about '%s': %s", disk, strerror_l (errno, c_locale));
+        return NULL;
+    }
+
+    if (!S_ISBLK (st.st_mode)) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "'%s' is not a block device", disk);
+        return NULL;
+    }
+
+    /* size is always in 512B sectors */
+    if (!read_sysfs_attr (st.st_rdev, "size", &sectors, error) ||
+        !read_sysfs_attr (st.st_rdev, "queue/logical_block_size", &sector_size, error))
+        /* error is already populated */
+        return NULL;
+
+    /* these are just hints, use the defaults if not available */
+    if (!read_sysfs_attr (st.st_rdev, "queue/optimal_io_size", &optimal_io, NULL) || optimal_io < 0)
+        optimal_io = 0;
+    /* -1 means the device is misaligned, nothing we can do about it */
+    if (!read_sysfs_attr (st.st_rdev, "alignment_offset", &offset, NULL) || offset < 0)
+        offset = 0;
+
+    ret = g_new0 (BDPartDiskGeometry, 1);
+    ret->size = (guint64) sectors * 512;
+    ret->sector_size = (guint64) sector_size;
+    ret->alignment = (guint64) optimal_io;
+    ret->alignment_offset = (guint64) offset;
+
+    return ret;
+}
+
+/* size of the GPT partition entries array (128 entries, 128 bytes each) */
+#define GPT_ENTRIES_SIZE (128 * 128)
+#define GPT_MAX_PARTS 128
+#define MBR_MAX_PRIMARY 4
+
+static inline guint64 lba_align_up (guint64 lba, guint64 grain, guint64 offset) {
+    if (lba <= offset)
+        return offset;
+    return offset + ((lba - offset + grain - 1) / grain) * grain;
+}
+
+static inline guint64 lba_align_down (guint64 lba, guint64 grain, guint64 offset) {
+    if (lba < offset)
+        return 0;
+    return offset + ((lba - offset) / grain) * grain;
+}
+
+static BDPartSpec* new_layout_spec (guint64 type, guint64 start, guint64 size) {
+    BDPartSpec *ret = g_new0 (BDPartSpec, 1);
+
+    ret->type = type;
+    ret->start = start;
+    ret->size = size;
+
+    return ret;
+}
+
+/**
+ * bd_part_plan_layout:
+ * @geometry: geometry of the disk to plan the layout for (see bd_part_get_disk_geometry())
+ * @table_type: type of the partition table to plan the layout for
+ * @requests: (array zero-terminated=1): requested partitions in the order they should be placed on the disk
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Computes a complete partition layout for a disk with @geometry without
+ * touching any disk. Partitions are placed one after another starting at the
+ * first aligned sector after the partition table, with their starts and sizes
+ * aligned to the optimal I/O size of the disk (or 1 MiB, whichever is bigger).
+ *
+ * Each request needs a size, a percentage of the usable space or the
+ * %BD_PART_LAYOUT_FLAG_GROW flag. Sizes are aligned down just like with
+ * bd_part_create_part(). Growing partitions get at least the requested size
+ * (or percentage) plus an equal share of the space not used by the other
+ * partitions.
+ *
+ * On MBR, requests with the %BD_PART_LAYOUT_FLAG_LOGICAL flag are placed
+ * into an extended partition created automatically in front of the first of
+ * them, all of them need to be next to each other. Each logical partition is
+ * preceded by a gap for its EBR.
+ *
+ * The resulting layout has the same form as what bd_part_get_disk_parts() and
+ * bd_part_get_disk_free_regions() would report for the disk after
+ * bd_part_apply_layout() -- partitions, the metadata gaps between them
+ * (%BD_PART_TYPE_METADATA) and the free space at the end (%BD_PART_TYPE_FREESPACE),
+ * all sorted by their start. The @path of the partitions is not set.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): specs of the planned
+ *          partitions, gaps and free space or %NULL in case of error
+ *
+ * Tech category: always available
+ */
+BDPartSpec** bd_part_plan_layout (BDPartDiskGeometry *geometry, BDPartTableType table_type, BDPartLayoutRequest **requests, GError **error) {
+    BDPartLayoutRequest **req_p = NULL;
+    BDPartLayoutRequest *req = NULL;
+    GPtrArray *specs = NULL;
+    BDPartSpec *spec = NULL;
+    BDPartSpec *ext_spec = NULL;
+    guint64 *grains = NULL;
+    guint64 ss = 0;
+    guint64 grain = 0;
+    guint64 offset = 0;
+    guint64 total = 0;
+    guint64 first_lba = 0;
+    guint64 end_lba = 0;
+    guint64 entries = 0;
+    guint64 start = 0;
+    guint64 limit = 0;
+    guint64 usable = 0;
+    guint64 used = 0;
+    guint64 remaining = 0;
+    guint64 share = 0;
+    guint64 pos = 0;
+    guint n_reqs = 0;
+    guint n_grow = 0;
+    guint n_primary = 0;
+    guint i = 0;
+    gboolean logical = FALSE;
+    gboolean logicals_done = FALSE;
+
+    if (!geometry || geometry->sector_size == 0 || geometry->size < geometry->sector_size) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Invalid disk geometry given");
+        return NULL;
+    }
+
+    if (table_type >= BD_PART_TABLE_UNDEF) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Invalid partition table type given");
+        return NULL;
+    }
+
+    /* everything below is in sectors */
+    ss = geometry->sector_size;
+    grain = (MAX (geometry->alignment, 1 MiB) + ss - 1) / ss;
+    offset = (geometry->alignment_offset / ss) % grain;
+    total = geometry->size / ss;
+
+    if (table_type == BD_PART_TABLE_GPT) {
+        /* protective MBR + header + entries at the start, entries + backup header at the end */
+        entries = (GPT_ENTRIES_SIZE + ss - 1) / ss;
+        first_lba = 2 + entries;
+        end_lba = total > entries + 1 ? total - entries - 1 : 0;
+    } else {
+        /* MBR can only address 2^32 sectors */
+        first_lba = 1;
+        end_lba = MIN (total, (guint64) G_MAXUINT32 + 1);
+    }
+
+    start = lba_align_up (first_lba, grain, offset);
+    limit = lba_align_down (end_lba, grain, offset);
+    if (limit <= start) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Disk too small for a partition layout");
+        return NULL;
+    }
+    usable = (limit - start) / grain;
+
+    /* validate the requests and get their sizes (in grains) */
+    for (req_p = requests; req_p && *req_p; req_p++)
+        n_reqs++;
+
+    if (n_reqs == 0) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "No partitions requested");
+        return NULL;
+    }
+
+    grains = g_new0 (guint64, n_reqs);
+    for (i = 0; i < n_reqs; i++) {
+        req = requests[i];
+        logical = (req->flags & BD_PART_LAYOUT_FLAG_LOGICAL) != 0;
+
+        if (table_type == BD_PART_TABLE_GPT) {
+            if (logical || (req->flags & BD_PART_LAYOUT_FLAG_BOOTABLE)) {
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                             "Partition %u: logical and bootable partitions are only supported on MBR", i + 1);
+                g_free (grains);
+                return NULL;
+            }
+        } else {
+            if (req->name) {
+                g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                             "Partition %u: partition names are only supported on GPT", i + 1);
+                g_free (grains);
+                return NULL;
+            }
+            if (logical) {
+                if (logicals_done) {
+                    g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                                 "Partition %u: logical partitions need to be next to each other", i + 1);
+                    g_free (grains);
+                    return NULL;
+                }
+                if (i == 0 || !(requests[i - 1]->flags & BD_PART_LAYOUT_FLAG_LOGICAL))
+                    /* the extended partition */
+                    n_primary++;
+                /* the EBR gap */
+                used++;
+            } else {
+                if (i > 0 && (requests[i - 1]->flags & BD_PART_LAYOUT_FLAG_LOGICAL))
+                    logicals_done = TRUE;
+                n_primary++;
+            }
+        }
+
+        if (req->percent < 0 || req->percent > 100) {
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                         "Partition %u: invalid percentage %g", i + 1, req->percent);
+            g_free (grains);
+            return NULL;
+        }
+
+        if (req->size > 0)
+            grains[i] = (req->size / ss) / grain;
+        else if (req->percent > 0)
+            grains[i] = (guint64) (usable * req->percent / 100);
+        else if (!(req->flags & BD_PART_LAYOUT_FLAG_GROW)) {
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                         "Partition %u: size, percentage or the grow flag needs to be specified", i + 1);
+            g_free (grains);
+            return NULL;
+        }
+
+        if (grains[i] == 0 && !(req->flags & BD_PART_LAYOUT_FLAG_GROW)) {
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                         "Partition %u: size smaller than the alignment (%"G_GUINT64_FORMAT" bytes)",
+                         i + 1, grain * ss);
+            g_free (grains);
+            return NULL;
+        }
+
+        if (req->flags & BD_PART_LAYOUT_FLAG_GROW)
+            n_grow++;
+        used += grains[i];
+    }
+
+    if (table_type == BD_PART_TABLE_GPT && n_reqs > GPT_MAX_PARTS) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Too many partitions requested, GPT supports at most %d", GPT_MAX_PARTS);
+        g_free (grains);
+        return NULL;
+    }
+    if (table_type == BD_PART_TABLE_MSDOS && n_primary > MBR_MAX_PRIMARY) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Too many primary partitions requested, MBR supports at most %d", MBR_MAX_PRIMARY);
+        g_free (grains);
+        return NULL;
+    }
+
+    if (used > usable) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Requested partitions (%"G_GUINT64_FORMAT" bytes) don't fit on the disk (%"G_GUINT64_FORMAT" bytes usable)",
+                     used * grain * ss, usable * grain * ss);
+        g_free (grains);
+        return NULL;
+    }
+
+    /* distribute the remaining space among the growing partitions, the last one gets the rest */
+    remaining = usable - used;
+    share = n_grow > 0 ? remaining / n_grow : 0;
+    for (i = 0; n_grow > 0 && i < n_reqs; i++) {
+        if (!(requests[i]->flags & BD_PART_LAYOUT_FLAG_GROW))
+            continue;
+        if (--n_grow == 0)
+            share = remaining;
+        grains[i] += share;
+        remaining -= share;
+        if (grains[i] == 0) {
+            g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                         "Partition %u: no space left to grow into", i + 1);
+            g_free (grains);
+            return NULL;
+        }
+    }
+
+    specs = g_ptr_array_new ();
+    pos = start;
+    for (i = 0; i < n_reqs; i++) {
+        req = requests[i];
+        logical = (req->flags & BD_PART_LAYOUT_FLAG_LOGICAL) != 0;
+
+        if (logical) {
+            if (!ext_spec) {
+                ext_spec = new_layout_spec (BD_PART_TYPE_EXTENDED, pos * ss, 0);
+                g_ptr_array_add (specs, ext_spec);
+            }
+            /* space for the EBR in front of every logical partition */
+            g_ptr_array_add (specs, new_layout_spec (BD_PART_TYPE_METADATA | BD_PART_TYPE_LOGICAL, pos * ss, grain * ss));
+            pos += grain;
+        }
+
+        spec = new_layout_spec (logical ? BD_PART_TYPE_LOGICAL : BD_PART_TYPE_NORMAL, pos * ss, grains[i] * grain * ss);
+        spec->name = g_strdup (req->name);
+        if (table_type == BD_PART_TABLE_GPT)
+            spec->type_guid = g_strdup (req->type);
+        else
+            spec->id = g_strdup (req->type);
+        spec->bootable = (req->flags & BD_PART_LAYOUT_FLAG_BOOTABLE) != 0;
+        g_ptr_array_add (specs, spec);
+        pos += grains[i] * grain;
+
+        if (logical && (i == n_reqs - 1 || !(requests[i + 1]->flags & BD_PART_LAYOUT_FLAG_LOGICAL)))
+            ext_spec->size = pos * ss - ext_spec->start;
+    }
+    g_free (grains);
+
+    if (pos < limit)
+        g_ptr_array_add (specs, new_layout_spec (BD_PART_TYPE_FREESPACE, pos * ss, (end_lba - pos) * ss));
+
+    g_ptr_array_add (specs, NULL);
+    return (BDPartSpec **) g_ptr_array_free (specs, FALSE);
+}
+
+/**
+ * bd_part_apply_layout:
+ * @disk: disk to apply the layout to
+ * @table_type: type of the partition table to create
+ * @layout: (array zero-terminated=1): layout to apply (see bd_part_plan_layout())
+ * @ignore_existing: whether to ignore/overwrite the existing partition table or not
+ * @error: (out) (optional): place to store error (if any)
+ *
+ * Creates a new partition table of the @table_type type on @disk with all the
+ * partitions from @layout (free space and metadata entries are skipped) placed
+ * exactly as specified, including their names, types/ids and bootable flags.
+ * Everything is done in memory first and written to the disk at once.
+ *
+ * Returns: (transfer full) (array zero-terminated=1): specs of the created
+ *          partitions (except the extended one) or %NULL in case of error
+ *
+ * Tech category: %BD_PART_TECH_MODE_CREATE_TABLE + %BD_PART_TECH_MODE_MODIFY_TABLE + the tech according to @table_type
+ */
+BDPartSpec** bd_part_apply_layout (const gchar *disk, BDPartTableType table_type, BDPartSpec **layout, gboolean ignore_existing, GError **error) {
+    struct fdisk_context *cxt = NULL;
+    struct fdisk_partition *npa = NULL;
+    struct fdisk_partition *pa = NULL;
+    BDPartSpec **spec_p = NULL;
+    BDPartTypeReq type_req = BD_PART_TYPE_REQ_NORMAL;
+    GArray *created = NULL;
+    GPtrArray *specs = NULL;
+    BDPartSpec *spec = NULL;
+    gboolean new_extended = FALSE;
+    gboolean changed = FALSE;
+    gboolean success = TRUE;
+    guint64 progress_id = 0;
+    gchar *part = NULL;
+    gchar *msg = NULL;
+    gint status = 0;
+    guint i = 0;
+    size_t partno = 0;
+    GError *l_error = NULL;
+
+    if (table_type >= BD_PART_TABLE_UNDEF) {
+        g_set_error (error, BD_PART_ERROR, BD_PART_ERROR_INVAL,
+                     "Invalid partition table type given");
+        return NULL;
+    }
+
+    msg = g_strdup_printf ("Started applying a new partition layout to '%s'", disk);
+    progress_id = bd_utils_report_started (msg);
+    g_free (msg);
+
+    cxt = get_device_context (disk, FALSE, &l_error);
+    if (!cxt) {
+        /* error is already populated */
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    if (!ignore_existing && fdisk_has_label (cxt)) {
+        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_EXISTS,
+                     "Device '%s' already contains a partition table", disk);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    status = fdisk_create_disklabel (cxt, table_type_str[table_type]);
+    if (status != 0) {
+        g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                     "Failed to create a new disklabel for disk '%s': %s", disk, strerror_l (-status, c_locale));
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    created = g_array_new (FALSE, FALSE, sizeof (size_t));
+
+    /* the layout is already aligned, no further alignment wanted */
+    for (spec_p = layout; success && spec_p && *spec_p; spec_p++) {
+        if ((*spec_p)->type & (BD_PART_TYPE_FREESPACE | BD_PART_TYPE_METADATA))
+            continue;
+
+        if ((*spec_p)->type & BD_PART_TYPE_EXTENDED)
+            type_req = BD_PART_TYPE_REQ_EXTENDED;
+        else if ((*spec_p)->type & BD_PART_TYPE_LOGICAL)
+            type_req = BD_PART_TYPE_REQ_LOGICAL;
+        else
+            type_req = BD_PART_TYPE_REQ_NORMAL;
+
+        npa = add_part (cxt, type_req, (*spec_p)->start, (*spec_p)->size, BD_PART_ALIGN_NONE, &new_extended, &l_error);
+        if (!npa) {
+            success = FALSE;
+            break;
+        }
+        partno = fdisk_partition_get_partno (npa);
+        fdisk_unref_partition (npa);
+
+        if (type_req == BD_PART_TYPE_REQ_EXTENDED)
+            continue;
+        g_array_append_val (created, partno);
+
+        part = get_part_path (disk, partno);
+        if ((*spec_p)->name)
+            success = set_part_name (cxt, disk, part, (*spec_p)->name, &l_error);
+        if (success && table_type == BD_PART_TABLE_GPT && (*spec_p)->type_guid)
+            success = set_part_type (cxt, partno, (*spec_p)->type_guid, BD_PART_TABLE_GPT, &l_error);
+        if (success && table_type == BD_PART_TABLE_MSDOS && (*spec_p)->id)
+            success = set_part_type (cxt, partno, (*spec_p)->id, BD_PART_TABLE_MSDOS, &l_error);
+        if (success && (*spec_p)->bootable)
+            success = set_part_bootable (cxt, part, TRUE, &changed, &l_error);
+        g_free (part);
+    }
+
+    if (!success) {
+        g_prefix_error (&l_error, "Failed to apply the layout, no changes written: ");
+        g_array_free (created, TRUE);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    bd_utils_report_progress (progress_id, 50, NULL);
+
+    /* brand new partition table, the kernel needs to re-read all of it */
+    if (!write_label (cxt, NULL, disk, TRUE, &l_error)) {
+        g_array_free (created, TRUE);
+        close_context (cxt);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    specs = g_ptr_array_new_with_free_func ((GDestroyNotify) (void *) bd_part_spec_free);
+    for (i = 0; i < created->len; i++) {
+        partno = g_array_index (created, size_t, i);
+        status = fdisk_get_partition (cxt, partno, &pa);
+        if (status != 0) {
+            g_set_error (&l_error, BD_PART_ERROR, BD_PART_ERROR_FAIL,
+                         "Failed to get partition %zu on device '%s'", partno + 1, disk);
+            break;
+        }
+
+        spec = get_part_spec_fdisk (cxt, pa, &l_error);
+        fdisk_unref_partition (pa);
+        pa = NULL;
+        if (!spec)
+            break;
+        g_ptr_array_add (specs, spec);
+    }
+
+    g_array_free (created, TRUE);
+    close_context (cxt);
+
+    if (l_error) {
+        g_ptr_array_free (specs, TRUE);
+        bd_utils_report_finished (progress_id, l_error->message);
+        g_propagate_error (error, l_error);
+        return NULL;
+    }
+
+    bd_utils_report_finished (progress_id, "Completed");
+
+    g_ptr_array_add (specs, NULL);
+    return (BDPartSpec **) g_ptr_array_free (specs, FALSE);
+}
+
 /**
  * bd_part_get_part_table_type_str:
  * @type: table type to get string representation for
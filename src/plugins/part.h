@@ -67,6 +67,40 @@ typedef struct BDPartDiskSpec {
 BDPartDiskSpec* bd_part_disk_spec_copy (BDPartDiskSpec *data);
 void bd_part_disk_spec_free (BDPartDiskSpec *data);
 
+typedef struct _BDPartTransaction BDPartTransaction;
+
+BDPartTransaction* bd_part_transaction_copy (BDPartTransaction *trans);
+void bd_part_transaction_free (BDPartTransaction *trans);
+
+typedef struct BDPartDiskGeometry {
+    guint64 size;
+    guint64 sector_size;
+    guint64 alignment;
+    guint64 alignment_offset;
+} BDPartDiskGeometry;
+
+BDPartDiskGeometry* bd_part_disk_geometry_copy (BDPartDiskGeometry *data);
+void bd_part_disk_geometry_free (BDPartDiskGeometry *data);
+
+typedef enum {
+    BD_PART_LAYOUT_FLAG_NONE     = 0,
+    BD_PART_LAYOUT_FLAG_GROW     = 1 << 0,
+    BD_PART_LAYOUT_FLAG_BOOTABLE = 1 << 1,
+    BD_PART_LAYOUT_FLAG_LOGICAL  = 1 << 2,
+} BDPartLayoutFlags;
+
+typedef struct BDPartLayoutRequest {
+    guint64 size;
+    gdouble percent;
+    guint64 flags;
+    gchar *name;
+    gchar *type;
+} BDPartLayoutRequest;
+
+BDPartLayoutRequest* bd_part_layout_request_copy (BDPartLayoutRequest *data);
+void bd_part_layout_request_free (BDPartLayoutRequest *data);
+BDPartLayoutRequest* bd_part_layout_request_new (guint64 size, gdouble percent, guint64 flags, const gchar *name, const gchar *type);
+
 typedef enum {
     BD_PART_TECH_MBR = 0,
     BD_PART_TECH_GPT,
@@ -113,6 +147,25 @@ gboolean bd_part_set_part_bootable (const gchar *disk, const gchar *part, gboole
 gboolean bd_part_set_part_attributes (const gchar *disk, const gchar *part, guint64 attrs, GError **error);
 gboolean bd_part_set_part_uuid (const gchar *disk, const gchar *part, const gchar *uuid, GError **error);
 
+BDPartTransaction* bd_part_transaction_new (const gchar *disk, GError **error);
+gboolean bd_part_transaction_create_part (BDPartTransaction *trans, BDPartTypeReq type, guint64 start, guint64 size, BDPartAlign align, GError **error);
+gboolean bd_part_transaction_delete_part (BDPartTransaction *trans, const gchar *part, GError **error);
+gboolean bd_part_transaction_resize_part (BDPartTransaction *trans, const gchar *part, guint64 size, BDPartAlign align, GError **error);
+gboolean bd_part_transaction_set_part_name (BDPartTransaction *trans, const gchar *part, const gchar *name, GError **error);
+gboolean bd_part_transaction_set_part_type (BDPartTransaction *trans, const gchar *part, const gchar *type_guid, GError **error);
+gboolean bd_part_transaction_set_part_id (BDPartTransaction *trans, const gchar *part, const gchar *part_id, GError **error);
+gboolean bd_part_transaction_set_part_uuid (BDPartTransaction *trans, const gchar *part, const gchar *uuid, GError **error);
+gboolean bd_part_transaction_set_part_bootable (BDPartTransaction *trans, const gchar *part, gboolean bootable, GError **error);
+gboolean bd_part_transaction_set_part_attributes (BDPartTransaction *trans, const gchar *part, guint64 attrs, GError **error);
+BDPartSpec** bd_part_transaction_commit (BDPartTransaction *trans, GError **error);
+
+gboolean bd_part_set_table_cache (gboolean enabled, GError **error);
+gboolean bd_part_invalidate_table_cache (const gchar *disk, GError **error);
+
+BDPartDiskGeometry* bd_part_get_disk_geometry (const gchar *disk, GError **error);
+BDPartSpec** bd_part_plan_layout (BDPartDiskGeometry *geometry, BDPartTableType table_type, BDPartLayoutRequest **requests, GError **error);
+BDPartSpec** bd_part_apply_layout (const gchar *disk, BDPartTableType table_type, BDPartSpec **layout, gboolean ignore_existing, GError **error);
+
 const gchar* bd_part_get_part_table_type_str (BDPartTableType type, GError **error);
 const gchar* bd_part_get_type_str (BDPartType type, GError **error);
 
@@ -44,6 +44,9 @@ void free_drivedb_attrs (DriveDBAttr **attrs) {
 DriveDBAttr** drivedb_lookup_drive (G_GNUC_UNUSED const gchar *model, G_GNUC_UNUSED const gchar *fw, G_GNUC_UNUSED gboolean include_defaults) {
     return NULL;
 }
+
+void drivedb_index_free (void) {
+}
 #else
 
 struct drive_settings {
@@ -117,29 +120,161 @@ static void parse_presets_str (const char *presets, GHashTable *attrs) {
     }
 }
 
-DriveDBAttr** drivedb_lookup_drive (const gchar *model, const gchar *fw, gboolean include_defaults) {
-    gulong i;
+/* maximum number of (model, firmware) lookups remembered */
+#define DRIVEDB_CACHE_SIZE 64
+
+/* a drivedb entry prepared for matching */
+typedef struct DriveDBEntry {
+    GRegex *model_regex;
+    GRegex *firmware_regex;
+    /* literal every matching model string contains, NULL if not known */
+    gchar *model_literal;
+    /* parsed presets, NULL-terminated */
+    DriveDBAttr **attrs;
+} DriveDBEntry;
+
+typedef struct DriveDBIndex {
+    DriveDBEntry *entries;
+    guint n_entries;
+    DriveDBAttr **defaults;
+    /* "include_defaults:model\nfirmware" -> DriveDBAttr** (NULL if nothing found) */
+    GHashTable *cache;
+} DriveDBIndex;
+
+/* protects the index (built on first lookup) and its cache, held during lookups */
+static GMutex drivedb_lock;
+static DriveDBIndex *drivedb_index = NULL;
+
+static DriveDBAttr** parse_presets (const char *presets) {
     GHashTable *attrs;
     DriveDBAttr **ret = NULL;
+    GHashTableIter iter;
+    gpointer key, val;
+    guint i = 0;
 
-    if (G_N_ELEMENTS (builtin_knowndrives) == 0)
+    attrs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    parse_presets_str (presets, attrs);
+
+    if (g_hash_table_size (attrs) > 0) {
+        ret = g_new0 (DriveDBAttr *, g_hash_table_size (attrs) + 1);
+        g_hash_table_iter_init (&iter, attrs);
+        while (g_hash_table_iter_next (&iter, &key, &val)) {
+            ret[i] = g_new0 (DriveDBAttr, 1);
+            ret[i]->id = GPOINTER_TO_INT (key);
+            ret[i]->name = g_strdup (val);
+            i++;
+        }
+    }
+    g_hash_table_destroy (attrs);
+
+    return ret;
+}
+
+static DriveDBAttr** copy_drivedb_attrs (DriveDBAttr **attrs) {
+    DriveDBAttr **ret;
+    guint i;
+    guint n = 0;
+
+    if (attrs == NULL)
         return NULL;
 
-    attrs = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    while (attrs[n])
+        n++;
+    ret = g_new0 (DriveDBAttr *, n + 1);
+    for (i = 0; attrs[i]; i++) {
+        ret[i] = g_new0 (DriveDBAttr, 1);
+        ret[i]->id = attrs[i]->id;
+        ret[i]->name = g_strdup (attrs[i]->name);
+    }
 
-    /* first parse the DEFAULTS definitions */
-    if (include_defaults)
-        for (i = 0; i < G_N_ELEMENTS (builtin_knowndrives); i++)
-            if (builtin_knowndrives[i].modelfamily &&
-                builtin_knowndrives[i].presets &&
-                g_ascii_strncasecmp (builtin_knowndrives[i].modelfamily, "DEFAULT", 7) == 0)
-                    parse_presets_str (builtin_knowndrives[i].presets, attrs);
+    return ret;
+}
 
-    /* now overlay/replace with drive specific keys */
+/* gets the literal the (unanchored) @regexp starts with, i.e. a string any
+ * matching string has to contain, or %NULL if there's no such literal */
+static gchar* get_regexp_literal (const char *regexp) {
+    const char *p;
+    gsize len;
+    gint depth = 0;
+    gboolean in_class = FALSE;
+
+    /* a top-level alternative makes the leading literal optional */
+    for (p = regexp; *p; p++) {
+        if (*p == '\\' && p[1])
+            p++;
+        else if (in_class)
+            in_class = *p != ']';
+        else if (*p == '[')
+            in_class = TRUE;
+        else if (*p == '(')
+            depth++;
+        else if (*p == ')')
+            depth--;
+        else if (*p == '|' && depth == 0)
+            return NULL;
+    }
+
+    if (*regexp == '^')
+        regexp++;
+    len = strcspn (regexp, "\\^$.|?*+()[]{}");
+    /* the last character is optional with these quantifiers */
+    if (len > 0 && (regexp[len] == '?' || regexp[len] == '*' || regexp[len] == '{'))
+        len--;
+
+    return len > 0 ? g_strndup (regexp, len) : NULL;
+}
+
+static GRegex* compile_regexp (const char *regexp) {
+    GRegex *regex;
+    GError *error = NULL;
+
+    /* G_REGEX_OPTIMIZE enables JIT compilation of the pattern */
+    regex = g_regex_new (regexp, G_REGEX_OPTIMIZE, 0, &error);
+    if (regex == NULL) {
+        bd_utils_log_format (BD_UTILS_LOG_DEBUG,
+                             "drivedb-parser: regex compilation failed for '%s': %s",
+                             regexp, error->message);
+        g_error_free (error);
+    }
+
+    return regex;
+}
+
+static DriveDBIndex* build_drivedb_index (void) {
+    DriveDBIndex *index;
+    GHashTable *defaults;
+    gulong i;
+
+    index = g_new0 (DriveDBIndex, 1);
+    index->entries = g_new0 (DriveDBEntry, G_N_ELEMENTS (builtin_knowndrives));
+    index->cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) free_drivedb_attrs);
+
+    /* the DEFAULT definitions */
+    defaults = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+    for (i = 0; i < G_N_ELEMENTS (builtin_knowndrives); i++)
+        if (builtin_knowndrives[i].modelfamily &&
+            builtin_knowndrives[i].presets &&
+            g_ascii_strncasecmp (builtin_knowndrives[i].modelfamily, "DEFAULT", 7) == 0)
+                parse_presets_str (builtin_knowndrives[i].presets, defaults);
+    if (g_hash_table_size (defaults) > 0) {
+        GHashTableIter iter;
+        gpointer key, val;
+        guint n = 0;
+
+        index->defaults = g_new0 (DriveDBAttr *, g_hash_table_size (defaults) + 1);
+        g_hash_table_iter_init (&iter, defaults);
+        while (g_hash_table_iter_next (&iter, &key, &val)) {
+            index->defaults[n] = g_new0 (DriveDBAttr, 1);
+            index->defaults[n]->id = GPOINTER_TO_INT (key);
+            index->defaults[n]->name = g_strdup (val);
+            n++;
+        }
+    }
+    g_hash_table_destroy (defaults);
+
+    /* drive specific entries, in the table order */
     for (i = 0; i < G_N_ELEMENTS (builtin_knowndrives); i++) {
-        GRegex *regex;
-        GError *error = NULL;
-        gboolean match = FALSE;
+        DriveDBEntry *entry = &(index->entries[index->n_entries]);
 
         /* check the modelfamily string */
         if (builtin_knowndrives[i].modelfamily == NULL ||
@@ -151,45 +286,111 @@ DriveDBAttr** drivedb_lookup_drive (const gchar *model, const gchar *fw, gboolea
             continue;
         /* assuming modelfamily=ATA from now on... */
 
-        /* match the model string */
-        regex = g_regex_new (builtin_knowndrives[i].modelregexp,
-                             0, 0, &error);
-        if (regex == NULL) {
-            bd_utils_log_format (BD_UTILS_LOG_DEBUG,
-                                 "drivedb-parser: regex compilation failed for '%s': %s",
-                                 builtin_knowndrives[i].modelregexp,
-                                 error->message);
-            g_error_free (error);
+        /* entries not defining any attributes would never change the result */
+        entry->attrs = parse_presets (builtin_knowndrives[i].presets);
+        if (entry->attrs == NULL)
             continue;
-        }
-        if (g_regex_match (regex, model, 0, NULL))
-            match = TRUE;
-        g_regex_unref (regex);
-        if (!match)
+
+        entry->model_regex = compile_regexp (builtin_knowndrives[i].modelregexp);
+        if (entry->model_regex == NULL) {
+            free_drivedb_attrs (entry->attrs);
+            entry->attrs = NULL;
             continue;
+        }
 
-        /* match the firmware string */
-        if (builtin_knowndrives[i].firmwareregexp &&
-            strlen (builtin_knowndrives[i].firmwareregexp) > 0 &&
-            fw && strlen (fw) > 0)
-        {
-            regex = g_regex_new (builtin_knowndrives[i].firmwareregexp,
-                                 0, 0, &error);
-            if (regex == NULL) {
-                bd_utils_log_format (BD_UTILS_LOG_DEBUG,
-                                     "drivedb-parser: regex compilation failed for '%s': %s",
-                                     builtin_knowndrives[i].firmwareregexp,
-                                     error->message);
-                g_error_free (error);
+        if (builtin_knowndrives[i].firmwareregexp && strlen (builtin_knowndrives[i].firmwareregexp) > 0) {
+            entry->firmware_regex = compile_regexp (builtin_knowndrives[i].firmwareregexp);
+            if (entry->firmware_regex == NULL) {
+                g_regex_unref (entry->model_regex);
+                free_drivedb_attrs (entry->attrs);
+                memset (entry, 0, sizeof (DriveDBEntry));
                 continue;
             }
-            if (!g_regex_match (regex, model, 0, NULL))
-                match = FALSE;
-            g_regex_unref (regex);
         }
 
-        if (match)
-            parse_presets_str (builtin_knowndrives[i].presets, attrs);
+        entry->model_literal = get_regexp_literal (builtin_knowndrives[i].modelregexp);
+        index->n_entries++;
+    }
+
+    return index;
+}
+
+/* frees the index together with the lookup cache, it's built again on the next lookup */
+void drivedb_index_free (void) {
+    guint i;
+
+    g_mutex_lock (&drivedb_lock);
+    if (drivedb_index) {
+        for (i = 0; i < drivedb_index->n_entries; i++) {
+            g_regex_unref (drivedb_index->entries[i].model_regex);
+            if (drivedb_index->entries[i].firmware_regex)
+                g_regex_unref (drivedb_index->entries[i].firmware_regex);
+            g_free (drivedb_index->entries[i].model_literal);
+            free_drivedb_attrs (drivedb_index->entries[i].attrs);
+        }
+        g_free (drivedb_index->entries);
+        free_drivedb_attrs (drivedb_index->defaults);
+        g_hash_table_destroy (drivedb_index->cache);
+        g_free (drivedb_index);
+        drivedb_index = NULL;
+    }
+    g_mutex_unlock (&drivedb_lock);
+}
+
+static void overlay_attrs (GHashTable *attrs, DriveDBAttr **overlay) {
+    DriveDBAttr **a;
+
+    for (a = overlay; a && *a; a++)
+        g_hash_table_replace (attrs, GINT_TO_POINTER ((*a)->id), (*a)->name);
+}
+
+DriveDBAttr** drivedb_lookup_drive (const gchar *model, const gchar *fw, gboolean include_defaults) {
+    DriveDBIndex *index;
+    GHashTable *attrs;
+    DriveDBAttr **ret = NULL;
+    gchar *cache_key;
+    gpointer cached = NULL;
+    guint i;
+
+    if (G_N_ELEMENTS (builtin_knowndrives) == 0)
+        return NULL;
+
+    cache_key = g_strdup_printf ("%d:%s\n%s", include_defaults ? 1 : 0, model, fw ? fw : "");
+
+    /* the index can be freed by drivedb_index_free() at any time so the lock
+     * is held for the whole lookup, the precompiled index keeps it short */
+    g_mutex_lock (&drivedb_lock);
+    if (drivedb_index == NULL)
+        drivedb_index = build_drivedb_index ();
+    index = drivedb_index;
+    if (g_hash_table_lookup_extended (index->cache, cache_key, NULL, &cached)) {
+        ret = copy_drivedb_attrs (cached);
+        g_mutex_unlock (&drivedb_lock);
+        g_free (cache_key);
+        return ret;
+    }
+
+    /* values are owned by the index */
+    attrs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    /* first the DEFAULTS definitions */
+    if (include_defaults)
+        overlay_attrs (attrs, index->defaults);
+
+    /* now overlay/replace with drive specific keys */
+    for (i = 0; i < index->n_entries; i++) {
+        DriveDBEntry *entry = &(index->entries[i]);
+
+        /* cheap check before running the regex */
+        if (entry->model_literal && strstr (model, entry->model_literal) == NULL)
+            continue;
+        if (!g_regex_match (entry->model_regex, model, 0, NULL))
+            continue;
+        if (entry->firmware_regex && fw && strlen (fw) > 0 &&
+            !g_regex_match (entry->firmware_regex, fw, 0, NULL))
+            continue;
+
+        overlay_attrs (attrs, entry->attrs);
     }
 
     if (g_hash_table_size (attrs) > 0) {
@@ -211,6 +412,11 @@ DriveDBAttr** drivedb_lookup_drive (const gchar *model, const gchar *fw, gboolea
     }
     g_hash_table_destroy (attrs);
 
+    if (g_hash_table_size (index->cache) >= DRIVEDB_CACHE_SIZE)
+        g_hash_table_remove_all (index->cache);
+    g_hash_table_replace (index->cache, cache_key, copy_drivedb_attrs (ret));
+    g_mutex_unlock (&drivedb_lock);
+
     return ret;
 }
 #endif   /* HAVE_DRIVEDB_H */
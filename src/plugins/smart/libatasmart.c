@@ -412,6 +412,22 @@ BDSmartATA * bd_smart_ata_get_info (const gchar *device, G_GNUC_UNUSED const BDE
     return data;
 }
 
+/**
+ * bd_smart_ata_get_info_native:
+ * @device: device to check.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from the drive by sending the ATA commands to it
+ * directly. This is what bd_smart_ata_get_info() does with libatasmart.
+ *
+ * Returns: (transfer full): ATA SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_ATA-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartATA * bd_smart_ata_get_info_native (const gchar *device, GError **error) {
+    return bd_smart_ata_get_info (device, NULL, error);
+}
+
 
 /**
  * bd_smart_ata_get_info_from_data:
@@ -470,6 +486,40 @@ BDSmartSCSI * bd_smart_scsi_get_info (G_GNUC_UNUSED const gchar *device, G_GNUC_
     return FALSE;
 }
 
+/**
+ * bd_smart_scsi_get_info_native:
+ * @device: device to check.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from SCSI or SAS-compliant drive by reading the
+ * log pages directly.
+ *
+ * Returns: (transfer full): SCSI SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_SCSI-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartSCSI * bd_smart_scsi_get_info_native (G_GNUC_UNUSED const gchar *device, GError **error) {
+    g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_TECH_UNAVAIL, "SCSI SMART is unavailable with libatasmart");
+    return FALSE;
+}
+
+/**
+ * bd_smart_scsi_get_info_from_data:
+ * @data: (array length=data_len): binary data to parse.
+ * @data_len: length of the data supplied.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from the supplied data.
+ *
+ * Returns: (transfer full): SCSI SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_SCSI-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartSCSI * bd_smart_scsi_get_info_from_data (G_GNUC_UNUSED const guint8 *data, G_GNUC_UNUSED gsize data_len, GError **error) {
+    g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_TECH_UNAVAIL, "SCSI SMART is unavailable with libatasmart");
+    return FALSE;
+}
+
 
 /**
  * bd_smart_set_enabled:
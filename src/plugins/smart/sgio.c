@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2026  Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <scsi/sg.h>
+
+#include "smart.h"
+#include "smart-private.h"
+
+#define SGIO_TIMEOUT_MS 15000
+#define SGIO_SENSE_LEN 32
+
+/* SCSI status byte and the driver status flag signalling valid sense data */
+#define SCSI_STATUS_GOOD            0x00
+#define SCSI_STATUS_CHECK_CONDITION 0x02
+#define SG_DRIVER_SENSE             0x08
+
+#define SCSI_LOG_SENSE              0x4d
+#define SCSI_MODE_SENSE_10          0x5a
+#define SCSI_READ_DEFECT_DATA_10    0x37
+#define SCSI_ATA_PASS_THROUGH_16    0x85
+
+#define ATA_PROTOCOL_NON_DATA       3
+#define ATA_PROTOCOL_PIO_DATA_IN    4
+
+#define ATA_CMD_IDENTIFY_DEVICE     0xec
+#define ATA_CMD_SMART               0xb0
+#define ATA_SMART_READ_DATA         0xd0
+#define ATA_SMART_READ_THRESHOLDS   0xd1
+#define ATA_SMART_RETURN_STATUS     0xda
+
+
+/* Opens @device for issuing SG_IO requests, returns the file descriptor or -1
+ * in case of an error (with @error set). */
+gint sgio_open (const gchar *device, GError **error) {
+    gint fd;
+
+    fd = open (device, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "Failed to open device '%s': %s", device, strerror_l (errno, _C_LOCALE));
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Issues @cdb and returns whether the command got completed, either
+ * successfully or with a CHECK CONDITION status in which case @sense is filled
+ * and @sense_len is set to a non-zero value. */
+static gboolean sg_io (gint fd, guint8 *cdb, guint8 cdb_len, guint8 *buf, guint buf_len,
+                       guint8 *sense, guint *sense_len, GError **error) {
+    sg_io_hdr_t io_hdr;
+
+    memset (&io_hdr, 0, sizeof (io_hdr));
+    memset (sense, 0, SGIO_SENSE_LEN);
+    io_hdr.interface_id = 'S';
+    io_hdr.cmdp = cdb;
+    io_hdr.cmd_len = cdb_len;
+    io_hdr.dxfer_direction = buf_len > 0 ? SG_DXFER_FROM_DEV : SG_DXFER_NONE;
+    io_hdr.dxferp = buf;
+    io_hdr.dxfer_len = buf_len;
+    io_hdr.sbp = sense;
+    io_hdr.mx_sb_len = SGIO_SENSE_LEN;
+    io_hdr.timeout = SGIO_TIMEOUT_MS;
+
+    if (ioctl (fd, SG_IO, &io_hdr) < 0) {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "SG_IO request 0x%02x failed: %s", cdb[0], strerror_l (errno, _C_LOCALE));
+        return FALSE;
+    }
+
+    if (io_hdr.host_status != 0 || (io_hdr.driver_status & ~SG_DRIVER_SENSE) != 0) {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "SG_IO request 0x%02x failed: host status 0x%x, driver status 0x%x",
+                     cdb[0], io_hdr.host_status, io_hdr.driver_status);
+        return FALSE;
+    }
+
+    if (io_hdr.status != SCSI_STATUS_GOOD && io_hdr.status != SCSI_STATUS_CHECK_CONDITION) {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "SG_IO request 0x%02x failed: SCSI status 0x%x", cdb[0], io_hdr.status);
+        return FALSE;
+    }
+
+    *sense_len = io_hdr.status == SCSI_STATUS_CHECK_CONDITION ? MAX (io_hdr.sb_len_wr, 1) : 0;
+    return TRUE;
+}
+
+static void get_sense_info (const guint8 *sense, guint8 *key, guint8 *asc, guint8 *ascq) {
+    if ((sense[0] & 0x7f) >= 0x72) {
+        /* descriptor format */
+        *key = sense[1] & 0x0f;
+        *asc = sense[2];
+        *ascq = sense[3];
+    } else {
+        /* fixed format */
+        *key = sense[2] & 0x0f;
+        *asc = sense[12];
+        *ascq = sense[13];
+    }
+}
+
+/* Issues a data-in SCSI command, failing on anything but a GOOD status or a
+ * RECOVERED ERROR sense key. */
+static gboolean scsi_command (gint fd, guint8 *cdb, guint8 cdb_len, guint8 *buf, guint buf_len, GError **error) {
+    guint8 sense[SGIO_SENSE_LEN];
+    guint sense_len = 0;
+    guint8 key, asc, ascq;
+
+    if (! sg_io (fd, cdb, cdb_len, buf, buf_len, sense, &sense_len, error))
+        return FALSE;
+
+    if (sense_len > 0) {
+        get_sense_info (sense, &key, &asc, &ascq);
+        if (key != 0x00 && key != 0x01) {
+            g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                         "SCSI command 0x%02x failed: sense key 0x%x, asc 0x%02x, ascq 0x%02x",
+                         cdb[0], key, asc, ascq);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Returns the ATA Status Return sense data descriptor or %NULL if not present. */
+static const guint8 * get_ata_status_descriptor (const guint8 *sense, guint sense_len) {
+    guint offset = 8;
+    guint end;
+
+    if (sense_len < 8 || (sense[0] & 0x7f) < 0x72)
+        return NULL;
+
+    end = MIN (8 + (guint) sense[7], MIN (sense_len, SGIO_SENSE_LEN));
+    while (offset + 2 <= end) {
+        if (sense[offset] == 0x09 && offset + 14 <= end)
+            return sense + offset;
+        offset += sense[offset + 1] + 2;
+    }
+
+    return NULL;
+}
+
+static gboolean ata_pio_in (gint fd, guint8 command, guint8 feature, guint8 *buf, GError **error) {
+    guint8 cdb[16] = { 0, };
+    guint8 sense[SGIO_SENSE_LEN];
+    guint sense_len = 0;
+    const guint8 *desc;
+    guint8 key, asc, ascq;
+
+    cdb[0] = SCSI_ATA_PASS_THROUGH_16;
+    cdb[1] = ATA_PROTOCOL_PIO_DATA_IN << 1;
+    /* T_DIR (from device), BYT_BLOK (in blocks), T_LENGTH (in the count field) */
+    cdb[2] = 0x0e;
+    cdb[4] = feature;
+    cdb[6] = 1;
+    if (command == ATA_CMD_SMART) {
+        cdb[10] = 0x4f;
+        cdb[12] = 0xc2;
+    }
+    cdb[14] = command;
+
+    memset (buf, 0, 512);
+    if (! sg_io (fd, cdb, sizeof (cdb), buf, 512, sense, &sense_len, error))
+        return FALSE;
+
+    if (sense_len > 0) {
+        /* some translation layers report the ATA registers even on success */
+        desc = get_ata_status_descriptor (sense, sense_len);
+        get_sense_info (sense, &key, &asc, &ascq);
+        if ((key != 0x00 && key != 0x01) || (desc && (desc[13] & 0x01))) {
+            g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                         "ATA command 0x%02x (feature 0x%02x) failed: sense key 0x%x, asc 0x%02x, ascq 0x%02x",
+                         command, feature, key, asc, ascq);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Reads the 512-byte IDENTIFY DEVICE data through the SAT ATA PASS-THROUGH. */
+gboolean sgio_ata_identify (gint fd, guint8 *buf, GError **error) {
+    return ata_pio_in (fd, ATA_CMD_IDENTIFY_DEVICE, 0, buf, error);
+}
+
+/* Reads the 512-byte SMART READ DATA structure. */
+gboolean sgio_ata_smart_read_data (gint fd, guint8 *buf, GError **error) {
+    return ata_pio_in (fd, ATA_CMD_SMART, ATA_SMART_READ_DATA, buf, error);
+}
+
+/* Reads the 512-byte (obsolete, yet widely implemented) SMART READ ATTRIBUTE
+ * THRESHOLDS structure. */
+gboolean sgio_ata_smart_read_thresholds (gint fd, guint8 *buf, GError **error) {
+    return ata_pio_in (fd, ATA_CMD_SMART, ATA_SMART_READ_THRESHOLDS, buf, error);
+}
+
+/* Issues SMART RETURN STATUS and sets @passed based on the returned LBA
+ * registers. */
+gboolean sgio_ata_smart_return_status (gint fd, gboolean *passed, GError **error) {
+    guint8 cdb[16] = { 0, };
+    guint8 sense[SGIO_SENSE_LEN];
+    guint sense_len = 0;
+    const guint8 *desc;
+
+    cdb[0] = SCSI_ATA_PASS_THROUGH_16;
+    cdb[1] = ATA_PROTOCOL_NON_DATA << 1;
+    /* CK_COND to get the ATA registers back in the sense data */
+    cdb[2] = 0x20;
+    cdb[4] = ATA_SMART_RETURN_STATUS;
+    cdb[10] = 0x4f;
+    cdb[12] = 0xc2;
+    cdb[14] = ATA_CMD_SMART;
+
+    if (! sg_io (fd, cdb, sizeof (cdb), NULL, 0, sense, &sense_len, error))
+        return FALSE;
+
+    desc = get_ata_status_descriptor (sense, sense_len);
+    if (desc == NULL) {
+        g_set_error_literal (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                             "SMART RETURN STATUS didn't return the ATA registers");
+        return FALSE;
+    }
+
+    /* LBA mid and LBA high (7:0) */
+    if (desc[9] == 0x4f && desc[11] == 0xc2)
+        *passed = TRUE;
+    else if (desc[9] == 0xf4 && desc[11] == 0x2c)
+        *passed = FALSE;
+    else {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "SMART RETURN STATUS returned unexpected registers: 0x%02x 0x%02x",
+                     desc[9], desc[11]);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Reads the cumulative values of the @page log page. */
+gboolean sgio_scsi_log_sense (gint fd, guint8 page, guint8 *buf, guint16 buf_len, GError **error) {
+    guint8 cdb[10] = { 0, };
+
+    cdb[0] = SCSI_LOG_SENSE;
+    /* PC = cumulative values */
+    cdb[2] = 0x40 | (page & 0x3f);
+    cdb[7] = buf_len >> 8;
+    cdb[8] = buf_len & 0xff;
+
+    memset (buf, 0, buf_len);
+    if (! scsi_command (fd, cdb, sizeof (cdb), buf, buf_len, error))
+        return FALSE;
+
+    if ((buf[0] & 0x3f) != (page & 0x3f)) {
+        g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                     "LOG SENSE returned page 0x%02x instead of 0x%02x", buf[0] & 0x3f, page);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Reads the current values of the @page mode page, without block descriptors. */
+gboolean sgio_scsi_mode_sense (gint fd, guint8 page, guint8 *buf, guint16 buf_len, GError **error) {
+    guint8 cdb[10] = { 0, };
+
+    cdb[0] = SCSI_MODE_SENSE_10;
+    /* DBD */
+    cdb[1] = 0x08;
+    cdb[2] = page & 0x3f;
+    cdb[7] = buf_len >> 8;
+    cdb[8] = buf_len & 0xff;
+
+    memset (buf, 0, buf_len);
+    return scsi_command (fd, cdb, sizeof (cdb), buf, buf_len, error);
+}
+
+/* Reads the READ DEFECT DATA header of the grown defect list and sets @count
+ * to the number of its entries. */
+gboolean sgio_scsi_read_grown_defects (gint fd, guint *count, GError **error) {
+    guint8 cdb[10] = { 0, };
+    guint8 buf[4];
+    guint len;
+
+    cdb[0] = SCSI_READ_DEFECT_DATA_10;
+    /* REQ_GLIST, physical sector format */
+    cdb[2] = 0x08 | 0x05;
+    cdb[8] = sizeof (buf);
+
+    memset (buf, 0, sizeof (buf));
+    if (! scsi_command (fd, cdb, sizeof (cdb), buf, sizeof (buf), error))
+        return FALSE;
+
+    len = (buf[2] << 8) | buf[3];
+    /* the device may pick a different format, only the short block one uses 4-byte entries */
+    *count = (buf[1] & 0x07) == 0x00 ? len / 4 : len / 8;
+
+    return TRUE;
+}
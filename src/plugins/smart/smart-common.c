@@ -69,6 +69,14 @@
  * certain performance overhead and caution is advised when retrieving SMART data
  * from multiple drives in parallel.
  *
+ * To limit that overhead, SMART data are read directly from the drive through
+ * the `SG_IO` interface when no extra arguments are passed to
+ * bd_smart_ata_get_info() and bd_smart_scsi_get_info(): ATA `IDENTIFY DEVICE`,
+ * `SMART READ DATA` and `SMART RETURN STATUS` commands via the SAT ATA PASS-THROUGH
+ * and SCSI `LOG SENSE` pages respectively. The compiled-in `drivedb.h` is used
+ * for ATA attribute naming in that case. Devices the native reader can't handle
+ * are transparently passed to `smartctl`.
+ *
  * ## Attribute naming and value interpretation #
  *
  * Check #BDSmartATAAttribute for the struct members overview first. The plugin
@@ -195,7 +203,7 @@ gboolean bd_smart_init (void) {
  *
  */
 void bd_smart_close (void) {
-    /* nothing to do here */
+    drivedb_index_free ();
 }
 
 /**
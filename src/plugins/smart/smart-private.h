@@ -101,4 +101,31 @@ DriveDBAttr** drivedb_lookup_drive (const gchar *model, const gchar *fw, gboolea
 G_GNUC_INTERNAL
 void free_drivedb_attrs (DriveDBAttr **attrs);
 
+G_GNUC_INTERNAL
+void drivedb_index_free (void);
+
+G_GNUC_INTERNAL
+gint sgio_open (const gchar *device, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_ata_identify (gint fd, guint8 *buf, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_ata_smart_read_data (gint fd, guint8 *buf, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_ata_smart_read_thresholds (gint fd, guint8 *buf, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_ata_smart_return_status (gint fd, gboolean *passed, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_scsi_log_sense (gint fd, guint8 page, guint8 *buf, guint16 buf_len, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_scsi_mode_sense (gint fd, guint8 page, guint8 *buf, guint16 buf_len, GError **error);
+
+G_GNUC_INTERNAL
+gboolean sgio_scsi_read_grown_defects (gint fd, guint *count, GError **error);
+
 #endif  /* BD_SMART_PRIVATE */
@@ -442,12 +442,19 @@ gboolean bd_smart_is_tech_avail (BDSmartTech tech, guint64 mode, GError **error)
 BDSmartATA *   bd_smart_ata_get_info            (const gchar        *device,
                                                  const BDExtraArg  **extra,
                                                  GError            **error);
+BDSmartATA *   bd_smart_ata_get_info_native     (const gchar        *device,
+                                                 GError            **error);
 BDSmartATA *   bd_smart_ata_get_info_from_data  (const guint8       *data,
                                                  gsize               data_len,
                                                  GError            **error);
 BDSmartSCSI *  bd_smart_scsi_get_info           (const gchar        *device,
                                                  const BDExtraArg  **extra,
                                                  GError            **error);
+BDSmartSCSI *  bd_smart_scsi_get_info_native    (const gchar        *device,
+                                                 GError            **error);
+BDSmartSCSI *  bd_smart_scsi_get_info_from_data (const guint8       *data,
+                                                 gsize               data_len,
+                                                 GError            **error);
 gboolean       bd_smart_set_enabled             (const gchar        *device,
                                                  gboolean            enabled,
                                                  const BDExtraArg  **extra,
@@ -107,22 +107,26 @@ static const gchar * get_error_message_from_exit_code (gint exit_code) {
     return NULL;
 }
 
+/* verify the attribute name matches the well-known attribute */
+static gboolean is_well_known_attr (guint8 id, const gchar *name) {
+    const gchar * const *n;
+
+    if (well_known_attrs[id].libatasmart_name == NULL)
+        return FALSE;
+    for (n = well_known_attrs[id].smartmontools_names; *n; n++)
+        if (g_strcmp0 (*n, name) == 0)
+            return TRUE;
+
+    return FALSE;
+}
+
 static void lookup_well_known_attr (BDSmartATAAttribute *a,
                                     gchar **well_known_name,
                                     gint64 *pretty_value,
                                     BDSmartATAAttributeUnit *pretty_unit) {
     *well_known_name = g_strdup (well_known_attrs[a->id].libatasmart_name);
     if (*well_known_name) {
-        /* verify matching attribute names */
-        const gchar * const *n;
-        gboolean trusted = FALSE;
-
-        for (n = well_known_attrs[a->id].smartmontools_names; *n; n++)
-            if (g_strcmp0 (*n, a->name) == 0) {
-                trusted = TRUE;
-                break;
-            }
-        if (trusted) {
+        if (is_well_known_attr (a->id, a->name)) {
             char *endptr = NULL;
             guint64 hour, min, sec, usec;
 
@@ -338,6 +342,27 @@ static gboolean parse_smartctl_error (gint status, const gchar *stdout, const gc
     return TRUE;
 }
 
+static guint16 get_attribute_flags (gint64 f) {
+    guint16 flags = 0;
+
+    if (f & 0x01)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_PREFAILURE;
+    if (f & 0x02)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_ONLINE;
+    if (f & 0x04)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_PERFORMANCE;
+    if (f & 0x08)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_ERROR_RATE;
+    if (f & 0x10)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_EVENT_COUNT;
+    if (f & 0x20)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_SELF_PRESERVING;
+    if (f & 0xffc0)
+        flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_OTHER;
+
+    return flags;
+}
+
 static BDSmartATAAttribute ** parse_ata_smart_attributes (JsonReader *reader, GError **error) {
     GPtrArray *ptr_array;
     gint count;
@@ -347,7 +372,6 @@ static BDSmartATAAttribute ** parse_ata_smart_attributes (JsonReader *reader, GE
     count = json_reader_count_elements (reader);
     for (i = 0; count > 0 && i < count; i++) {
         BDSmartATAAttribute *attr;
-        gint64 f;
 
         if (! json_reader_read_element (reader, i)) {
             g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_INVALID_ARGUMENT,
@@ -411,21 +435,7 @@ static BDSmartATAAttribute ** parse_ata_smart_attributes (JsonReader *reader, GE
 
         _READ_AND_CHECK ("flags");
         _READ_AND_CHECK ("value");
-        f = json_reader_get_int_value (reader);
-        if (f & 0x01)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_PREFAILURE;
-        if (f & 0x02)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_ONLINE;
-        if (f & 0x04)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_PERFORMANCE;
-        if (f & 0x08)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_ERROR_RATE;
-        if (f & 0x10)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_EVENT_COUNT;
-        if (f & 0x20)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_SELF_PRESERVING;
-        if (f & 0xffc0)
-            attr->flags |= BD_SMART_ATA_ATTRIBUTE_FLAG_OTHER;
+        attr->flags = get_attribute_flags (json_reader_get_int_value (reader));
         json_reader_end_member (reader);
         json_reader_end_member (reader);
         json_reader_end_element (reader);
@@ -443,6 +453,99 @@ static BDSmartATAAttribute ** parse_ata_smart_attributes (JsonReader *reader, GE
     return (BDSmartATAAttribute **) g_ptr_array_free (ptr_array, FALSE);
 }
 
+static void set_offline_data_collection_status (BDSmartATA *data, gint64 val) {
+    switch (val & 0x7f) {
+        case 0x00:
+            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_NEVER_STARTED;
+            break;
+        case 0x02:
+            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_NO_ERROR;
+            break;
+        case 0x03:
+            if (val == 0x03)
+                data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_IN_PROGRESS;
+            else
+                data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_RESERVED;
+            break;
+        case 0x04:
+            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_SUSPENDED_INTR;
+            break;
+        case 0x05:
+            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_ABORTED_INTR;
+            break;
+        case 0x06:
+            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_ABORTED_ERROR;
+            break;
+        default:
+            if ((val & 0x7f) >= 0x40)
+                data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_VENDOR_SPECIFIC;
+            else
+                data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_RESERVED;
+            break;
+    }
+    data->auto_offline_data_collection_enabled = val & 0x80;
+}
+
+static void set_self_test_status (BDSmartATA *data, gint64 val) {
+    switch (val >> 4) {
+        case 0x00:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_COMPLETED_NO_ERROR;
+            break;
+        case 0x01:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ABORTED_HOST;
+            break;
+        case 0x02:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_INTR_HOST_RESET;
+            break;
+        case 0x03:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_FATAL;
+            break;
+        case 0x04:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_UNKNOWN;
+            break;
+        case 0x05:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_ELECTRICAL;
+            break;
+        case 0x06:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_SERVO;
+            break;
+        case 0x07:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_READ;
+            break;
+        case 0x08:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_HANDLING;
+            break;
+        case 0x0f:
+            data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_IN_PROGRESS;
+            data->self_test_percent_remaining = (val & 0x0f) * 10;
+            break;
+    }
+}
+
+static void set_capabilities (BDSmartATA *data, gint64 offline_cap, gint64 smart_cap) {
+    if (offline_cap == 0x00)
+        data->offline_data_collection_capabilities = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_NOT_SUPPORTED;
+    else {
+        if (offline_cap & 0x01)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_EXEC_OFFLINE_IMMEDIATE;
+        /* 0x02 is deprecated - SupportAutomaticTimer */
+        if (offline_cap & 0x04)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_OFFLINE_ABORT;
+        if (offline_cap & 0x08)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_OFFLINE_SURFACE_SCAN;
+        if (offline_cap & 0x10)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_SELF_TEST;
+        if (offline_cap & 0x20)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_CONVEYANCE_SELF_TEST;
+        if (offline_cap & 0x40)
+            data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_SELECTIVE_SELF_TEST;
+    }
+    if (smart_cap & 0x01)
+        data->smart_capabilities |= BD_SMART_ATA_CAP_ATTRIBUTE_AUTOSAVE;
+    if (smart_cap & 0x02)
+        data->smart_capabilities |= BD_SMART_ATA_CAP_AUTOSAVE_TIMER;
+}
+
 static BDSmartATA * parse_ata_smart (JsonParser *parser, GError **error) {
     BDSmartATA *data;
     JsonReader *reader;
@@ -480,40 +583,8 @@ static BDSmartATA * parse_ata_smart (JsonParser *parser, GError **error) {
     }
     if (json_reader_read_member (reader, "offline_data_collection")) {
         if (json_reader_read_member (reader, "status")) {
-            if (json_reader_read_member (reader, "value")) {
-                gint64 val = json_reader_get_int_value (reader);
-
-                switch (val & 0x7f) {
-                    case 0x00:
-                        data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_NEVER_STARTED;
-                        break;
-                    case 0x02:
-                        data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_NO_ERROR;
-                        break;
-                    case 0x03:
-                        if (val == 0x03)
-                            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_IN_PROGRESS;
-                        else
-                            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_RESERVED;
-                        break;
-                    case 0x04:
-                        data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_SUSPENDED_INTR;
-                        break;
-                    case 0x05:
-                        data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_ABORTED_INTR;
-                        break;
-                    case 0x06:
-                        data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_ABORTED_ERROR;
-                        break;
-                    default:
-                        if ((val & 0x7f) >= 0x40)
-                            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_VENDOR_SPECIFIC;
-                        else
-                            data->offline_data_collection_status = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_STATUS_RESERVED;
-                        break;
-                }
-                data->auto_offline_data_collection_enabled = val & 0x80;
-            }
+            if (json_reader_read_member (reader, "value"))
+                set_offline_data_collection_status (data, json_reader_get_int_value (reader));
             json_reader_end_member (reader);
         }
         json_reader_end_member (reader);
@@ -525,43 +596,8 @@ static BDSmartATA * parse_ata_smart (JsonParser *parser, GError **error) {
 
     if (json_reader_read_member (reader, "self_test")) {
         if (json_reader_read_member (reader, "status")) {
-            if (json_reader_read_member (reader, "value")) {
-                gint64 val = json_reader_get_int_value (reader);
-
-                switch (val >> 4) {
-                    case 0x00:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_COMPLETED_NO_ERROR;
-                        break;
-                    case 0x01:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ABORTED_HOST;
-                        break;
-                    case 0x02:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_INTR_HOST_RESET;
-                        break;
-                    case 0x03:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_FATAL;
-                        break;
-                    case 0x04:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_UNKNOWN;
-                        break;
-                    case 0x05:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_ELECTRICAL;
-                        break;
-                    case 0x06:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_SERVO;
-                        break;
-                    case 0x07:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_READ;
-                        break;
-                    case 0x08:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_ERROR_HANDLING;
-                        break;
-                    case 0x0f:
-                        data->self_test_status = BD_SMART_ATA_SELF_TEST_STATUS_IN_PROGRESS;
-                        data->self_test_percent_remaining = (val & 0x0f) * 10;
-                        break;
-                }
-            }
+            if (json_reader_read_member (reader, "value"))
+                set_self_test_status (data, json_reader_get_int_value (reader));
             json_reader_end_member (reader);
         }
         json_reader_end_member (reader);
@@ -583,29 +619,8 @@ static BDSmartATA * parse_ata_smart (JsonParser *parser, GError **error) {
     if (json_reader_read_member (reader, "capabilities")) {
         gint64 val[2] = { 0, 0 };
 
-        if (parse_int_array (reader, "values", val, G_N_ELEMENTS (val), NULL) == G_N_ELEMENTS (val)) {
-            if (val[0] == 0x00)
-                data->offline_data_collection_capabilities = BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_NOT_SUPPORTED;
-            else {
-                if (val[0] & 0x01)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_EXEC_OFFLINE_IMMEDIATE;
-                /* 0x02 is deprecated - SupportAutomaticTimer */
-                if (val[0] & 0x04)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_OFFLINE_ABORT;
-                if (val[0] & 0x08)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_OFFLINE_SURFACE_SCAN;
-                if (val[0] & 0x10)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_SELF_TEST;
-                if (val[0] & 0x20)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_CONVEYANCE_SELF_TEST;
-                if (val[0] & 0x40)
-                    data->offline_data_collection_capabilities |= BD_SMART_ATA_OFFLINE_DATA_COLLECTION_CAP_SELECTIVE_SELF_TEST;
-            }
-            if (val[1] & 0x01)
-                data->smart_capabilities |= BD_SMART_ATA_CAP_ATTRIBUTE_AUTOSAVE;
-            if (val[1] & 0x02)
-                data->smart_capabilities |= BD_SMART_ATA_CAP_AUTOSAVE_TIMER;
-        }
+        if (parse_int_array (reader, "values", val, G_N_ELEMENTS (val), NULL) == G_N_ELEMENTS (val))
+            set_capabilities (data, val[0], val[1]);
         if (json_reader_read_member (reader, "error_logging_supported"))
             if (json_reader_get_boolean_value (reader))
                 data->smart_capabilities |= BD_SMART_ATA_CAP_ERROR_LOGGING;
@@ -667,6 +682,114 @@ static BDSmartATA * parse_ata_smart (JsonParser *parser, GError **error) {
 }
 
 
+static BDSmartSCSIInformationalException get_scsi_ie (gint64 asc, gint64 ascq) {
+    if (asc == 0xb) {
+        switch (ascq) {
+            case 0x00:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_ABORTED_COMMAND;
+            case 0x01:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_TEMPERATURE_EXCEEDED;
+            case 0x02:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_ENCLOSURE_DEGRADED;
+            case 0x03:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_SELFTEST_FAILED;
+            case 0x04:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_PRESCAN_MEDIUM_ERROR;
+            case 0x05:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_SCAN_MEDIUM_ERROR;
+            case 0x06:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_NV_CACHE_VOLATILE;
+            case 0x07:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_NV_CACHE_DEGRADED_POWER;
+            case 0x08:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_POWER_LOSS_EXPECTED;
+            case 0x09:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_STATISTICS_NOTIFICATION;
+            case 0x0a:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_CRITICAL_TEMP;
+            case 0x0b:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_CRITICAL_TEMP;
+            case 0x0c:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_OPERATING_TEMP;
+            case 0x0d:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_OPERATING_TEMP;
+            case 0x0e:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_CRITICAL_HUMIDITY;
+            case 0x0f:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_CRITICAL_HUMIDITY;
+            case 0x10:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_OPERATING_HUMIDITY;
+            case 0x11:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_OPERATING_HUMIDITY;
+            case 0x12:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MICROCODE_SECURITY_RISK;
+            case 0x13:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MICROCODE_SIGNATURE_VALIDATION_FAILURE;
+            case 0x14:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_PHYSICAL_ELEMENT_STATUS_CHANGE;
+            default:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_UNSPECIFIED;
+        }
+    } else if (asc == 0x5d) {
+        switch (ascq) {
+            case 0x00:
+            case 0xff:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_FAILURE_PREDICTION_THRESH;
+            case 0x01:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MEDIA_FAILURE_PREDICTION_THRESH;
+            case 0x02:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOGICAL_UNIT_FAILURE_PREDICTION_THRESH;
+            case 0x03:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SPARE_EXHAUSTION_PREDICTION_THRESH;
+            case 0x73:
+                return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MEDIA_ENDURANCE_LIMIT;
+            default:
+                if (ascq >= 0x10 && ascq <= 0x1d)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HARDWARE_IMPENDING_FAILURE;
+                else if (ascq >= 0x20 && ascq <= 0x2c)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_CONTROLLER_IMPENDING_FAILURE;
+                else if (ascq >= 0x30 && ascq <= 0x3c)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_DATA_CHANNEL_IMPENDING_FAILURE;
+                else if (ascq >= 0x40 && ascq <= 0x4c)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SERVO_IMPENDING_FAILURE;
+                else if (ascq >= 0x50 && ascq <= 0x5c)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SPINDLE_IMPENDING_FAILURE;
+                else if (ascq >= 0x60 && ascq <= 0x6c)
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_FIRMWARE_IMPENDING_FAILURE;
+                else
+                    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_UNSPECIFIED;
+        }
+    }
+
+    return BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_NONE;
+}
+
+static BDSmartSCSIBackgroundScanStatus get_background_scan_status (guint64 val) {
+    switch (val) {
+        case 0x00:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_NO_SCANS_ACTIVE;
+        case 0x01:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_SCAN_ACTIVE;
+        case 0x02:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_PRESCAN_ACTIVE;
+        case 0x03:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_ERROR_FATAL;
+        case 0x04:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_PATTERN_VENDOR_SPECIFIC;
+        case 0x05:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_ERROR_PLIST;
+        case 0x06:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_VENDOR_SPECIFIC;
+        case 0x07:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_TEMPERATURE;
+        case 0x08:
+            return BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_BMS_TIMER;
+        default:
+            /* just copy the value, it corresponds to the above anyway */
+            return val;
+    }
+}
+
 static BDSmartSCSI * parse_scsi_smart (JsonParser *parser, G_GNUC_UNUSED GError **error) {
     BDSmartSCSI *data;
     JsonReader *reader;
@@ -708,111 +831,8 @@ static BDSmartSCSI * parse_scsi_smart (JsonParser *parser, G_GNUC_UNUSED GError
                 data->scsi_ie_string = g_strdup (json_reader_get_string_value (reader));
             json_reader_end_member (reader);
 
-            if (asc == 0xb && ascq >= 0) {
-                switch (ascq) {
-                    case 0x00:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_ABORTED_COMMAND;
-                        break;
-                    case 0x01:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_TEMPERATURE_EXCEEDED;
-                        break;
-                    case 0x02:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_ENCLOSURE_DEGRADED;
-                        break;
-                    case 0x03:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_SELFTEST_FAILED;
-                        break;
-                    case 0x04:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_PRESCAN_MEDIUM_ERROR;
-                        break;
-                    case 0x05:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_BACKGROUND_SCAN_MEDIUM_ERROR;
-                        break;
-                    case 0x06:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_NV_CACHE_VOLATILE;
-                        break;
-                    case 0x07:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_NV_CACHE_DEGRADED_POWER;
-                        break;
-                    case 0x08:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_POWER_LOSS_EXPECTED;
-                        break;
-                    case 0x09:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_STATISTICS_NOTIFICATION;
-                        break;
-                    case 0x0a:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_CRITICAL_TEMP;
-                        break;
-                    case 0x0b:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_CRITICAL_TEMP;
-                        break;
-                    case 0x0c:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_OPERATING_TEMP;
-                        break;
-                    case 0x0d:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_OPERATING_TEMP;
-                        break;
-                    case 0x0e:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_CRITICAL_HUMIDITY;
-                        break;
-                    case 0x0f:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_CRITICAL_HUMIDITY;
-                        break;
-                    case 0x10:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HIGH_OPERATING_HUMIDITY;
-                        break;
-                    case 0x11:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOW_OPERATING_HUMIDITY;
-                        break;
-                    case 0x12:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MICROCODE_SECURITY_RISK;
-                        break;
-                    case 0x13:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MICROCODE_SIGNATURE_VALIDATION_FAILURE;
-                        break;
-                    case 0x14:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_PHYSICAL_ELEMENT_STATUS_CHANGE;
-                        break;
-                    default:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_UNSPECIFIED;
-                        break;
-                }
-            } else if (asc == 0x5d && ascq >= 0) {
-                switch (ascq) {
-                    case 0x00:
-                    case 0xff:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_FAILURE_PREDICTION_THRESH;
-                        break;
-                    case 0x01:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MEDIA_FAILURE_PREDICTION_THRESH;
-                        break;
-                    case 0x02:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_LOGICAL_UNIT_FAILURE_PREDICTION_THRESH;
-                        break;
-                    case 0x03:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SPARE_EXHAUSTION_PREDICTION_THRESH;
-                        break;
-                    case 0x73:
-                        data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_MEDIA_ENDURANCE_LIMIT;
-                        break;
-                    default:
-                        if (ascq >= 0x10 && ascq <= 0x1d)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_HARDWARE_IMPENDING_FAILURE;
-                        else if (ascq >= 0x20 && ascq <= 0x2c)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_CONTROLLER_IMPENDING_FAILURE;
-                        else if (ascq >= 0x30 && ascq <= 0x3c)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_DATA_CHANNEL_IMPENDING_FAILURE;
-                        else if (ascq >= 0x40 && ascq <= 0x4c)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SERVO_IMPENDING_FAILURE;
-                        else if (ascq >= 0x50 && ascq <= 0x5c)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_SPINDLE_IMPENDING_FAILURE;
-                        else if (ascq >= 0x60 && ascq <= 0x6c)
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_FIRMWARE_IMPENDING_FAILURE;
-                        else
-                            data->scsi_ie = BD_SMART_SCSI_INFORMATIONAL_EXCEPTION_UNSPECIFIED;
-                        break;
-                }
-            }
+            if (asc >= 0 && ascq >= 0)
+                data->scsi_ie = get_scsi_ie (asc, ascq);
         }
         json_reader_end_member (reader);
     }
@@ -840,42 +860,8 @@ static BDSmartSCSI * parse_scsi_smart (JsonParser *parser, G_GNUC_UNUSED GError
     /* scsi_background_scan section */
     if (json_reader_read_member (reader, "scsi_background_scan")) {
         if (json_reader_read_member (reader, "status")) {
-            if (json_reader_read_member (reader, "value")) {
-                guint64 val = json_reader_get_int_value (reader);
-
-                switch (val) {
-                    case 0x00:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_NO_SCANS_ACTIVE;
-                        break;
-                    case 0x01:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_SCAN_ACTIVE;
-                        break;
-                    case 0x02:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_PRESCAN_ACTIVE;
-                        break;
-                    case 0x03:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_ERROR_FATAL;
-                        break;
-                    case 0x04:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_PATTERN_VENDOR_SPECIFIC;
-                        break;
-                    case 0x05:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_ERROR_PLIST;
-                        break;
-                    case 0x06:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_VENDOR_SPECIFIC;
-                        break;
-                    case 0x07:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_HALTED_TEMPERATURE;
-                        break;
-                    case 0x08:
-                        data->background_scan_status = BD_SMART_SCSI_BACKGROUND_SCAN_STATUS_BMS_TIMER;
-                        break;
-                    default:
-                        /* just copy the value, it corresponds to the above anyway */
-                        data->background_scan_status = val;
-                }
-            }
+            if (json_reader_read_member (reader, "value"))
+                data->background_scan_status = get_background_scan_status (json_reader_get_int_value (reader));
             json_reader_end_member (reader);
             if (json_reader_read_member (reader, "scan_progress")) {
                 const gchar *val = json_reader_get_string_value (reader);
@@ -994,6 +980,577 @@ static BDSmartSCSI * parse_scsi_smart (JsonParser *parser, G_GNUC_UNUSED GError
 }
 
 
+/* libatasmart blob (skdump) section tags */
+#define SKDUMP_TAG_IDENTIFY         "IDFY"
+#define SKDUMP_TAG_SMART_STATUS     "SMST"
+#define SKDUMP_TAG_SMART_DATA       "SMDT"
+#define SKDUMP_TAG_SMART_THRESHOLDS "SMTH"
+
+#define ATA_SECTOR_SIZE 512
+#define ATA_SMART_N_ATTRS 30
+
+#define SCSI_LOG_PAGE_SUPPORTED       0x00
+#define SCSI_LOG_PAGE_WRITE_ERRORS    0x02
+#define SCSI_LOG_PAGE_READ_ERRORS     0x03
+#define SCSI_LOG_PAGE_TEMPERATURE     0x0d
+#define SCSI_LOG_PAGE_START_STOP      0x0e
+#define SCSI_LOG_PAGE_BACKGROUND_SCAN 0x15
+#define SCSI_LOG_PAGE_IE              0x2f
+#define SCSI_MODE_PAGE_IE_CONTROL     0x1c
+#define SCSI_PAGE_BUF_SIZE            1024
+
+static guint16 get_le16 (const guint8 *buf) {
+    return buf[0] | (buf[1] << 8);
+}
+
+static guint16 get_be16 (const guint8 *buf) {
+    return (buf[0] << 8) | buf[1];
+}
+
+static guint32 get_be32 (const guint8 *buf) {
+    return ((guint32) buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+static guint8 get_checksum (const guint8 *buf) {
+    guint8 sum = 0;
+    guint i;
+
+    for (i = 0; i < ATA_SECTOR_SIZE; i++)
+        sum += buf[i];
+
+    return sum;
+}
+
+/* IDENTIFY DEVICE strings are stored as byte-swapped words padded with spaces */
+static gchar * get_identify_string (const guint8 *identify, guint word, guint n_words) {
+    gchar *s;
+    guint i;
+
+    s = g_new0 (gchar, n_words * 2 + 1);
+    for (i = 0; i < n_words; i++) {
+        s[i * 2] = identify[(word + i) * 2 + 1];
+        s[i * 2 + 1] = identify[(word + i) * 2];
+    }
+
+    return g_strstrip (s);
+}
+
+/* the power-on time unit of attribute 9 depends on its drivedb name */
+static guint get_power_on_minutes (const gchar *name, guint64 raw) {
+    if (g_strcmp0 (name, "Power_On_Minutes") == 0)
+        return raw & 0xffffffff;
+    if (g_strcmp0 (name, "Power_On_Half_Minutes") == 0)
+        return (raw & 0xffffffff) / 2;
+    if (g_strcmp0 (name, "Power_On_Seconds") == 0)
+        return (raw & 0xffffffff) / 60;
+    if (g_strcmp0 (name, "Power_On_Hours_and_Msec") == 0)
+        return (raw & 0xffffffff) * 60;
+    /* Power_On_Hours, raw24(raw8) */
+    return (raw & 0xffffff) * 60;
+}
+
+static BDSmartATAAttribute * parse_ata_native_attr (const guint8 *entry, const guint8 *thresholds, DriveDBAttr **drivedb_attrs) {
+    BDSmartATAAttribute *attr;
+    DriveDBAttr **l;
+    guint64 val;
+    gint i;
+
+    attr = g_new0 (BDSmartATAAttribute, 1);
+    attr->id = entry[0];
+    attr->flags = get_attribute_flags (get_le16 (entry + 1));
+    attr->value = entry[3];
+    attr->worst = entry[4];
+    for (i = 5; i >= 0; i--)
+        attr->value_raw = (attr->value_raw << 8) | entry[5 + i];
+
+    for (i = 0; i < ATA_SMART_N_ATTRS; i++)
+        if (thresholds[2 + i * 12] == attr->id) {
+            attr->threshold = thresholds[2 + i * 12 + 1];
+            break;
+        }
+    if (attr->threshold > 0 && attr->value <= attr->threshold)
+        attr->failing_now = TRUE;
+    else if (attr->threshold > 0 && attr->worst <= attr->threshold)
+        attr->failed_past = TRUE;
+
+    for (l = drivedb_attrs; l && *l; l++)
+        if ((*l)->id == attr->id) {
+            attr->name = g_strdup ((*l)->name);
+            break;
+        }
+    if (attr->name == NULL)
+        attr->name = g_strdup (well_known_attrs[attr->id].smartmontools_names[0] ?
+                               well_known_attrs[attr->id].smartmontools_names[0] : "Unknown_Attribute");
+
+    /* the value as smartctl would print it */
+    val = attr->value_raw;
+    attr->pretty_value = attr->value_raw;
+    if (is_well_known_attr (attr->id, attr->name)) {
+        attr->well_known_name = g_strdup (well_known_attrs[attr->id].libatasmart_name);
+        attr->pretty_value_unit = well_known_attrs[attr->id].unit;
+        switch (well_known_attrs[attr->id].unit) {
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_MSECONDS:
+                if (attr->id == 9) {
+                    val = get_power_on_minutes (attr->name, attr->value_raw) / 60;
+                    attr->pretty_value = (gint64) get_power_on_minutes (attr->name, attr->value_raw) * 60000;
+                } else if (attr->id == 3 || attr->id == 226) {
+                    /* raw16(avg16) in milliseconds */
+                    val = attr->value_raw & 0xffff;
+                    attr->pretty_value = val;
+                } else {
+                    /* hours */
+                    val = attr->value_raw & 0xffffffff;
+                    attr->pretty_value = val * 3600000;
+                }
+                break;
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_MKELVIN:
+                /* temperature in degrees Celsius, need millikelvins */
+                val = attr->value_raw & 0xff;
+                attr->pretty_value = val * 1000 + 273150;
+                break;
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_UNKNOWN:
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_NONE:
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_SECTORS:
+                break;
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_SMALL_PERCENT:
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_PERCENT:
+            case BD_SMART_ATA_ATTRIBUTE_UNIT_MB:
+            default:
+                /* not implemented */
+                attr->pretty_value_unit = BD_SMART_ATA_ATTRIBUTE_UNIT_UNKNOWN;
+                break;
+        }
+    }
+    attr->pretty_value_string = g_strdup_printf ("%" G_GUINT64_FORMAT, val);
+
+    return attr;
+}
+
+/* Decodes the raw IDENTIFY DEVICE, SMART READ DATA and SMART READ THRESHOLDS
+ * structures the same way smartctl does. */
+static BDSmartATA * parse_ata_native (const guint8 *identify, const guint8 *smart_data, const guint8 *thresholds, gboolean passed, GError **error) {
+    BDSmartATA *data;
+    GPtrArray *ptr_array;
+    DriveDBAttr **drivedb_attrs;
+    gchar *model;
+    gchar *fw;
+    guint16 w84;
+    guint i;
+
+    /* the integrity word is only valid with the 0xa5 signature */
+    if (identify[510] == 0xa5 && get_checksum (identify) != 0) {
+        g_set_error_literal (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                             "Checksum error in the IDENTIFY DEVICE data");
+        return NULL;
+    }
+    if (get_checksum (smart_data) != 0) {
+        g_set_error_literal (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                             "Checksum error in the SMART data structure");
+        return NULL;
+    }
+
+    data = g_new0 (BDSmartATA, 1);
+    data->smart_supported = get_le16 (identify + 82 * 2) & 0x01;
+    data->smart_enabled = get_le16 (identify + 85 * 2) & 0x01;
+    data->overall_status_passed = passed;
+
+    set_offline_data_collection_status (data, smart_data[362]);
+    data->offline_data_collection_completion = get_le16 (smart_data + 364);
+    set_self_test_status (data, smart_data[363]);
+    set_capabilities (data, smart_data[367], get_le16 (smart_data + 368));
+    if (smart_data[370] & 0x01)
+        data->smart_capabilities |= BD_SMART_ATA_CAP_ERROR_LOGGING;
+    w84 = get_le16 (identify + 84 * 2);
+    if ((w84 & 0xc000) == 0x4000 && (w84 & 0x20))
+        data->smart_capabilities |= BD_SMART_ATA_CAP_GP_LOGGING;
+    if (smart_data[367] & 0x10) {
+        data->self_test_polling_short = smart_data[372];
+        data->self_test_polling_extended = smart_data[373] == 0xff ? get_le16 (smart_data + 375) : smart_data[373];
+    }
+    if (smart_data[367] & 0x20)
+        data->self_test_polling_conveyance = smart_data[374];
+
+    model = get_identify_string (identify, 27, 20);
+    fw = get_identify_string (identify, 23, 4);
+    drivedb_attrs = drivedb_lookup_drive (model, fw, TRUE);
+    g_free (model);
+    g_free (fw);
+
+    ptr_array = g_ptr_array_new ();
+    for (i = 0; i < ATA_SMART_N_ATTRS; i++) {
+        const guint8 *entry = smart_data + 2 + i * 12;
+        BDSmartATAAttribute *attr;
+
+        if (entry[0] == 0)
+            continue;
+
+        attr = parse_ata_native_attr (entry, thresholds, drivedb_attrs);
+        switch (attr->id) {
+            case 9:
+                data->power_on_time = get_power_on_minutes (attr->name, attr->value_raw);
+                break;
+            case 12:
+                data->power_cycle_count = attr->value_raw;
+                break;
+            case 190:
+                if (data->temperature == 0 && (attr->value_raw & 0xff) > 0)
+                    data->temperature = (attr->value_raw & 0xff) + 273;
+                break;
+            case 194:
+                /* preferred over the airflow temperature */
+                if ((attr->value_raw & 0xff) > 0)
+                    data->temperature = (attr->value_raw & 0xff) + 273;
+                break;
+        }
+        g_ptr_array_add (ptr_array, attr);
+    }
+    free_drivedb_attrs (drivedb_attrs);
+
+    g_ptr_array_add (ptr_array, NULL);
+    data->attributes = (BDSmartATAAttribute **) g_ptr_array_free (ptr_array, FALSE);
+
+    return data;
+}
+
+static gboolean is_skdump (const guint8 *data, gsize data_len) {
+    return data_len >= 8 &&
+           (memcmp (data, SKDUMP_TAG_IDENTIFY, 4) == 0 ||
+            memcmp (data, SKDUMP_TAG_SMART_STATUS, 4) == 0 ||
+            memcmp (data, SKDUMP_TAG_SMART_DATA, 4) == 0 ||
+            memcmp (data, SKDUMP_TAG_SMART_THRESHOLDS, 4) == 0);
+}
+
+/* Parses the libatasmart blob format: a sequence of 4-byte tags followed by
+ * a big-endian 32-bit size and the raw data. */
+static BDSmartATA * parse_skdump (const guint8 *data, gsize data_len, GError **error) {
+    static const guint8 no_thresholds[ATA_SECTOR_SIZE] = { 0, };
+    const guint8 *identify = NULL;
+    const guint8 *smart_data = NULL;
+    const guint8 *thresholds = no_thresholds;
+    gboolean have_status = FALSE;
+    gboolean passed = FALSE;
+    gsize offset = 0;
+
+    while (offset + 8 <= data_len) {
+        const guint8 *tag = data + offset;
+        guint32 size = get_be32 (data + offset + 4);
+
+        offset += 8;
+        if (size > data_len - offset) {
+            g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_INVALID_ARGUMENT,
+                         "Error parsing blob data: truncated '%.4s' section", (const gchar *) tag);
+            return NULL;
+        }
+
+        if (memcmp (tag, SKDUMP_TAG_IDENTIFY, 4) == 0 && size == ATA_SECTOR_SIZE)
+            identify = data + offset;
+        else if (memcmp (tag, SKDUMP_TAG_SMART_DATA, 4) == 0 && size == ATA_SECTOR_SIZE)
+            smart_data = data + offset;
+        else if (memcmp (tag, SKDUMP_TAG_SMART_THRESHOLDS, 4) == 0 && size == ATA_SECTOR_SIZE)
+            thresholds = data + offset;
+        else if (memcmp (tag, SKDUMP_TAG_SMART_STATUS, 4) == 0 && size == 4) {
+            passed = get_be32 (data + offset) != 0;
+            have_status = TRUE;
+        }
+        offset += size;
+    }
+
+    if (identify == NULL || smart_data == NULL || !have_status) {
+        g_set_error_literal (error, BD_SMART_ERROR, BD_SMART_ERROR_INVALID_ARGUMENT,
+                             "Error parsing blob data: missing IDENTIFY, SMART data or SMART status section");
+        return NULL;
+    }
+
+    return parse_ata_native (identify, smart_data, thresholds, passed, error);
+}
+
+static BDSmartATA * get_ata_info_native (const gchar *device, GError **error) {
+    guint8 identify[ATA_SECTOR_SIZE];
+    guint8 smart_data[ATA_SECTOR_SIZE];
+    guint8 thresholds[ATA_SECTOR_SIZE];
+    gboolean passed = FALSE;
+    gint fd;
+
+    fd = sgio_open (device, error);
+    if (fd < 0)
+        return NULL;
+
+    if (! sgio_ata_identify (fd, identify, error)) {
+        close (fd);
+        return NULL;
+    }
+
+    /* smartctl doesn't report any SMART data in such case either */
+    if (! (get_le16 (identify + 85 * 2) & 0x01)) {
+        g_set_error_literal (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                             "SMART is not enabled on the device");
+        close (fd);
+        return NULL;
+    }
+
+    if (! sgio_ata_smart_read_data (fd, smart_data, error) ||
+        ! sgio_ata_smart_return_status (fd, &passed, error)) {
+        close (fd);
+        return NULL;
+    }
+
+    /* thresholds are obsolete since ATA-8, treat them as unset if not available */
+    if (! sgio_ata_smart_read_thresholds (fd, thresholds, NULL))
+        memset (thresholds, 0, sizeof (thresholds));
+    close (fd);
+
+    return parse_ata_native (identify, smart_data, thresholds, passed, error);
+}
+
+/* Returns the value of the @param_code LOG SENSE page parameter and sets @len
+ * to its length, or returns %NULL if the page doesn't contain the parameter. */
+static const guint8 * get_log_param (const guint8 *page, guint16 param_code, guint *len) {
+    guint end = MIN (4 + get_be16 (page + 2), SCSI_PAGE_BUF_SIZE);
+    guint offset = 4;
+
+    while (offset + 4 <= end) {
+        guint param_len = page[offset + 3];
+
+        if (offset + 4 + param_len > end)
+            break;
+        if (get_be16 (page + offset) == param_code) {
+            *len = param_len;
+            return page + offset + 4;
+        }
+        offset += 4 + param_len;
+    }
+
+    return NULL;
+}
+
+static guint64 get_log_param_uint (const guint8 *page, guint16 param_code) {
+    const guint8 *p;
+    guint len = 0;
+    guint64 val = 0;
+    guint i;
+
+    p = get_log_param (page, param_code, &len);
+    for (i = 0; p && i < len && i < 8; i++)
+        val = (val << 8) | p[i];
+
+    return val;
+}
+
+/* kinds of data the native SCSI decoder reads */
+typedef enum {
+    SCSI_DATA_LOG_PAGE,
+    SCSI_DATA_MODE_PAGE,
+    SCSI_DATA_GROWN_DEFECTS,
+} ScsiDataType;
+
+/* Reads the @page log or mode page response (or the number of the grown
+ * defects as a big-endian 32-bit value) from @source into @buf. */
+typedef gboolean (*ScsiReadFunc) (gpointer source, ScsiDataType type, guint8 page, guint8 *buf, guint16 buf_len, GError **error);
+
+static gboolean scsi_read_device (gpointer source, ScsiDataType type, guint8 page, guint8 *buf, guint16 buf_len, GError **error) {
+    gint fd = GPOINTER_TO_INT (source);
+    guint count = 0;
+
+    switch (type) {
+        case SCSI_DATA_LOG_PAGE:
+            return sgio_scsi_log_sense (fd, page, buf, buf_len, error);
+        case SCSI_DATA_MODE_PAGE:
+            return sgio_scsi_mode_sense (fd, page, buf, buf_len, error);
+        case SCSI_DATA_GROWN_DEFECTS:
+            if (! sgio_scsi_read_grown_defects (fd, &count, error))
+                return FALSE;
+            buf[0] = count >> 24;
+            buf[1] = count >> 16;
+            buf[2] = count >> 8;
+            buf[3] = count;
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* SCSI dump section tags, the log and mode page ones are followed by the page
+ * code in hex, e.g. "LP2F" */
+#define SCSI_DUMP_TAG_SUPPORTED     "LP00"
+#define SCSI_DUMP_TAG_LOG_PAGE      "LP"
+#define SCSI_DUMP_TAG_MODE_PAGE     "MP"
+#define SCSI_DUMP_TAG_GROWN_DEFECTS "GDEF"
+
+typedef struct ScsiDump {
+    const guint8 *data;
+    gsize data_len;
+} ScsiDump;
+
+static gboolean is_scsi_dump (const guint8 *data, gsize data_len) {
+    return data_len >= 8 && memcmp (data, SCSI_DUMP_TAG_SUPPORTED, 4) == 0;
+}
+
+/* Looks up the section for the requested data in a blob using the skdump
+ * section layout: a sequence of 4-byte tags followed by a big-endian 32-bit
+ * size and the raw response data. */
+static gboolean scsi_read_dump (gpointer source, ScsiDataType type, guint8 page, guint8 *buf, guint16 buf_len, GError **error) {
+    const ScsiDump *dump = source;
+    gchar tag[5];
+    gsize offset = 0;
+
+    if (type == SCSI_DATA_GROWN_DEFECTS)
+        g_strlcpy (tag, SCSI_DUMP_TAG_GROWN_DEFECTS, sizeof (tag));
+    else
+        g_snprintf (tag, sizeof (tag), "%s%02X",
+                    type == SCSI_DATA_LOG_PAGE ? SCSI_DUMP_TAG_LOG_PAGE : SCSI_DUMP_TAG_MODE_PAGE, page);
+
+    while (offset + 8 <= dump->data_len) {
+        const guint8 *section = dump->data + offset;
+        guint32 size = get_be32 (section + 4);
+
+        offset += 8;
+        if (size > dump->data_len - offset) {
+            g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_INVALID_ARGUMENT,
+                         "Error parsing blob data: truncated '%.4s' section", (const gchar *) section);
+            return FALSE;
+        }
+        if (memcmp (section, tag, 4) == 0) {
+            memset (buf, 0, buf_len);
+            memcpy (buf, section + 8, MIN (size, buf_len));
+            return TRUE;
+        }
+        offset += size;
+    }
+
+    g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_INVALID_ARGUMENT,
+                 "Error parsing blob data: missing '%s' section", tag);
+    return FALSE;
+}
+
+static BDSmartSCSI * read_scsi_info_native (ScsiReadFunc read_fn, gpointer source, GError **error) {
+    static const guint8 required_pages[] = { SCSI_LOG_PAGE_WRITE_ERRORS, SCSI_LOG_PAGE_READ_ERRORS,
+                                             SCSI_LOG_PAGE_TEMPERATURE, SCSI_LOG_PAGE_IE };
+    guint8 supported[SCSI_PAGE_BUF_SIZE];
+    guint8 buf[SCSI_PAGE_BUF_SIZE];
+    guint n_supported;
+    BDSmartSCSI *data;
+    const guint8 *p;
+    guint len = 0;
+    guint i;
+
+    if (! read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_SUPPORTED, supported, sizeof (supported), error))
+        return NULL;
+    n_supported = MIN ((guint) get_be16 (supported + 2), (guint) sizeof (supported) - 4);
+
+    /* smartctl fails on devices missing any of these, leave those to it */
+    for (i = 0; i < G_N_ELEMENTS (required_pages); i++)
+        if (! memchr (supported + 4, required_pages[i], n_supported)) {
+            g_set_error (error, BD_SMART_ERROR, BD_SMART_ERROR_FAILED,
+                         "Device doesn't provide the 0x%02x log page", required_pages[i]);
+            return NULL;
+        }
+
+    data = g_new0 (BDSmartSCSI, 1);
+
+    /* Informational Exceptions Control mode page */
+    if (read_fn (source, SCSI_DATA_MODE_PAGE, SCSI_MODE_PAGE_IE_CONTROL, buf, sizeof (buf), NULL)) {
+        guint bd_len = get_be16 (buf + 6);
+
+        if (8 + bd_len + 3 <= sizeof (buf) && (buf[8 + bd_len] & 0x3f) == SCSI_MODE_PAGE_IE_CONTROL) {
+            data->smart_supported = TRUE;
+            /* DEXCPT and EWASC bits */
+            data->smart_enabled = ! (buf[8 + bd_len + 2] & 0x08);
+            data->temperature_warning_enabled = (buf[8 + bd_len + 2] & 0x10) != 0;
+        }
+    }
+
+    if (! read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_IE, buf, sizeof (buf), error)) {
+        bd_smart_scsi_free (data);
+        return NULL;
+    }
+    p = get_log_param (buf, 0x0000, &len);
+    if (p && len >= 2) {
+        data->scsi_ie_asc = p[0];
+        data->scsi_ie_ascq = p[1];
+        data->scsi_ie = get_scsi_ie (p[0], p[1]);
+        if (p[0] != 0)
+            data->scsi_ie_string = g_strdup_printf ("Informational Exception [asc=0x%02x, ascq=0x%02x]", p[0], p[1]);
+        /* most recent temperature reading */
+        if (len >= 3 && p[2] > 0 && p[2] != 0xff)
+            data->temperature = p[2] + 273;
+    }
+    data->overall_status_passed = data->scsi_ie_asc == 0;
+
+    if (! read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_TEMPERATURE, buf, sizeof (buf), error)) {
+        bd_smart_scsi_free (data);
+        return NULL;
+    }
+    p = get_log_param (buf, 0x0000, &len);
+    if (p && len >= 2 && p[1] > 0 && p[1] != 0xff)
+        data->temperature = p[1] + 273;
+    p = get_log_param (buf, 0x0001, &len);
+    if (p && len >= 2 && p[1] > 0 && p[1] != 0xff)
+        data->temperature_drive_trip = p[1] + 273;
+
+    if (! read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_READ_ERRORS, buf, sizeof (buf), error)) {
+        bd_smart_scsi_free (data);
+        return NULL;
+    }
+    data->read_errors_corrected_eccfast = get_log_param_uint (buf, 0x0000);
+    data->read_errors_corrected_eccdelayed = get_log_param_uint (buf, 0x0001);
+    data->read_errors_corrected_rereads = get_log_param_uint (buf, 0x0002);
+    data->read_errors_corrected_total = get_log_param_uint (buf, 0x0003);
+    data->read_processed_bytes = get_log_param_uint (buf, 0x0005);
+    data->read_errors_uncorrected = get_log_param_uint (buf, 0x0006);
+
+    if (! read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_WRITE_ERRORS, buf, sizeof (buf), error)) {
+        bd_smart_scsi_free (data);
+        return NULL;
+    }
+    data->write_errors_corrected_eccfast = get_log_param_uint (buf, 0x0000);
+    data->write_errors_corrected_eccdelayed = get_log_param_uint (buf, 0x0001);
+    data->write_errors_corrected_rewrites = get_log_param_uint (buf, 0x0002);
+    data->write_errors_corrected_total = get_log_param_uint (buf, 0x0003);
+    data->write_processed_bytes = get_log_param_uint (buf, 0x0005);
+    data->write_errors_uncorrected = get_log_param_uint (buf, 0x0006);
+
+    /* optional pages */
+    if (memchr (supported + 4, SCSI_LOG_PAGE_START_STOP, n_supported) &&
+        read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_START_STOP, buf, sizeof (buf), NULL)) {
+        data->start_stop_cycle_lifetime = get_log_param_uint (buf, 0x0003);
+        data->start_stop_cycle_count = get_log_param_uint (buf, 0x0004);
+        data->load_unload_cycle_lifetime = get_log_param_uint (buf, 0x0005);
+        data->load_unload_cycle_count = get_log_param_uint (buf, 0x0006);
+    }
+
+    if (memchr (supported + 4, SCSI_LOG_PAGE_BACKGROUND_SCAN, n_supported) &&
+        read_fn (source, SCSI_DATA_LOG_PAGE, SCSI_LOG_PAGE_BACKGROUND_SCAN, buf, sizeof (buf), NULL)) {
+        p = get_log_param (buf, 0x0000, &len);
+        if (p && len >= 12) {
+            data->power_on_time = get_be32 (p);
+            data->background_scan_status = get_background_scan_status (p[5]);
+            data->background_scan_runs = get_be16 (p + 6);
+            data->background_scan_progress = get_be16 (p + 8) * 100.0 / 65536;
+            data->background_medium_scan_runs = get_be16 (p + 10);
+        }
+    }
+
+    if (read_fn (source, SCSI_DATA_GROWN_DEFECTS, 0, buf, sizeof (buf), NULL))
+        data->scsi_grown_defect_list = get_be32 (buf);
+
+    return data;
+}
+
+static BDSmartSCSI * get_scsi_info_native (const gchar *device, GError **error) {
+    BDSmartSCSI *data;
+    gint fd;
+
+    fd = sgio_open (device, error);
+    if (fd < 0)
+        return NULL;
+
+    data = read_scsi_info_native (scsi_read_device, GINT_TO_POINTER (fd), error);
+    close (fd);
+
+    return data;
+}
+
+
 /**
  * bd_smart_ata_get_info:
  * @device: device to check.
@@ -1041,13 +1598,40 @@ BDSmartATA * bd_smart_ata_get_info (const gchar *device, const BDExtraArg **extr
     return data;
 }
 
+/**
+ * bd_smart_ata_get_info_native:
+ * @device: device to check.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from the drive by sending the ATA commands to it
+ * directly via the SG_IO interface instead of running smartctl. This requires
+ * permissions to send raw commands to the device. Attribute names are taken
+ * from the drive database but the value formats defined there are not applied
+ * so the pretty values may differ from the ones reported by bd_smart_ata_get_info().
+ *
+ * Returns: (transfer full): ATA SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_ATA-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartATA * bd_smart_ata_get_info_native (const gchar *device, GError **error) {
+    BDSmartATA *data;
+
+    data = get_ata_info_native (device, error);
+    if (! data)
+        g_prefix_error (error, "Error getting ATA SMART info: ");
+
+    return data;
+}
+
 /**
  * bd_smart_ata_get_info_from_data:
  * @data: (array length=data_len): binary data to parse.
  * @data_len: length of the data supplied.
  * @error: (out) (optional): place to store error (if any).
  *
- * Retrieve SMART information from the supplied data.
+ * Retrieve SMART information from the supplied data. Both the smartctl JSON
+ * output and the libatasmart blob (skdump) containing the raw ATA structures
+ * are accepted.
  *
  * Returns: (transfer full): ATA SMART log or %NULL in case of an error (with @error set).
  *
@@ -1062,6 +1646,13 @@ BDSmartATA * bd_smart_ata_get_info_from_data (const guint8 *data, gsize data_len
     g_warn_if_fail (data != NULL);
     g_warn_if_fail (data_len > 0);
 
+    if (data && is_skdump (data, data_len)) {
+        ata_data = parse_skdump (data, data_len, error);
+        if (! ata_data)
+            g_prefix_error (error, "Error getting ATA SMART info: ");
+        return ata_data;
+    }
+
     stdout = g_strndup ((gchar *)data, data_len);
     g_strstrip (stdout);
 
@@ -1129,6 +1720,85 @@ BDSmartSCSI * bd_smart_scsi_get_info (const gchar *device, const BDExtraArg **ex
 }
 
 
+/**
+ * bd_smart_scsi_get_info_native:
+ * @device: device to check.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from SCSI or SAS-compliant drive by reading the
+ * log pages directly via the SG_IO interface instead of running smartctl. This
+ * requires permissions to send raw commands to the device. The informational
+ * exception string only contains the ASC and ASCQ values, not their description.
+ *
+ * Returns: (transfer full): SCSI SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_SCSI-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartSCSI * bd_smart_scsi_get_info_native (const gchar *device, GError **error) {
+    BDSmartSCSI *data;
+
+    data = get_scsi_info_native (device, error);
+    if (! data)
+        g_prefix_error (error, "Error getting SCSI SMART info: ");
+
+    return data;
+}
+
+/**
+ * bd_smart_scsi_get_info_from_data:
+ * @data: (array length=data_len): binary data to parse.
+ * @data_len: length of the data supplied.
+ * @error: (out) (optional): place to store error (if any).
+ *
+ * Retrieve SMART information from the supplied data. Both the smartctl JSON
+ * output and a blob containing the raw SCSI log and mode pages are accepted.
+ * The blob is a sequence of sections made of a 4-byte tag, big-endian 32-bit
+ * size and the data as returned by the drive: "LPxx" for the LOG SENSE response
+ * of the xx (hex) page, starting with the list of supported pages ("LP00"),
+ * "MP1C" for the MODE SENSE(10) response of the Informational Exceptions
+ * Control page and "GDEF" for the number of grown defects (big-endian 32-bit).
+ *
+ * Returns: (transfer full): SCSI SMART log or %NULL in case of an error (with @error set).
+ *
+ * Tech category: %BD_SMART_TECH_SCSI-%BD_SMART_TECH_MODE_INFO
+ */
+BDSmartSCSI * bd_smart_scsi_get_info_from_data (const guint8 *data, gsize data_len, GError **error) {
+    JsonParser *parser;
+    gchar *stdout;
+    BDSmartSCSI *scsi_data = NULL;
+    gboolean ret;
+
+    g_warn_if_fail (data != NULL);
+    g_warn_if_fail (data_len > 0);
+
+    if (data && is_scsi_dump (data, data_len)) {
+        ScsiDump dump = { data, data_len };
+
+        scsi_data = read_scsi_info_native (scsi_read_dump, &dump, error);
+        if (! scsi_data)
+            g_prefix_error (error, "Error getting SCSI SMART info: ");
+        return scsi_data;
+    }
+
+    stdout = g_strndup ((gchar *)data, data_len);
+    g_strstrip (stdout);
+
+    parser = json_parser_new ();
+    ret = parse_smartctl_error (0, stdout, NULL, parser, error);
+    g_free (stdout);
+    if (! ret) {
+        g_prefix_error (error, "Error getting SCSI SMART info: ");
+        g_object_unref (parser);
+        return NULL;
+    }
+
+    scsi_data = parse_scsi_smart (parser, error);
+    g_object_unref (parser);
+
+    return scsi_data;
+}
+
+
 /**
  * bd_smart_set_enabled:
  * @device: SMART-capable device.
@@ -281,6 +281,16 @@ class CryptoLUKSExtra(BlockDev.CryptoLUKSExtra):
 CryptoLUKSExtra = override(CryptoLUKSExtra)
 __all__.append("CryptoLUKSExtra")
 
+class CryptoLUKSReencryptParams(BlockDev.CryptoLUKSReencryptParams):
+    def __new__(cls, mode=BlockDev.CryptoLUKSReencryptMode.REENCRYPT, cipher=None, key_size=0, sector_size=0, pbkdf=None, header=None, resilience=None, hash=None, max_hotzone_size=0, device_size=0, max_rate=0):  # pylint: disable=redefined-builtin
+        ret = BlockDev.CryptoLUKSReencryptParams.new(mode, cipher, key_size, sector_size, pbkdf, header, resilience, hash, max_hotzone_size, device_size, max_rate)
+        ret.__class__ = cls
+        return ret
+    def __init__(self, *args, **kwargs):   # pylint: disable=unused-argument
+        super(CryptoLUKSReencryptParams, self).__init__()  #pylint: disable=bad-super-call
+CryptoLUKSReencryptParams = override(CryptoLUKSReencryptParams)
+__all__.append("CryptoLUKSReencryptParams")
+
 class CryptoKeyslotContext(BlockDev.CryptoKeyslotContext):
     def __new__(cls, passphrase=None, keyfile=None, keyfile_offset=0, key_size=0, keyring=None, volume_key=None):
         if sum(bool(x) for x in (passphrase, keyfile, keyring, volume_key)) != 1:
@@ -301,6 +311,12 @@ class CryptoKeyslotContext(BlockDev.CryptoKeyslotContext):
 CryptoKeyslotContext = override(CryptoKeyslotContext)
 __all__.append("CryptoKeyslotContext")
 
+_crypto_luks_pbkdf_calibrate = BlockDev.crypto_luks_pbkdf_calibrate
+@override(BlockDev.crypto_luks_pbkdf_calibrate)
+def crypto_luks_pbkdf_calibrate(pbkdf=None, key_size=0):
+    return _crypto_luks_pbkdf_calibrate(pbkdf, key_size)
+__all__.append("crypto_luks_pbkdf_calibrate")
+
 # calling `crypto_luks_format_luks2` with `luks_version` set to
 # `BlockDev.CryptoLUKSVersion.LUKS1` and `extra` to `None` is the same
 # as using the "original" function `crypto_luks_format`
@@ -316,6 +332,52 @@ def crypto_luks_open(device, name, context, read_only=False):
     return _crypto_luks_open(device, name, context, read_only)
 __all__.append("crypto_luks_open")
 
+_crypto_luks_open_with_flags = BlockDev.crypto_luks_open_with_flags
+@override(BlockDev.crypto_luks_open_with_flags)
+def crypto_luks_open_with_flags(device, name, context, flags, read_only=False):
+    return _crypto_luks_open_with_flags(device, name, context, flags, read_only)
+__all__.append("crypto_luks_open_with_flags")
+
+_crypto_luks_open_stash_key = BlockDev.crypto_luks_open_stash_key
+@override(BlockDev.crypto_luks_open_stash_key)
+def crypto_luks_open_stash_key(device, name, context, read_only=False):
+    return _crypto_luks_open_stash_key(device, name, context, read_only)
+__all__.append("crypto_luks_open_stash_key")
+
+_crypto_luks_resume = BlockDev.crypto_luks_resume
+@override(BlockDev.crypto_luks_resume)
+def crypto_luks_resume(luks_device, context=None):
+    return _crypto_luks_resume(luks_device, context)
+__all__.append("crypto_luks_resume")
+
+_crypto_tune_flags = BlockDev.crypto_tune_flags
+@override(BlockDev.crypto_tune_flags)
+def crypto_tune_flags(cipher=None, key_size=0, size=0):
+    return _crypto_tune_flags(cipher, key_size, size)
+__all__.append("crypto_tune_flags")
+
+_crypto_luks_reencrypt = BlockDev.crypto_luks_reencrypt
+@override(BlockDev.crypto_luks_reencrypt)
+def crypto_luks_reencrypt(device, context, params=None, name=None):
+    return _crypto_luks_reencrypt(device, name, context, params)
+__all__.append("crypto_luks_reencrypt")
+
+_crypto_luks_reencrypt_resume = BlockDev.crypto_luks_reencrypt_resume
+@override(BlockDev.crypto_luks_reencrypt_resume)
+def crypto_luks_reencrypt_resume(device, context, params=None, name=None):
+    return _crypto_luks_reencrypt_resume(device, name, context, params)
+__all__.append("crypto_luks_reencrypt_resume")
+
+# `requests` is a list of (device, name, context) tuples
+_crypto_luks_open_many = BlockDev.crypto_luks_open_many
+@override(BlockDev.crypto_luks_open_many)
+def crypto_luks_open_many(requests, read_only=False, max_jobs=0):
+    devices = [r[0] for r in requests]
+    names = [r[1] for r in requests]
+    contexts = [r[2] for r in requests]
+    return _crypto_luks_open_many(devices, names, contexts, read_only, max_jobs)
+__all__.append("crypto_luks_open_many")
+
 _crypto_luks_resize = BlockDev.crypto_luks_resize
 @override(BlockDev.crypto_luks_resize)
 def crypto_luks_resize(luks_device, size=0, context=None):
@@ -379,6 +441,12 @@ def crypto_integrity_format(device, algorithm, wipe=True, context=None, extra=No
     return _crypto_integrity_format(device, algorithm, wipe, context, extra)
 __all__.append("crypto_integrity_format")
 
+_crypto_integrity_format_parallel = BlockDev.crypto_integrity_format_parallel
+@override(BlockDev.crypto_integrity_format_parallel)
+def crypto_integrity_format_parallel(device, algorithm, max_jobs=0, context=None, extra=None):
+    return _crypto_integrity_format_parallel(device, algorithm, max_jobs, context, extra)
+__all__.append("crypto_integrity_format_parallel")
+
 _crypto_integrity_open = BlockDev.crypto_integrity_open
 @override(BlockDev.crypto_integrity_open)
 def crypto_integrity_open(device, name, algorithm, context=None, flags=0, extra=None):
@@ -393,6 +461,13 @@ def crypto_opal_format(device, cipher=None, key_size=0, context=None, min_entrop
 __all__.append("crypto_opal_format")
 
 
+_crypto_luks_header_info_many = BlockDev.crypto_luks_header_info_many
+@override(BlockDev.crypto_luks_header_info_many)
+def crypto_luks_header_info_many(devices, max_jobs=0):
+    return _crypto_luks_header_info_many(devices, max_jobs)
+__all__.append("crypto_luks_header_info_many")
+
+
 _dm_create_linear = BlockDev.dm_create_linear
 @override(BlockDev.dm_create_linear)
 def dm_create_linear(map_name, device, length, uuid=None):
@@ -431,6 +506,12 @@ def fs_clean(spec, force=False):
     return _fs_clean(spec, force)
 __all__.append("fs_clean")
 
+_fs_zero_device = BlockDev.fs_zero_device
+@override(BlockDev.fs_zero_device)
+def fs_zero_device(device, method=BlockDev.FSZeroMethod.AUTO, threads=0, force=False):
+    return _fs_zero_device(device, method, threads, force)
+__all__.append("fs_zero_device")
+
 _fs_unmount = BlockDev.fs_unmount
 @override(BlockDev.fs_unmount)
 def fs_unmount(spec, lazy=False, force=False, extra=None, **kwargs):
@@ -1030,6 +1111,12 @@ def md_get_superblock_size(size, version=None):
     return _md_get_superblock_size(size, version)
 __all__.append("md_get_superblock_size")
 
+_md_plan_capacity = BlockDev.md_plan_capacity
+@override(BlockDev.md_plan_capacity)
+def md_plan_capacity(level, member_sizes, version=None, chunk_size=0, bitmap=False):
+    return _md_plan_capacity(level, member_sizes, version, chunk_size, bitmap)
+__all__.append("md_plan_capacity")
+
 _md_create = BlockDev.md_create
 @override(BlockDev.md_create)
 def md_create(device_name, level, disks, spares=0, version=None, bitmap=None, chunk_size=0, extra=None, **kwargs):
@@ -1058,6 +1145,12 @@ def md_activate(raid_spec=None, members=None, uuid=None, start_degraded=True, ex
     return _md_activate(raid_spec, members, uuid, start_degraded, extra)
 __all__.append("md_activate")
 
+_md_activate_many = BlockDev.md_activate_many
+@override(BlockDev.md_activate_many)
+def md_activate_many(devices, start_degraded=True, max_jobs=0):
+    return _md_activate_many(devices, start_degraded, max_jobs)
+__all__.append("md_activate_many")
+
 
 # XXX enums with just one member are broken with GI
 class MDTech():
@@ -1100,6 +1193,22 @@ def part_create_table(disk, type, ignore_existing=True):
     return _part_create_table(disk, type, ignore_existing)
 __all__.append("part_create_table")
 
+class PartLayoutRequest(BlockDev.PartLayoutRequest):
+    def __new__(cls, size=0, percent=0, flags=0, name=None, type=None):  # pylint: disable=redefined-builtin
+        ret = BlockDev.PartLayoutRequest.new(size, percent, flags, name, type)
+        ret.__class__ = cls
+        return ret
+    def __init__(self, *args, **kwargs):  # pylint: disable=unused-argument
+        super(PartLayoutRequest, self).__init__()  #pylint: disable=bad-super-call
+PartLayoutRequest = override(PartLayoutRequest)
+__all__.append("PartLayoutRequest")
+
+_part_apply_layout = BlockDev.part_apply_layout
+@override(BlockDev.part_apply_layout)
+def part_apply_layout(disk, table_type, layout, ignore_existing=True):
+    return _part_apply_layout(disk, table_type, layout, ignore_existing)
+__all__.append("part_apply_layout")
+
 
 _nvdimm_namespace_reconfigure = BlockDev.nvdimm_namespace_reconfigure
 @override(BlockDev.nvdimm_namespace_reconfigure)
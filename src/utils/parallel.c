@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2026  Red Hat, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "parallel.h"
+
+typedef struct ParallelJob {
+    BDUtilsTaskFunc func;
+    gpointer user_data;
+    guint n_tasks;
+    gint next;
+    gint stop;
+} ParallelJob;
+
+static gpointer parallel_worker (gpointer data) {
+    ParallelJob *job = (ParallelJob *) data;
+    guint i = 0;
+
+    while (!g_atomic_int_get (&(job->stop)) &&
+           (i = (guint) g_atomic_int_add (&(job->next), 1)) < job->n_tasks)
+        if (!job->func (i, job->user_data))
+            g_atomic_int_set (&(job->stop), 1);
+
+    return NULL;
+}
+
+/**
+ * bd_utils_run_parallel: (skip)
+ * @thread_name: name for the worker threads (for debugging)
+ * @n_tasks: number of tasks to run
+ * @max_threads: maximum number of worker threads (0 to use one per CPU)
+ * @func: function to run for every task
+ * @user_data: data to pass to @func
+ *
+ * Runs @func for every task index from 0 to @n_tasks - 1 in up to @max_threads
+ * worker threads, every task is run exactly once (unless @func asks to stop).
+ * The tasks are run in this thread if no worker thread can be started. Returns
+ * once all the tasks are done.
+ */
+void bd_utils_run_parallel (const gchar *thread_name, guint n_tasks, guint max_threads, BDUtilsTaskFunc func, gpointer user_data) {
+    ParallelJob job = { func, user_data, n_tasks, 0, 0 };
+    GThread **workers = NULL;
+    guint n_workers = 0;
+    guint started = 0;
+    guint i = 0;
+
+    if (max_threads == 0)
+        max_threads = g_get_num_processors ();
+    n_workers = MIN (n_tasks, max_threads);
+    if (n_workers == 0)
+        return;
+
+    workers = g_new0 (GThread *, n_workers);
+    for (i = 0; i < n_workers; i++) {
+        workers[i] = g_thread_try_new (thread_name, parallel_worker, &job, NULL);
+        if (workers[i])
+            started++;
+    }
+    if (started == 0)
+        parallel_worker (&job);
+
+    for (i = 0; i < n_workers; i++)
+        if (workers[i])
+            g_thread_join (workers[i]);
+    g_free (workers);
+}
@@ -0,0 +1,19 @@
+#include <glib.h>
+
+#ifndef BD_UTILS_PARALLEL
+#define BD_UTILS_PARALLEL
+
+/**
+ * BDUtilsTaskFunc:
+ * @task: index of the task to run
+ * @user_data: data passed to bd_utils_run_parallel()
+ *
+ * Function type for the tasks run by bd_utils_run_parallel().
+ *
+ * Returns: whether to continue with the remaining tasks or not
+ */
+typedef gboolean (*BDUtilsTaskFunc) (guint task, gpointer user_data);
+
+void bd_utils_run_parallel (const gchar *thread_name, guint n_tasks, guint max_threads, BDUtilsTaskFunc func, gpointer user_data);
+
+#endif  /* BD_UTILS_PARALLEL */
@@ -8,6 +8,7 @@
 #include "module.h"
 #include "dbus.h"
 #include "logging.h"
+#include "parallel.h"
 
 /**
  * SECTION: utils
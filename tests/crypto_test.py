@@ -8,6 +8,8 @@ import subprocess
 import locale
 import re
 import tarfile
+import threading
+import time
 
 from utils import create_sparse_tempfile, create_lio_device, delete_lio_device, get_avail_locales, requires_locales, run_command, read_file, TestTags, tag_test, required_plugins
 
@@ -77,6 +79,9 @@ class CryptoTestCase(unittest.TestCase):
         except:
             pass
 
+        # volume key stashed by a test that failed before closing the device
+        run_command("keyctl purge -s user libblockdev:luks-vk:%s" % self._dm_name)
+
         try:
             delete_lio_device(self.loop_dev)
         except RuntimeError:
@@ -491,6 +496,33 @@ class CryptoTestOpenClose(CryptoTestCase):
         succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
         self.assertTrue(succ)
 
+    @tag_test(TestTags.SLOW)
+    def test_luks2_open_close_keyfile_read_once(self):
+        """Verify that a keyslot context reads its key file only once"""
+        self._luks2_format(self.loop_dev, PASSWD, self.keyfile)
+
+        ctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+        succ = BlockDev.crypto_luks_open(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
+        # the key file is read only when the context is used for the first time
+        with open(self.keyfile, "wb") as f:
+            f.write(b"somethingelse")
+
+        succ = BlockDev.crypto_luks_open(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
+        # but a new context uses the new content
+        with self.assertRaises(GLib.GError):
+            ctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+            BlockDev.crypto_luks_open(self.loop_dev, "libblockdevTestLUKS", ctx)
+
 
 class CryptoTestAddKey(CryptoTestCase):
     def _add_key(self, create_fn):
@@ -880,6 +912,107 @@ class CryptoTestSuspendResume(CryptoTestCase):
         """Verify that suspending/resuming LUKS 2 device works"""
         self._luks_suspend_resume(self._luks2_format)
 
+    def _luks_suspend_resume_stashed(self, create_fn):
+        create_fn(self.loop_dev, PASSWD, self.keyfile)
+
+        # nothing stashed with a normal open
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        succ = BlockDev.crypto_luks_open(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        succ = BlockDev.crypto_luks_suspend("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
+        with self.assertRaisesRegex(GLib.GError, r"No volume key stashed"):
+            BlockDev.crypto_luks_resume("libblockdevTestLUKS")
+
+        succ = BlockDev.crypto_luks_resume("libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
+        with self.assertRaises(GLib.GError):
+            ctx = BlockDev.CryptoKeyslotContext(passphrase="wrong-passphrase")
+            BlockDev.crypto_luks_open_stash_key(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertFalse(os.path.exists("/dev/mapper/libblockdevTestLUKS"))
+
+        ctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+        succ = BlockDev.crypto_luks_open_stash_key(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        ret, out, _err = run_command("keyctl search @s user libblockdev:luks-vk:libblockdevTestLUKS")
+        self.assertEqual(ret, 0)
+
+        # only the possessor can access the key and it expires
+        key_id = int(out)
+        ret, out, _err = run_command("keyctl rdescribe %d" % key_id)
+        self.assertEqual(ret, 0)
+        perm = int(out.split(";")[3], 16)
+        self.assertEqual(perm & 0x00ffffff, 0)
+        with open("/proc/keys") as keys:
+            key_line = next(line for line in keys if int(line.split()[0], 16) == key_id)
+        self.assertNotEqual(key_line.split()[3], "perm")
+
+        for _i in range(3):
+            succ = BlockDev.crypto_luks_suspend("/dev/mapper/libblockdevTestLUKS")
+            self.assertTrue(succ)
+
+            _ret, state, _err = run_command("lsblk -oSTATE -n /dev/mapper/libblockdevTestLUKS")
+            self.assertEqual(state, "suspended")
+
+            succ = BlockDev.crypto_luks_resume("/dev/mapper/libblockdevTestLUKS")
+            self.assertTrue(succ)
+
+            _ret, state, _err = run_command("lsblk -oSTATE -n /dev/mapper/libblockdevTestLUKS")
+            self.assertEqual(state, "running")
+
+        # the stashed key is removed on close
+        succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
+        ret, _out, _err = run_command("keyctl search @s user libblockdev:luks-vk:libblockdevTestLUKS")
+        self.assertNotEqual(ret, 0)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_suspend_resume_stashed(self):
+        """Verify that resuming LUKS device with stashed volume key works"""
+        self._luks_suspend_resume_stashed(self._luks_format)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks2_suspend_resume_stashed(self):
+        """Verify that resuming LUKS 2 device with stashed volume key works"""
+        self._luks_suspend_resume_stashed(self._luks2_format)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks2_resume_stashed_time(self):
+        """Verify that resuming with stashed volume key skips the key derivation"""
+        self._luks2_format(self.loop_dev, PASSWD)
+
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        succ = BlockDev.crypto_luks_open_stash_key(self.loop_dev, "libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+
+        succ = BlockDev.crypto_luks_suspend("libblockdevTestLUKS")
+        self.assertTrue(succ)
+        start = time.monotonic()
+        succ = BlockDev.crypto_luks_resume("libblockdevTestLUKS", ctx)
+        self.assertTrue(succ)
+        with_passphrase = time.monotonic() - start
+
+        succ = BlockDev.crypto_luks_suspend("libblockdevTestLUKS")
+        self.assertTrue(succ)
+        start = time.monotonic()
+        succ = BlockDev.crypto_luks_resume("libblockdevTestLUKS")
+        self.assertTrue(succ)
+        stashed = time.monotonic() - start
+
+        self.assertLess(stashed, with_passphrase,
+                        msg="Resume with stashed key took %.3f s, with passphrase %.3f s" % (stashed, with_passphrase))
+
+        succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
+        self.assertTrue(succ)
+
 class CryptoTestKillSlot(CryptoTestCase):
     def _luks_kill_slot(self, create_fn):
 
@@ -1188,6 +1321,258 @@ class CryptoTestSetPersistentFlags(CryptoTestCase):
         self.assertEqual(m.group(1), "allow-discards")
 
 
+class CryptoTestOpenWithFlags(CryptoTestCase):
+
+    def _get_dm_table(self, name):
+        ret, out, err = run_command("dmsetup table %s" % name)
+        self.assertEqual(ret, 0, msg="Failed to get dm table for %s: %s" % (name, err))
+        return out
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_open_with_flags(self):
+        """Verify that we can open a LUKS device with activation flags"""
+
+        self._luks_format(self.loop_dev, PASSWD)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+
+        # works for LUKS 1 too, the flags are not stored in the header
+        succ = BlockDev.crypto_luks_open_with_flags(self.loop_dev, self._dm_name, ctx,
+                                                    BlockDev.CryptoLUKSPersistentFlags.ALLOW_DISCARDS |
+                                                    BlockDev.CryptoLUKSPersistentFlags.SAME_CPU_CRYPT)
+        self.assertTrue(succ)
+        table = self._get_dm_table(self._dm_name)
+        self.assertIn("allow_discards", table)
+        self.assertIn("same_cpu_crypt", table)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        succ = BlockDev.crypto_luks_open_with_flags(self.loop_dev, self._dm_name, ctx, 0, read_only=True)
+        self.assertTrue(succ)
+        table = self._get_dm_table(self._dm_name)
+        self.assertNotIn("allow_discards", table)
+        self.assertNotIn("same_cpu_crypt", table)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        with self.assertRaisesRegex(GLib.GError, r"Incorrect passphrase"):
+            BlockDev.crypto_luks_open_with_flags(self.loop_dev, self._dm_name,
+                                                 BlockDev.CryptoKeyslotContext(passphrase=PASSWD2),
+                                                 BlockDev.CryptoLUKSPersistentFlags.SAME_CPU_CRYPT)
+
+    @tag_test(TestTags.SLOW)
+    def test_tune_flags(self):
+        """Verify that the dm-crypt flags benchmark works"""
+
+        # the benchmark uses a plain dm-crypt device
+        self.assertTrue(BlockDev.crypto_is_tech_avail(BlockDev.CryptoTech.PLAIN, BlockDev.CryptoTechMode.OPEN_CLOSE))
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_is_tech_avail(BlockDev.CryptoTech.PLAIN, BlockDev.CryptoTechMode.CREATE)
+
+        results = BlockDev.crypto_tune_flags(size=4 * 1024**2)
+        self.assertGreater(len(results), 0)
+
+        # sorted from the best to the worst
+        times = [r.total_time for r in results]
+        self.assertEqual(times, sorted(times))
+
+        for r in results:
+            self.assertIn(r.sector_size, (512, 4096))
+            self.assertGreater(r.seq_read, 0)
+            self.assertGreater(r.seq_write, 0)
+            self.assertGreater(r.rand_read_latency, 0)
+            self.assertGreater(r.rand_write_latency, 0)
+
+        # each combination is there at most once
+        combinations = set((int(r.flags), r.sector_size) for r in results)
+        self.assertEqual(len(combinations), len(results))
+
+        # the temporary device is gone
+        self.assertFalse([d for d in os.listdir("/dev/mapper") if d.startswith("bd-crypto-tune-")])
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_tune_flags(cipher="aes")
+
+
+class CryptoTestReencrypt(CryptoTestCase):
+
+    # LUKS 2 header takes 16 MiB, keep the data area small to make the tests fast
+    _sparse_size = 64 * 1024**2
+
+    def setUp(self):
+        super(CryptoTestReencrypt, self).setUp()
+
+        self.header_dir = tempfile.mkdtemp(prefix="libblockdev_test_reencrypt")
+        self.addCleanup(shutil.rmtree, self.header_dir)
+
+    def _write_data(self, device, size=1024**2):
+        data = os.urandom(size)
+        with open(device, "wb") as f:
+            f.write(data)
+        return data
+
+    def _read_data(self, device, size=1024**2):
+        with open(device, "rb") as f:
+            return f.read(size)
+
+    def _check_data(self, ctx, data):
+        BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+        self.assertEqual(self._read_data("/dev/mapper/%s" % self._dm_name, len(data)), data)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_reencrypt(self):
+        """Verify that we can re-encrypt a LUKS 2 device"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+
+        BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+        data = self._write_data("/dev/mapper/%s" % self._dm_name)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        # offline with a new cipher
+        params = BlockDev.CryptoLUKSReencryptParams(cipher="aes-cbc-essiv:sha256", key_size=256)
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, params)
+        self.assertTrue(succ)
+        self.assertEqual(BlockDev.crypto_luks_reencrypt_status(self.loop_dev),
+                         BlockDev.CryptoLUKSReencryptStatus.NONE)
+
+        info = BlockDev.crypto_luks_info(self.loop_dev)
+        self.assertEqual(info.cipher, "aes")
+        self.assertEqual(info.mode, "cbc-essiv:sha256")
+        self._check_data(ctx, data)
+
+        # online with a new volume key only
+        BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, name=self._dm_name)
+        self.assertTrue(succ)
+        self.assertEqual(self._read_data("/dev/mapper/%s" % self._dm_name), data)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        info = BlockDev.crypto_luks_info(self.loop_dev)
+        self.assertEqual(info.cipher, "aes")
+        self.assertEqual(info.mode, "cbc-essiv:sha256")
+        self._check_data(ctx, data)
+
+        # wrong passphrase
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_luks_reencrypt(self.loop_dev, BlockDev.CryptoKeyslotContext(passphrase=PASSWD2))
+        self._check_data(ctx, data)
+
+        # nothing to cancel or resume
+        with self.assertRaisesRegex(GLib.GError, r"No re-encryption"):
+            BlockDev.crypto_luks_reencrypt_cancel(self.loop_dev)
+        with self.assertRaisesRegex(GLib.GError, r"No re-encryption"):
+            BlockDev.crypto_luks_reencrypt_resume(self.loop_dev, ctx)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_encrypt_decrypt(self):
+        """Verify that we can encrypt and decrypt a device with a detached LUKS 2 header"""
+
+        header = os.path.join(self.header_dir, "header")
+        data = self._write_data(self.loop_dev)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+
+        with self.assertRaisesRegex(GLib.GError, r"detached LUKS header"):
+            BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx,
+                                           BlockDev.CryptoLUKSReencryptParams(mode=BlockDev.CryptoLUKSReencryptMode.ENCRYPT))
+
+        # the header file is removed if the encryption fails to start so it can be retried
+        params = BlockDev.CryptoLUKSReencryptParams(mode=BlockDev.CryptoLUKSReencryptMode.ENCRYPT, header=header, cipher="aes")
+        with self.assertRaisesRegex(GLib.GError, r"Invalid cipher specification"):
+            BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, params)
+        self.assertFalse(os.path.exists(header))
+
+        params = BlockDev.CryptoLUKSReencryptParams(mode=BlockDev.CryptoLUKSReencryptMode.ENCRYPT, header=header)
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, params)
+        self.assertTrue(succ)
+        self.assertTrue(os.path.exists(header))
+        self.assertEqual(BlockDev.crypto_luks_info(header).version, BlockDev.CryptoLUKSVersion.LUKS2)
+        self.assertEqual(BlockDev.crypto_luks_reencrypt_status(header),
+                         BlockDev.CryptoLUKSReencryptStatus.NONE)
+
+        # the data is encrypted in place
+        self.assertNotEqual(self._read_data(self.loop_dev, len(data)), data)
+
+        ret, _out, err = run_command("echo -n %s | cryptsetup open --header %s %s %s -" % (PASSWD, header, self.loop_dev, self._dm_name))
+        self.assertEqual(ret, 0, msg="Failed to open the encrypted device: %s" % err)
+        self.assertEqual(self._read_data("/dev/mapper/%s" % self._dm_name, len(data)), data)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        params = BlockDev.CryptoLUKSReencryptParams(mode=BlockDev.CryptoLUKSReencryptMode.DECRYPT, header=header)
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, params)
+        self.assertTrue(succ)
+        self.assertEqual(self._read_data(self.loop_dev, len(data)), data)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_reencrypt_cancel_resume(self):
+        """Verify that LUKS 2 re-encryption can be cancelled and resumed"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+
+        BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+        data = self._write_data("/dev/mapper/%s" % self._dm_name)
+        BlockDev.crypto_luks_close(self._dm_name)
+
+        # slow enough to be cancelled before it finishes
+        params = BlockDev.CryptoLUKSReencryptParams(max_rate=4 * 1024**2)
+        errors = []
+        def reencrypt():
+            try:
+                BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, params)
+            except GLib.GError as e:
+                errors.append(e)
+
+        thread = threading.Thread(target=reencrypt)
+        thread.start()
+        time.sleep(2)
+
+        # only one re-encryption of the device at a time
+        with self.assertRaisesRegex(GLib.GError, r"already running"):
+            BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx)
+
+        succ = BlockDev.crypto_luks_reencrypt_cancel(self.loop_dev)
+        self.assertTrue(succ)
+        thread.join()
+
+        self.assertEqual(len(errors), 1)
+        self.assertIn("was cancelled", errors[0].message)
+        self.assertEqual(BlockDev.crypto_luks_reencrypt_status(self.loop_dev),
+                         BlockDev.CryptoLUKSReencryptStatus.CLEAN)
+
+        # cannot start a new one before the interrupted one finishes
+        with self.assertRaisesRegex(GLib.GError, r"needs to be resumed"):
+            BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx)
+
+        succ = BlockDev.crypto_luks_reencrypt_resume(self.loop_dev, ctx)
+        self.assertTrue(succ)
+        self.assertEqual(BlockDev.crypto_luks_reencrypt_status(self.loop_dev),
+                         BlockDev.CryptoLUKSReencryptStatus.NONE)
+        self._check_data(ctx, data)
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_reencrypt_throughput(self):
+        """Verify that the LUKS 2 re-encryption rate limit is honored"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        data_size = self._sparse_size - BlockDev.crypto_luks_info(self.loop_dev).metadata_size
+
+        start = time.monotonic()
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx)
+        self.assertTrue(succ)
+        unlimited = time.monotonic() - start
+
+        max_rate = 8 * 1024**2
+        start = time.monotonic()
+        succ = BlockDev.crypto_luks_reencrypt(self.loop_dev, ctx, BlockDev.CryptoLUKSReencryptParams(max_rate=max_rate))
+        self.assertTrue(succ)
+        limited = time.monotonic() - start
+
+        # the limit is checked after each hotzone (at most 2 MiB here), so the last one isn't waited for
+        self.assertGreaterEqual(limited, (data_size - 2 * 1024**2) / max_rate)
+        self.assertGreater(limited, unlimited)
+
+
 class CryptoTestConvert(CryptoTestCase):
 
     @tag_test(TestTags.SLOW, TestTags.CORE)
@@ -1388,6 +1773,365 @@ class CryptoTestLUKSToken(CryptoTestCase):
         succ = BlockDev.crypto_luks_close("libblockdevTestLUKS")
         self.assertTrue(succ)
 
+class CryptoTestLUKSHeaderInfo(CryptoTestCase):
+
+    label = "aaaaaa"
+    subsystem = "bbbbbb"
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_header_info(self):
+        """Verify that we can get all information from a LUKS header at once"""
+
+        self._luks_format(self.loop_dev, PASSWD, self.keyfile)
+
+        hinfo = BlockDev.crypto_luks_header_info(self.loop_dev)
+        self.assertEqual(hinfo.device, self.loop_dev)
+        self.assertEqual(hinfo.info.version, BlockDev.CryptoLUKSVersion.LUKS1)
+        _ret, uuid, _err = run_command("blkid -p -ovalue -sUUID %s" % self.loop_dev)
+        self.assertEqual(hinfo.info.uuid, uuid)
+        self.assertEqual(hinfo.info.label, "")
+        self.assertEqual([k.id for k in hinfo.keyslots], [0, 1])
+        self.assertFalse(any(k.last for k in hinfo.keyslots))
+        self.assertEqual(hinfo.keyslots[0].pbkdf, "pbkdf2")
+        self.assertListEqual(hinfo.tokens, [])
+
+    @tag_test(TestTags.SLOW)
+    def test_luks2_header_info(self):
+        """Verify that we can get all information from a LUKS 2 header at once"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+
+        succ = BlockDev.crypto_luks_set_label(self.loop_dev, self.label, self.subsystem)
+        self.assertTrue(succ)
+
+        ret, _out, err = run_command("cryptsetup token add --key-description aaaa %s" % self.loop_dev)
+        self.assertEqual(ret, 0, msg="Failed to add token to %s: %s" % (self.loop_dev, err))
+
+        hinfo = BlockDev.crypto_luks_header_info(self.loop_dev)
+        self.assertEqual(hinfo.info.version, BlockDev.CryptoLUKSVersion.LUKS2)
+        self.assertEqual(hinfo.info.label, self.label)
+        self.assertEqual(hinfo.info.subsystem, self.subsystem)
+        self.assertEqual(len(hinfo.keyslots), 1)
+        self.assertEqual(hinfo.keyslots[0].id, 0)
+        self.assertTrue(hinfo.keyslots[0].last)
+        self.assertIn(hinfo.keyslots[0].pbkdf, ("argon2i", "argon2id", "pbkdf2"))
+        self.assertEqual(len(hinfo.tokens), 1)
+        self.assertEqual(hinfo.tokens[0].type, "luks2-keyring")
+
+        # label and subsystem must match what blkid reads from the header
+        info = BlockDev.crypto_luks_info(self.loop_dev)
+        self.assertEqual(info.label, self.label)
+        self.assertEqual(info.subsystem, self.subsystem)
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_luks_header_info("/non/existing/device")
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_header_info_many(self):
+        """Verify that we can inspect multiple LUKS headers in parallel"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+
+        # non-LUKS devices are skipped
+        infos = BlockDev.crypto_luks_header_info_many([self.loop_dev, self.loop_dev2])
+        self.assertEqual(len(infos), 1)
+        self.assertEqual(infos[0].device, self.loop_dev)
+
+        self._luks_format(self.loop_dev2, PASSWD)
+
+        for jobs in (0, 1, 2):
+            infos = BlockDev.crypto_luks_header_info_many([self.loop_dev2, self.loop_dev], max_jobs=jobs)
+            self.assertEqual([i.device for i in infos], [self.loop_dev2, self.loop_dev])
+            self.assertEqual([i.info.version for i in infos],
+                             [BlockDev.CryptoLUKSVersion.LUKS1, BlockDev.CryptoLUKSVersion.LUKS2])
+
+class CryptoTestOpenMany(CryptoTestCase):
+
+    _dm_name2 = "libblockdevTestLUKS2"
+
+    def _clean_up(self):
+        try:
+            BlockDev.crypto_luks_close(self._dm_name2)
+        except:
+            pass
+
+        super(CryptoTestOpenMany, self)._clean_up()
+
+    @tag_test(TestTags.SLOW)
+    def test_luks_open_many(self):
+        """Verify that we can open multiple LUKS devices in parallel"""
+
+        self._luks2_format(self.loop_dev, PASSWD)
+        self._luks_format(self.loop_dev2, PASSWD2, self.keyfile)
+
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        fctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+        wctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD3)
+
+        # the names need to be valid
+        with self.assertRaisesRegex(GLib.GError, r"cannot contain '/'"):
+            BlockDev.crypto_luks_open_many([(self.loop_dev, "a/b", ctx)])
+
+        results = BlockDev.crypto_luks_open_many([(self.loop_dev, self._dm_name, ctx),
+                                                  (self.loop_dev2, self._dm_name2, fctx)])
+        self.assertEqual(len(results), 2)
+        self.assertEqual([r.device for r in results], [self.loop_dev, self.loop_dev2])
+        self.assertEqual([r.name for r in results], [self._dm_name, self._dm_name2])
+        for r in results:
+            self.assertTrue(r.success, msg=r.error_msg)
+            self.assertIsNone(r.error_msg)
+            self.assertGreater(r.duration, 0)
+        # LUKS 2 keyslot uses Argon2, LUKS 1 PBKDF2
+        self.assertGreater(results[0].kdf_memory, 0)
+        self.assertEqual(results[1].kdf_memory, 0)
+
+        self.assertTrue(os.path.exists("/dev/mapper/%s" % self._dm_name))
+        self.assertTrue(os.path.exists("/dev/mapper/%s" % self._dm_name2))
+
+        BlockDev.crypto_luks_close(self._dm_name)
+        BlockDev.crypto_luks_close(self._dm_name2)
+
+        # one failure doesn't affect the other devices
+        results = BlockDev.crypto_luks_open_many([(self.loop_dev, self._dm_name, wctx),
+                                                  (self.loop_dev2, self._dm_name2, fctx)],
+                                                 read_only=True, max_jobs=1)
+        self.assertEqual(len(results), 2)
+        self.assertFalse(results[0].success)
+        self.assertIn("Incorrect passphrase", results[0].error_msg)
+        self.assertTrue(results[1].success)
+        self.assertFalse(os.path.exists("/dev/mapper/%s" % self._dm_name))
+        self.assertEqual(BlockDev.crypto_luks_info(self._dm_name2).backing_device, self.loop_dev2)
+
+        BlockDev.crypto_luks_close(self._dm_name2)
+
+        results = BlockDev.crypto_luks_open_many([])
+        self.assertEqual(results, [])
+
+class CryptoTestKeyslotHint(CryptoTestCase):
+
+    def setUp(self):
+        super(CryptoTestKeyslotHint, self).setUp()
+
+        # keyslots tried first are logged
+        self.log = ""
+        succ = BlockDev.utils_init_logging(self._log_func)
+        self.assertTrue(succ)
+        BlockDev.utils_set_log_level(BlockDev.UTILS_LOG_INFO)
+
+    def _clean_up(self):
+        BlockDev.utils_set_log_level(BlockDev.UTILS_LOG_WARNING)
+        BlockDev.utils_init_logging(None)
+
+        super(CryptoTestKeyslotHint, self)._clean_up()
+
+    def _log_func(self, _level, msg):
+        self.log += msg + "\n"
+
+    def _open_close(self, ctx):
+        self.log = ""
+        succ = BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+        self.assertTrue(succ)
+        succ = BlockDev.crypto_luks_close(self._dm_name)
+        self.assertTrue(succ)
+
+    def _assert_hint_used(self, keyslot):
+        self.assertIn("Trying keyslot %d of '%s' first" % (keyslot, self.loop_dev), self.log)
+        self.assertNotIn("trying all keyslots", self.log)
+
+    def _assert_hint_missed(self, keyslot):
+        self.assertIn("Trying keyslot %d of '%s' first" % (keyslot, self.loop_dev), self.log)
+        self.assertIn("Keyslot %d of '%s' didn't accept the key, trying all keyslots" % (keyslot, self.loop_dev), self.log)
+
+    def _format_multislot(self):
+        # PASSWD in slot 0, keyfile in slot 1 and PASSWD2 in slot 2
+        self._luks2_format(self.loop_dev, PASSWD, self.keyfile)
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        nctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD2)
+        succ = BlockDev.crypto_luks_add_key(self.loop_dev, ctx, nctx)
+        self.assertTrue(succ)
+
+    @tag_test(TestTags.SLOW)
+    def test_keyslot_hint(self):
+        """Verify that keyslot and token hints are used and wrong hints are ignored"""
+
+        self._format_multislot()
+
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD2)
+        with self.assertRaises(GLib.GError):
+            ctx.set_keyslot_hint(-2)
+        with self.assertRaises(GLib.GError):
+            ctx.set_token_hint(1000)
+
+        # no hint, all keyslots are tried right away
+        self._open_close(ctx)
+        self.assertNotIn("Trying keyslot", self.log)
+
+        # right hint
+        succ = ctx.set_keyslot_hint(2)
+        self.assertTrue(succ)
+        self._open_close(ctx)
+        self._assert_hint_used(2)
+
+        # wrong hint (both a keyslot with different key and an inactive keyslot)
+        # just means all the keyslots are tried
+        ctx.set_keyslot_hint(0)
+        self._open_close(ctx)
+        self._assert_hint_missed(0)
+        ctx.set_keyslot_hint(7)
+        self._open_close(ctx)
+        self._assert_hint_missed(7)
+
+        # wrong key is still rejected
+        wctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD3)
+        wctx.set_keyslot_hint(2)
+        with self.assertRaisesRegex(GLib.GError, r"Incorrect passphrase"):
+            BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, wctx)
+
+        # token assigned to keyslot 2
+        ret, _out, err = run_command("cryptsetup token add --key-description aaaa --key-slot 2 %s" % self.loop_dev)
+        self.assertEqual(ret, 0, msg="Failed to add token to %s: %s" % (self.loop_dev, err))
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD2)
+        ctx.set_token_hint(0)
+        self._open_close(ctx)
+        self._assert_hint_used(2)
+
+        fctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+        fctx.set_keyslot_hint(1)
+        self._open_close(fctx)
+        self._assert_hint_used(1)
+
+        # other operations using the key use the hint too
+        ctx.set_keyslot_hint(2)
+        nctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD3)
+        succ = BlockDev.crypto_luks_add_key(self.loop_dev, ctx, nctx)
+        self.assertTrue(succ)
+        self._open_close(nctx)
+
+        succ = BlockDev.crypto_luks_change_key(self.loop_dev, nctx, wctx)
+        self.assertTrue(succ)
+        succ = BlockDev.crypto_luks_remove_key(self.loop_dev, wctx)
+        self.assertTrue(succ)
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, wctx)
+
+    @tag_test(TestTags.SLOW)
+    def test_keyslot_cache(self):
+        """Verify that the keyslot cache works"""
+
+        self._format_multislot()
+
+        succ = BlockDev.crypto_set_keyslot_cache(True)
+        self.assertTrue(succ)
+        self.addCleanup(BlockDev.crypto_set_keyslot_cache, False)
+
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD2)
+        fctx = BlockDev.CryptoKeyslotContext(keyfile=self.keyfile)
+        self._open_close(ctx)
+        self.assertNotIn("Trying keyslot", self.log)
+        self._open_close(fctx)
+        self.assertNotIn("Trying keyslot", self.log)
+
+        # the keyslots that accepted the keys are tried first now
+        self._open_close(ctx)
+        self._assert_hint_used(2)
+        self._open_close(fctx)
+        self._assert_hint_used(1)
+
+        # the cached keyslot is gone, the key must not be accepted anymore
+        succ = BlockDev.crypto_luks_kill_slot(self.loop_dev, 2)
+        self.assertTrue(succ)
+        with self.assertRaisesRegex(GLib.GError, r"Incorrect passphrase"):
+            BlockDev.crypto_luks_open(self.loop_dev, self._dm_name, ctx)
+
+        # the same key in a different keyslot (the cache entry is outdated)
+        nctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        self._open_close(nctx)
+        succ = BlockDev.crypto_luks_add_key(self.loop_dev, nctx, ctx)
+        self.assertTrue(succ)
+        self._open_close(ctx)
+        self._open_close(fctx)
+        self._assert_hint_used(1)
+
+        succ = BlockDev.crypto_invalidate_keyslot_cache(self.loop_dev)
+        self.assertTrue(succ)
+        self._open_close(ctx)
+        self.assertNotIn("Trying keyslot", self.log)
+
+        succ = BlockDev.crypto_invalidate_keyslot_cache(None)
+        self.assertTrue(succ)
+        self._open_close(fctx)
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.crypto_invalidate_keyslot_cache(self.loop_dev2)
+
+        # the cache is optional
+        succ = BlockDev.crypto_set_keyslot_cache(False)
+        self.assertTrue(succ)
+        self._open_close(ctx)
+
+class CryptoTestPBKDFCache(CryptoTestCase):
+
+    def _get_iterations(self, device):
+        _ret, out, err = run_command("cryptsetup luksDump %s" % device)
+        # LUKS 2 digests use PBKDF2 too, only look at the keyslots
+        keyslots = out.split("Digests:")[0]
+        iterations = [int(i) for i in re.findall(r"Iterations:\s*(\d+)", keyslots)]
+        if not iterations:
+            self.fail("Failed to get pbkdf information from:\n%s %s" % (out, err))
+        return iterations
+
+    @tag_test(TestTags.SLOW)
+    def test_pbkdf_calibrate(self):
+        """Verify that PBKDF calibration works"""
+
+        pbkdf = BlockDev.crypto_luks_pbkdf_calibrate()
+        self.assertIsNotNone(pbkdf.type)
+        self.assertGreater(pbkdf.iterations, 0)
+
+        pbkdf = BlockDev.crypto_luks_pbkdf_calibrate(BlockDev.CryptoLUKSPBKDF(type="pbkdf2", time_ms=100))
+        self.assertEqual(pbkdf.type, "pbkdf2")
+        self.assertEqual(pbkdf.time_ms, 100)
+        self.assertGreaterEqual(pbkdf.iterations, 1000)
+
+        # iterations specified, nothing to calibrate
+        pbkdf = BlockDev.crypto_luks_pbkdf_calibrate(BlockDev.CryptoLUKSPBKDF(type="pbkdf2", iterations=1234))
+        self.assertEqual(pbkdf.iterations, 1234)
+
+    @tag_test(TestTags.SLOW)
+    def test_pbkdf_cache(self):
+        """Verify that calibrated PBKDF parameters are reused with the PBKDF cache enabled"""
+
+        succ = BlockDev.crypto_set_pbkdf_cache(True)
+        self.assertTrue(succ)
+        self.addCleanup(BlockDev.crypto_set_pbkdf_cache, False)
+
+        # aes-xts-plain64 uses 512 bits key by default
+        calibrated = BlockDev.crypto_luks_pbkdf_calibrate(BlockDev.CryptoLUKSPBKDF(type="pbkdf2", time_ms=100), 512)
+
+        ctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD)
+        extra = BlockDev.CryptoLUKSExtra(pbkdf=BlockDev.CryptoLUKSPBKDF(type="pbkdf2", time_ms=100))
+        for _i in range(2):
+            succ = BlockDev.crypto_luks_format(self.loop_dev, "aes-xts-plain64", 0, ctx, 0,
+                                               BlockDev.CryptoLUKSVersion.LUKS2, extra)
+            self.assertTrue(succ)
+            self.assertEqual(self._get_iterations(self.loop_dev), [calibrated.iterations])
+
+        # format and the following keyslots use the same (LUKS 1 default) parameters
+        self._luks_format(self.loop_dev2, PASSWD, self.keyfile)
+        nctx = BlockDev.CryptoKeyslotContext(passphrase=PASSWD2)
+        succ = BlockDev.crypto_luks_add_key(self.loop_dev2, ctx, nctx)
+        self.assertTrue(succ)
+        iterations = self._get_iterations(self.loop_dev2)
+        self.assertEqual(len(iterations), 3)
+        self.assertEqual(len(set(iterations)), 1)
+
+        # still works after disabling the cache
+        succ = BlockDev.crypto_set_pbkdf_cache(False)
+        self.assertTrue(succ)
+        succ = BlockDev.crypto_luks_add_key(self.loop_dev2, ctx, BlockDev.CryptoKeyslotContext(passphrase=PASSWD3))
+        self.assertTrue(succ)
+        self.assertEqual(len(self._get_iterations(self.loop_dev2)), 4)
+
 class CryptoTestTrueCrypt(CryptoTestCase):
 
     # we can't create TrueCrypt/VeraCrypt formats using libblockdev
@@ -1780,6 +2524,73 @@ class CryptoTestIntegrity(CryptoTestCase):
         self.assertTrue(succ)
         self.assertFalse(os.path.exists("/dev/mapper/%s" % self._dm_name))
 
+    def _check_integrity_wiped(self, device, algorithm):
+        succ = BlockDev.crypto_integrity_open(device, self._dm_name, algorithm)
+        self.assertTrue(succ)
+
+        # reading a block with invalid checksum fails so the whole device
+        # can be read only if all of it was wiped
+        ret, _out, err = run_command("dd if=/dev/mapper/%s of=/dev/null bs=1M iflag=direct" % self._dm_name)
+        self.assertEqual(ret, 0, msg="Failed to read the wiped integrity device: %s" % err)
+
+        succ = BlockDev.crypto_integrity_close(self._dm_name)
+        self.assertTrue(succ)
+
+    @tag_test(TestTags.SLOW)
+    def test_integrity_wipe_parallel(self):
+        """Verify that the integrity device is wiped in parallel with the progress reported"""
+
+        progress_log = []
+
+        def _my_progress_func(_task, _status, completion, msg):
+            progress_log.append((completion, msg))
+
+        succ = BlockDev.utils_init_prog_reporting(_my_progress_func)
+        self.assertTrue(succ)
+        self.addCleanup(BlockDev.utils_init_prog_reporting, None)
+
+        succ = BlockDev.crypto_integrity_format_parallel(self.loop_dev, "crc32c", max_jobs=4)
+        self.assertTrue(succ)
+
+        # progress from all the threads is aggregated and only grows
+        wipe_progress = [prog[0] for prog in progress_log if prog[1] == "Integrity device wipe in progress"]
+        self.assertTrue(wipe_progress)
+        self.assertEqual(wipe_progress, sorted(wipe_progress))
+        self.assertEqual(wipe_progress[-1], 100)
+
+        self._check_integrity_wiped(self.loop_dev, "crc32c")
+
+        # single job and automatic number of jobs
+        succ = BlockDev.crypto_integrity_format_parallel(self.loop_dev, "sha256", max_jobs=1)
+        self.assertTrue(succ)
+        self._check_integrity_wiped(self.loop_dev, "sha256")
+
+        extra = BlockDev.CryptoIntegrityExtra(sector_size=4096)
+        succ = BlockDev.crypto_integrity_format_parallel(self.loop_dev, "sha256", extra=extra)
+        self.assertTrue(succ)
+        self._check_integrity_wiped(self.loop_dev, "sha256")
+
+    @tag_test(TestTags.SLOW)
+    def test_integrity_wipe_parallel_throughput(self):
+        """Verify that the parallel integrity wipe is not slower than the serial one"""
+
+        start = time.monotonic()
+        succ = BlockDev.crypto_integrity_format(self.loop_dev, "crc32c", True)
+        self.assertTrue(succ)
+        serial = time.monotonic() - start
+
+        start = time.monotonic()
+        succ = BlockDev.crypto_integrity_format_parallel(self.loop_dev2, "crc32c")
+        self.assertTrue(succ)
+        parallel = time.monotonic() - start
+
+        self._check_integrity_wiped(self.loop_dev2, "crc32c")
+
+        # loop devices don't scale much with more writers, just make sure the
+        # parallel wipe is not considerably slower than the serial one
+        self.assertLess(parallel, serial * 1.5 + 1,
+                        msg="Parallel wipe took %.2f s, serial wipe %.2f s" % (parallel, serial))
+
 
 class CryptoTestLUKSOpal(CryptoTestCase):
 
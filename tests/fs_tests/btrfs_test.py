@@ -243,6 +243,30 @@ class BtrfsResize(BtrfsTestCase):
             fi = BlockDev.fs_btrfs_get_info(self.mount_dir)
             self.assertEqual(fi.size, self.loop_size)
 
+    def test_btrfs_resize_mounted(self):
+        """Verify that it is possible to resize a mounted btrfs file system without the btrfs utility"""
+
+        succ = BlockDev.fs_btrfs_mkfs(self.loop_dev)
+        self.assertTrue(succ)
+
+        with mounted(self.loop_dev, self.mount_dir):
+            succ = BlockDev.fs_btrfs_resize(self.mount_dir, 300 * 1024**2, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_btrfs_get_info(self.mount_dir)
+            self.assertEqual(fi.size, 300 * 1024**2)
+
+            # grow to the size of the device
+            succ = BlockDev.fs_btrfs_resize(self.mount_dir, 0, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_btrfs_get_info(self.mount_dir)
+            self.assertEqual(fi.size, self.loop_size)
+
+            # too small, the ioctl fails and the btrfs utility reports the error
+            with self.assertRaises(GLib.GError):
+                BlockDev.fs_btrfs_resize(self.mount_dir, 1024**2, None)
+            fi = BlockDev.fs_btrfs_get_info(self.mount_dir)
+            self.assertEqual(fi.size, self.loop_size)
+
 
 class BtrfsMultiDevice(BtrfsTestCase):
 
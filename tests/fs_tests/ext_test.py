@@ -410,6 +410,26 @@ class ExtResize(ExtTestCase):
                               resize_function=BlockDev.fs_ext4_resize,
                               minsize_function=BlockDev.fs_ext4_get_min_size)
 
+    def test_ext4_resize_mounted(self):
+        """Verify that it is possible to grow a mounted ext4 file system"""
+        succ = BlockDev.fs_ext4_mkfs(self.loop_dev, None)
+        self.assertTrue(succ)
+
+        succ = BlockDev.fs_ext4_resize(self.loop_dev, 50 * 1024**2, None)
+        self.assertTrue(succ)
+
+        with mounted(self.loop_dev, self.mount_dir):
+            # grow to the size of the device
+            succ = BlockDev.fs_ext4_resize(self.loop_dev, 0, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_ext4_get_info(self.loop_dev)
+            self.assertTrue(fi)
+            self.assertEqual(fi.block_count, self.loop_size / 1024)
+
+            # shrinking a mounted ext4 is not supported
+            with self.assertRaises(GLib.GError):
+                BlockDev.fs_ext4_resize(self.loop_dev, 50 * 1024**2, None)
+
 
 class ExtSetUUID(ExtTestCase):
 
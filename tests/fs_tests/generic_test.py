@@ -177,6 +177,56 @@ class TestClean(GenericTestCase):
         self.assertEqual(fs_type, b"")
 
 
+class TestZeroDevice(GenericTestCase):
+
+    def _fill_device(self):
+        ret = utils.run("dd if=/dev/urandom of=%s bs=1M count=50 oflag=direct >/dev/null 2>&1" % self.loop_dev)
+        self.assertEqual(ret, 0)
+
+    def _check_zeroed(self):
+        with open(self.loop_dev, "rb") as f:
+            while True:
+                data = f.read(4 * 1024**2)
+                if not data:
+                    break
+                self.assertEqual(data.count(0), len(data))
+
+    @tag_test(TestTags.CORE)
+    def test_zero_device(self):
+        """Verify that clearing the whole device works as expected"""
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.fs_zero_device("/non/existing/device")
+
+        for method in (BlockDev.FSZeroMethod.AUTO, BlockDev.FSZeroMethod.ZEROOUT,
+                       BlockDev.FSZeroMethod.WRITE):
+            self._fill_device()
+            succ = BlockDev.fs_zero_device(self.loop_dev, method)
+            self.assertTrue(succ)
+            self._check_zeroed()
+
+        # single thread should work too
+        self._fill_device()
+        succ = BlockDev.fs_zero_device(self.loop_dev, BlockDev.FSZeroMethod.WRITE, threads=1)
+        self.assertTrue(succ)
+        self._check_zeroed()
+
+        # loop devices backed by a file support discard (punching holes)
+        self._fill_device()
+        succ = BlockDev.fs_zero_device(self.loop_dev, BlockDev.FSZeroMethod.DISCARD)
+        self.assertTrue(succ)
+        self._check_zeroed()
+
+    @tag_test(TestTags.CORE)
+    def test_zero_device_force(self):
+        ret = utils.run("mkfs.ext2 %s >/dev/null 2>&1" % self.loop_dev)
+        self.assertEqual(ret, 0)
+
+        with mounted(self.loop_dev, self.mount_dir):
+            with self.assertRaisesRegex(GLib.GError, "Failed to open the device"):
+                BlockDev.fs_zero_device(self.loop_dev)
+
+
 class CanResizeRepairCheckLabel(GenericNoDevTestCase):
     def test_can_resize(self):
         """Verify that tooling query works for resize"""
@@ -361,6 +411,53 @@ class CanResizeRepairCheckLabel(GenericNoDevTestCase):
         with self.assertRaises(GLib.GError):
             BlockDev.fs_can_get_min_size("udf")
 
+    def test_get_capabilities(self):
+        """Verify that the capability matrix matches the fs_can_* functions"""
+
+        caps = BlockDev.fs_get_capabilities()
+        self.assertEqual(sorted(c.type for c in caps), sorted(BlockDev.fs_supported_filesystems()))
+
+        for c in caps:
+            supported = True
+            try:
+                avail, mode, util = BlockDev.fs_can_resize(c.type)
+            except GLib.GError:
+                supported = False
+                avail = False
+            self.assertEqual(bool(c.supported & BlockDev.FSCapabilityFlags.RESIZE), supported)
+            self.assertEqual(bool(c.available & BlockDev.FSCapabilityFlags.RESIZE), avail)
+            if supported:
+                self.assertEqual(c.resize, mode)
+
+            try:
+                avail, util = BlockDev.fs_can_get_free_space(c.type)
+            except GLib.GError:
+                avail = False
+            self.assertEqual(bool(c.available & BlockDev.FSCapabilityFlags.GET_FREE_SPACE), avail)
+
+        ext4 = [c for c in caps if c.type == "ext4"][0]
+        self.assertTrue(ext4.available & BlockDev.FSCapabilityFlags.MKFS)
+        self.assertEqual(ext4.mkfs_util, "mkfs.ext4")
+        self.assertEqual(ext4.minsize_util, "resize2fs")
+
+        xfs = [c for c in caps if c.type == "xfs"][0]
+        self.assertFalse(xfs.supported & BlockDev.FSCapabilityFlags.GET_MIN_SIZE)
+        self.assertFalse(xfs.supported & BlockDev.FSCapabilityFlags.GET_FREE_SPACE)
+        self.assertIsNone(xfs.minsize_util)
+
+        # the cache is invalidated when PATH changes
+        old_path = os.environ.get("PATH", "")
+        os.environ["PATH"] = ""
+        caps = BlockDev.fs_get_capabilities()
+        os.environ["PATH"] = old_path
+        ext4 = [c for c in caps if c.type == "ext4"][0]
+        self.assertTrue(ext4.supported & BlockDev.FSCapabilityFlags.MKFS)
+        self.assertFalse(ext4.available & BlockDev.FSCapabilityFlags.MKFS)
+
+        caps = BlockDev.fs_get_capabilities()
+        ext4 = [c for c in caps if c.type == "ext4"][0]
+        self.assertTrue(ext4.available & BlockDev.FSCapabilityFlags.MKFS)
+
 
 class GenericMkfs(GenericTestCase):
 
@@ -1150,6 +1247,78 @@ class GenericResize(GenericTestCase):
             BlockDev.fs_resize(self.loop_dev, 80 * 1024**2)
 
 
+class GenericMountPool(GenericTestCase):
+    def tearDown(self):
+        BlockDev.fs_set_mount_pool_timeout(0)
+        super(GenericMountPool, self).tearDown()
+
+    def test_btrfs_mount_pool(self):
+        """Verify that temporary mounts are reused with the mount pool enabled"""
+        if not self.btrfs_avail:
+            self.skipTest("skipping Btrfs: not available")
+
+        succ = BlockDev.fs_btrfs_mkfs(self.loop_dev, None)
+        self.assertTrue(succ)
+
+        succ = BlockDev.fs_set_mount_pool_timeout(60)
+        self.assertTrue(succ)
+
+        size = BlockDev.fs_get_size(self.loop_dev)
+        self.assertNotEqual(size, 0)
+
+        # the temporary mount should be kept around and reused
+        mountpoint = BlockDev.fs_get_mountpoint(self.loop_dev)
+        self.assertIsNotNone(mountpoint)
+        self.assertTrue(os.path.basename(mountpoint).startswith("blockdev."))
+
+        succ = BlockDev.fs_resize(self.loop_dev, 300 * 1024**2)
+        self.assertTrue(succ)
+        new_size = BlockDev.fs_get_size(self.loop_dev)
+        self.assertAlmostEqual(new_size, 300 * 1024**2)
+        self.assertEqual(BlockDev.fs_get_mountpoint(self.loop_dev), mountpoint)
+
+        succ = BlockDev.fs_set_label(self.loop_dev, "pooled")
+        self.assertTrue(succ)
+        self.assertEqual(BlockDev.fs_get_mountpoint(self.loop_dev), mountpoint)
+
+        # operations that need the device unmounted release the pooled mount
+        succ = BlockDev.fs_check(self.loop_dev)
+        self.assertTrue(succ)
+        self.assertIsNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+        self.assertFalse(os.path.exists(mountpoint))
+
+        # the same applies to the filesystem specific functions
+        size = BlockDev.fs_get_size(self.loop_dev)
+        self.assertIsNotNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+        succ = BlockDev.fs_btrfs_check(self.loop_dev, None)
+        self.assertTrue(succ)
+        self.assertIsNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+
+        # flushing the pool unmounts everything
+        size = BlockDev.fs_get_size(self.loop_dev)
+        self.assertIsNotNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+        succ = BlockDev.fs_flush_mount_pool()
+        self.assertTrue(succ)
+        self.assertIsNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+
+    def test_btrfs_mount_pool_timeout(self):
+        """Verify that idle temporary mounts are released after the timeout"""
+        if not self.btrfs_avail:
+            self.skipTest("skipping Btrfs: not available")
+
+        succ = BlockDev.fs_btrfs_mkfs(self.loop_dev, None)
+        self.assertTrue(succ)
+
+        succ = BlockDev.fs_set_mount_pool_timeout(1)
+        self.assertTrue(succ)
+
+        BlockDev.fs_get_size(self.loop_dev)
+        self.assertIsNotNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+
+        time.sleep(3)
+        self.assertIsNone(BlockDev.fs_get_mountpoint(self.loop_dev))
+
+
 class GenericGetFreeSpace(GenericTestCase):
     def _test_get_free_space(self, mkfs_function, fstype, size_delta=0):
         # clean the device
@@ -1327,6 +1496,54 @@ class FSFreezeTest(GenericTestCase):
         with self.assertRaises(GLib.GError):
             BlockDev.fs_freeze(tmp)
 
+    def test_freeze_group(self):
+        """ Test freezing and un-freezing a group of filesystems """
+
+        succ = BlockDev.fs_xfs_mkfs(self.loop_dev, None)
+        self.assertTrue(succ)
+        succ = BlockDev.fs_ext4_mkfs(self.loop_dev2, None)
+        self.assertTrue(succ)
+
+        tmp1 = tempfile.mkdtemp(prefix="libblockdev.", suffix="freeze_test")
+        self.addCleanup(os.rmdir, tmp1)
+        tmp2 = tempfile.mkdtemp(prefix="libblockdev.", suffix="freeze_test")
+        self.addCleanup(os.rmdir, tmp2)
+
+        self.addCleanup(utils.umount, self.loop_dev)
+        succ = BlockDev.fs_mount(self.loop_dev, tmp1, "xfs", None)
+        self.assertTrue(succ)
+        self.addCleanup(utils.umount, self.loop_dev2)
+        succ = BlockDev.fs_mount(self.loop_dev2, tmp2, "ext4", None)
+        self.assertTrue(succ)
+
+        # one of the mountpoints is invalid -- nothing should stay frozen
+        with self.assertRaises(GLib.GError):
+            BlockDev.fs_freeze_group([tmp1, "/not/a/mountpoint", tmp2], 0)
+        succ = BlockDev.fs_freeze(tmp1)
+        self.assertTrue(succ)
+        succ = BlockDev.fs_unfreeze(tmp1)
+        self.assertTrue(succ)
+
+        members = BlockDev.fs_freeze_group([tmp1, tmp2], 5000)
+        self.assertEqual(len(members), 2)
+        self.assertEqual({m.mountpoint for m in members}, {tmp1, tmp2})
+        self.assertTrue(all(m.frozen for m in members))
+
+        # already frozen
+        with self.assertRaises(GLib.GError):
+            BlockDev.fs_freeze(tmp2)
+
+        succ = BlockDev.fs_unfreeze_group(members)
+        self.assertTrue(succ)
+        self.assertFalse(any(m.frozen for m in members))
+        self.assertTrue(all(m.frozen_time > 0 for m in members))
+
+        # both thawed, can be frozen again
+        succ = BlockDev.fs_freeze(tmp2)
+        self.assertTrue(succ)
+        succ = BlockDev.fs_unfreeze(tmp2)
+        self.assertTrue(succ)
+
 
 class SupportedFilesystemsTest(GenericNoDevTestCase):
     def test_supported_filesystems(self):
@@ -283,6 +283,46 @@ class XfsResize(XfsTestCase):
         self.assertTrue(fi)
         self.assertEqual(fi.block_size * fi.block_count, 450 * 1024**2)
 
+    def test_xfs_resize_mounted(self):
+        """Verify that it is possible to grow a mounted xfs file system without xfs_growfs"""
+
+        lv = self._setup_lvm(vgname="libbd_fs_tests", lvname="xfs_test", lvsize="350M")
+
+        succ = BlockDev.fs_xfs_mkfs(lv, None)
+        self.assertTrue(succ)
+
+        self._lvresize("libbd_fs_tests", "xfs_test", "400M")
+
+        # the file system stays mounted for all the resizes
+        with mounted(lv, self.mount_dir):
+            fi = BlockDev.fs_xfs_get_info(lv)
+            self.assertTrue(fi)
+            self.assertEqual(fi.block_size * fi.block_count, 350 * 1024**2)
+            block_size = fi.block_size
+
+            # grow just to 380 MiB
+            succ = BlockDev.fs_xfs_resize(self.mount_dir, 380 * 1024**2 // block_size, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_xfs_get_info(lv)
+            self.assertEqual(fi.block_size * fi.block_count, 380 * 1024**2)
+
+            # no change, nothing should happen
+            succ = BlockDev.fs_xfs_resize(self.mount_dir, 380 * 1024**2 // block_size, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_xfs_get_info(lv)
+            self.assertEqual(fi.block_size * fi.block_count, 380 * 1024**2)
+
+            # should grow to 400 MiB (full size of the LV)
+            succ = BlockDev.fs_xfs_resize(self.mount_dir, 0, None)
+            self.assertTrue(succ)
+            fi = BlockDev.fs_xfs_get_info(lv)
+            self.assertEqual(fi.block_size * fi.block_count, 400 * 1024**2)
+
+            # shrinking is left to xfs_growfs which reports the error
+            if self._get_xfs_version() < Version("5.12"):
+                with self.assertRaises(GLib.GError):
+                    BlockDev.fs_xfs_resize(self.mount_dir, 380 * 1024**2 // block_size, None)
+
 
 class XfsSetUUID(XfsTestCase):
 
@@ -2,6 +2,8 @@ import unittest
 import os
 import re
 import time
+import threading
+from uuid import uuid4
 from contextlib import contextmanager
 import overrides_hack
 
@@ -77,6 +79,62 @@ class MDNoDevTestCase(MDTest):
         self.assertEqual(BlockDev.md_get_superblock_size(257 * 1024**2, version="unknown version"),
                          2 * 1024**2)
 
+    @tag_test(TestTags.NOSTORAGE)
+    def test_plan_capacity(self):
+        """Verify that capacity of MD RAIDs is computed as expected"""
+
+        member = 10 * 1024**2
+        data = 9 * 1024**2  # 1 MiB of data offset, multiple of the chunk size
+
+        for level, size in (("raid0", 4 * data), ("raid1", data), ("raid4", 3 * data),
+                            ("raid5", 3 * data), ("raid6", 2 * data), ("raid10", 2 * data)):
+            cap = BlockDev.md_plan_capacity(level, [member] * 4)
+            self.assertEqual(cap.size, size, msg=level)
+            self.assertEqual(cap.member_data_size, data)
+            self.assertEqual(cap.data_offset, 1024**2)
+            self.assertEqual(cap.metadata_size, 1024**2)
+            self.assertEqual(cap.parity_size, 4 * data - size)
+
+        # the smallest member limits the capacity
+        cap = BlockDev.md_plan_capacity("5", [member, 2 * member, member])
+        self.assertEqual(cap.size, 2 * data)
+
+        # RAID10 with an odd number of members and chunk alignment
+        cap = BlockDev.md_plan_capacity("raid10", [member] * 3, chunk_size=4 * 1024**2)
+        self.assertEqual(cap.member_data_size, 8 * 1024**2)
+        self.assertEqual(cap.size, 12 * 1024**2)
+
+        # superblock at the end of the members, data from the start
+        cap = BlockDev.md_plan_capacity("raid1", [member] * 2, "1.0", bitmap=True)
+        self.assertEqual(cap.data_offset, 0)
+        self.assertEqual(cap.bitmap_size, 4 * 1024)
+        self.assertEqual(cap.member_data_size, member - 64 * 1024)
+        self.assertEqual(cap.parity_size, member - 64 * 1024)
+        cap = BlockDev.md_plan_capacity("raid1", [member] * 2, "0.90")
+        self.assertEqual(cap.data_offset, 0)
+        self.assertEqual(cap.member_data_size, member - 64 * 1024)
+
+        # big members get the full reshape headroom and bigger bitmap space
+        cap = BlockDev.md_plan_capacity("raid6", [1024**4] * 6, "1.2", bitmap=True)
+        self.assertEqual(cap.data_offset, 128 * 1024**2)
+        self.assertEqual(cap.bitmap_size, 128 * 1024)
+        self.assertEqual(cap.member_data_size, 1024**4 - 128 * 1024**2)
+        self.assertEqual(cap.size, 4 * cap.member_data_size)
+
+        with self.assertRaisesRegex(GLib.GError, "Unsupported RAID level"):
+            BlockDev.md_plan_capacity("raid7", [member] * 4)
+        with self.assertRaisesRegex(GLib.GError, "At least 4 member devices"):
+            BlockDev.md_plan_capacity("raid6", [member] * 3)
+        with self.assertRaisesRegex(GLib.GError, "Unsupported metadata version"):
+            BlockDev.md_plan_capacity("raid1", [member] * 2, "2.0")
+
+        # pure computation, many combinations can be evaluated quickly
+        start = time.time()
+        for i in range(10000):
+            BlockDev.md_plan_capacity(("raid0", "raid1", "raid5", "raid6", "raid10")[i % 5],
+                                      [member + i * 4096] * (4 + i % 8), bitmap=bool(i % 2))
+        self.assertLess(time.time() - start, 10)
+
     @tag_test(TestTags.NOSTORAGE)
     def test_canonicalize_uuid(self):
         """Verify that UUID canonicalization works as expected"""
@@ -84,6 +142,10 @@ class MDNoDevTestCase(MDTest):
         self.assertEqual(BlockDev.md_canonicalize_uuid("3386ff85:f5012621:4a435f06:1eb47236"),
                          "3386ff85-f501-2621-4a43-5f061eb47236")
 
+        # mdadm may add a note about the host to the UUID
+        self.assertEqual(BlockDev.md_canonicalize_uuid("3386ff85:f5012621:4a435f06:1eb47236 (local to host foo)"),
+                         "3386ff85-f501-2621-4a43-5f061eb47236")
+
         with self.assertRaisesRegex(GLib.GError, r'malformed or invalid'):
             BlockDev.md_canonicalize_uuid("malformed-uuid-example")
 
@@ -97,6 +159,45 @@ class MDNoDevTestCase(MDTest):
         with self.assertRaisesRegex(GLib.GError, r'malformed or invalid'):
             BlockDev.md_get_md_uuid("malformed-uuid-example")
 
+    @tag_test(TestTags.NOSTORAGE)
+    def test_uuid_conversions(self):
+        """Verify that UUID conversions validate the whole UUID and are reversible"""
+
+        # too short, too long, invalid characters and misplaced separators
+        for uuid in ("", "3386ff85:f5012621:4a435f06:1eb4723", "3386ff85:f5012621:4a435f06:1eb472366",
+                     "3386ff85:f5012621:4a435f06:1eb4723g", "x3386ff85:f5012621:4a435f06:1eb47236",
+                     "3386ff85-f5012621-4a435f06-1eb47236", "3386ff85:f5012621:4a435f061:eb47236"):
+            with self.assertRaisesRegex(GLib.GError, r'malformed or invalid'):
+                BlockDev.md_canonicalize_uuid(uuid)
+
+        for uuid in ("", "3386ff85-f501-2621-4a43-5f061eb4723", "3386ff85-f501-2621-4a43-5f061eb472366",
+                     "3386ff85-f501-2621-4a43-5f061eb4723z", "3386ff85-f501-2621-4a435-f061eb47236",
+                     "3386ff85:f5012621:4a435f06:1eb47236"):
+            with self.assertRaisesRegex(GLib.GError, r'malformed or invalid'):
+                BlockDev.md_get_md_uuid(uuid)
+
+        # conversions in both directions are reversible
+        canonical = str(uuid4())
+        md_uuid = BlockDev.md_get_md_uuid(canonical)
+        self.assertEqual(md_uuid, "%s:%s:%s:%s" % tuple(canonical.replace("-", "")[i:i + 8] for i in range(0, 32, 8)))
+        self.assertEqual(BlockDev.md_canonicalize_uuid(md_uuid), canonical)
+
+    @tag_test(TestTags.SLOW)
+    def test_uuid_conversions_benchmark(self):
+        """Benchmark the UUID conversions (examine/detail do them for every member)"""
+
+        uuids = [str(uuid4()) for _i in range(10000)]
+
+        start = time.monotonic()
+        for canonical in uuids:
+            md_uuid = BlockDev.md_get_md_uuid(canonical)
+            self.assertEqual(BlockDev.md_canonicalize_uuid(md_uuid), canonical)
+        elapsed = time.monotonic() - start
+
+        # a generous limit, the conversions should only take a few microseconds each
+        self.assertLess(elapsed / len(uuids), 0.001,
+                        "%d UUID round-trips took %.3f s" % (len(uuids), elapsed))
+
 class MDTestCase(MDTest):
 
     _sparse_size = 10 * 1024**2
@@ -327,6 +428,114 @@ class MDTestActivateByUUID(MDTestCase):
             succ = BlockDev.md_activate(None, None, md_info.uuid)
 
 
+class MDTestActivateMany(MDTestCase):
+    def _clean_up(self):
+        try:
+            BlockDev.md_deactivate("bd_test_md2")
+        except:
+            pass
+
+        super(MDTestActivateMany, self)._clean_up()
+
+    @tag_test(TestTags.SLOW)
+    def test_activate_many(self):
+        """Verify that it is possible to activate multiple MD RAIDs at once"""
+
+        with wait_for_action("resync"):
+            succ = BlockDev.md_create("bd_test_md", "raid1",
+                                      [self.loop_dev, self.loop_dev2],
+                                      0, None, None)
+            self.assertTrue(succ)
+
+        # degraded from the beginning
+        succ = BlockDev.md_create("bd_test_md2", "raid1",
+                                  [self.loop_dev3, "missing"],
+                                  0, None, None)
+        self.assertTrue(succ)
+
+        uuid = BlockDev.md_examine(self.loop_dev).uuid
+        uuid2 = BlockDev.md_examine(self.loop_dev3).uuid
+
+        succ = BlockDev.md_deactivate("bd_test_md")
+        self.assertTrue(succ)
+        succ = BlockDev.md_deactivate("bd_test_md2")
+        self.assertTrue(succ)
+
+        # non-existing devices are just ignored
+        results = BlockDev.md_activate_many([self.loop_dev3, self.loop_dev, "/dev/bd_nonexistent", self.loop_dev2],
+                                            start_degraded=True, max_jobs=2)
+        self.assertEqual(len(results), 2)
+
+        # in the order of the first member
+        self.assertEqual(results[0].uuid, uuid2)
+        self.assertEqual(results[0].device, "/dev/md/bd_test_md2")
+        self.assertEqual(results[0].members, [self.loop_dev3])
+        self.assertEqual(results[1].uuid, uuid)
+        self.assertEqual(results[1].device, "/dev/md/bd_test_md")
+        self.assertEqual(results[1].members, [self.loop_dev, self.loop_dev2])
+
+        for result in results:
+            self.assertTrue(result.success, msg=result.error_msg)
+            self.assertIsNone(result.error_msg)
+            self.assertGreater(result.duration, 0)
+
+        self.assertEqual(BlockDev.md_detail("bd_test_md").uuid, uuid)
+        self.assertEqual(BlockDev.md_detail("bd_test_md2").uuid, uuid2)
+
+        # already active arrays are just reported as activated
+        results = BlockDev.md_activate_many([self.loop_dev, self.loop_dev2, self.loop_dev3])
+        self.assertEqual(len(results), 2)
+        self.assertTrue(all(result.success for result in results))
+
+        self.assertEqual(BlockDev.md_activate_many([]), [])
+
+    @tag_test(TestTags.SLOW)
+    def test_activate_many_no_name(self):
+        """Verify that MD RAIDs without a name are activated from the given members"""
+
+        with wait_for_action("resync"):
+            succ = BlockDev.md_create("bd_test_md", "raid1",
+                                      [self.loop_dev, self.loop_dev2],
+                                      0, "0.90", None)
+            self.assertTrue(succ)
+
+        uuid = BlockDev.md_examine(self.loop_dev).uuid
+        succ = BlockDev.md_deactivate("bd_test_md")
+        self.assertTrue(succ)
+
+        # only one of the members is given, the array has to be activated degraded from it
+        results = BlockDev.md_activate_many([self.loop_dev], start_degraded=True)
+        self.assertEqual(len(results), 1)
+        self.assertTrue(results[0].success, msg=results[0].error_msg)
+        self.assertEqual(results[0].device, "/dev/md/%s" % uuid[:8])
+        self.assertEqual(results[0].members, [self.loop_dev])
+
+        md_info = BlockDev.md_detail(results[0].device)
+        self.assertEqual(md_info.uuid, uuid)
+        self.assertEqual(md_info.active_devices, 1)
+
+        BlockDev.md_deactivate(results[0].device)
+
+
+class MDTestPlanCapacity(MDTestCase):
+    @tag_test(TestTags.SLOW)
+    def test_plan_capacity_matches_mdadm(self):
+        """Verify that the planned capacity matches the capacity of a real MD RAID"""
+
+        cap = BlockDev.md_plan_capacity("raid5", [self._sparse_size] * 3)
+
+        with wait_for_action("resync"):
+            succ = BlockDev.md_create("bd_test_md", "raid5",
+                                      [self.loop_dev, self.loop_dev2, self.loop_dev3],
+                                      0, None, None)
+            self.assertTrue(succ)
+
+        # sizes in BDMDDetailData are in KiB
+        detail = BlockDev.md_detail("bd_test_md")
+        self.assertEqual(detail.array_size * 1024, cap.size)
+        self.assertEqual(detail.use_dev_size * 1024, cap.member_data_size)
+
+
 class MDTestNominateDenominate(MDTestCase):
     @tag_test(TestTags.SLOW)
     def test_nominate_denominate(self):
@@ -475,6 +684,49 @@ class MDTestExamineDetail(MDTestCase):
         de_data = BlockDev.md_detail("/dev/%s" % node)
         self.assertTrue(de_data)
 
+    @tag_test(TestTags.SLOW)
+    def test_examine_detail_mdadm(self):
+        """Verify that MD RAID info matches what mdadm reports"""
+
+        for version in ("0.90", "1.0", "1.2"):
+            with wait_for_action("resync"):
+                succ = BlockDev.md_create("bd_test_md", "raid5",
+                                          [self.loop_dev, self.loop_dev2, self.loop_dev3],
+                                          0, version, None)
+                self.assertTrue(succ)
+
+            ret, out, err = run_command("mdadm --examine --export %s" % self.loop_dev)
+            self.assertEqual(ret, 0, msg="Failed to examine %s: %s" % (self.loop_dev, err))
+            mdadm_ex = dict(line.split("=", 1) for line in out.splitlines() if "=" in line)
+
+            ex_data = BlockDev.md_examine(self.loop_dev)
+            self.assertEqual(ex_data.metadata, version)
+            self.assertEqual(ex_data.level, mdadm_ex["MD_LEVEL"])
+            self.assertEqual(ex_data.num_devices, int(mdadm_ex["MD_DEVICES"]))
+            self.assertEqual(ex_data.uuid, BlockDev.md_canonicalize_uuid(mdadm_ex["MD_UUID"]))
+            self.assertEqual(ex_data.events, int(mdadm_ex["MD_EVENTS"]))
+            if "MD_DEV_UUID" in mdadm_ex:
+                self.assertEqual(ex_data.dev_uuid, BlockDev.md_canonicalize_uuid(mdadm_ex["MD_DEV_UUID"]))
+            self.assertEqual(ex_data.chunk_size, 512 * 1024)
+
+            ret, out, err = run_command("mdadm --detail --export /dev/md/bd_test_md")
+            self.assertEqual(ret, 0, msg="Failed to get detail of the array: %s" % err)
+            mdadm_de = dict(line.split("=", 1) for line in out.splitlines() if "=" in line)
+
+            de_data = BlockDev.md_detail("bd_test_md")
+            self.assertEqual(de_data.metadata, mdadm_de["MD_METADATA"])
+            self.assertEqual(de_data.level, mdadm_de["MD_LEVEL"])
+            self.assertEqual(de_data.raid_devices, int(mdadm_de["MD_DEVICES"]))
+            self.assertEqual(de_data.uuid, BlockDev.md_canonicalize_uuid(mdadm_de["MD_UUID"]))
+            self.assertEqual(de_data.uuid, ex_data.uuid)
+            self.assertEqual(de_data.total_devices, 3)
+            self.assertEqual(de_data.active_devices, 3)
+            self.assertEqual(de_data.failed_devices, 0)
+
+            BlockDev.md_deactivate("bd_test_md")
+            for dev in (self.loop_dev, self.loop_dev2, self.loop_dev3):
+                BlockDev.md_destroy(dev)
+
 class MDTestNameNodeBijection(MDTestCase):
     @tag_test(TestTags.SLOW)
     def test_name_node_bijection(self):
@@ -589,6 +841,66 @@ class MDTestRequestSyncAction(MDTestCase):
         self.assertEqual(action, "check")
 
 
+class MDTestMonitor(MDTestCase):
+    @tag_test(TestTags.SLOW)
+    def test_monitor(self):
+        """Verify that MD arrays and their sync actions can be monitored"""
+
+        reports = []
+        lock = threading.Lock()
+
+        def monitor_cb(statuses, _user_data):
+            with lock:
+                reports.append([(s.node, s.array_state, s.sync_action, s.sync_total, s.progress) for s in statuses])
+
+        monitor_id = BlockDev.md_monitor_start(monitor_cb, None, 100)
+        self.assertGreater(monitor_id, 0)
+
+        try:
+            with wait_for_action("resync"):
+                succ = BlockDev.md_create("bd_test_md", "raid1",
+                                          [self.loop_dev, self.loop_dev2],
+                                          0, None, None)
+                self.assertTrue(succ)
+
+            node = BlockDev.md_node_from_name("bd_test_md")
+            statuses = BlockDev.md_get_array_statuses()
+            status = next(s for s in statuses if s.node == node)
+            self.assertEqual(status.sync_action, "idle")
+            self.assertEqual(status.sync_total, 0)
+            self.assertEqual(status.degraded, 0)
+            self.assertIn(status.array_state, ("clean", "active", "active-idle"))
+
+            # give the monitor a moment to notice the end of the resync
+            time.sleep(1)
+        finally:
+            succ = BlockDev.md_monitor_stop(monitor_id)
+            self.assertTrue(succ)
+
+        with lock:
+            # initial report, the new array and the end of the resync at least
+            self.assertGreaterEqual(len(reports), 3)
+            nodes = [[r[0] for r in report] for report in reports]
+            self.assertNotIn(node, nodes[0])
+            self.assertIn(node, nodes[-1])
+            last = next(r for r in reports[-1] if r[0] == node)
+            self.assertEqual(last[2], "idle")
+
+            # progress of a running resync should have been reported (unless it was too fast)
+            progress = [r[4] for report in reports for r in report if r[0] == node and r[3] > 0]
+            self.assertTrue(all(0 <= p <= 100 for p in progress))
+
+        # no more reports after the monitor is stopped
+        with lock:
+            num_reports = len(reports)
+        time.sleep(0.5)
+        with lock:
+            self.assertEqual(len(reports), num_reports)
+
+        with self.assertRaisesRegex(GLib.GError, "No MD monitor"):
+            BlockDev.md_monitor_stop(monitor_id)
+
+
 class MDTestDDFRAID(MDTestCase):
 
     _sparse_size = 50 * 1024**2
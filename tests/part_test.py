@@ -670,6 +670,44 @@ class PartGetDiskPartsCase(PartTestCase):
         with self.assertRaises(GLib.GError):
             BlockDev.part_get_disk_parts (self.loop_dev)
 
+    def test_get_disk_parts_gpt(self):
+        """Verify that getting info about partitions on GPT works"""
+
+        succ = BlockDev.part_create_table (self.loop_dev, BlockDev.PartTableType.GPT, True)
+        self.assertTrue(succ)
+
+        # create some partitions with different types and attributes
+        paths = []
+        start = 2048 * 512
+        for _i in range(4):
+            ps = BlockDev.part_create_part (self.loop_dev, BlockDev.PartTypeReq.NORMAL, start, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+            self.assertTrue(ps)
+            paths.append(ps.path)
+            start = ps.start + ps.size
+
+        succ = BlockDev.part_set_part_type (self.loop_dev, paths[1], "C12A7328-F81F-11D2-BA4B-00A0C93EC93B")
+        self.assertTrue(succ)
+        succ = BlockDev.part_set_part_attributes (self.loop_dev, paths[2], (1 << 0) | (1 << 60))
+        self.assertTrue(succ)
+
+        parts = BlockDev.part_get_disk_parts (self.loop_dev)
+        self.assertEqual(len(parts), 4)
+
+        # everything should match what we get for the individual partitions
+        for path, part in zip(paths, parts):
+            ps = BlockDev.part_get_part_spec (self.loop_dev, path)
+            self.assertEqual(part.path, ps.path)
+            self.assertEqual(part.start, ps.start)
+            self.assertEqual(part.size, ps.size)
+            self.assertEqual(part.type_guid, ps.type_guid)
+            self.assertEqual(part.type_name, ps.type_name)
+            self.assertEqual(part.attrs, ps.attrs)
+
+        self.assertEqual(parts[1].type_guid, "C12A7328-F81F-11D2-BA4B-00A0C93EC93B")
+        self.assertEqual(parts[1].type_name, "EFI System")
+        self.assertEqual(parts[2].attrs, (1 << 0) | (1 << 60))
+        self.assertEqual(parts[0].attrs, 0)
+
 
 def _round_up_mib(size):
     # convert size to nearest MiB (up)
@@ -1352,6 +1390,269 @@ class PartSetGptAttrsCase(PartTestCase):
         self.assertEqual(ps.attrs, attrs)
 
 
+class PartTransactionCase(PartTestCase):
+    def _part_path(self, num):
+        if self.loop_dev[-1].isdigit():
+            return "%sp%d" % (self.loop_dev, num)
+        else:
+            return "%s%d" % (self.loop_dev, num)
+
+    def test_transaction(self):
+        """Verify that changes queued in a transaction are written at once"""
+
+        succ = BlockDev.part_create_table (self.loop_dev, BlockDev.PartTableType.GPT, True)
+        self.assertTrue(succ)
+
+        # one existing partition to be removed by the transaction
+        ps = BlockDev.part_create_part (self.loop_dev, BlockDev.PartTypeReq.NORMAL, 2048*512, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(ps)
+        old_path = ps.path
+
+        trans = BlockDev.part_transaction_new (self.loop_dev)
+        self.assertTrue(trans)
+
+        succ = BlockDev.part_transaction_delete_part (trans, old_path)
+        self.assertTrue(succ)
+
+        start = 2048 * 512
+        for _i in range(5):
+            succ = BlockDev.part_transaction_create_part (trans, BlockDev.PartTypeReq.NORMAL, start, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+            self.assertTrue(succ)
+            start += 10 * 1024**2
+
+        # the partitions will be numbered from 1 again after the removal
+        succ = BlockDev.part_transaction_set_part_name (trans, self._part_path(2), "second")
+        self.assertTrue(succ)
+        succ = BlockDev.part_transaction_set_part_type (trans, self._part_path(3), "C12A7328-F81F-11D2-BA4B-00A0C93EC93B")
+        self.assertTrue(succ)
+        succ = BlockDev.part_transaction_set_part_attributes (trans, self._part_path(4), (1 << 60))
+        self.assertTrue(succ)
+        succ = BlockDev.part_transaction_resize_part (trans, self._part_path(5), 20 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(succ)
+
+        # nothing changed on the disk yet
+        parts = BlockDev.part_get_disk_parts (self.loop_dev)
+        self.assertEqual(len(parts), 1)
+
+        created = BlockDev.part_transaction_commit (trans)
+        self.assertEqual(len(created), 5)
+        self.assertEqual([p.path for p in created], [self._part_path(i) for i in range(1, 6)])
+
+        parts = BlockDev.part_get_disk_parts (self.loop_dev)
+        self.assertEqual(len(parts), 5)
+        for part in parts:
+            self.assertTrue(os.path.exists(part.path))
+        self.assertEqual(parts[1].name, "second")
+        self.assertEqual(parts[2].type_guid, "C12A7328-F81F-11D2-BA4B-00A0C93EC93B")
+        self.assertEqual(parts[3].attrs, (1 << 60))
+        self.assertGreaterEqual(parts[4].size, 20 * 1024**2)
+
+        # committed transaction is empty
+        created = BlockDev.part_transaction_commit (trans)
+        self.assertEqual(len(created), 0)
+
+    def test_transaction_recreate(self):
+        """Verify that a partition re-created in a transaction is reported once"""
+
+        succ = BlockDev.part_create_table (self.loop_dev, BlockDev.PartTableType.GPT, True)
+        self.assertTrue(succ)
+
+        trans = BlockDev.part_transaction_new (self.loop_dev)
+        succ = BlockDev.part_transaction_create_part (trans, BlockDev.PartTypeReq.NORMAL, 2048*512, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(succ)
+        succ = BlockDev.part_transaction_delete_part (trans, self._part_path(1))
+        self.assertTrue(succ)
+        succ = BlockDev.part_transaction_create_part (trans, BlockDev.PartTypeReq.NORMAL, 2048*512, 20 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(succ)
+
+        created = BlockDev.part_transaction_commit (trans)
+        self.assertEqual(len(created), 1)
+        self.assertEqual(created[0].path, self._part_path(1))
+        self.assertGreaterEqual(created[0].size, 20 * 1024**2)
+
+    def test_transaction_invalid(self):
+        """Verify that nothing is written if any of the queued changes is invalid"""
+
+        succ = BlockDev.part_create_table (self.loop_dev, BlockDev.PartTableType.GPT, True)
+        self.assertTrue(succ)
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_transaction_new ("/non/existing/device")
+
+        trans = BlockDev.part_transaction_new (self.loop_dev)
+
+        # invalid partition
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_transaction_delete_part (trans, "/non/existing/device")
+
+        succ = BlockDev.part_transaction_create_part (trans, BlockDev.PartTypeReq.NORMAL, 2048*512, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(succ)
+        # partition ID is not supported on GPT
+        succ = BlockDev.part_transaction_set_part_id (trans, self._part_path(1), "0x8e")
+        self.assertTrue(succ)
+
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_transaction_commit (trans)
+
+        # the first partition was not created
+        parts = BlockDev.part_get_disk_parts (self.loop_dev)
+        self.assertEqual(len(parts), 0)
+
+
+class PartTableCacheCase(PartTestCase):
+    def setUp(self):
+        super(PartTableCacheCase, self).setUp()
+        succ = BlockDev.part_set_table_cache(True)
+        self.assertTrue(succ)
+        self.addCleanup(BlockDev.part_set_table_cache, False)
+
+    def test_table_cache(self):
+        """Verify that the cached partition table is kept up to date"""
+
+        succ = BlockDev.part_create_table (self.loop_dev, BlockDev.PartTableType.GPT, True)
+        self.assertTrue(succ)
+
+        spec = BlockDev.part_get_disk_spec (self.loop_dev)
+        self.assertEqual(spec.table_type, BlockDev.PartTableType.GPT)
+        self.assertEqual(len(BlockDev.part_get_disk_parts (self.loop_dev)), 0)
+
+        # changes made by the plugin are visible immediately
+        ps = BlockDev.part_create_part (self.loop_dev, BlockDev.PartTypeReq.NORMAL, 2048 * 512, 10 * 1024**2, BlockDev.PartAlign.OPTIMAL)
+        self.assertTrue(ps)
+        parts = BlockDev.part_get_disk_parts (self.loop_dev)
+        self.assertEqual(len(parts), 1)
+        self.assertEqual(parts[0].path, ps.path)
+
+        spec = BlockDev.part_get_part_spec (self.loop_dev, ps.path)
+        self.assertEqual(spec.start, ps.start)
+        self.assertEqual(spec.size, ps.size)
+
+        # the same results as without the cache
+        cached_free = BlockDev.part_get_disk_free_regions (self.loop_dev)
+        cached_best = BlockDev.part_get_best_free_region (self.loop_dev, BlockDev.PartType.NORMAL, 10 * 1024**2)
+        cached_pos = BlockDev.part_get_part_by_pos (self.loop_dev, ps.start + 1)
+        BlockDev.part_set_table_cache(False)
+        self.assertEqual([(r.start, r.size) for r in cached_free],
+                         [(r.start, r.size) for r in BlockDev.part_get_disk_free_regions (self.loop_dev)])
+        best = BlockDev.part_get_best_free_region (self.loop_dev, BlockDev.PartType.NORMAL, 10 * 1024**2)
+        self.assertEqual((cached_best.start, cached_best.size), (best.start, best.size))
+        self.assertEqual(cached_pos.path, ps.path)
+        BlockDev.part_set_table_cache(True)
+
+        # nonexisting partitions are still reported as errors
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_get_part_spec (self.loop_dev, self.loop_dev + "p5")
+
+        # changes made by other tools are visible after udev processes the change event
+        BlockDev.part_get_disk_parts (self.loop_dev)
+        ret, _out, _err = run_command("sfdisk --delete %s 1" % self.loop_dev)
+        self.assertEqual(ret, 0)
+        run_command("udevadm settle")
+        self.assertEqual(len(BlockDev.part_get_disk_parts (self.loop_dev)), 0)
+
+        # explicit invalidation
+        succ = BlockDev.part_invalidate_table_cache (self.loop_dev)
+        self.assertTrue(succ)
+        succ = BlockDev.part_invalidate_table_cache (None)
+        self.assertTrue(succ)
+        self.assertEqual(len(BlockDev.part_get_disk_parts (self.loop_dev)), 0)
+
+
+class PartLayoutCase(PartTestCase):
+    @tag_test(TestTags.NOSTORAGE)
+    def test_plan_layout(self):
+        """Verify that partition layouts can be planned without any disk"""
+
+        geom = BlockDev.PartDiskGeometry()
+        geom.size = 100 * 1024**2
+        geom.sector_size = 512
+
+        reqs = [BlockDev.PartLayoutRequest(size=10 * 1024**2, name="efi"),
+                BlockDev.PartLayoutRequest(percent=25, name="boot"),
+                BlockDev.PartLayoutRequest(flags=BlockDev.PartLayoutFlags.GROW, name="root")]
+        layout = BlockDev.part_plan_layout(geom, BlockDev.PartTableType.GPT, reqs)
+        parts = [p for p in layout if p.type == BlockDev.PartType.NORMAL]
+        self.assertEqual(len(parts), 3)
+        self.assertEqual([p.name for p in parts], ["efi", "boot", "root"])
+
+        # aligned to 1 MiB, one after another
+        self.assertEqual(parts[0].start, 1024**2)
+        self.assertEqual(parts[0].size, 10 * 1024**2)
+        for prev, part in zip(parts, parts[1:]):
+            self.assertEqual(part.start, prev.start + prev.size)
+        for part in parts:
+            self.assertEqual(part.start % 1024**2, 0)
+            self.assertEqual(part.size % 1024**2, 0)
+
+        # the last partition takes everything up to the backup GPT header
+        self.assertEqual(parts[2].start + parts[2].size, 99 * 1024**2)
+
+        # MBR with logical partitions, each logical partition has space for its EBR in front of it
+        reqs = [BlockDev.PartLayoutRequest(size=10 * 1024**2, flags=BlockDev.PartLayoutFlags.BOOTABLE),
+                BlockDev.PartLayoutRequest(size=10 * 1024**2, flags=BlockDev.PartLayoutFlags.LOGICAL),
+                BlockDev.PartLayoutRequest(flags=BlockDev.PartLayoutFlags.LOGICAL | BlockDev.PartLayoutFlags.GROW)]
+        layout = BlockDev.part_plan_layout(geom, BlockDev.PartTableType.MSDOS, reqs)
+        self.assertEqual([p.type for p in layout],
+                         [BlockDev.PartType.NORMAL, BlockDev.PartType.EXTENDED,
+                          BlockDev.PartType.METADATA | BlockDev.PartType.LOGICAL, BlockDev.PartType.LOGICAL,
+                          BlockDev.PartType.METADATA | BlockDev.PartType.LOGICAL, BlockDev.PartType.LOGICAL])
+        self.assertTrue(layout[0].bootable)
+        self.assertEqual(layout[1].start + layout[1].size, geom.size)
+
+        # too big
+        with self.assertRaisesRegex(GLib.GError, "don't fit"):
+            BlockDev.part_plan_layout(geom, BlockDev.PartTableType.GPT, [BlockDev.PartLayoutRequest(size=200 * 1024**2)])
+
+        # logical partitions only on MBR
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_plan_layout(geom, BlockDev.PartTableType.GPT,
+                                      [BlockDev.PartLayoutRequest(size=10 * 1024**2, flags=BlockDev.PartLayoutFlags.LOGICAL)])
+
+        # no size given
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_plan_layout(geom, BlockDev.PartTableType.GPT, [BlockDev.PartLayoutRequest()])
+
+    def test_apply_layout(self):
+        """Verify that a planned partition layout can be applied to a disk"""
+
+        geom = BlockDev.part_get_disk_geometry(self.loop_dev)
+        self.assertEqual(geom.size, 100 * 1024**2)
+        self.assertEqual(geom.sector_size, self.block_size)
+
+        reqs = [BlockDev.PartLayoutRequest(size=10 * 1024**2, name="efi", type="C12A7328-F81F-11D2-BA4B-00A0C93EC93B"),
+                BlockDev.PartLayoutRequest(percent=25, name="boot"),
+                BlockDev.PartLayoutRequest(flags=BlockDev.PartLayoutFlags.GROW, name="root")]
+        layout = BlockDev.part_plan_layout(geom, BlockDev.PartTableType.GPT, reqs)
+        created = BlockDev.part_apply_layout(self.loop_dev, BlockDev.PartTableType.GPT, layout)
+        self.assertEqual(len(created), 3)
+
+        parts = BlockDev.part_get_disk_parts(self.loop_dev)
+        planned = [p for p in layout if p.type == BlockDev.PartType.NORMAL]
+        self.assertEqual([(p.start, p.size, p.name) for p in parts],
+                         [(p.start, p.size, p.name) for p in planned])
+        self.assertEqual(parts[0].type_guid, "C12A7328-F81F-11D2-BA4B-00A0C93EC93B")
+
+        # the same with MBR and logical partitions
+        reqs = [BlockDev.PartLayoutRequest(size=10 * 1024**2, flags=BlockDev.PartLayoutFlags.BOOTABLE),
+                BlockDev.PartLayoutRequest(size=10 * 1024**2, flags=BlockDev.PartLayoutFlags.LOGICAL, type="0x8e"),
+                BlockDev.PartLayoutRequest(flags=BlockDev.PartLayoutFlags.LOGICAL | BlockDev.PartLayoutFlags.GROW)]
+        layout = BlockDev.part_plan_layout(geom, BlockDev.PartTableType.MSDOS, reqs)
+
+        # there's a partition table already
+        with self.assertRaises(GLib.GError):
+            BlockDev.part_apply_layout(self.loop_dev, BlockDev.PartTableType.MSDOS, layout, False)
+
+        created = BlockDev.part_apply_layout(self.loop_dev, BlockDev.PartTableType.MSDOS, layout)
+        self.assertEqual(len(created), 3)
+        self.assertTrue(created[0].bootable)
+        self.assertEqual(created[1].id, "0x8e")
+
+        parts = BlockDev.part_get_disk_parts(self.loop_dev)
+        planned = [p for p in layout if not p.type & (BlockDev.PartType.METADATA | BlockDev.PartType.FREESPACE)]
+        self.assertEqual([(p.start, p.size, p.type) for p in parts],
+                         [(p.start, p.size, p.type) for p in planned])
+
+
 class PartNoDevCase(PartTestCase):
 
     def setUp(self):
@@ -245,3 +245,29 @@ class SMARTTest(unittest.TestCase):
                     self.assertGreater(attr.id, 0)
                     self.assertGreater(len(attr.name), 0)
                     self.assertGreater(len(attr.pretty_value_string), 0)
+
+    @tag_test(TestTags.SLOW)
+    def test_ata_drivedb_lookup_benchmark(self):
+        """Benchmark the drivedb index build and uncached lookups on the supplied skdump blobs"""
+
+        blobs = []
+        for d in self.SKDUMPS:
+            with open(os.path.join("tests", "smart_dumps", "%s.bin" % d), "rb") as f:
+                blobs.append(f.read())
+
+        rounds = 20
+        elapsed = 0
+        for _i in range(rounds):
+            # reloading the plugin frees the drivedb index together with its
+            # lookup cache so every round starts with a cold index and none of
+            # the lookups (all the dumps are from different drives) is cached
+            BlockDev.reinit([self.ps, self.ps2], True, None)
+
+            start = time.monotonic()
+            for blob in blobs:
+                BlockDev.smart_ata_get_info_from_data(blob)
+            elapsed += time.monotonic() - start
+
+        # a generous limit, building the index and the lookups should only take a few milliseconds
+        self.assertLess(elapsed / rounds, 0.5,
+                        "%d index builds with %d lookups each took %.3f s" % (rounds, len(blobs), elapsed))
@@ -1,6 +1,7 @@
 import unittest
 import os
 import re
+import struct
 import glob
 import time
 import shutil
@@ -22,6 +23,12 @@ class SmartmontoolsTest(unittest.TestCase):
                       "HGST_HUS726060ALA640", "INTEL_SSDSC2BB120G4L", "WDC_WD10EFRX-68PJCN0"]
     SCSI_JSON_DUMPS = ["WD4001FYYG-01SL3", "HGST_HUSMR3280ASS200", "SEAGATE_ST600MP0036",
                       "TOSHIBA_AL15SEB120NY", "TOSHIBA_AL15SEB18EQY", "TOSHIBA_KPM5XMUG400G"]
+    # raw ATA structures (libatasmart skdumps) from real drives, both HDD and SSD
+    SKDUMPS = ["TOSHIBA_THNSNH128GBST", "Hitachi_HDS721010CLA632", "WDC_WD20EARS-00MVWB0",
+               "SAMSUNG_HS122JC", "SAMSUNG_MMCRE28G5MXP-0VBH1", "IBM_IC25N020ATCS04-0",
+               "Maxtor_6Y120P0", "SiliconPower_SSD_SBFM61.3", "Patriot_Burst_240GB",
+               "KINGSTON_SA400S37480G_SBFKQ13", "KINGSTON_SA400S37240G_SBFK71B1",
+               "GIGABYTE_GP-GSTFS31100TNTD", "Biwintech_SSD_SX500"]
 
     @classmethod
     def setUpClass(cls):
@@ -198,6 +205,69 @@ class SmartmontoolsTest(unittest.TestCase):
                     self.assertGreater(len(attr.name), 0)
                     self.assertGreater(len(attr.pretty_value_string), 0)
 
+    @tag_test(TestTags.CORE)
+    def test_ata_real_skdumps_by_blob(self):
+        """Test SMART ATA info on supplied skdump blobs decoded by the native reader"""
+
+        for d in self.SKDUMPS:
+            with open(os.path.join("tests", "smart_dumps", "%s.bin" % d), "rb") as f:
+                content = f.read()
+                data = BlockDev.smart_ata_get_info_from_data(content)
+                self.assertIsNotNone(data)
+                self.assertGreater(data.power_cycle_count, 0)
+                self.assertGreater(data.power_on_time, 0)
+                self.assertGreater(data.smart_capabilities, 0)
+                self.assertTrue(data.smart_enabled)
+                self.assertTrue(data.smart_supported)
+                self.assertLess(data.temperature, 320)
+                self.assertGreater(len(data.attributes), 0)
+                for attr in data.attributes:
+                    self.assertGreater(attr.id, 0)
+                    self.assertGreater(len(attr.name), 0)
+                    self.assertGreater(len(attr.pretty_value_string), 0)
+
+        with open(os.path.join("tests", "smart_dumps", "Hitachi_HDS721010CLA632.bin"), "rb") as f:
+            content = f.read()
+
+        data = BlockDev.smart_ata_get_info_from_data(content)
+        self.assertTrue(data.overall_status_passed)
+        self.assertEqual(data.power_on_time, 8055 * 60)
+        self.assertEqual(data.power_cycle_count, 44)
+        self.assertEqual(data.temperature, 30 + 273)
+        self.assertEqual(data.self_test_polling_short, 2)
+        self.assertEqual(data.self_test_polling_extended, 167)
+
+        # truncated blob
+        msg = r"Error getting ATA SMART info: Error parsing blob data: truncated 'SMDT' section"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_ata_get_info_from_data(content[:600])
+
+        # corrupted SMART data (checksum mismatch), the SMDT section data start at offset 540
+        corrupted = bytearray(content)
+        corrupted[540 + 100] ^= 0xff
+        msg = r"Error getting ATA SMART info: Checksum error in the SMART data structure"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_ata_get_info_from_data(bytes(corrupted))
+
+    @tag_test(TestTags.CORE)
+    def test_ata_drivedb_firmware(self):
+        """Test that drivedb entries specific to a firmware revision are used"""
+
+        # Hitachi_HDS721010CLA632 dump with the IDENTIFY data of a Crucial m4 with
+        # the fixed firmware that has its own entry in the drive database
+        with open(os.path.join("tests", "smart_dumps", "Crucial_M4-CT128M4SSD2_0309.bin"), "rb") as f:
+            content = f.read()
+        data = BlockDev.smart_ata_get_info_from_data(content)
+        self.assertIsNotNone(data)
+
+        names = dict((attr.id, attr.name) for attr in data.attributes)
+        # names from the drivedb entry instead of the defaults (Runtime_Bad_Block, High_Fly_Writes)
+        self.assertEqual(names[183], "SATA_Iface_Downshift")
+        self.assertEqual(names[189], "Factory_Bad_Block_Ct")
+        # not redefined by the entry
+        self.assertEqual(names[9], "Power_On_Hours")
+        self.assertEqual(names[194], "Temperature_Celsius")
+
     @tag_test(TestTags.CORE)
     def test_ata_error_dumps(self):
         """Test SMART ATA info on supplied JSON dumps (error cases)"""
@@ -408,6 +478,116 @@ class SmartmontoolsTest(unittest.TestCase):
         with self.assertRaisesRegex(GLib.GError, msg):
             BlockDev.smart_scsi_get_info(self.scsi_debug_dev, [BlockDev.ExtraArg.new("--device=ata", "")])
 
+    def _scsi_log_page(self, page, params):
+        """Returns a LOG SENSE response with the given (code, value bytes) parameters"""
+        data = b"".join(struct.pack(">HBB", code, 0x03, len(value)) + value for code, value in params)
+        return struct.pack(">BBH", page, 0, len(data)) + data
+
+    def _scsi_supported_pages(self, pages):
+        """Returns a LOG SENSE response listing the supported log pages"""
+        return struct.pack(">BBH", 0x00, 0, len(pages)) + bytes(pages)
+
+    def _scsi_dump(self, sections):
+        """Returns a SCSI pages blob with the given (tag, data) sections"""
+        return b"".join(tag.encode("ascii") + struct.pack(">I", len(data)) + data for tag, data in sections)
+
+    def _scsi_dump_sections(self, power_on_minutes):
+        """Returns the SCSI pages matching the SEAGATE_ST600MP0036 JSON dump"""
+        def counters(eccfast, total, processed, uncorrected):
+            return [(0x0000, struct.pack(">I", eccfast)), (0x0001, struct.pack(">I", 0)),
+                    (0x0002, struct.pack(">I", 0)), (0x0003, struct.pack(">I", total)),
+                    (0x0004, struct.pack(">I", 0)), (0x0005, struct.pack(">Q", processed)),
+                    (0x0006, struct.pack(">I", uncorrected))]
+
+        # the Informational Exceptions Control mode page without block descriptors,
+        # SMART enabled (DEXCPT unset) and no temperature warning (EWASC unset)
+        ie_control = struct.pack(">HBBHH", 18, 0, 0, 0, 0) + bytes([0x1c, 0x0a, 0x00, 0x04]) + bytes(8)
+
+        return [("LP00", self._scsi_supported_pages([0x00, 0x02, 0x03, 0x0d, 0x0e, 0x15, 0x2f])),
+                ("MP1C", ie_control),
+                ("LP2F", self._scsi_log_page(0x2f, [(0x0000, bytes([0x00, 0x00, 29]))])),
+                ("LP0D", self._scsi_log_page(0x0d, [(0x0000, bytes([0, 29])), (0x0001, bytes([0, 60]))])),
+                ("LP03", self._scsi_log_page(0x03, counters(170693715, 170693715, 88818000000, 0))),
+                ("LP02", self._scsi_log_page(0x02, counters(0, 0, 2256473000000, 0))),
+                ("LP0E", self._scsi_log_page(0x0e, [(0x0003, struct.pack(">I", 10000)), (0x0004, struct.pack(">I", 1090)),
+                                                    (0x0005, struct.pack(">I", 300000)), (0x0006, struct.pack(">I", 1181))])),
+                ("LP15", self._scsi_log_page(0x15, [(0x0000, struct.pack(">IBBHHH", power_on_minutes, 0, 0, 0, 0, 0))])),
+                ("GDEF", struct.pack(">I", 0))]
+
+    @tag_test(TestTags.CORE)
+    def test_scsi_dumps_by_blob(self):
+        """Test SMART SCSI info on raw SCSI pages decoded by the native reader"""
+
+        with open(os.path.join("tests", "smart_dumps", "SEAGATE_ST600MP0036.json"), "rb") as f:
+            expected = BlockDev.smart_scsi_get_info_from_data(f.read())
+
+        sections = self._scsi_dump_sections(expected.power_on_time)
+        data = BlockDev.smart_scsi_get_info_from_data(self._scsi_dump(sections))
+        self.assertIsNotNone(data)
+
+        # the native reader should give the same results as smartctl
+        for field in ("overall_status_passed", "smart_supported", "smart_enabled", "temperature_warning_enabled",
+                      "scsi_ie", "scsi_ie_asc", "scsi_ie_ascq", "scsi_ie_string", "background_scan_status",
+                      "background_scan_progress", "background_scan_runs", "background_medium_scan_runs",
+                      "read_errors_corrected_eccfast", "read_errors_corrected_eccdelayed",
+                      "read_errors_corrected_rereads", "read_errors_corrected_total", "read_errors_uncorrected",
+                      "write_errors_corrected_eccfast", "write_errors_corrected_eccdelayed",
+                      "write_errors_corrected_rewrites", "write_errors_corrected_total", "write_errors_uncorrected",
+                      "start_stop_cycle_count", "start_stop_cycle_lifetime", "load_unload_cycle_count",
+                      "load_unload_cycle_lifetime", "scsi_grown_defect_list", "temperature",
+                      "temperature_drive_trip", "power_on_time"):
+            self.assertEqual(getattr(data, field), getattr(expected, field), field)
+        # smartctl rounds the processed bytes to megabytes
+        self.assertAlmostEqual(data.read_processed_bytes, expected.read_processed_bytes, delta=1000000)
+        self.assertAlmostEqual(data.write_processed_bytes, expected.write_processed_bytes, delta=1000000)
+
+        # informational exception reported
+        failing = [(tag, self._scsi_log_page(0x2f, [(0x0000, bytes([0x5d, 0x00, 29]))]) if tag == "LP2F" else page)
+                   for tag, page in sections]
+        data = BlockDev.smart_scsi_get_info_from_data(self._scsi_dump(failing))
+        self.assertFalse(data.overall_status_passed)
+        self.assertEqual(data.scsi_ie_asc, 0x5d)
+        self.assertEqual(data.scsi_ie_ascq, 0x00)
+        self.assertEqual(data.scsi_ie_string, "Informational Exception [asc=0x5d, ascq=0x00]")
+
+        # optional pages missing
+        data = BlockDev.smart_scsi_get_info_from_data(self._scsi_dump([(tag, page) for tag, page in sections
+                                                                       if tag not in ("MP1C", "LP0E", "LP15", "GDEF")]))
+        self.assertFalse(data.smart_supported)
+        self.assertEqual(data.start_stop_cycle_count, 0)
+        self.assertEqual(data.power_on_time, 0)
+        self.assertEqual(data.temperature, 29 + 273)
+
+        # required page not supported by the device
+        no_ie = [(tag, self._scsi_supported_pages([0x00, 0x02, 0x03, 0x0d]) if tag == "LP00" else page)
+                 for tag, page in sections]
+        msg = r"Error getting SCSI SMART info: Device doesn't provide the 0x2f log page"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_scsi_get_info_from_data(self._scsi_dump(no_ie))
+
+        # required page missing in the dump
+        msg = r"Error getting SCSI SMART info: Error parsing blob data: missing 'LP0D' section"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_scsi_get_info_from_data(self._scsi_dump([(tag, page) for tag, page in sections if tag != "LP0D"]))
+
+        # truncated blob
+        blob = self._scsi_dump(sections)
+        msg = r"Error getting SCSI SMART info: Error parsing blob data: truncated 'LP2F' section"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_scsi_get_info_from_data(blob[:blob.index(b"LP2F") + 12])
+
+    @tag_test(TestTags.NOSTORAGE)
+    def test_get_info_native(self):
+        """Test that the native SMART info functions fail on a non-existing device"""
+
+        msg = r"Error getting ATA SMART info: Failed to open device '/dev/nonexistent'"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_ata_get_info_native("/dev/nonexistent")
+
+        msg = r"Error getting SCSI SMART info: Failed to open device '/dev/nonexistent'"
+        with self.assertRaisesRegex(GLib.GError, msg):
+            BlockDev.smart_scsi_get_info_native("/dev/nonexistent")
+
     @tag_test(TestTags.CORE)
     def test_scsi_real_dumps(self):
         """Test SMART SCSI info on supplied JSON dumps (from real devices)"""